@@ -0,0 +1,329 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief malloc interposer counting allocations per thread, stage and frame, see alloc_tracker.h.
+ *
+ * Only built with -DALLOC_TRACKER=ON. Nothing in here may allocate while counting, the report of
+ * a steady state allocation formats into a stack buffer and writes it with write(2).
+ */
+
+#include "alloc_tracker.h"
+#include "frame_timing.h"
+
+#include <errno.h>
+#include <execinfo.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// glibc's allocator behind the interposed functions
+extern void*
+__libc_malloc(size_t size);
+extern void*
+__libc_calloc(size_t count, size_t size);
+extern void*
+__libc_realloc(void* ptr, size_t size);
+extern void
+__libc_free(void* ptr);
+extern void*
+__libc_memalign(size_t alignment, size_t size);
+
+// the stage arrays are indexed by enum frame_stage, a new frame stage must not read past them
+_Static_assert(ALLOC_TRACKER_STAGES >= FRAME_STAGE_COUNT, "allocation tracker stages too few");
+
+// slot 0 counts every thread that did not call alloc_tracker_set_thread()
+#define TRACKER_THREADS 16
+// steady state allocations per thread that get a backtrace in ALLOC_TRACKER_WARN
+#define REPORTED_STEADY_ALLOCS 8
+#define BACKTRACE_DEPTH 16
+
+struct thread_counts
+{
+	const char* name;
+	// named threads are checked after the steady state marker
+	bool checked;
+
+	// bumped by the interposer on the thread itself, alloc_tracker_print() reads them at exit
+	// while driver threads may still allocate
+	_Atomic uint64_t allocs;
+	_Atomic uint64_t bytes;
+	_Atomic uint64_t frees;
+	_Atomic uint64_t steady_allocs;
+	_Atomic uint64_t stage_allocs[ALLOC_TRACKER_STAGES];
+	_Atomic uint64_t stage_bytes[ALLOC_TRACKER_STAGES];
+};
+
+static struct
+{
+	struct thread_counts threads[TRACKER_THREADS];
+	_Atomic uint32_t thread_count;
+
+	_Atomic uint64_t allocs;
+	_Atomic uint64_t bytes;
+
+	_Atomic bool steady;
+	enum alloc_tracker_mode mode;
+	uint64_t steady_frame;
+
+	// only the thread calling alloc_tracker_frame()
+	uint64_t frames;
+	uint64_t first_allocs;
+	uint64_t first_bytes;
+	uint64_t last_allocs;
+	uint64_t last_bytes;
+	uint64_t frames_allocating;
+	uint64_t max_frame_allocs;
+	uint64_t max_frame_bytes;
+	uint64_t steady_start_frame;
+	uint64_t steady_start_allocs;
+	uint64_t steady_start_bytes;
+} tracker = {.threads = {{.name = "(unnamed)"}}, .thread_count = 1};
+
+static _Thread_local struct thread_counts* thread_slot;
+// allocations since the previous stage of this thread
+static _Thread_local uint64_t pending_allocs;
+static _Thread_local uint64_t pending_bytes;
+// the first stage end only starts attributing
+static _Thread_local bool staged;
+// set while reporting, backtrace() may allocate on its first call
+static _Thread_local bool reporting;
+
+static struct thread_counts*
+current_thread(void)
+{
+	return thread_slot != NULL ? thread_slot : &tracker.threads[0];
+}
+
+static void
+report_steady_alloc(struct thread_counts* thread, size_t size)
+{
+	uint64_t count =
+	    atomic_fetch_add_explicit(&thread->steady_allocs, 1, memory_order_relaxed) + 1;
+	if (tracker.mode != ALLOC_TRACKER_ABORT && count > REPORTED_STEADY_ALLOCS)
+		return;
+
+	reporting = true;
+	char msg[160];
+	int len = snprintf(msg, sizeof(msg), "Allocation of %zu bytes on thread %s in steady state%s\n",
+	                   size, thread->name, tracker.mode == ALLOC_TRACKER_ABORT ? ", aborting" : "");
+	if (len > 0) {
+		ssize_t written = write(STDERR_FILENO, msg, (size_t)len);
+		(void)written;
+	}
+	void* frames[BACKTRACE_DEPTH];
+	int depth = backtrace(frames, BACKTRACE_DEPTH);
+	backtrace_symbols_fd(frames, depth, STDERR_FILENO);
+	reporting = false;
+
+	if (tracker.mode == ALLOC_TRACKER_ABORT)
+		abort();
+}
+
+static void
+count_alloc(size_t size)
+{
+	struct thread_counts* thread = current_thread();
+	atomic_fetch_add_explicit(&thread->allocs, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&thread->bytes, size, memory_order_relaxed);
+	atomic_fetch_add_explicit(&tracker.allocs, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&tracker.bytes, size, memory_order_relaxed);
+	pending_allocs++;
+	pending_bytes += size;
+
+	if (thread->checked && !reporting && atomic_load_explicit(&tracker.steady, memory_order_relaxed))
+		report_steady_alloc(thread, size);
+}
+
+static void
+count_free(void)
+{
+	atomic_fetch_add_explicit(&current_thread()->frees, 1, memory_order_relaxed);
+}
+
+void*
+malloc(size_t size)
+{
+	void* ptr = __libc_malloc(size);
+	if (ptr != NULL)
+		count_alloc(size);
+	return ptr;
+}
+
+void*
+calloc(size_t count, size_t size)
+{
+	void* ptr = __libc_calloc(count, size);
+	if (ptr != NULL)
+		count_alloc(count * size);
+	return ptr;
+}
+
+void*
+realloc(void* ptr, size_t size)
+{
+	void* new_ptr = __libc_realloc(ptr, size);
+	// realloc(ptr, 0) frees, every other call may move the block and counts as an allocation
+	if (new_ptr != NULL)
+		count_alloc(size);
+	else if (ptr != NULL && size == 0)
+		count_free();
+	return new_ptr;
+}
+
+void
+free(void* ptr)
+{
+	if (ptr != NULL)
+		count_free();
+	__libc_free(ptr);
+}
+
+void*
+memalign(size_t alignment, size_t size)
+{
+	void* ptr = __libc_memalign(alignment, size);
+	if (ptr != NULL)
+		count_alloc(size);
+	return ptr;
+}
+
+void*
+aligned_alloc(size_t alignment, size_t size)
+{
+	return memalign(alignment, size);
+}
+
+int
+posix_memalign(void** out, size_t alignment, size_t size)
+{
+	if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0)
+		return EINVAL;
+	void* ptr = memalign(alignment, size);
+	if (ptr == NULL)
+		return ENOMEM;
+	*out = ptr;
+	return 0;
+}
+
+void
+alloc_tracker_set_thread(const char* name)
+{
+	uint32_t index = atomic_fetch_add(&tracker.thread_count, 1);
+	if (index >= TRACKER_THREADS)
+		return;
+	tracker.threads[index].name = name;
+	tracker.threads[index].checked = true;
+	thread_slot = &tracker.threads[index];
+	// what the thread allocated while starting up belongs to no stage
+	pending_allocs = 0;
+	pending_bytes = 0;
+}
+
+void
+alloc_tracker_configure(uint64_t steady_frame, enum alloc_tracker_mode mode)
+{
+	tracker.steady_frame = steady_frame;
+	tracker.mode = mode;
+}
+
+void
+alloc_tracker_steady(void)
+{
+	tracker.steady_start_frame = tracker.frames;
+	tracker.steady_start_allocs = atomic_load(&tracker.allocs);
+	tracker.steady_start_bytes = atomic_load(&tracker.bytes);
+	atomic_store(&tracker.steady, true);
+}
+
+void
+alloc_tracker_stage_end(uint32_t stage)
+{
+	struct thread_counts* thread = current_thread();
+	if (staged && stage < ALLOC_TRACKER_STAGES) {
+		atomic_fetch_add_explicit(&thread->stage_allocs[stage], pending_allocs, memory_order_relaxed);
+		atomic_fetch_add_explicit(&thread->stage_bytes[stage], pending_bytes, memory_order_relaxed);
+	}
+	staged = true;
+	pending_allocs = 0;
+	pending_bytes = 0;
+}
+
+void
+alloc_tracker_frame(void)
+{
+	uint64_t allocs = atomic_load_explicit(&tracker.allocs, memory_order_relaxed);
+	uint64_t bytes = atomic_load_explicit(&tracker.bytes, memory_order_relaxed);
+	// the first frame also carries everything allocated during startup
+	if (tracker.frames == 0) {
+		tracker.first_allocs = allocs;
+		tracker.first_bytes = bytes;
+	} else {
+		uint64_t frame_allocs = allocs - tracker.last_allocs;
+		uint64_t frame_bytes = bytes - tracker.last_bytes;
+		if (frame_allocs > 0)
+			tracker.frames_allocating++;
+		if (frame_allocs > tracker.max_frame_allocs)
+			tracker.max_frame_allocs = frame_allocs;
+		if (frame_bytes > tracker.max_frame_bytes)
+			tracker.max_frame_bytes = frame_bytes;
+	}
+	tracker.last_allocs = allocs;
+	tracker.last_bytes = bytes;
+	tracker.frames++;
+
+	if (tracker.steady_frame > 0 && tracker.frames == tracker.steady_frame)
+		alloc_tracker_steady();
+}
+
+void
+alloc_tracker_print(void)
+{
+	// stdio allocates its buffers, the report is not part of the steady state
+	bool steady = atomic_exchange(&tracker.steady, false);
+	uint64_t allocs = atomic_load(&tracker.allocs);
+	uint64_t bytes = atomic_load(&tracker.bytes);
+	printf("Allocations: %lu, %.1f KiB in total\n", (unsigned long)allocs, bytes / 1024.);
+
+	if (tracker.frames > 1) {
+		uint64_t frames = tracker.frames - 1;
+		printf("  per frame over %lu frames: %.2f allocations, %.1f bytes on average, max %lu "
+		       "allocations, %lu bytes, %lu frames allocated\n",
+		       (unsigned long)frames, (double)(tracker.last_allocs - tracker.first_allocs) / frames,
+		       (double)(tracker.last_bytes - tracker.first_bytes) / frames,
+		       (unsigned long)tracker.max_frame_allocs, (unsigned long)tracker.max_frame_bytes,
+		       (unsigned long)tracker.frames_allocating);
+	}
+
+	uint64_t steady_allocs = 0;
+	uint32_t thread_count = atomic_load(&tracker.thread_count);
+	if (thread_count > TRACKER_THREADS)
+		thread_count = TRACKER_THREADS;
+	for (uint32_t i = 0; i < thread_count; i++)
+		steady_allocs += atomic_load(&tracker.threads[i].steady_allocs);
+	if (steady) {
+		printf("  steady state since frame %lu: %lu allocations on named threads, %lu (%.1f KiB) "
+		       "on all\n",
+		       (unsigned long)tracker.steady_start_frame, (unsigned long)steady_allocs,
+		       (unsigned long)(allocs - tracker.steady_start_allocs),
+		       (bytes - tracker.steady_start_bytes) / 1024.);
+	}
+
+	printf("  %-12s %10s %12s %10s %8s\n", "thread", "allocs", "KiB", "frees", "steady");
+	for (uint32_t i = 0; i < thread_count; i++) {
+		struct thread_counts* thread = &tracker.threads[i];
+		printf("  %-12s %10lu %12.1f %10lu %8lu\n", thread->name,
+		       (unsigned long)atomic_load(&thread->allocs), atomic_load(&thread->bytes) / 1024.,
+		       (unsigned long)atomic_load(&thread->frees),
+		       (unsigned long)atomic_load(&thread->steady_allocs));
+		for (int stage = 0; stage < FRAME_STAGE_COUNT; stage++) {
+			uint64_t stage_allocs = atomic_load(&thread->stage_allocs[stage]);
+			if (stage_allocs == 0)
+				continue;
+			printf("    %-21s %10lu %12.1f\n", frame_timing_stage_name(stage),
+			       (unsigned long)stage_allocs, atomic_load(&thread->stage_bytes[stage]) / 1024.);
+		}
+	}
+}
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Optional malloc interposer that counts allocations per thread, frame stage and frame.
+ *
+ * Built with -DALLOC_TRACKER=ON, alloc_tracker.c defines malloc(), calloc(), realloc(), free() and
+ * the aligned variants for the whole process, GL driver and libraries included, and forwards them
+ * to glibc's __libc_*() functions. Without it all calls below are empty inline functions.
+ *
+ * Every allocation is counted for the calling thread, threads announce themselves with
+ * alloc_tracker_set_thread(). frame_timing_add() attributes the allocations a thread made since
+ * its previous stage to the stage that just ended, those before its first stage stay unattributed.
+ * alloc_tracker_frame(), called once per committed or replayed frame, takes the process wide
+ * counts per frame.
+ *
+ * After the steady state marker, alloc_tracker_steady() or the configured frame, every allocation
+ * on a named thread is reported with a backtrace on stderr (the first few) or aborts the process.
+ * Unnamed threads, like the GL driver's or the logger's, are counted but not checked.
+ */
+
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+#include <stdint.h>
+
+enum alloc_tracker_mode
+{
+	ALLOC_TRACKER_WARN,
+	ALLOC_TRACKER_ABORT,
+};
+
+// frame stages attributed per thread, at least FRAME_STAGE_COUNT (asserted in alloc_tracker.c)
+#define ALLOC_TRACKER_STAGES 16
+
+#ifdef ALLOC_TRACKER
+
+// at most 15 threads get their own counters, later ones share the unnamed ones. name has to be a
+// string literal.
+void
+alloc_tracker_set_thread(const char* name);
+
+// steady state starts after steady_frame calls of alloc_tracker_frame(), 0 only with
+// alloc_tracker_steady()
+void
+alloc_tracker_configure(uint64_t steady_frame, enum alloc_tracker_mode mode);
+
+void
+alloc_tracker_steady(void);
+
+// called by frame_timing_add()
+void
+alloc_tracker_stage_end(uint32_t stage);
+
+void
+alloc_tracker_frame(void);
+
+// per thread, stage and frame counts to stdout
+void
+alloc_tracker_print(void);
+
+#else
+
+static inline void
+alloc_tracker_set_thread(const char* name)
+{}
+
+static inline void
+alloc_tracker_configure(uint64_t steady_frame, enum alloc_tracker_mode mode)
+{}
+
+static inline void
+alloc_tracker_steady(void)
+{}
+
+static inline void
+alloc_tracker_stage_end(uint32_t stage)
+{}
+
+static inline void
+alloc_tracker_frame(void)
+{}
+
+static inline void
+alloc_tracker_print(void)
+{}
+
+#endif
+
+#endif // ALLOC_TRACKER_H
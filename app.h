@@ -0,0 +1,389 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Application state shared by the frame loop in main.c and the renderer.
+ */
+
+#ifndef APP_H
+#define APP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __linux__
+
+// Required headers for OpenGL rendering, as well as for including openxr_platform
+#define GL_GLEXT_PROTOTYPES
+#define GL3_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+// Required headers for windowing, as well as the XrGraphicsBindingOpenGLXlibKHR struct.
+#include <X11/Xlib.h>
+#include <GL/glx.h>
+
+#define XR_USE_PLATFORM_XLIB
+#define XR_USE_GRAPHICS_API_OPENGL
+#include "openxr_headers/openxr.h"
+#include "openxr_headers/openxr_platform.h"
+#include "openxr_headers/openxr_reflection.h"
+
+#else
+#error Only Linux/XLib supported for now
+#endif
+
+#include "xr_linear.h"
+
+#define HAND_LEFT_INDEX 0
+#define HAND_RIGHT_INDEX 1
+#define HAND_COUNT 2
+
+// how render_frame_stereo() renders both views into the layers of an array texture in one pass
+enum stereo_mode
+{
+	// one swapchain per view, render_frame() is called once per view
+	STEREO_OFF = 0,
+	// pick the first supported of the modes below
+	STEREO_AUTO,
+	// GL_OVR_multiview, the driver broadcasts each draw to both layers
+	STEREO_MULTIVIEW,
+	// every object is drawn twice with instancing, the vertex shader selects the layer
+	// (GL_ARB_shader_viewport_layer_array)
+	STEREO_VERTEX_LAYER,
+	// like STEREO_VERTEX_LAYER, but a geometry shader selects the layer
+	STEREO_GEOMETRY_SHADER,
+};
+
+enum mesh_id
+{
+	// the textured rectangle showing the video frame
+	MESH_RECTANGLE = 0,
+	// unit cube, drawn instanced
+	MESH_CUBE,
+	MESH_COUNT,
+};
+
+// one object of the draw list, the model matrix and color are also the per instance vertex data of
+// the instanced cube draw
+struct draw_item_t
+{
+	float model[16];
+	float color[4];
+};
+
+#define DRAW_ITEM_NONE UINT32_MAX
+
+// everything visible in a frame, built once by prepare_scene() and replayed for every view with the
+// view's camera. Items are sorted by mesh, the items of one mesh are contiguous.
+struct draw_list_t
+{
+	struct draw_item_t* items;
+	uint32_t count;
+	uint32_t mesh_first[MESH_COUNT];
+	uint32_t mesh_count[MESH_COUNT];
+
+	// items in the order they were added and their mesh ids, sorted into items when the list is
+	// finished
+	struct draw_item_t* staging;
+	uint8_t* staging_mesh;
+	uint32_t staging_count;
+	uint32_t staging_mesh_count[MESH_COUNT];
+	uint32_t capacity;
+
+	// position of each hand joint among the cube items, DRAW_ITEM_NONE if it is not drawn. Lets a
+	// late latch replace the joint matrices after the list is finished.
+	uint32_t joint_items[HAND_COUNT][XR_HAND_JOINT_COUNT_EXT];
+
+	// the cube items still have to be copied into the instance buffer
+	bool dirty;
+};
+
+// GL objects of the instanced cube draw
+struct gl_instances_t
+{
+	GLuint program_id;
+	GLuint vao;
+	GLuint vbo;
+
+	// capacity of the GL buffer in instances
+	uint32_t buffer_capacity;
+};
+
+// std140 uniform blocks shared by both programs. The camera buffer has one slot per render pass
+// (per view, or one for both views in the stereo modes), the material buffer one slot per item drawn
+// with the textured program. Slots are padded to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+struct gl_uniform_buffers_t
+{
+	GLuint camera;
+	GLuint material;
+	GLsizeiptr camera_stride;
+	GLsizeiptr material_stride;
+	uint32_t camera_slots;
+
+	// CPU copy of the material slots, capacity in slots
+	uint8_t* material_staging;
+	uint32_t material_capacity;
+};
+
+struct gl_renderer_t
+{
+	// To render into a texture we need a framebuffer (one per texture to make it easy)
+	GLuint** framebuffers;
+
+	float near_z;
+	float far_z;
+
+	GLuint shader_program_id;
+	GLuint* VAOs;
+
+	struct
+	{
+		bool initialized;
+		GLuint texture;
+		GLuint fbo;
+	} quad;
+
+	struct gl_instances_t instances;
+	struct gl_uniform_buffers_t uniforms;
+	struct draw_list_t draw_list;
+
+	// requested before init_gl(), which resolves STEREO_AUTO
+	enum stereo_mode stereo_mode;
+	// only needed for STEREO_MULTIVIEW, looked up by the window system code
+	PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC FramebufferTextureMultiviewOVR;
+};
+
+enum mirror_mode
+{
+	// the desktop window stays hidden
+	MIRROR_OFF = 0,
+	// blit and swap on the rendering thread every mirror_every frames
+	MIRROR_EVERY,
+	// downscale into a texture and blit and swap on a separate context after xrEndFrame()
+	MIRROR_ASYNC,
+};
+
+struct swapchain_t
+{
+	uint32_t* swapchain_lengths;
+	XrSwapchainImageOpenGLKHR** images;
+	XrSwapchain* swapchains;
+	uint32_t swapchain_count;
+};
+
+struct quad_layer_t
+{
+	// quad layers are placed into world space, no need to render them per eye
+	struct swapchain_t swapchain;
+	uint32_t pixel_width, pixel_height;
+};
+
+struct action_t
+{
+	XrAction action;
+	XrActionType action_type;
+	union {
+		XrActionStateFloat float_;
+		XrActionStateBoolean boolean_;
+		XrActionStatePose pose_;
+		XrActionStateVector2f vec2f_;
+	} states[HAND_COUNT];
+	XrSpace pose_spaces[HAND_COUNT];
+	XrSpaceLocation pose_locations[HAND_COUNT];
+	XrSpaceVelocity pose_velocities[HAND_COUNT];
+
+	// the subaction paths this action was created with
+	XrPath* subaction_paths;
+	uint32_t subaction_path_count;
+
+	// enum rec_action_id used when recording this action
+	uint32_t record_id;
+};
+
+struct base_extension_t
+{
+	bool supported;
+	uint32_t version;
+
+	char* ext_name_string;
+};
+
+struct opengl_t
+{
+	struct base_extension_t base;
+
+	// functions belonging to extensions must be loaded with xrGetInstanceProcAddr before use
+	PFN_xrGetOpenGLGraphicsRequirementsKHR xrGetOpenGLGraphicsRequirementsKHR;
+};
+
+struct hand_tracking_t
+{
+	struct base_extension_t base;
+
+	// whether the current VR system in use has hand tracking
+	bool system_supported;
+	XrHandTrackerEXT trackers[HAND_COUNT];
+
+	// out data
+	XrHandJointLocationEXT joints[HAND_COUNT][XR_HAND_JOINT_COUNT_EXT];
+	XrHandJointLocationsEXT joint_locations[HAND_COUNT];
+
+	// optional
+	XrHandJointVelocitiesEXT joint_velocities[HAND_COUNT];
+	XrHandJointVelocityEXT joint_velocities_arr[HAND_COUNT][XR_HAND_JOINT_COUNT_EXT];
+
+	PFN_xrLocateHandJointsEXT xrLocateHandJointsEXT;
+	PFN_xrCreateHandTrackerEXT xrCreateHandTrackerEXT;
+};
+
+struct depth_t
+{
+	struct base_extension_t base;
+
+	XrCompositionLayerDepthInfoKHR* infos;
+};
+
+struct refresh_rate_t
+{
+	struct base_extension_t base;
+
+	PFN_xrEnumerateDisplayRefreshRatesFB xrEnumerateDisplayRefreshRatesFB;
+	PFN_xrGetDisplayRefreshRateFB xrGetDisplayRefreshRateFB;
+	PFN_xrRequestDisplayRefreshRateFB xrRequestDisplayRefreshRateFB;
+};
+
+struct known_vive_tracker
+{
+	XrPath persistent_path;
+	XrPath role_path;
+
+	char* role_str;
+
+	// pointing to the pre-created per-role action. NULL if role_PATH == XR_NULL_PATH.
+	struct action_t action;
+
+	struct known_vive_tracker* next;
+};
+
+struct vive_tracker_t
+{
+	struct base_extension_t base;
+
+	// dynamic list of trackers
+	struct known_vive_tracker* trackers;
+
+	PFN_xrEnumerateViveTrackerPathsHTCX pfnxrEnumerateViveTrackerPathsHTCX;
+};
+
+struct ext_t
+{
+	struct opengl_t opengl;
+	struct depth_t depth;
+
+	struct hand_tracking_t hand_tracking;
+	struct refresh_rate_t refresh_rate;
+
+	struct vive_tracker_t vive_tracker;
+};
+
+struct OpenXRState
+{
+	XrFormFactor form_factor;
+	XrViewConfigurationType view_type;
+	XrReferenceSpaceType play_space_type;
+
+	XrInstance instance;
+	XrSession session;
+	XrSystemId system_id;
+	XrSessionState state;
+
+	XrEnvironmentBlendMode blend_mode;
+	bool blend_mode_explicitly_set;
+
+	XrSpace play_space;
+
+	// Each physical Display/Eye is described by a view
+	uint32_t view_count;
+	XrViewConfigurationView* viewconfig_views;
+	XrCompositionLayerProjectionView* projection_views;
+	XrView* views;
+};
+
+struct ApplicationState
+{
+	// have to define the names somewhere
+	struct ext_t ext;
+
+	struct OpenXRState oxr;
+
+	// use optional XrSpaceVelocity in xrLocateSpace for controllers and visualize linear velocity
+	bool query_hand_velocities;
+
+	// use optional XrSpaceVelocity in xrLocateHandJointsEXT and visualize linear velocity
+	bool query_joint_velocities;
+
+	// write joints, actions, frame timing and video arrivals to this file
+	const char* record_path;
+
+	// feed joints and actions from this recording instead of an OpenXR session
+	const char* replay_path;
+	// 1 replays in original timing, 0 as fast as the network thread sends the frames
+	double replay_speed;
+
+	// render and submit on a separate thread while the xr thread waits for the next frame
+	bool pipelined;
+
+	// locate views and hand joints again once, right before the first projection pass
+	bool late_latch;
+
+	// seconds between the frame timing reports in the log, 0 only prints them at exit
+	double timing_report_s;
+
+	// desktop mirror of the left eye, mirror_every only for MIRROR_EVERY
+	enum mirror_mode mirror_mode;
+	uint32_t mirror_every;
+	// mirror window size relative to the eye resolution
+	float mirror_scale;
+
+	// directory for linked program binaries, NULL for the default one, "off" disables the cache
+	const char* shader_cache_dir;
+
+	// threads running the frame's job graph next to the xr thread, 0 runs it on the xr thread
+	uint32_t job_workers;
+
+	struct
+	{
+		bool enabled;
+		// cube moves in `velocity` direction until it hits `center_pos +- `bouncing_lengths, then
+		// reverse `velocity
+		XrVector3f center_pos;       // m
+		XrVector3f current_pos;      // m
+		XrTime pos_ts;               // ns
+		XrVector3f velocity;         // m/s
+		XrVector3f bouncing_lengths; // m
+	} cube;
+
+	// Grabbing objects is not actually implemented in this demo, it only gives some  haptic feebdack.
+	struct action_t grab_action;
+
+	// A 1D action that is fed by one axis of a 2D input (y axis of thumbstick).
+	struct action_t accelerate_action;
+
+	struct action_t hand_pose_action;
+	struct action_t aim_action;
+
+	struct action_t haptic_action;
+
+	XrSpace ref_local_space;
+	XrSpace ref_local_space_y1;
+
+	XrSpace ref_stage_space;
+	XrSpace ref_stage_space_y1;
+
+	XrSpace ref_view_space;
+	XrSpace ref_view_space_z1;
+
+	struct gl_renderer_t gl_renderer;
+};
+
+#endif // APP_H
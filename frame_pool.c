@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Preallocated video frame buffers, see frame_pool.h.
+ */
+
+#include "frame_pool.h"
+#include "logger.h"
+
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// the size x86-64 and aarch64 (4k granule) use for transparent and hugetlb pages
+#define HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+static size_t
+round_up(size_t size, size_t alignment)
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+// a huge page aligned mapping, the kernel only backs aligned 2 MiB ranges with transparent huge
+// pages
+static void*
+map_huge_aligned(size_t size)
+{
+	size_t padded = size + HUGE_PAGE_SIZE;
+	uint8_t* base =
+	    mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
+		return MAP_FAILED;
+
+	uint8_t* aligned = (uint8_t*)round_up((uintptr_t)base, HUGE_PAGE_SIZE);
+	if (aligned > base)
+		munmap(base, aligned - base);
+	size_t tail = (base + padded) - (aligned + size);
+	if (tail > 0)
+		munmap(aligned + size, tail);
+	return aligned;
+}
+
+bool
+frame_pool_init(struct frame_pool* pool, const struct frame_pool_config* config)
+{
+	uint32_t allocations = pool->allocations;
+	memset(pool, 0, sizeof(*pool));
+	pool->config = *config;
+	pool->allocations = allocations;
+
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	pool->frame_size =
+	    (size_t)config->max_width * config->max_height * config->bytes_per_pixel;
+	pool->frame_stride = round_up(pool->frame_size, page_size);
+	pool->mapping_size = pool->frame_stride * config->frame_count;
+	if (pool->mapping_size == 0) {
+		LOG_ERROR("%s: empty, %ux%u x %u\n", config->name, config->max_width, config->max_height,
+		          config->frame_count);
+		return false;
+	}
+
+	void* memory = MAP_FAILED;
+	pool->pages = config->pages;
+	if (config->pages == FRAME_POOL_PAGES_HUGETLB) {
+		size_t size = round_up(pool->mapping_size, HUGE_PAGE_SIZE);
+		memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+		if (memory != MAP_FAILED) {
+			pool->mapping_size = size;
+		} else {
+			LOG_WARN("%s: no hugetlb pages, using normal pages\n", config->name);
+			pool->pages = FRAME_POOL_PAGES_NORMAL;
+		}
+	} else if (config->pages == FRAME_POOL_PAGES_TRANSPARENT_HUGE) {
+		size_t size = round_up(pool->mapping_size, HUGE_PAGE_SIZE);
+		memory = map_huge_aligned(size);
+		if (memory != MAP_FAILED) {
+			pool->mapping_size = size;
+			// before the first touch, so the faults below already allocate huge pages
+			if (madvise(memory, size, MADV_HUGEPAGE) != 0) {
+				LOG_WARN("%s: transparent huge pages not available\n", config->name);
+				pool->pages = FRAME_POOL_PAGES_NORMAL;
+			}
+		} else {
+			// the padding for the alignment may not fit where the pool alone does
+			LOG_WARN("%s: could not map an aligned range, using normal pages\n", config->name);
+			pool->pages = FRAME_POOL_PAGES_NORMAL;
+		}
+	}
+	if (memory == MAP_FAILED && pool->pages == FRAME_POOL_PAGES_NORMAL) {
+		memory = mmap(NULL, pool->mapping_size, PROT_READ | PROT_WRITE,
+		              MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	}
+	if (memory == MAP_FAILED) {
+		LOG_ERROR("%s: could not map %zu bytes\n", config->name, pool->mapping_size);
+		pool->mapping_size = 0;
+		return false;
+	}
+	pool->memory = memory;
+	pool->allocations++;
+
+	// MAP_POPULATE is only a hint, write every page so none is left to fault in while receiving
+	for (size_t offset = 0; offset < pool->mapping_size; offset += page_size)
+		pool->memory[offset] = 0;
+
+	if (config->lock) {
+		pool->locked = mlock(pool->memory, pool->mapping_size) == 0;
+		if (!pool->locked)
+			LOG_WARN("%s: could not lock the frames, raise RLIMIT_MEMLOCK (ulimit -l)\n",
+			         config->name);
+	}
+
+	LOG_INFO("%s: %u frames of %zu bytes, %zu bytes mapped%s%s\n", config->name,
+	         config->frame_count, pool->frame_size, pool->mapping_size,
+	         pool->pages == FRAME_POOL_PAGES_HUGETLB             ? ", hugetlb pages"
+	         : pool->pages == FRAME_POOL_PAGES_TRANSPARENT_HUGE ? ", transparent huge pages"
+	                                                             : "",
+	         pool->locked ? ", locked" : "");
+	return true;
+}
+
+void
+frame_pool_destroy(struct frame_pool* pool)
+{
+	if (pool->memory == NULL)
+		return;
+	// munmap() also unlocks
+	munmap(pool->memory, pool->mapping_size);
+	pool->memory = NULL;
+	pool->mapping_size = 0;
+	pool->locked = false;
+}
+
+bool
+frame_pool_fit(struct frame_pool* pool, uint32_t width, uint32_t height)
+{
+	size_t size = (size_t)width * height * pool->config.bytes_per_pixel;
+	if (pool->memory != NULL && size <= pool->frame_size)
+		return true;
+
+	struct frame_pool_config config = pool->config;
+	if (width > config.max_width)
+		config.max_width = width;
+	if (height > config.max_height)
+		config.max_height = height;
+	LOG_WARN("%s: frame %ux%u does not fit, growing the pool to %ux%u\n", config.name, width,
+	         height, config.max_width, config.max_height);
+
+	frame_pool_destroy(pool);
+	return frame_pool_init(pool, &config);
+}
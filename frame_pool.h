@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Fixed set of video frame buffers allocated once for the largest expected resolution.
+ *
+ * All frames live in one anonymous mapping, every frame starts on a page boundary. The mapping is
+ * pre-faulted when it is created and optionally locked with mlock() and backed by transparent or
+ * explicit (hugetlbfs) huge pages, so receiving into a frame never allocates or faults.
+ *
+ * Only a frame larger than the configured maximum maps the pool again, allocations counts the
+ * mappings so the steady state can be checked to stay at one.
+ */
+
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum frame_pool_pages
+{
+	FRAME_POOL_PAGES_NORMAL,
+	// madvise(MADV_HUGEPAGE), the kernel may still use normal pages
+	FRAME_POOL_PAGES_TRANSPARENT_HUGE,
+	// MAP_HUGETLB, needs reserved huge pages (vm.nr_hugepages), falls back to normal pages
+	FRAME_POOL_PAGES_HUGETLB,
+};
+
+struct frame_pool_config
+{
+	// for the log, like "Video frame pool"
+	const char* name;
+	uint32_t max_width;
+	uint32_t max_height;
+	uint32_t bytes_per_pixel;
+	uint32_t frame_count;
+	enum frame_pool_pages pages;
+	// mlock() the frames, a failure (RLIMIT_MEMLOCK) only warns
+	bool lock;
+};
+
+struct frame_pool
+{
+	struct frame_pool_config config;
+
+	uint8_t* memory;
+	size_t mapping_size;
+	// usable bytes of every frame, at least max_width * max_height * bytes_per_pixel
+	size_t frame_size;
+	size_t frame_stride;
+
+	// what the mapping actually got
+	enum frame_pool_pages pages;
+	bool locked;
+
+	// mappings created over the lifetime of the pool, also across frame_pool_fit()
+	uint32_t allocations;
+};
+
+// maps, pre-faults and optionally locks config->frame_count frames. Returns false if the mapping
+// fails, the pool is then empty.
+bool
+frame_pool_init(struct frame_pool* pool, const struct frame_pool_config* config);
+
+void
+frame_pool_destroy(struct frame_pool* pool);
+
+// makes the frames large enough for width x height, mapping the pool again if they are not. All
+// previous frame pointers are invalid if it did. Returns false if the new mapping failed.
+bool
+frame_pool_fit(struct frame_pool* pool, uint32_t width, uint32_t height);
+
+static inline uint8_t*
+frame_pool_frame(const struct frame_pool* pool, uint32_t index)
+{
+	return pool->memory + (size_t)index * pool->frame_stride;
+}
+
+#endif // FRAME_POOL_H
@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Blocking ring of frame slot indices between the xr and the render thread.
+ *
+ * The ring only hands out indices, the slots themselves live in an array owned by the caller. The
+ * writer acquires the next free slot, fills it and pushes it; the reader peeks the oldest pushed
+ * slot, renders it and releases it. A slot stays owned by the reader until it is released, so with
+ * two slots the writer prepares frame N+1 while frame N is rendered.
+ *
+ * Unlike spsc_ring.h both sides block, frames are produced at display rate and a sleeping thread
+ * is what we want when the other one falls behind.
+ */
+
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FRAME_RING_MAX_SLOTS 4
+
+struct frame_ring
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t changed;
+
+	// free running, head counts pushed and tail released slots
+	uint32_t head;
+	uint32_t tail;
+	uint32_t capacity;
+
+	// no more frames are pushed, the reader renders what is queued and stops
+	bool closed;
+};
+
+// capacity is clamped to 1..FRAME_RING_MAX_SLOTS
+static inline void
+frame_ring_init(struct frame_ring* ring, uint32_t capacity)
+{
+	pthread_mutex_init(&ring->mutex, NULL);
+	pthread_cond_init(&ring->changed, NULL);
+	ring->head = 0;
+	ring->tail = 0;
+	if (capacity < 1)
+		capacity = 1;
+	if (capacity > FRAME_RING_MAX_SLOTS)
+		capacity = FRAME_RING_MAX_SLOTS;
+	ring->capacity = capacity;
+	ring->closed = false;
+}
+
+static inline void
+frame_ring_destroy(struct frame_ring* ring)
+{
+	pthread_cond_destroy(&ring->changed);
+	pthread_mutex_destroy(&ring->mutex);
+}
+
+// writer: waits for a free slot and returns its index, -1 once the ring is closed
+static inline int
+frame_ring_acquire(struct frame_ring* ring)
+{
+	pthread_mutex_lock(&ring->mutex);
+	while (!ring->closed && ring->head - ring->tail == ring->capacity)
+		pthread_cond_wait(&ring->changed, &ring->mutex);
+	int index = ring->closed ? -1 : (int)(ring->head % ring->capacity);
+	pthread_mutex_unlock(&ring->mutex);
+	return index;
+}
+
+// writer: hands the slot returned by frame_ring_acquire() to the reader
+static inline void
+frame_ring_push(struct frame_ring* ring)
+{
+	pthread_mutex_lock(&ring->mutex);
+	ring->head++;
+	pthread_cond_broadcast(&ring->changed);
+	pthread_mutex_unlock(&ring->mutex);
+}
+
+// writer: waits until the reader released or discarded every pushed slot, false if the ring was
+// closed meanwhile
+static inline bool
+frame_ring_drain(struct frame_ring* ring)
+{
+	pthread_mutex_lock(&ring->mutex);
+	while (ring->head != ring->tail)
+		pthread_cond_wait(&ring->changed, &ring->mutex);
+	bool drained = !ring->closed;
+	pthread_mutex_unlock(&ring->mutex);
+	return drained;
+}
+
+// reader: waits for the oldest pushed slot, -1 once the ring is closed and empty
+static inline int
+frame_ring_peek(struct frame_ring* ring)
+{
+	pthread_mutex_lock(&ring->mutex);
+	while (!ring->closed && ring->head == ring->tail)
+		pthread_cond_wait(&ring->changed, &ring->mutex);
+	int index = ring->head == ring->tail ? -1 : (int)(ring->tail % ring->capacity);
+	pthread_mutex_unlock(&ring->mutex);
+	return index;
+}
+
+// reader: gives the slot returned by frame_ring_peek() back to the writer
+static inline void
+frame_ring_release(struct frame_ring* ring)
+{
+	pthread_mutex_lock(&ring->mutex);
+	ring->tail++;
+	pthread_cond_broadcast(&ring->changed);
+	pthread_mutex_unlock(&ring->mutex);
+}
+
+// either side: wakes all waiters, the writer gets no more slots. The reader still gets the queued
+// ones, a reader that fails drops them with frame_ring_discard().
+static inline void
+frame_ring_close(struct frame_ring* ring)
+{
+	pthread_mutex_lock(&ring->mutex);
+	ring->closed = true;
+	pthread_cond_broadcast(&ring->changed);
+	pthread_mutex_unlock(&ring->mutex);
+}
+
+// reader: closes the ring and drops all queued slots
+static inline void
+frame_ring_discard(struct frame_ring* ring)
+{
+	pthread_mutex_lock(&ring->mutex);
+	ring->closed = true;
+	ring->tail = ring->head;
+	pthread_cond_broadcast(&ring->changed);
+	pthread_mutex_unlock(&ring->mutex);
+}
+
+#endif // FRAME_RING_H
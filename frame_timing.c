@@ -0,0 +1,288 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Per-stage frame timing histograms, see frame_timing.h.
+ */
+
+#include "frame_timing.h"
+#include "logger.h"
+#include "recorder.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+// linear buckets per power of two, values below HIST_SUB_COUNT ns are exact
+#define HIST_SUB_BITS 4
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+// 2^36 ns is about 69 s, longer durations land in the last bucket
+#define HIST_MAX_EXP 36
+#define HIST_BUCKETS ((HIST_MAX_EXP - HIST_SUB_BITS + 2) * HIST_SUB_COUNT)
+
+_Static_assert(FRAME_STAGE_COUNT <= REC_FRAME_TIMING_STAGES, "frame timing record too small");
+_Static_assert(sizeof(struct rec_frame_timing) <= REC_MAX_PAYLOAD, "frame timing record too large");
+_Static_assert(FRAME_STAGE_COUNT <= ALLOC_TRACKER_STAGES, "allocation tracker stages too few");
+
+// written by the committing thread, swapped out by the reporting one
+struct histogram
+{
+	_Atomic uint64_t counts[HIST_BUCKETS];
+	_Atomic uint64_t count;
+	_Atomic int64_t sum;
+	_Atomic int64_t max;
+};
+
+// only touched by the reporting thread
+struct histogram_snapshot
+{
+	uint64_t counts[HIST_BUCKETS];
+	uint64_t count;
+	int64_t sum;
+	int64_t max;
+};
+
+// the GPU stages follow the CPU ones
+#define HIST_COUNT (FRAME_STAGE_COUNT + GPU_STAGE_COUNT)
+
+static const char* stage_names[HIST_COUNT] = {
+    [FRAME_STAGE_POLL_EVENTS] = "poll events",     [FRAME_STAGE_WAIT_FRAME] = "wait frame",
+    [FRAME_STAGE_LOCATE_VIEWS] = "locate views",   [FRAME_STAGE_SYNC_ACTIONS] = "sync actions",
+    [FRAME_STAGE_HAND_TRACKING] = "hand tracking", [FRAME_STAGE_CUBE_UPDATE] = "cube update",
+    [FRAME_STAGE_PREPARE_SCENE] = "prepare scene", [FRAME_STAGE_BEGIN_FRAME] = "begin frame",
+    [FRAME_STAGE_RENDER_PASS_0] = "render pass 0", [FRAME_STAGE_RENDER_PASS_1] = "render pass 1",
+    [FRAME_STAGE_QUAD_UPLOAD] = "quad upload",     [FRAME_STAGE_END_FRAME] = "end frame",
+    [FRAME_STAGE_FRAME] = "frame",                 [FRAME_STAGE_POSE_TO_SUBMIT] = "pose to submit",
+    [FRAME_STAGE_QUEUED] = "queued",
+    [FRAME_STAGE_COUNT + GPU_STAGE_RENDER_PASS_0] = "gpu render pass 0",
+    [FRAME_STAGE_COUNT + GPU_STAGE_RENDER_PASS_1] = "gpu render pass 1",
+    [FRAME_STAGE_COUNT + GPU_STAGE_QUAD_UPLOAD] = "gpu quad upload",
+    [FRAME_STAGE_COUNT + GPU_STAGE_MIRROR_BLIT] = "gpu mirror blit",
+};
+
+static struct
+{
+	struct histogram stages[HIST_COUNT];
+
+	// display slots the runtime skipped and frames that took longer than the display period
+	_Atomic uint64_t missed_slots;
+	_Atomic uint64_t late_frames;
+	_Atomic uint64_t frames;
+
+	// committing thread only
+	XrTime last_display_time;
+	XrDuration last_period;
+
+	int64_t report_interval_ns;
+	_Atomic int64_t next_report_ns;
+
+	// folded in by the reporting thread
+	struct histogram_snapshot totals[HIST_COUNT];
+	uint64_t reported_missed_slots;
+	uint64_t reported_late_frames;
+	uint64_t reported_frames;
+} timing;
+
+static uint32_t
+bucket_of(int64_t ns)
+{
+	if (ns < HIST_SUB_COUNT)
+		return ns < 0 ? 0 : (uint32_t)ns;
+	int exp = 63 - __builtin_clzll((uint64_t)ns);
+	if (exp > HIST_MAX_EXP)
+		return HIST_BUCKETS - 1;
+	uint32_t sub = (uint32_t)(ns >> (exp - HIST_SUB_BITS)) & (HIST_SUB_COUNT - 1);
+	return (uint32_t)(exp - HIST_SUB_BITS + 1) * HIST_SUB_COUNT + sub;
+}
+
+// middle of the range of values counted in the bucket
+static double
+bucket_value(uint32_t bucket)
+{
+	if (bucket < HIST_SUB_COUNT)
+		return bucket;
+	int exp = (int)(bucket / HIST_SUB_COUNT) + HIST_SUB_BITS - 1;
+	uint32_t sub = bucket % HIST_SUB_COUNT;
+	double width = (double)(1ull << (exp - HIST_SUB_BITS));
+	return (HIST_SUB_COUNT + sub) * width + width / 2;
+}
+
+static void
+histogram_add(struct histogram* hist, int64_t ns)
+{
+	atomic_fetch_add_explicit(&hist->counts[bucket_of(ns)], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&hist->count, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&hist->sum, ns, memory_order_relaxed);
+	int64_t max = atomic_load_explicit(&hist->max, memory_order_relaxed);
+	while (ns > max &&
+	       !atomic_compare_exchange_weak_explicit(&hist->max, &max, ns, memory_order_relaxed,
+	                                              memory_order_relaxed))
+		;
+}
+
+// moves the counts out of hist, a concurrent add lands either in this or in the next interval
+static void
+histogram_take(struct histogram* hist, struct histogram_snapshot* out)
+{
+	for (uint32_t i = 0; i < HIST_BUCKETS; i++)
+		out->counts[i] = atomic_exchange_explicit(&hist->counts[i], 0, memory_order_relaxed);
+	out->count = atomic_exchange_explicit(&hist->count, 0, memory_order_relaxed);
+	out->sum = atomic_exchange_explicit(&hist->sum, 0, memory_order_relaxed);
+	out->max = atomic_exchange_explicit(&hist->max, 0, memory_order_relaxed);
+}
+
+static void
+snapshot_merge(struct histogram_snapshot* into, const struct histogram_snapshot* from)
+{
+	for (uint32_t i = 0; i < HIST_BUCKETS; i++)
+		into->counts[i] += from->counts[i];
+	into->count += from->count;
+	into->sum += from->sum;
+	if (from->max > into->max)
+		into->max = from->max;
+}
+
+// in ms, percentile in 0..1
+static double
+snapshot_percentile(const struct histogram_snapshot* snap, double percentile)
+{
+	uint64_t total = 0;
+	for (uint32_t i = 0; i < HIST_BUCKETS; i++)
+		total += snap->counts[i];
+	if (total == 0)
+		return 0;
+
+	uint64_t rank = (uint64_t)(percentile * (double)total + 0.5);
+	if (rank < 1)
+		rank = 1;
+	uint64_t seen = 0;
+	for (uint32_t i = 0; i < HIST_BUCKETS; i++) {
+		seen += snap->counts[i];
+		if (seen >= rank) {
+			// the bucket middle can lie above the largest value that was counted
+			double ns = bucket_value(i);
+			return (ns > (double)snap->max ? (double)snap->max : ns) / 1e6;
+		}
+	}
+	return snap->max / 1e6;
+}
+
+static void
+report_interval(void)
+{
+	uint64_t frames = atomic_load_explicit(&timing.frames, memory_order_relaxed);
+	uint64_t missed = atomic_load_explicit(&timing.missed_slots, memory_order_relaxed);
+	uint64_t late = atomic_load_explicit(&timing.late_frames, memory_order_relaxed);
+
+	LOG_INFO("Frame timing, %lu frames, %lu missed display slots, %lu over the display period\n",
+	         (unsigned long)(frames - timing.reported_frames),
+	         (unsigned long)(missed - timing.reported_missed_slots),
+	         (unsigned long)(late - timing.reported_late_frames));
+	timing.reported_frames = frames;
+	timing.reported_missed_slots = missed;
+	timing.reported_late_frames = late;
+
+	static struct histogram_snapshot snap;
+	for (int stage = 0; stage < HIST_COUNT; stage++) {
+		histogram_take(&timing.stages[stage], &snap);
+		if (snap.count == 0)
+			continue;
+		LOG_INFO("  %-17s p50 %7.3f  p90 %7.3f  p99 %7.3f  max %7.3f ms\n", stage_names[stage],
+		         snapshot_percentile(&snap, .5), snapshot_percentile(&snap, .9),
+		         snapshot_percentile(&snap, .99), snap.max / 1e6);
+		snapshot_merge(&timing.totals[stage], &snap);
+	}
+}
+
+void
+frame_timing_init(double report_interval_s)
+{
+	timing.report_interval_ns = (int64_t)(report_interval_s * 1e9);
+	atomic_store(&timing.next_report_ns, frame_timing_now() + timing.report_interval_ns);
+}
+
+void
+frame_timing_commit(const struct frame_timing* frame)
+{
+	for (int stage = 0; stage < FRAME_STAGE_COUNT; stage++) {
+		if (frame->start_ns[stage] != 0)
+			histogram_add(&timing.stages[stage], frame->duration_ns[stage]);
+	}
+	atomic_fetch_add_explicit(&timing.frames, 1, memory_order_relaxed);
+	alloc_tracker_frame();
+
+	// the runtime predicts the next free display slot, a gap of more than one period means the
+	// frames in between were never shown
+	XrDuration period = frame->display_period;
+	if (timing.last_display_time != 0 && period > 0) {
+		XrDuration gap = frame->display_time - timing.last_display_time;
+		if (gap > period + period / 2)
+			atomic_fetch_add_explicit(&timing.missed_slots, (gap + period / 2) / period - 1,
+			                          memory_order_relaxed);
+	}
+	timing.last_display_time = frame->display_time;
+	if (period > 0 && frame->duration_ns[FRAME_STAGE_FRAME] > period)
+		atomic_fetch_add_explicit(&timing.late_frames, 1, memory_order_relaxed);
+	timing.last_period = period;
+
+	if (recorder_active()) {
+		struct rec_frame_timing* rec = recorder_begin(REC_FRAME_TIMING, sizeof(*rec));
+		if (rec != NULL) {
+			memset(rec, 0, sizeof(*rec));
+			rec->frame_index = frame->frame_index;
+			rec->display_time = frame->display_time;
+			rec->display_period = frame->display_period;
+			rec->stage_count = FRAME_STAGE_COUNT;
+			memcpy(rec->start_ns, frame->start_ns, sizeof(frame->start_ns));
+			memcpy(rec->duration_ns, frame->duration_ns, sizeof(frame->duration_ns));
+			recorder_commit();
+		}
+	}
+
+	if (timing.report_interval_ns <= 0)
+		return;
+	int64_t now = frame_timing_now();
+	int64_t due = atomic_load_explicit(&timing.next_report_ns, memory_order_relaxed);
+	if (now >= due && atomic_compare_exchange_strong(&timing.next_report_ns, &due,
+	                                                 now + timing.report_interval_ns))
+		report_interval();
+}
+
+void
+frame_timing_add_gpu(enum gpu_stage stage, int64_t ns)
+{
+	histogram_add(&timing.stages[FRAME_STAGE_COUNT + stage], ns);
+}
+
+void
+frame_timing_print(void)
+{
+	static struct histogram_snapshot snap;
+	for (int stage = 0; stage < HIST_COUNT; stage++) {
+		histogram_take(&timing.stages[stage], &snap);
+		snapshot_merge(&timing.totals[stage], &snap);
+	}
+
+	uint64_t frames = atomic_load(&timing.frames);
+	if (frames == 0)
+		return;
+
+	printf("Frame timing over %lu frames (ms):  %7s  %7s  %7s  %7s  %7s\n", (unsigned long)frames,
+	       "p50", "p90", "p99", "max", "mean");
+	for (int stage = 0; stage < HIST_COUNT; stage++) {
+		const struct histogram_snapshot* total = &timing.totals[stage];
+		if (total->count == 0)
+			continue;
+		printf("  %-33s  %7.3f  %7.3f  %7.3f  %7.3f  %7.3f\n", stage_names[stage],
+		       snapshot_percentile(total, .5), snapshot_percentile(total, .9),
+		       snapshot_percentile(total, .99), total->max / 1e6,
+		       (double)total->sum / total->count / 1e6);
+	}
+	printf("Missed display slots: %lu, frames over the %.3f ms display period: %lu\n",
+	       (unsigned long)atomic_load(&timing.missed_slots), timing.last_period / 1e6,
+	       (unsigned long)atomic_load(&timing.late_frames));
+}
+
+const char*
+frame_timing_stage_name(enum frame_stage stage)
+{
+	return stage_names[stage];
+}
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Per-stage frame timing aggregated into lock-free histograms.
+ *
+ * The frame loop stamps every stage of a frame with CLOCK_MONOTONIC into a struct frame_timing that
+ * travels with the frame, with --pipelined inside the frame slot from the xr to the render thread.
+ * frame_timing_commit() adds the stage durations to one histogram per stage, counts missed
+ * deadlines from the predicted display period and, while recording, writes the stamps together
+ * with the XrTime of the frame as a REC_FRAME_TIMING record.
+ *
+ * The histograms are log-linear like HdrHistogram: 16 linear buckets per power of two nanoseconds,
+ * so a percentile is off by at most 3.2%. Buckets are bumped with relaxed atomic adds. The
+ * periodic report swaps them out, logs the percentiles of the interval and folds them into the
+ * totals printed by frame_timing_print() at exit.
+ *
+ * GPU durations measured by gpu_timer.h arrive a few frames late and are added on their own with
+ * frame_timing_add_gpu(), they are reported next to the CPU stages but not recorded.
+ */
+
+#ifndef FRAME_TIMING_H
+#define FRAME_TIMING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "alloc_tracker.h"
+#include "openxr_headers/openxr.h"
+
+enum frame_stage
+{
+	FRAME_STAGE_POLL_EVENTS,
+	FRAME_STAGE_WAIT_FRAME,
+	FRAME_STAGE_LOCATE_VIEWS,
+	FRAME_STAGE_SYNC_ACTIONS,
+	FRAME_STAGE_HAND_TRACKING,
+	FRAME_STAGE_CUBE_UPDATE,
+	FRAME_STAGE_PREPARE_SCENE,
+	FRAME_STAGE_BEGIN_FRAME,
+	// one projection pass per swapchain, single pass stereo only has the first
+	FRAME_STAGE_RENDER_PASS_0,
+	FRAME_STAGE_RENDER_PASS_1,
+	FRAME_STAGE_QUAD_UPLOAD,
+	FRAME_STAGE_END_FRAME,
+	// xrWaitFrame() returning until xrEndFrame() returned, without FRAME_STAGE_QUEUED. Frames
+	// over the display period count as late.
+	FRAME_STAGE_FRAME,
+	// locating the views of the first pass, or late latching them, until xrEndFrame() was called
+	FRAME_STAGE_POSE_TO_SUBMIT,
+	// --pipelined: pushed into the frame ring until the render thread took the slot
+	FRAME_STAGE_QUEUED,
+	FRAME_STAGE_COUNT,
+};
+
+// passes timed on the GPU, see gpu_timer.h
+enum gpu_stage
+{
+	GPU_STAGE_RENDER_PASS_0,
+	GPU_STAGE_RENDER_PASS_1,
+	// update_quad_texture() and the copy into the quad swapchain in render_quad()
+	GPU_STAGE_QUAD_UPLOAD,
+	GPU_STAGE_MIRROR_BLIT,
+	GPU_STAGE_COUNT,
+};
+
+struct frame_timing
+{
+	uint64_t frame_index;
+	XrTime display_time;
+	XrDuration display_period;
+
+	// CLOCK_MONOTONIC when the stage first began in this frame, 0 if it did not run
+	int64_t start_ns[FRAME_STAGE_COUNT];
+	// summed over every time the stage ran in this frame
+	int64_t duration_ns[FRAME_STAGE_COUNT];
+};
+
+static inline int64_t
+frame_timing_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline void
+frame_timing_reset(struct frame_timing* timing, uint64_t frame_index)
+{
+	memset(timing, 0, sizeof(*timing));
+	timing->frame_index = frame_index;
+}
+
+// the stage ran from start_ns until now, returns now so consecutive stages can be chained
+static inline int64_t
+frame_timing_add(struct frame_timing* timing, enum frame_stage stage, int64_t start_ns)
+{
+	int64_t now = frame_timing_now();
+	if (timing->start_ns[stage] == 0)
+		timing->start_ns[stage] = start_ns;
+	timing->duration_ns[stage] += now - start_ns;
+	alloc_tracker_stage_end(stage);
+	return now;
+}
+
+// logs the percentiles of the last interval every report_interval_s seconds, 0 only prints at exit
+void
+frame_timing_init(double report_interval_s);
+
+// frames have to be committed in display order by one thread at a time
+void
+frame_timing_commit(const struct frame_timing* timing);
+
+// a GPU duration read back by gpu_timer_next_frame()
+void
+frame_timing_add_gpu(enum gpu_stage stage, int64_t ns);
+
+// totals since frame_timing_init(), to stdout
+void
+frame_timing_print(void);
+
+const char*
+frame_timing_stage_name(enum frame_stage stage);
+
+#endif // FRAME_TIMING_H
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief GPU pass timing with a ring of timestamp queries, see gpu_timer.h.
+ */
+
+#include "gpu_timer.h"
+#include "logger.h"
+
+#include <string.h>
+
+void
+gpu_timer_init(struct gpu_timer* timer)
+{
+	memset(timer, 0, sizeof(*timer));
+
+	// a context without timer queries reports an invalid enum here
+	while (glGetError() != GL_NO_ERROR)
+		;
+	GLint bits = 0;
+	glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+	if (glGetError() != GL_NO_ERROR || bits == 0) {
+		LOG_WARN("GL timer queries not supported, no GPU timing\n");
+		return;
+	}
+
+	glGenQueries(GPU_TIMER_FRAMES * GPU_STAGE_COUNT * 2, &timer->queries[0][0][0]);
+	timer->supported = true;
+}
+
+void
+gpu_timer_destroy(struct gpu_timer* timer)
+{
+	if (!timer->supported)
+		return;
+	glDeleteQueries(GPU_TIMER_FRAMES * GPU_STAGE_COUNT * 2, &timer->queries[0][0][0]);
+	timer->supported = false;
+}
+
+bool
+gpu_timer_next_frame(struct gpu_timer* timer, int64_t ns[GPU_STAGE_COUNT])
+{
+	if (!timer->supported)
+		return false;
+
+	timer->frame++;
+	uint32_t f = timer->frame % GPU_TIMER_FRAMES;
+
+	bool timed = false;
+	bool available = true;
+	for (int stage = 0; stage < GPU_STAGE_COUNT && available; stage++) {
+		if (!timer->pending[f][stage])
+			continue;
+		timed = true;
+
+		// the end timestamp is the last one written, the begin one is then available as well
+		GLuint result_available = GL_FALSE;
+		glGetQueryObjectuiv(timer->queries[f][stage][1], GL_QUERY_RESULT_AVAILABLE, &result_available);
+		available = result_available == GL_TRUE;
+	}
+
+	if (timed && !available)
+		timer->dropped_frames++;
+
+	for (int stage = 0; stage < GPU_STAGE_COUNT; stage++) {
+		ns[stage] = -1;
+		if (timed && available && timer->pending[f][stage]) {
+			GLuint64 begin, end;
+			glGetQueryObjectui64v(timer->queries[f][stage][0], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(timer->queries[f][stage][1], GL_QUERY_RESULT, &end);
+			ns[stage] = (int64_t)(end - begin);
+		}
+		timer->pending[f][stage] = false;
+	}
+
+	return timed && available;
+}
+
+void
+gpu_timer_begin(struct gpu_timer* timer, enum gpu_stage stage)
+{
+	if (!timer->supported)
+		return;
+	uint32_t f = timer->frame % GPU_TIMER_FRAMES;
+	glQueryCounter(timer->queries[f][stage][0], GL_TIMESTAMP);
+}
+
+void
+gpu_timer_end(struct gpu_timer* timer, enum gpu_stage stage)
+{
+	if (!timer->supported)
+		return;
+	uint32_t f = timer->frame % GPU_TIMER_FRAMES;
+	glQueryCounter(timer->queries[f][stage][1], GL_TIMESTAMP);
+	timer->pending[f][stage] = true;
+}
@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Ring of GL_TIMESTAMP queries that times render passes on the GPU.
+ *
+ * Every pass of a frame is bracketed with two glQueryCounter() timestamps. The queries of a frame
+ * stay in the ring for GPU_TIMER_FRAMES frames before gpu_timer_next_frame() reads them back, by
+ * then the GPU has long finished them. A frame whose results are still not available is dropped
+ * instead of waiting, the timer never stalls the pipeline.
+ *
+ * Timestamps instead of GL_TIME_ELAPSED because elapsed queries can not overlap, so the passes
+ * could not be timed while something else, like render_bench's whole frame query, is active.
+ */
+
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include "frame_timing.h"
+
+// frames of queries in flight
+#define GPU_TIMER_FRAMES 4
+
+struct gpu_timer
+{
+	// begin and end timestamp of every stage
+	GLuint queries[GPU_TIMER_FRAMES][GPU_STAGE_COUNT][2];
+	// the stage was timed in this frame and its queries are pending
+	bool pending[GPU_TIMER_FRAMES][GPU_STAGE_COUNT];
+	uint32_t frame;
+
+	// frames whose results were not available in time
+	uint64_t dropped_frames;
+	bool supported;
+};
+
+// needs a current context, without timer queries (GL 3.3 or ARB_timer_query) all calls do nothing
+void
+gpu_timer_init(struct gpu_timer* timer);
+
+void
+gpu_timer_destroy(struct gpu_timer* timer);
+
+// starts a new frame of queries. Returns true if the frame issued GPU_TIMER_FRAMES frames ago
+// timed anything and its results were available, ns then holds its stage durations, -1 for stages
+// that did not run.
+bool
+gpu_timer_next_frame(struct gpu_timer* timer, int64_t ns[GPU_STAGE_COUNT]);
+
+// brackets one stage of the current frame, each stage at most once per frame
+void
+gpu_timer_begin(struct gpu_timer* timer, enum gpu_stage stage);
+
+void
+gpu_timer_end(struct gpu_timer* timer, enum gpu_stage stage);
+
+#endif // GPU_TIMER_H
@@ -0,0 +1,418 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Work-stealing job system, see job_system.h.
+ */
+
+#define _GNU_SOURCE
+#include "job_system.h"
+#include "alloc_tracker.h"
+#include "logger.h"
+#include "thread_profile.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define JOB_CACHE_LINE 64
+// power of two, a frame's graph is a handful of jobs
+#define JOB_DEQUE_SIZE 256
+#define JOB_ARENA_SIZE ((size_t)64 * 1024)
+// distinct job names timed, later ones are not
+#define JOB_PROFILE_NAMES 32
+
+struct job
+{
+	const char* name;
+	job_fn fn;
+	void* arg;
+
+	// unfinished dependencies, plus one until job_submit()
+	_Atomic uint32_t pending;
+	_Atomic bool done;
+	int64_t runnable_ns;
+
+	uint32_t successor_count;
+	struct job* successors[JOB_MAX_SUCCESSORS];
+};
+
+// Chase-Lev: the owner pushes and pops at the bottom, thieves take from the top
+struct job_deque
+{
+	_Alignas(JOB_CACHE_LINE) _Atomic int64_t top;
+	_Alignas(JOB_CACHE_LINE) _Atomic int64_t bottom;
+	_Alignas(JOB_CACHE_LINE) struct job* _Atomic slots[JOB_DEQUE_SIZE];
+};
+
+struct job_profile
+{
+	_Atomic(const char*) name;
+	_Atomic uint64_t runs;
+	_Atomic uint64_t total_ns;
+	_Atomic uint64_t max_ns;
+	// runnable until started
+	_Atomic uint64_t total_delay_ns;
+};
+
+static struct
+{
+	// 0 belongs to the frame thread, 1.. to the workers
+	struct job_deque deques[JOB_MAX_WORKERS + 1];
+	// set before the workers start, a worker that failed to start leaves its deque empty
+	uint32_t deque_count;
+	pthread_t threads[JOB_MAX_WORKERS];
+	uint32_t worker_count;
+
+	// sleeping threads wait for wakeups to change
+	pthread_mutex_t mutex;
+	pthread_cond_t wake;
+	_Atomic uint32_t wakeups;
+	_Atomic uint32_t sleepers;
+	// sleepers inside job_wait(), woken on every finished job
+	_Atomic uint32_t waiting;
+	_Atomic bool quit;
+
+	uint8_t* arena;
+	_Atomic size_t arena_used;
+
+	struct job_profile profiles[JOB_PROFILE_NAMES];
+	_Atomic uint64_t steals;
+	// runnable jobs that did not fit the deque and ran right away
+	_Atomic uint64_t overflows;
+} jobs = {.deque_count = 1, .mutex = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER};
+
+// the deque of the calling thread, -1 on threads that may not submit
+static _Thread_local int deque_index = -1;
+
+static int64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool
+deque_push(struct job_deque* deque, struct job* job)
+{
+	int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+	int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+	if (bottom - top >= JOB_DEQUE_SIZE)
+		return false;
+	atomic_store_explicit(&deque->slots[bottom & (JOB_DEQUE_SIZE - 1)], job, memory_order_relaxed);
+	// publishes the slot and the job to thieves, seq_cst for make_runnable()
+	atomic_store(&deque->bottom, bottom + 1);
+	return true;
+}
+
+static struct job*
+deque_pop(struct job_deque* deque)
+{
+	// seq_cst store and load instead of the fence of the paper, same cost and understood by TSan
+	int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+	atomic_store(&deque->bottom, bottom);
+	int64_t top = atomic_load(&deque->top);
+	if (top > bottom) {
+		atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+		return NULL;
+	}
+
+	struct job* job =
+	    atomic_load_explicit(&deque->slots[bottom & (JOB_DEQUE_SIZE - 1)], memory_order_relaxed);
+	// the last job, a thief may be taking it at the same time
+	if (top == bottom) {
+		if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+		                                             memory_order_seq_cst, memory_order_relaxed))
+			job = NULL;
+		atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+	}
+	return job;
+}
+
+static struct job*
+deque_steal(struct job_deque* deque)
+{
+	int64_t top = atomic_load(&deque->top);
+	int64_t bottom = atomic_load(&deque->bottom);
+	if (top >= bottom)
+		return NULL;
+
+	struct job* job =
+	    atomic_load_explicit(&deque->slots[top & (JOB_DEQUE_SIZE - 1)], memory_order_relaxed);
+	if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst,
+	                                             memory_order_relaxed))
+		return NULL;
+	return job;
+}
+
+// own deque first, then the others starting with the next one
+static struct job*
+find_job(void)
+{
+	struct job* job = deque_pop(&jobs.deques[deque_index]);
+	if (job != NULL)
+		return job;
+
+	for (uint32_t i = 1; i < jobs.deque_count; i++) {
+		job = deque_steal(&jobs.deques[(deque_index + i) % jobs.deque_count]);
+		if (job != NULL) {
+			atomic_fetch_add_explicit(&jobs.steals, 1, memory_order_relaxed);
+			return job;
+		}
+	}
+	return NULL;
+}
+
+static void
+wake(bool all)
+{
+	pthread_mutex_lock(&jobs.mutex);
+	atomic_fetch_add(&jobs.wakeups, 1);
+	if (all)
+		pthread_cond_broadcast(&jobs.wake);
+	else
+		pthread_cond_signal(&jobs.wake);
+	pthread_mutex_unlock(&jobs.mutex);
+}
+
+// sleeps until something changed, unless a job turned up while announcing it. waited is the job
+// job_wait() is waiting for, NULL on workers.
+static struct job*
+idle(const struct job* waited)
+{
+	uint32_t seen = atomic_load(&jobs.wakeups);
+	// seq_cst like the push and the load in make_runnable(), so either the pusher sees this sleeper
+	// or the recheck below sees the job
+	atomic_fetch_add(&jobs.sleepers, 1);
+	if (waited != NULL)
+		atomic_fetch_add(&jobs.waiting, 1);
+
+	struct job* job = find_job();
+	if (job == NULL && (waited == NULL || !atomic_load(&waited->done))) {
+		pthread_mutex_lock(&jobs.mutex);
+		while (atomic_load(&jobs.wakeups) == seen && !atomic_load(&jobs.quit))
+			pthread_cond_wait(&jobs.wake, &jobs.mutex);
+		pthread_mutex_unlock(&jobs.mutex);
+	}
+
+	if (waited != NULL)
+		atomic_fetch_sub(&jobs.waiting, 1);
+	atomic_fetch_sub(&jobs.sleepers, 1);
+	return job;
+}
+
+static void
+run_job(struct job* job);
+
+static void
+make_runnable(struct job* job)
+{
+	job->runnable_ns = now_ns();
+	if (!deque_push(&jobs.deques[deque_index], job)) {
+		atomic_fetch_add_explicit(&jobs.overflows, 1, memory_order_relaxed);
+		run_job(job);
+		return;
+	}
+	if (atomic_load(&jobs.sleepers) > 0)
+		wake(false);
+}
+
+static void
+profile_add(const char* name, int64_t duration_ns, int64_t delay_ns)
+{
+	for (int i = 0; i < JOB_PROFILE_NAMES; i++) {
+		struct job_profile* profile = &jobs.profiles[i];
+		const char* slot_name = atomic_load_explicit(&profile->name, memory_order_acquire);
+		if (slot_name == NULL &&
+		    atomic_compare_exchange_strong_explicit(&profile->name, &slot_name, name,
+		                                            memory_order_acq_rel, memory_order_acquire))
+			slot_name = name;
+		if (slot_name != name)
+			continue;
+
+		atomic_fetch_add_explicit(&profile->runs, 1, memory_order_relaxed);
+		atomic_fetch_add_explicit(&profile->total_ns, duration_ns, memory_order_relaxed);
+		atomic_fetch_add_explicit(&profile->total_delay_ns, delay_ns, memory_order_relaxed);
+		uint64_t max = atomic_load_explicit(&profile->max_ns, memory_order_relaxed);
+		while ((uint64_t)duration_ns > max &&
+		       !atomic_compare_exchange_weak_explicit(&profile->max_ns, &max, duration_ns,
+		                                              memory_order_relaxed, memory_order_relaxed))
+			;
+		return;
+	}
+}
+
+static void
+run_job(struct job* job)
+{
+	int64_t start_ns = now_ns();
+	if (job->fn != NULL)
+		job->fn(job->arg);
+	int64_t end_ns = now_ns();
+	profile_add(job->name, end_ns - start_ns, start_ns - job->runnable_ns);
+
+	// once done is set the frame thread may start the next frame and reuse the job, keep what is
+	// still needed
+	uint32_t successor_count = job->successor_count;
+	struct job* successors[JOB_MAX_SUCCESSORS];
+	memcpy(successors, job->successors, successor_count * sizeof(successors[0]));
+	atomic_store(&job->done, true);
+	if (atomic_load(&jobs.waiting) > 0)
+		wake(true);
+
+	for (uint32_t i = 0; i < successor_count; i++) {
+		if (atomic_fetch_sub_explicit(&successors[i]->pending, 1, memory_order_acq_rel) == 1)
+			make_runnable(successors[i]);
+	}
+}
+
+static void*
+worker_main(void* arg)
+{
+	deque_index = (int)(intptr_t)arg;
+	// workers are started from the xr thread, without this they would inherit its placement
+	thread_profile_start(THREAD_ROLE_JOB);
+	char thread_name[16];
+	snprintf(thread_name, sizeof(thread_name), "lis-job-%d", deque_index);
+	pthread_setname_np(pthread_self(), thread_name);
+	logger_set_thread_name("job");
+	alloc_tracker_set_thread("job");
+
+	while (!atomic_load_explicit(&jobs.quit, memory_order_acquire)) {
+		struct job* job = find_job();
+		if (job == NULL)
+			job = idle(NULL);
+		if (job != NULL)
+			run_job(job);
+	}
+	return NULL;
+}
+
+bool
+job_system_init(uint32_t worker_count)
+{
+	if (worker_count > JOB_MAX_WORKERS)
+		worker_count = JOB_MAX_WORKERS;
+
+	jobs.arena = aligned_alloc(JOB_CACHE_LINE, JOB_ARENA_SIZE);
+	if (jobs.arena == NULL) {
+		LOG_ERROR("Could not allocate the %zu byte job arena\n", JOB_ARENA_SIZE);
+		return false;
+	}
+	// faulted in now, not by the first frame
+	memset(jobs.arena, 0, JOB_ARENA_SIZE);
+	deque_index = 0;
+	jobs.deque_count = worker_count + 1;
+
+	for (uint32_t i = 0; i < worker_count; i++) {
+		if (pthread_create(&jobs.threads[i], NULL, worker_main, (void*)(intptr_t)(i + 1)) != 0) {
+			LOG_WARN("Could only start %u of %u job workers\n", i, worker_count);
+			break;
+		}
+		jobs.worker_count = i + 1;
+	}
+	LOG_INFO("Job system: %u workers\n", jobs.worker_count);
+	return true;
+}
+
+void
+job_system_shutdown(void)
+{
+	atomic_store_explicit(&jobs.quit, true, memory_order_release);
+	wake(true);
+	for (uint32_t i = 0; i < jobs.worker_count; i++)
+		pthread_join(jobs.threads[i], NULL);
+	jobs.worker_count = 0;
+	jobs.deque_count = 1;
+	free(jobs.arena);
+	jobs.arena = NULL;
+}
+
+uint32_t
+job_system_worker_count(void)
+{
+	return jobs.worker_count;
+}
+
+void
+job_frame_begin(void)
+{
+	atomic_store_explicit(&jobs.arena_used, 0, memory_order_relaxed);
+}
+
+void*
+job_frame_alloc(size_t size)
+{
+	size = (size + 15) & ~(size_t)15;
+	size_t offset = atomic_fetch_add_explicit(&jobs.arena_used, size, memory_order_relaxed);
+	if (offset + size > JOB_ARENA_SIZE)
+		return NULL;
+	return jobs.arena + offset;
+}
+
+struct job*
+job_create(const char* name, job_fn fn, void* arg)
+{
+	struct job* job = job_frame_alloc(sizeof(*job));
+	if (job == NULL)
+		return NULL;
+	job->name = name;
+	job->fn = fn;
+	job->arg = arg;
+	atomic_init(&job->pending, 1);
+	atomic_init(&job->done, false);
+	job->runnable_ns = 0;
+	job->successor_count = 0;
+	return job;
+}
+
+bool
+job_depend(struct job* job, struct job* dependency)
+{
+	if (dependency->successor_count == JOB_MAX_SUCCESSORS)
+		return false;
+	dependency->successors[dependency->successor_count++] = job;
+	atomic_fetch_add_explicit(&job->pending, 1, memory_order_relaxed);
+	return true;
+}
+
+void
+job_submit(struct job* job)
+{
+	if (atomic_fetch_sub_explicit(&job->pending, 1, memory_order_acq_rel) == 1)
+		make_runnable(job);
+}
+
+void
+job_wait(struct job* job)
+{
+	while (!atomic_load_explicit(&job->done, memory_order_acquire)) {
+		struct job* next = find_job();
+		if (next == NULL)
+			next = idle(job);
+		if (next != NULL)
+			run_job(next);
+	}
+}
+
+void
+job_system_print(void)
+{
+	printf("Jobs: %u workers, %lu stolen, %lu overflowed\n", jobs.worker_count,
+	       (unsigned long)atomic_load(&jobs.steals), (unsigned long)atomic_load(&jobs.overflows));
+	printf("  %-24s  %8s  %9s  %9s  %9s\n", "job", "runs", "mean us", "max us", "delay us");
+	for (int i = 0; i < JOB_PROFILE_NAMES; i++) {
+		struct job_profile* profile = &jobs.profiles[i];
+		const char* name = atomic_load(&profile->name);
+		if (name == NULL)
+			break;
+		uint64_t runs = atomic_load(&profile->runs);
+		printf("  %-24s  %8lu  %9.2f  %9.2f  %9.2f\n", name, (unsigned long)runs,
+		       runs > 0 ? atomic_load(&profile->total_ns) / 1e3 / runs : 0,
+		       atomic_load(&profile->max_ns) / 1e3,
+		       runs > 0 ? atomic_load(&profile->total_delay_ns) / 1e3 / runs : 0);
+	}
+}
@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Work-stealing job system for the CPU work of a frame.
+ *
+ * The frame thread builds a graph of jobs every frame: job_create() takes a job from the frame
+ * arena, job_depend() orders two jobs and job_submit() hands a job over once it is wired up. A job
+ * becomes runnable when every job it depends on has finished. job_wait() returns when a job has
+ * finished, the waiting thread runs queued jobs in the meantime, so with no workers the graph runs
+ * inline on the frame thread in dependency order.
+ *
+ * Every worker and the frame thread own a Chase-Lev deque: runnable jobs are pushed to and popped
+ * from the bottom of the deque of the thread that made them runnable, idle threads steal from the
+ * top of the others. Workers with nothing to steal sleep on a condition variable.
+ *
+ * Jobs and their data come from an arena that job_frame_begin() resets, so building a frame's
+ * graph never calls malloc(). All jobs of the previous frame have to be waited for by then.
+ *
+ * Each job is timed, job_system_print() lists the runs, mean and maximum duration and the delay
+ * between becoming runnable and starting per job name.
+ */
+
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JOB_MAX_WORKERS 16
+// jobs that may run after one job
+#define JOB_MAX_SUCCESSORS 8
+
+struct job;
+
+typedef void (*job_fn)(void* arg);
+
+// starts worker_count threads, 0 runs every job on the thread calling job_wait(). The calling
+// thread becomes the frame thread, the only one besides running jobs that may build graphs.
+bool
+job_system_init(uint32_t worker_count);
+
+// waits for the workers to exit, every submitted job has to be waited for
+void
+job_system_shutdown(void);
+
+uint32_t
+job_system_worker_count(void);
+
+// starts a new frame, jobs and allocations of the previous one become invalid
+void
+job_frame_begin(void);
+
+// 16 byte aligned and valid until the next job_frame_begin(), NULL once the arena is used up
+void*
+job_frame_alloc(size_t size);
+
+// name has to be a string literal, fn may be NULL for a job that only joins its dependencies.
+// NULL once the arena is used up.
+struct job*
+job_create(const char* name, job_fn fn, void* arg);
+
+// job runs after dependency finished, both must not be submitted yet
+bool
+job_depend(struct job* job, struct job* dependency);
+
+void
+job_submit(struct job* job);
+
+// runs queued jobs until job finished
+void
+job_wait(struct job* job);
+
+// per job name timing since job_system_init(), to stdout
+void
+job_system_print(void);
+
+#endif // JOB_SYSTEM_H
@@ -0,0 +1,503 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Asynchronous logging for latency critical threads, see logger.h.
+ */
+
+#include "logger.h"
+#include "spsc_ring.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// records per thread ring, 512 KiB per logging thread
+#define LOG_RING_RECORDS 2048
+#define LOG_RECORD_SIZE 256
+// idle poll interval of the writer thread
+#define LOG_WRITER_POLL_NS 2000000
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+enum log_arg_type
+{
+	LOG_ARG_INT,
+	LOG_ARG_LONG,
+	LOG_ARG_DOUBLE,
+	LOG_ARG_STRING,
+	LOG_ARG_POINTER,
+};
+
+union log_arg
+{
+	int64_t i;
+	double d;
+	const void* p;
+	uint32_t str_offset;
+};
+
+struct log_record
+{
+	uint64_t timestamp_ns;
+	const struct log_site* site;
+	uint64_t text_len;
+	union log_arg args[LOG_MAX_ARGS];
+	// copied %s arguments, or the whole message for eager sites
+	char text[LOG_RECORD_SIZE - 24 - LOG_MAX_ARGS * sizeof(union log_arg)];
+};
+
+_Static_assert(sizeof(struct log_record) == LOG_RECORD_SIZE, "log record must stay fixed size");
+
+struct log_thread
+{
+	struct spsc_ring ring;
+	char name[16];
+	_Atomic uint64_t dropped;
+	uint64_t dropped_reported;
+	struct log_thread* next;
+};
+
+_Atomic int logger_level = LOG_LEVEL_INFO;
+
+static struct
+{
+	_Atomic bool running;
+	_Atomic bool stop;
+	_Atomic uint32_t rate_limit;
+	uint64_t start_ns;
+
+	pthread_t writer;
+	pthread_mutex_t threads_mutex;
+	_Atomic(struct log_thread*) threads;
+	_Atomic uint32_t thread_count;
+
+	// every call site that logged at least once, for reporting rate limited records
+	_Atomic(struct log_site*) sites;
+} logger = {.threads_mutex = PTHREAD_MUTEX_INITIALIZER};
+
+static _Thread_local struct log_thread* tls_log_thread;
+
+static const char level_chars[] = {'E', 'W', 'I', 'D', 'T'};
+
+static inline uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// --- format string handling
+
+// returns the length of the conversion spec starting at fmt (which points at '%'), fills type.
+// returns 0 for specs that need the slow path.
+static int
+parse_spec(const char* fmt, enum log_arg_type* type)
+{
+	const char* c = fmt + 1;
+	while (*c && strchr("-+ #0'", *c))
+		c++;
+	while (*c >= '0' && *c <= '9')
+		c++;
+	if (*c == '.') {
+		c++;
+		while (*c >= '0' && *c <= '9')
+			c++;
+	}
+
+	int longs = 0;
+	bool other_length = false;
+	while (*c && strchr("hlLjzt", *c)) {
+		if (*c == 'l')
+			longs++;
+		else if (*c == 'j' || *c == 'z' || *c == 't')
+			longs = 2;
+		else if (*c == 'L')
+			other_length = true;
+		c++;
+	}
+
+	switch (*c) {
+	case 'd':
+	case 'i':
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+	case 'c': *type = longs ? LOG_ARG_LONG : LOG_ARG_INT; break;
+	case 'f':
+	case 'F':
+	case 'e':
+	case 'E':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		if (other_length)
+			return 0;
+		*type = LOG_ARG_DOUBLE;
+		break;
+	case 's':
+		if (longs)
+			return 0;
+		*type = LOG_ARG_STRING;
+		break;
+	case 'p': *type = LOG_ARG_POINTER; break;
+	default: return 0; // '*' widths, %n, wide chars, ...
+	}
+	return (int)(c - fmt) + 1;
+}
+
+static void
+parse_site(struct log_site* site, const char* fmt)
+{
+	site->fmt = fmt;
+	site->arg_count = 0;
+	site->has_strings = false;
+	site->eager = false;
+
+	for (const char* c = fmt; *c; c++) {
+		if (*c != '%')
+			continue;
+		if (c[1] == '%') {
+			c++;
+			continue;
+		}
+		enum log_arg_type type;
+		int len = parse_spec(c, &type);
+		if (len == 0 || site->arg_count == LOG_MAX_ARGS) {
+			site->eager = true;
+			return;
+		}
+		if (type == LOG_ARG_STRING)
+			site->has_strings = true;
+		site->arg_types[site->arg_count++] = (uint8_t)type;
+		c += len - 1;
+	}
+}
+
+static void
+ensure_site_parsed(struct log_site* site, const char* fmt)
+{
+	if (atomic_load_explicit(&site->parse_state, memory_order_acquire) == 2)
+		return;
+
+	int expected = 0;
+	if (atomic_compare_exchange_strong(&site->parse_state, &expected, 1)) {
+		parse_site(site, fmt);
+
+		site->next = atomic_load_explicit(&logger.sites, memory_order_relaxed);
+		while (!atomic_compare_exchange_weak_explicit(&logger.sites, &site->next, site,
+		                                              memory_order_release, memory_order_relaxed)) {
+		}
+
+		atomic_store_explicit(&site->parse_state, 2, memory_order_release);
+		return;
+	}
+	while (atomic_load_explicit(&site->parse_state, memory_order_acquire) != 2) {
+		// another thread is parsing this site right now
+	}
+}
+
+// expands the record into out, returns the number of characters written
+static size_t
+format_record(const struct log_record* rec, char* out, size_t out_size)
+{
+	const struct log_site* site = rec->site;
+	if (site->eager) {
+		size_t len = rec->text_len < out_size - 1 ? rec->text_len : out_size - 1;
+		memcpy(out, rec->text, len);
+		out[len] = '\0';
+		return len;
+	}
+
+	size_t pos = 0;
+	int arg = 0;
+	for (const char* c = site->fmt; *c && pos < out_size - 1; c++) {
+		if (*c != '%') {
+			out[pos++] = *c;
+			continue;
+		}
+		if (c[1] == '%') {
+			out[pos++] = '%';
+			c++;
+			continue;
+		}
+
+		enum log_arg_type type;
+		int len = parse_spec(c, &type);
+		char spec[32];
+		if (len <= 0 || len >= (int)sizeof(spec))
+			break;
+		memcpy(spec, c, len);
+		spec[len] = '\0';
+
+		const union log_arg* a = &rec->args[arg++];
+		size_t room = out_size - pos;
+		int n = 0;
+		switch (type) {
+		case LOG_ARG_INT: n = snprintf(out + pos, room, spec, (int)a->i); break;
+		case LOG_ARG_LONG: n = snprintf(out + pos, room, spec, (long long)a->i); break;
+		case LOG_ARG_DOUBLE: n = snprintf(out + pos, room, spec, a->d); break;
+		case LOG_ARG_POINTER: n = snprintf(out + pos, room, spec, a->p); break;
+		case LOG_ARG_STRING: n = snprintf(out + pos, room, spec, rec->text + a->str_offset); break;
+		}
+		if (n < 0)
+			break;
+		pos += (size_t)n < room ? (size_t)n : room - 1;
+		c += len - 1;
+	}
+	out[pos] = '\0';
+	return pos;
+}
+
+// --- producer side
+
+static struct log_thread*
+register_thread(void)
+{
+	struct log_thread* t = calloc(1, sizeof(*t));
+	if (t == NULL)
+		return NULL;
+	if (!spsc_ring_init(&t->ring, LOG_RING_RECORDS, sizeof(struct log_record))) {
+		free(t);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&logger.threads_mutex);
+	uint32_t index = atomic_fetch_add(&logger.thread_count, 1);
+	if (t->name[0] == '\0')
+		snprintf(t->name, sizeof(t->name), "t%u", index);
+	t->next = atomic_load(&logger.threads);
+	atomic_store_explicit(&logger.threads, t, memory_order_release);
+	pthread_mutex_unlock(&logger.threads_mutex);
+
+	tls_log_thread = t;
+	return t;
+}
+
+void
+logger_set_thread_name(const char* name)
+{
+	struct log_thread* t = tls_log_thread ? tls_log_thread : register_thread();
+	if (t == NULL)
+		return;
+	// only read by the writer when formatting, a torn name is harmless
+	snprintf(t->name, sizeof(t->name), "%s", name);
+}
+
+void
+logger_write(struct log_site* site, const char* fmt, ...)
+{
+	va_list args;
+
+	if (!atomic_load_explicit(&logger.running, memory_order_acquire)) {
+		va_start(args, fmt);
+		vprintf(fmt, args);
+		va_end(args);
+		return;
+	}
+
+	ensure_site_parsed(site, fmt);
+
+	uint64_t now = now_ns();
+
+	uint32_t rate = atomic_load_explicit(&logger.rate_limit, memory_order_relaxed);
+	if (rate != 0) {
+		uint64_t start = atomic_load_explicit(&site->window_start_ns, memory_order_relaxed);
+		if (now - start >= 1000000000ull) {
+			atomic_store_explicit(&site->window_start_ns, now, memory_order_relaxed);
+			atomic_store_explicit(&site->window_count, 0, memory_order_relaxed);
+		}
+		if (atomic_fetch_add_explicit(&site->window_count, 1, memory_order_relaxed) >= rate) {
+			atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+			return;
+		}
+	}
+
+	struct log_thread* t = tls_log_thread;
+	if (t == NULL && (t = register_thread()) == NULL)
+		return;
+
+	struct log_record* rec = spsc_ring_reserve(&t->ring);
+	if (rec == NULL) {
+		atomic_fetch_add_explicit(&t->dropped, 1, memory_order_relaxed);
+		return;
+	}
+
+	rec->timestamp_ns = now;
+	rec->site = site;
+	rec->text_len = 0;
+
+	va_start(args, fmt);
+	if (site->eager) {
+		int n = vsnprintf(rec->text, sizeof(rec->text), fmt, args);
+		rec->text_len = n < 0 ? 0 : MIN((size_t)n, sizeof(rec->text) - 1);
+	} else {
+		for (int i = 0; i < site->arg_count; i++) {
+			switch (site->arg_types[i]) {
+			case LOG_ARG_INT: rec->args[i].i = va_arg(args, int); break;
+			case LOG_ARG_LONG: rec->args[i].i = va_arg(args, long long); break;
+			case LOG_ARG_DOUBLE: rec->args[i].d = va_arg(args, double); break;
+			case LOG_ARG_POINTER: rec->args[i].p = va_arg(args, const void*); break;
+			case LOG_ARG_STRING: {
+				const char* s = va_arg(args, const char*);
+				if (s == NULL)
+					s = "(null)";
+				size_t room = sizeof(rec->text) - rec->text_len;
+				size_t len = strnlen(s, room - 1);
+				memcpy(rec->text + rec->text_len, s, len);
+				rec->text[rec->text_len + len] = '\0';
+				rec->args[i].str_offset = rec->text_len;
+				rec->text_len += len + (room > len + 1 ? 1 : 0);
+				break;
+			}
+			}
+		}
+	}
+	va_end(args);
+
+	spsc_ring_commit(&t->ring);
+}
+
+// --- writer thread
+
+static void
+print_record(const struct log_record* rec, const char* thread_name)
+{
+	double ts = (double)(rec->timestamp_ns - logger.start_ns) / 1e9;
+	char level = level_chars[rec->site->level];
+
+	char msg[1024];
+	format_record(rec, msg, sizeof(msg));
+	printf("[%12.6f %c %s] %s", ts, level, thread_name, msg);
+}
+
+// writes all queued records in timestamp order, returns the number written
+static uint32_t
+drain(void)
+{
+	uint32_t written = 0;
+
+	while (true) {
+		struct log_thread* oldest_thread = NULL;
+		struct log_record* oldest = NULL;
+
+		for (struct log_thread* t = atomic_load_explicit(&logger.threads, memory_order_acquire); t;
+		     t = t->next) {
+			struct log_record* rec = spsc_ring_peek(&t->ring);
+			if (rec && (oldest == NULL || rec->timestamp_ns < oldest->timestamp_ns)) {
+				oldest = rec;
+				oldest_thread = t;
+			}
+		}
+		if (oldest == NULL)
+			break;
+
+		print_record(oldest, oldest_thread->name);
+		spsc_ring_release(&oldest_thread->ring);
+		written++;
+	}
+
+	double now = (double)(now_ns() - logger.start_ns) / 1e9;
+
+	for (struct log_site* s = atomic_load_explicit(&logger.sites, memory_order_acquire); s;
+	     s = s->next) {
+		if (atomic_load_explicit(&s->suppressed, memory_order_relaxed) == 0)
+			continue;
+		uint32_t suppressed = atomic_exchange_explicit(&s->suppressed, 0, memory_order_relaxed);
+		printf("[%12.6f W log] rate limit suppressed %u messages from %s:%d\n", now, suppressed,
+		       s->file, s->line);
+		written++;
+	}
+
+	for (struct log_thread* t = atomic_load_explicit(&logger.threads, memory_order_acquire); t;
+	     t = t->next) {
+		uint64_t dropped = atomic_load_explicit(&t->dropped, memory_order_relaxed);
+		if (dropped != t->dropped_reported) {
+			printf("[%12.6f W log] dropped %lu records of thread %s, ring full\n", now,
+			       (unsigned long)(dropped - t->dropped_reported), t->name);
+			t->dropped_reported = dropped;
+		}
+	}
+
+	if (written)
+		fflush(stdout);
+	return written;
+}
+
+static void*
+writer_thread(void* arg)
+{
+	(void)arg;
+	struct timespec poll = {.tv_sec = 0, .tv_nsec = LOG_WRITER_POLL_NS};
+
+	while (!atomic_load_explicit(&logger.stop, memory_order_acquire)) {
+		if (drain() == 0)
+			nanosleep(&poll, NULL);
+	}
+	drain();
+	return NULL;
+}
+
+bool
+logger_init(void)
+{
+	if (atomic_load(&logger.running))
+		return true;
+
+	logger.start_ns = now_ns();
+	atomic_store(&logger.stop, false);
+	if (pthread_create(&logger.writer, NULL, writer_thread, NULL) != 0) {
+		perror("pthread_create for logger failed");
+		return false;
+	}
+	atomic_store_explicit(&logger.running, true, memory_order_release);
+	return true;
+}
+
+void
+logger_shutdown(void)
+{
+	if (!atomic_load(&logger.running))
+		return;
+
+	atomic_store_explicit(&logger.running, false, memory_order_release);
+	atomic_store_explicit(&logger.stop, true, memory_order_release);
+	pthread_join(logger.writer, NULL);
+	fflush(stdout);
+}
+
+void
+logger_set_level(enum log_level level)
+{
+	atomic_store_explicit(&logger_level, (int)level, memory_order_relaxed);
+}
+
+bool
+logger_parse_level(const char* str, enum log_level* out_level)
+{
+	static const char* names[] = {"error", "warn", "info", "debug", "trace"};
+	for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+		if (strcmp(str, names[i]) == 0) {
+			*out_level = (enum log_level)i;
+			return true;
+		}
+	}
+
+	char* end;
+	long level = strtol(str, &end, 10);
+	if (*end != '\0' || level < LOG_LEVEL_ERROR || level > LOG_LEVEL_TRACE)
+		return false;
+	*out_level = (enum log_level)level;
+	return true;
+}
+
+void
+logger_set_rate_limit(uint32_t records_per_second)
+{
+	atomic_store_explicit(&logger.rate_limit, records_per_second, memory_order_relaxed);
+}
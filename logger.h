@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Asynchronous logging for latency critical threads.
+ *
+ * LOG_*() call sites push a fixed-size binary record (timestamp, call site, raw arguments) into a
+ * per-thread SPSC ring. A background thread merges the rings in timestamp order, formats the
+ * records and writes them to stdout, so hot threads never block on terminal I/O.
+ *
+ * The format string is parsed once per call site. Numeric arguments are stored as raw 64 bit
+ * values; %s arguments are copied into the record (truncated if long). Formats the fast path does
+ * not understand (e.g. '*' widths) fall back to formatting on the calling thread.
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+enum log_level
+{
+	LOG_LEVEL_ERROR = 0,
+	LOG_LEVEL_WARN,
+	LOG_LEVEL_INFO,
+	LOG_LEVEL_DEBUG,
+	LOG_LEVEL_TRACE,
+};
+
+#define LOG_MAX_ARGS 12
+
+// one per LOG_*() call site, zero initialized static storage
+struct log_site
+{
+	enum log_level level;
+	const char* file;
+	int line;
+
+	// filled on first use
+	const char* fmt;
+	_Atomic int parse_state;
+	bool eager;
+	bool has_strings;
+	uint8_t arg_count;
+	uint8_t arg_types[LOG_MAX_ARGS];
+
+	// rate limiting, fixed one second windows
+	_Atomic uint64_t window_start_ns;
+	_Atomic uint32_t window_count;
+	_Atomic uint32_t suppressed;
+
+	struct log_site* next;
+};
+
+// records above this level are discarded at the call site
+extern _Atomic int logger_level;
+
+bool
+logger_init(void);
+
+// stops the background thread after writing everything still queued
+void
+logger_shutdown(void);
+
+void
+logger_set_level(enum log_level level);
+
+// accepts error, warn, info, debug, trace or a number
+bool
+logger_parse_level(const char* str, enum log_level* out_level);
+
+// maximum records per second and call site, 0 for unlimited
+void
+logger_set_rate_limit(uint32_t records_per_second);
+
+// name shown for records of the calling thread, at most 15 characters are kept
+void
+logger_set_thread_name(const char* name);
+
+void
+logger_write(struct log_site* site, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#define LOG_AT(LEVEL, ...)                                                                         \
+	do {                                                                                             \
+		static struct log_site log_site_ = {.level = (LEVEL), .file = __FILE__, .line = __LINE__};    \
+		if ((int)(LEVEL) <= atomic_load_explicit(&logger_level, memory_order_relaxed))                \
+			logger_write(&log_site_, __VA_ARGS__);                                                     \
+	} while (0)
+
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_TRACE(...) LOG_AT(LOG_LEVEL_TRACE, __VA_ARGS__)
+
+#endif // LOGGER_H
@@ -11,37 +11,32 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <getopt.h>
+#include <math.h>
 #include <pthread.h>
 #include <sys/time.h>
 #include <time.h>
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 
-#ifdef __linux__
-
-// Required headers for OpenGL rendering, as well as for including openxr_platform
-#define GL_GLEXT_PROTOTYPES
-#define GL3_PROTOTYPES
-#include <GL/gl.h>
-#include <GL/glext.h>
-
-// Required headers for windowing, as well as the XrGraphicsBindingOpenGLXlibKHR struct.
-#include <X11/Xlib.h>
-#include <GL/glx.h>
-
-#define XR_USE_PLATFORM_XLIB
-#define XR_USE_GRAPHICS_API_OPENGL
-#include "openxr_headers/openxr.h"
-#include "openxr_headers/openxr_platform.h"
-#include "openxr_headers/openxr_reflection.h"
-
-#else
-#error Only Linux/XLib supported for now
-#endif
+#include "app.h"
 
 #define __USE_XOPEN_EXTENDED // strdup
 #include <string.h>
 
+#include "frame_ring.h"
+#include "alloc_tracker.h"
+#include "frame_pool.h"
+#include "frame_timing.h"
+#include "gpu_timer.h"
+#include "job_system.h"
+#include "logger.h"
+#include "reactor.h"
+#include "recorder.h"
+#include "recv_ring.h"
+#include "shader_cache.h"
+#include "startup.h"
+#include "thread_profile.h"
+
 /*
 This file contains expansion macros (X Macros) for OpenXR enumerations and structures.
 Example of how to use expansion macros to make an enum-to-string function:
@@ -94,29 +89,37 @@ typedef const char* (*XrStr_fn)(long value);
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_events.h>
 
-#define degrees_to_radians(angle_degrees) ((angle_degrees)*M_PI / 180.0)
-#define radians_to_degrees(angle_radians) ((angle_radians)*180.0 / M_PI)
-
 // we need an identity pose for creating spaces without offsets
 static XrPosef identity_pose = {.orientation = {.x = 0, .y = 0, .z = 0, .w = 1.0},
                                 .position = {.x = 0, .y = 0, .z = 0}};
 
-#define HAND_LEFT_INDEX 0
-#define HAND_RIGHT_INDEX 1
-#define HAND_COUNT 2
-
 
 // UDP
 #include <string.h>
 #include <unistd.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <arpa/inet.h>
+#include <errno.h>
+#include <sys/epoll.h>
 
 #define RECEIVER_IP "127.0.0.1"
 #define RECEIVER_PORT 12345
 #define SENDER_PORT 54321
 #define MAX_BUFFER_SIZE 65507
+// datagrams read per wakeup before the other sources get their turn
+#define VIDEO_PACKETS_PER_WAKEUP 16
+// a video frame whose packets stop arriving is dropped after this
+#define VIDEO_FRAME_TIMEOUT_NS (200 * 1000000ll)
+// the watchdog warns when no video frame arrived for this long
+#define VIDEO_WATCHDOG_NS (2 * 1000000000ll)
+// io_uring receive buffers of 64 KiB, datagrams that arrive while all are taken wait in the socket
+#define VIDEO_RING_BUFFERS 64
 #define SCALE 0.92
 #define JOINT_DEFAULT 100.0
+// one frame is published in buffer_in while the receiver fills the other
+#define VIDEO_POOL_FRAMES 2
+#define CACHE_LINE 64
 
 typedef struct {
     int width;
@@ -131,13 +134,76 @@ struct MainArgs {
 TextureInfo textureInfo;
 GLubyte* buffer_in = NULL;
 size_t buffer_in_size = 0;
-GLuint prev_frame_id = 0;
-int skip_frame_count = 0;
-
-// flags
-int VR_initialized = 0;
-int data_ready = 0;
-int closing_app = 0;
+// buffer_in points into it, only reallocated under buffer_mutex
+static struct frame_pool video_pool;
+// complete frames published in buffer_in
+static uint64_t video_frames_received = 0;
+// largest expected video frame, a larger one grows the pool, set by --videopool
+static struct frame_pool_config video_pool_config = {.name = "Video frame pool",
+                                                     .max_width = 1280,
+                                                     .max_height = 720,
+                                                     .bytes_per_pixel = 3,
+                                                     .frame_count = VIDEO_POOL_FRAMES,
+                                                     .pages = FRAME_POOL_PAGES_NORMAL};
+// --uring: receive the video through io_uring if the kernel supports it instead of recvfrom()
+static bool video_recv_ring = false;
+
+// flags shared by the xr (or replay) thread and the network thread, each on its own cache line so
+// that flipping one does not invalidate the others or the globals around them
+static struct
+{
+	// the joints of a new frame are in buffer_out. Set by the xr thread after packing them and
+	// cleared by the network thread after sending them, both under buffer_mutex with release,
+	// polled with acquire.
+	_Alignas(CACHE_LINE) _Atomic int data_ready;
+	// broadcast under buffer_mutex when data_ready or closing_app changes, the replay waits on it
+	// for the network thread to take a frame instead of spinning. Every frame writes it with
+	// data_ready, so it shares that line and not the one of closing_app.
+	pthread_cond_t data_ready_changed;
+	// set with release when the session ends, the thread loops poll it with acquire
+	_Alignas(CACHE_LINE) _Atomic bool closing_app;
+	// frames packed under buffer_mutex, by the xr thread's publish job or the replay, thins out
+	// the joint dump
+	_Alignas(CACHE_LINE) uint32_t packed_frames;
+} control = {.data_ready_changed = PTHREAD_COND_INITIALIZER};
+
+// the network thread, one reactor receiving the video frames and sending the joints, see
+// net_thread(). Everything but joints_ready belongs to that thread.
+static struct
+{
+	struct reactor reactor;
+	int video_fd;
+	// recvfrom() on the socket, or the completions of recv_ring
+	struct reactor_source video_socket;
+	struct reactor_source video_ring;
+	bool use_ring;
+	struct recv_ring ring;
+	// drops a video frame whose packets stopped arriving
+	struct reactor_source video_timeout;
+	// warns when the video stops
+	struct reactor_source video_watchdog;
+	// notified by the xr thread or the replay after the joints were packed into buffer_out
+	struct reactor_source joints_ready;
+
+	int send_fd;
+	struct sockaddr_in receiver_addr;
+	// the joints carry the time since the first joints were sent
+	bool joints_sent;
+
+	// the video frame being reassembled in frame
+	bool receiving;
+	GLubyte* frame;
+	int bytes_expected;
+	int bytes_received;
+	int64_t first_packet_ns;
+	uint32_t back_frame;
+	GLuint prev_frame_id;
+
+	uint64_t watchdog_frames;
+	bool video_stalled;
+
+	GLubyte recv_buffer[MAX_BUFFER_SIZE];
+} net;
 
 typedef struct {
 	int hand;
@@ -148,8 +214,8 @@ typedef struct {
 GLubyte* buffer_out = NULL;
 size_t buffer_out_size = 0;
 
-// flag for printing
-int flag = 0;
+// runtime, system and extension details printed during startup, off with --nodiagnostics
+static bool print_diagnostics = true;
 clock_t start_time, current_time;
 
 int initialized_hand[HAND_COUNT] = {0};
@@ -162,299 +228,11 @@ pthread_mutex_t buffer_mutex = PTHREAD_MUTEX_INITIALIZER;
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 
 
-// ============================================================================
-// math code adapted from
-// https://github.com/KhronosGroup/OpenXR-SDK-Source/blob/master/src/common/xr_linear.h
-// Copyright (c) 2017 The Khronos Group Inc.
-// Copyright (c) 2016 Oculus VR, LLC.
-// SPDX-License-Identifier: Apache-2.0
-// =============================================================================
-
-typedef enum
-{
-	GRAPHICS_VULKAN,
-	GRAPHICS_OPENGL,
-	GRAPHICS_OPENGL_ES
-} GraphicsAPI;
-
-typedef struct XrMatrix4x4f
-{
-	float m[16];
-} XrMatrix4x4f;
-
-inline static void
-XrMatrix4x4f_CreateProjectionFov(XrMatrix4x4f* result,
-                                 GraphicsAPI graphicsApi,
-                                 const XrFovf fov,
-                                 const float nearZ,
-                                 const float farZ)
-{
-	const float tanAngleLeft = tanf(fov.angleLeft);
-	const float tanAngleRight = tanf(fov.angleRight);
-
-	const float tanAngleDown = tanf(fov.angleDown);
-	const float tanAngleUp = tanf(fov.angleUp);
-
-	const float tanAngleWidth = tanAngleRight - tanAngleLeft;
-
-	// Set to tanAngleDown - tanAngleUp for a clip space with positive Y
-	// down (Vulkan). Set to tanAngleUp - tanAngleDown for a clip space with
-	// positive Y up (OpenGL / D3D / Metal).
-	const float tanAngleHeight =
-	    graphicsApi == GRAPHICS_VULKAN ? (tanAngleDown - tanAngleUp) : (tanAngleUp - tanAngleDown);
-
-	// Set to nearZ for a [-1,1] Z clip space (OpenGL / OpenGL ES).
-	// Set to zero for a [0,1] Z clip space (Vulkan / D3D / Metal).
-	const float offsetZ =
-	    (graphicsApi == GRAPHICS_OPENGL || graphicsApi == GRAPHICS_OPENGL_ES) ? nearZ : 0;
-
-	if (farZ <= nearZ) {
-		// place the far plane at infinity
-		result->m[0] = 2 / tanAngleWidth;
-		result->m[4] = 0;
-		result->m[8] = (tanAngleRight + tanAngleLeft) / tanAngleWidth;
-		result->m[12] = 0;
-
-		result->m[1] = 0;
-		result->m[5] = 2 / tanAngleHeight;
-		result->m[9] = (tanAngleUp + tanAngleDown) / tanAngleHeight;
-		result->m[13] = 0;
-
-		result->m[2] = 0;
-		result->m[6] = 0;
-		result->m[10] = -1;
-		result->m[14] = -(nearZ + offsetZ);
-
-		result->m[3] = 0;
-		result->m[7] = 0;
-		result->m[11] = -1;
-		result->m[15] = 0;
-	} else {
-		// normal projection
-		result->m[0] = 2 / tanAngleWidth;
-		result->m[4] = 0;
-		result->m[8] = (tanAngleRight + tanAngleLeft) / tanAngleWidth;
-		result->m[12] = 0;
-
-		result->m[1] = 0;
-		result->m[5] = 2 / tanAngleHeight;
-		result->m[9] = (tanAngleUp + tanAngleDown) / tanAngleHeight;
-		result->m[13] = 0;
-
-		result->m[2] = 0;
-		result->m[6] = 0;
-		result->m[10] = -(farZ + offsetZ) / (farZ - nearZ);
-		result->m[14] = -(farZ * (nearZ + offsetZ)) / (farZ - nearZ);
-
-		result->m[3] = 0;
-		result->m[7] = 0;
-		result->m[11] = -1;
-		result->m[15] = 0;
-	}
-}
-
-inline static void
-XrMatrix4x4f_CreateFromQuaternion(XrMatrix4x4f* result, const XrQuaternionf* quat)
-{
-	const float x2 = quat->x + quat->x;
-	const float y2 = quat->y + quat->y;
-	const float z2 = quat->z + quat->z;
-
-	const float xx2 = quat->x * x2;
-	const float yy2 = quat->y * y2;
-	const float zz2 = quat->z * z2;
-
-	const float yz2 = quat->y * z2;
-	const float wx2 = quat->w * x2;
-	const float xy2 = quat->x * y2;
-	const float wz2 = quat->w * z2;
-	const float xz2 = quat->x * z2;
-	const float wy2 = quat->w * y2;
-
-	result->m[0] = 1.0f - yy2 - zz2;
-	result->m[1] = xy2 + wz2;
-	result->m[2] = xz2 - wy2;
-	result->m[3] = 0.0f;
-
-	result->m[4] = xy2 - wz2;
-	result->m[5] = 1.0f - xx2 - zz2;
-	result->m[6] = yz2 + wx2;
-	result->m[7] = 0.0f;
-
-	result->m[8] = xz2 + wy2;
-	result->m[9] = yz2 - wx2;
-	result->m[10] = 1.0f - xx2 - yy2;
-	result->m[11] = 0.0f;
-
-	result->m[12] = 0.0f;
-	result->m[13] = 0.0f;
-	result->m[14] = 0.0f;
-	result->m[15] = 1.0f;
-}
-
-inline static void
-XrMatrix4x4f_CreateTranslation(XrMatrix4x4f* result, const float x, const float y, const float z)
-{
-	result->m[0] = 1.0f;
-	result->m[1] = 0.0f;
-	result->m[2] = 0.0f;
-	result->m[3] = 0.0f;
-	result->m[4] = 0.0f;
-	result->m[5] = 1.0f;
-	result->m[6] = 0.0f;
-	result->m[7] = 0.0f;
-	result->m[8] = 0.0f;
-	result->m[9] = 0.0f;
-	result->m[10] = 1.0f;
-	result->m[11] = 0.0f;
-	result->m[12] = x;
-	result->m[13] = y;
-	result->m[14] = z;
-	result->m[15] = 1.0f;
-}
-
-inline static void
-XrMatrix4x4f_Multiply(XrMatrix4x4f* result, const XrMatrix4x4f* a, const XrMatrix4x4f* b)
-{
-	result->m[0] = a->m[0] * b->m[0] + a->m[4] * b->m[1] + a->m[8] * b->m[2] + a->m[12] * b->m[3];
-	result->m[1] = a->m[1] * b->m[0] + a->m[5] * b->m[1] + a->m[9] * b->m[2] + a->m[13] * b->m[3];
-	result->m[2] = a->m[2] * b->m[0] + a->m[6] * b->m[1] + a->m[10] * b->m[2] + a->m[14] * b->m[3];
-	result->m[3] = a->m[3] * b->m[0] + a->m[7] * b->m[1] + a->m[11] * b->m[2] + a->m[15] * b->m[3];
-
-	result->m[4] = a->m[0] * b->m[4] + a->m[4] * b->m[5] + a->m[8] * b->m[6] + a->m[12] * b->m[7];
-	result->m[5] = a->m[1] * b->m[4] + a->m[5] * b->m[5] + a->m[9] * b->m[6] + a->m[13] * b->m[7];
-	result->m[6] = a->m[2] * b->m[4] + a->m[6] * b->m[5] + a->m[10] * b->m[6] + a->m[14] * b->m[7];
-	result->m[7] = a->m[3] * b->m[4] + a->m[7] * b->m[5] + a->m[11] * b->m[6] + a->m[15] * b->m[7];
-
-	result->m[8] = a->m[0] * b->m[8] + a->m[4] * b->m[9] + a->m[8] * b->m[10] + a->m[12] * b->m[11];
-	result->m[9] = a->m[1] * b->m[8] + a->m[5] * b->m[9] + a->m[9] * b->m[10] + a->m[13] * b->m[11];
-	result->m[10] = a->m[2] * b->m[8] + a->m[6] * b->m[9] + a->m[10] * b->m[10] + a->m[14] * b->m[11];
-	result->m[11] = a->m[3] * b->m[8] + a->m[7] * b->m[9] + a->m[11] * b->m[10] + a->m[15] * b->m[11];
-
-	result->m[12] =
-	    a->m[0] * b->m[12] + a->m[4] * b->m[13] + a->m[8] * b->m[14] + a->m[12] * b->m[15];
-	result->m[13] =
-	    a->m[1] * b->m[12] + a->m[5] * b->m[13] + a->m[9] * b->m[14] + a->m[13] * b->m[15];
-	result->m[14] =
-	    a->m[2] * b->m[12] + a->m[6] * b->m[13] + a->m[10] * b->m[14] + a->m[14] * b->m[15];
-	result->m[15] =
-	    a->m[3] * b->m[12] + a->m[7] * b->m[13] + a->m[11] * b->m[14] + a->m[15] * b->m[15];
-}
-
-inline static void
-XrMatrix4x4f_Invert(XrMatrix4x4f* result, const XrMatrix4x4f* src)
-{
-	result->m[0] = src->m[0];
-	result->m[1] = src->m[4];
-	result->m[2] = src->m[8];
-	result->m[3] = 0.0f;
-	result->m[4] = src->m[1];
-	result->m[5] = src->m[5];
-	result->m[6] = src->m[9];
-	result->m[7] = 0.0f;
-	result->m[8] = src->m[2];
-	result->m[9] = src->m[6];
-	result->m[10] = src->m[10];
-	result->m[11] = 0.0f;
-	result->m[12] = -(src->m[0] * src->m[12] + src->m[1] * src->m[13] + src->m[2] * src->m[14]);
-	result->m[13] = -(src->m[4] * src->m[12] + src->m[5] * src->m[13] + src->m[6] * src->m[14]);
-	result->m[14] = -(src->m[8] * src->m[12] + src->m[9] * src->m[13] + src->m[10] * src->m[14]);
-	result->m[15] = 1.0f;
-}
-
-inline static void
-XrMatrix4x4f_CreateViewMatrix(XrMatrix4x4f* result,
-                              const XrVector3f* translation,
-                              const XrQuaternionf* rotation)
-{
-
-	XrMatrix4x4f rotationMatrix;
-	XrMatrix4x4f_CreateFromQuaternion(&rotationMatrix, rotation);
-
-	XrMatrix4x4f translationMatrix;
-	XrMatrix4x4f_CreateTranslation(&translationMatrix, translation->x, translation->y,
-	                               translation->z);
-
-	XrMatrix4x4f viewMatrix;
-	XrMatrix4x4f_Multiply(&viewMatrix, &translationMatrix, &rotationMatrix);
-
-	XrMatrix4x4f_Invert(result, &viewMatrix);
-}
-
-inline static void
-XrMatrix4x4f_CreateScale(XrMatrix4x4f* result, const float x, const float y, const float z)
-{
-	result->m[0] = x;
-	result->m[1] = 0.0f;
-	result->m[2] = 0.0f;
-	result->m[3] = 0.0f;
-	result->m[4] = 0.0f;
-	result->m[5] = y;
-	result->m[6] = 0.0f;
-	result->m[7] = 0.0f;
-	result->m[8] = 0.0f;
-	result->m[9] = 0.0f;
-	result->m[10] = z;
-	result->m[11] = 0.0f;
-	result->m[12] = 0.0f;
-	result->m[13] = 0.0f;
-	result->m[14] = 0.0f;
-	result->m[15] = 1.0f;
-}
-
-inline static void
-XrMatrix4x4f_CreateModelMatrix(XrMatrix4x4f* result,
-                               const XrVector3f* translation,
-                               const XrQuaternionf* rotation,
-                               const XrVector3f* scale)
-{
-	XrMatrix4x4f scaleMatrix;
-	XrMatrix4x4f_CreateScale(&scaleMatrix, scale->x, scale->y, scale->z);
-
-	XrMatrix4x4f rotationMatrix;
-	XrMatrix4x4f_CreateFromQuaternion(&rotationMatrix, rotation);
-
-	XrMatrix4x4f translationMatrix;
-	XrMatrix4x4f_CreateTranslation(&translationMatrix, translation->x, translation->y,
-	                               translation->z);
-
-	XrMatrix4x4f combinedMatrix;
-	XrMatrix4x4f_Multiply(&combinedMatrix, &rotationMatrix, &scaleMatrix);
-	XrMatrix4x4f_Multiply(result, &translationMatrix, &combinedMatrix);
-}
-// =============================================================================
-
-
+#include "renderer.h"
 
 // =============================================================================
-// OpenGL rendering code at the end of the file
+// Desktop window code at the end of the file
 // =============================================================================
-struct gl_renderer_t
-{
-	// To render into a texture we need a framebuffer (one per texture to make it easy)
-	GLuint** framebuffers;
-
-	float near_z;
-	float far_z;
-
-	GLuint shader_program_id;
-	GLuint* VAOs;
-
-	struct
-	{
-		bool initialized;
-		GLuint texture;
-		GLuint fbo;
-	} quad;
-
-	int modelLoc;
-	int colorLoc;
-	int textureLoc;
-	int viewLoc;
-	int projLoc;
-};
-
-struct hand_tracking_t;
 
 #ifdef __linux__
 bool
@@ -464,34 +242,23 @@ init_sdl_window(Display** xDisplay,
                 GLXDrawable* glxDrawable,
                 GLXContext* glxContext,
                 int w,
-                int h);
+                int h,
+                enum mirror_mode mirror_mode);
 
-int
-init_gl(uint32_t view_count, uint32_t* swapchain_lengths, struct gl_renderer_t* gl_renderer);
+void
+blit_to_desktop(GLuint framebuffer, int w, int h);
+
+bool
+mirror_start(void);
 
-struct ApplicationState;
 void
-render_frame(struct ApplicationState* app,
-             int w,
-             int h,
-             struct gl_renderer_t* gl_renderer,
-             uint32_t projection_index,
-             XrTime predictedDisplayTime,
-             int view_index,
-             XrSpaceLocation* hand_locations,
-             struct hand_tracking_t* hand_tracking,
-             XrView* view,
-             GLuint image,
-             bool depth_supported,
-             GLuint depthbuffer);
-
-struct quad_layer_t;
+mirror_copy(GLuint framebuffer, int w, int h);
+
 void
-render_quad(struct gl_renderer_t* gl_renderer,
-            struct quad_layer_t* quad,
-            uint32_t swapchain_index,
-            XrTime predictedDisplayTime);
+mirror_publish(void);
 
+void
+mirror_stop(void);
 #endif
 // =============================================================================
 
@@ -676,7 +443,8 @@ get_swapchain_format(XrInstance instance,
 	if (!xr_check(instance, result, "Failed to get number of supported swapchain formats"))
 		return -1;
 
-	printf("Runtime supports %d swapchain formats\n", swapchain_format_count);
+	if (print_diagnostics)
+		printf("Runtime supports %d swapchain formats\n", swapchain_format_count);
 	int64_t* swapchain_formats = malloc(sizeof(int64_t) * swapchain_format_count);
 	result = xrEnumerateSwapchainFormats(session, swapchain_format_count, &swapchain_format_count,
 	                                     swapchain_formats);
@@ -686,7 +454,8 @@ get_swapchain_format(XrInstance instance,
 	int64_t chosen_format = fallback ? swapchain_formats[0] : -1;
 
 	for (uint32_t i = 0; i < swapchain_format_count; i++) {
-		printf("Supported GL format: %#lx\n", swapchain_formats[i]);
+		if (print_diagnostics)
+			printf("Supported GL format: %#lx\n", swapchain_formats[i]);
 		if (swapchain_formats[i] == preferred_format) {
 			chosen_format = swapchain_formats[i];
 			printf("Using preferred swapchain format %#lx\n", chosen_format);
@@ -702,24 +471,6 @@ get_swapchain_format(XrInstance instance,
 	return chosen_format;
 }
 
-struct action_t
-{
-	XrAction action;
-	XrActionType action_type;
-	union {
-		XrActionStateFloat float_;
-		XrActionStateBoolean boolean_;
-		XrActionStatePose pose_;
-		XrActionStateVector2f vec2f_;
-	} states[HAND_COUNT];
-	XrSpace pose_spaces[HAND_COUNT];
-	XrSpaceLocation pose_locations[HAND_COUNT];
-	XrSpaceVelocity pose_velocities[HAND_COUNT];
-
-	// the subaction paths this action was created with
-	XrPath* subaction_paths;
-	uint32_t subaction_path_count;
-};
 
 bool
 create_action(XrInstance instance,
@@ -772,58 +523,11 @@ create_action_space(XrInstance instance,
 	return true;
 }
 
-struct base_extension_t
-{
-	bool supported;
-	uint32_t version;
-
-	char* ext_name_string;
-};
-
-struct opengl_t
-{
-	struct base_extension_t base;
-
-	// functions belonging to extensions must be loaded with xrGetInstanceProcAddr before use
-	PFN_xrGetOpenGLGraphicsRequirementsKHR xrGetOpenGLGraphicsRequirementsKHR;
-};
-
-struct hand_tracking_t
-{
-	struct base_extension_t base;
-
-	// whether the current VR system in use has hand tracking
-	bool system_supported;
-	XrHandTrackerEXT trackers[HAND_COUNT];
-
-	// out data
-	XrHandJointLocationEXT joints[HAND_COUNT][XR_HAND_JOINT_COUNT_EXT];
-	XrHandJointLocationsEXT joint_locations[HAND_COUNT];
-
-	// optional
-	XrHandJointVelocitiesEXT joint_velocities[HAND_COUNT];
-	XrHandJointVelocityEXT joint_velocities_arr[HAND_COUNT][XR_HAND_JOINT_COUNT_EXT];
 
-	PFN_xrLocateHandJointsEXT xrLocateHandJointsEXT;
-	PFN_xrCreateHandTrackerEXT xrCreateHandTrackerEXT;
-};
-
-struct depth_t
-{
-	struct base_extension_t base;
 
-	XrCompositionLayerDepthInfoKHR* infos;
-};
 
 
-struct refresh_rate_t
-{
-	struct base_extension_t base;
 
-	PFN_xrEnumerateDisplayRefreshRatesFB xrEnumerateDisplayRefreshRatesFB;
-	PFN_xrGetDisplayRefreshRateFB xrGetDisplayRefreshRateFB;
-	PFN_xrRequestDisplayRefreshRateFB xrRequestDisplayRefreshRateFB;
-};
 
 
 static char* vive_tracker_role_str[] = {
@@ -837,112 +541,10 @@ static char* vive_tracker_role_str[] = {
 };
 #define VIVE_TRACKER_ROLE_COUNT (sizeof(vive_tracker_role_str) / sizeof(vive_tracker_role_str[0]))
 
-struct known_vive_tracker
-{
-	XrPath persistent_path;
-	XrPath role_path;
-
-	char* role_str;
-
-	// pointing to the pre-created per-role action. NULL if role_PATH == XR_NULL_PATH.
-	struct action_t action;
-
-	struct known_vive_tracker* next;
-};
-
-struct vive_tracker_t
-{
-	struct base_extension_t base;
-
-	// dynamic list of trackers
-	struct known_vive_tracker* trackers;
-
-	PFN_xrEnumerateViveTrackerPathsHTCX pfnxrEnumerateViveTrackerPathsHTCX;
-};
-
-struct ext_t
-{
-	struct opengl_t opengl;
-	struct depth_t depth;
-
-	struct hand_tracking_t hand_tracking;
-	struct refresh_rate_t refresh_rate;
-
-	struct vive_tracker_t vive_tracker;
-};
-
-struct OpenXRState
-{
-	XrFormFactor form_factor;
-	XrViewConfigurationType view_type;
-	XrReferenceSpaceType play_space_type;
-
-	XrInstance instance;
-	XrSession session;
-	XrSystemId system_id;
-	XrSessionState state;
-
-	XrEnvironmentBlendMode blend_mode;
-	bool blend_mode_explicitly_set;
-
-	XrSpace play_space;
-
-	// Each physical Display/Eye is described by a view
-	uint32_t view_count;
-	XrViewConfigurationView* viewconfig_views;
-	XrCompositionLayerProjectionView* projection_views;
-	XrView* views;
-
-	XrViewState view_state;
-};
-
-struct ApplicationState
-{
-	// have to define the names somewhere
-	struct ext_t ext;
-
-	struct OpenXRState oxr;
-
-	// use optional XrSpaceVelocity in xrLocateSpace for controllers and visualize linear velocity
-	bool query_hand_velocities;
-
-	// use optional XrSpaceVelocity in xrLocateHandJointsEXT and visualize linear velocity
-	bool query_joint_velocities;
-
-	struct
-	{
-		bool enabled;
-		// cube moves in `velocity` direction until it hits `center_pos +- `bouncing_lengths, then
-		// reverse `velocity
-		XrVector3f center_pos;       // m
-		XrVector3f current_pos;      // m
-		XrTime pos_ts;               // ns
-		XrVector3f velocity;         // m/s
-		XrVector3f bouncing_lengths; // m
-	} cube;
-
-	// Grabbing objects is not actually implemented in this demo, it only gives some  haptic feebdack.
-	struct action_t grab_action;
-
-	// A 1D action that is fed by one axis of a 2D input (y axis of thumbstick).
-	struct action_t accelerate_action;
-
-	struct action_t hand_pose_action;
-	struct action_t aim_action;
 
-	struct action_t haptic_action;
 
-	XrSpace ref_local_space;
-	XrSpace ref_local_space_y1;
 
-	XrSpace ref_stage_space;
-	XrSpace ref_stage_space_y1;
 
-	XrSpace ref_view_space;
-	XrSpace ref_view_space_z1;
-
-	struct gl_renderer_t gl_renderer;
-};
 
 static char*
 create_name_from_path(char* path)
@@ -973,7 +575,8 @@ create_vive_role_trackers(XrInstance instance,
 
 		struct known_vive_tracker* next_tracker = calloc(1, sizeof(struct known_vive_tracker));
 		next_tracker->action =
-		    (struct action_t){.action = XR_NULL_HANDLE, .action_type = XR_ACTION_TYPE_POSE_INPUT};
+		    (struct action_t){.action = XR_NULL_HANDLE, .action_type = XR_ACTION_TYPE_POSE_INPUT,
+		                      .record_id = REC_ACTION_VIVE_TRACKER + i};
 		next_tracker->role_path = XR_NULL_PATH;
 		next_tracker->role_str = (char*)vive_tracker_role_str[i];
 
@@ -1093,9 +696,11 @@ _check_extensions(struct ApplicationState* app, struct ext_t* ext)
 		return result;
 	}
 
-	printf("Runtime supports %d extensions\n", ext_count);
-	for (uint32_t i = 0; i < ext_count; i++) {
-		printf("\t%s v%d\n", ext_props[i].extensionName, ext_props[i].extensionVersion);
+	if (print_diagnostics) {
+		printf("Runtime supports %d extensions\n", ext_count);
+		for (uint32_t i = 0; i < ext_count; i++) {
+			printf("\t%s v%d\n", ext_props[i].extensionName, ext_props[i].extensionVersion);
+		}
 	}
 
 	_check_extension_support(&ext->opengl.base, ext_props, ext_count);
@@ -1156,13 +761,6 @@ _init_extensions(XrInstance instance, struct ext_t* ext)
 	return XR_SUCCESS;
 }
 
-struct swapchain_t
-{
-	uint32_t* swapchain_lengths;
-	XrSwapchainImageOpenGLKHR** images;
-	XrSwapchain* swapchains;
-	uint32_t swapchain_count;
-};
 
 enum Swapchain
 {
@@ -1181,6 +779,7 @@ _create_swapchain(XrInstance instance,
                   uint32_t sample_count,
                   uint32_t w,
                   uint32_t h,
+                  uint32_t array_size,
                   XrSwapchainUsageFlags usage_flags)
 {
 	XrSwapchainCreateInfo swapchain_create_info = {
@@ -1192,7 +791,7 @@ _create_swapchain(XrInstance instance,
 	    .width = w,
 	    .height = h,
 	    .faceCount = 1,
-	    .arraySize = 1,
+	    .arraySize = array_size,
 	    .mipCount = 1,
 	    .next = NULL,
 	};
@@ -1235,6 +834,7 @@ create_one_swapchain(XrInstance instance,
                      uint32_t sample_count,
                      uint32_t w,
                      uint32_t h,
+                     uint32_t array_size,
                      XrSwapchainUsageFlags usage_flags)
 {
 	swapchain->swapchains = malloc(sizeof(XrSwapchain));
@@ -1242,7 +842,7 @@ create_one_swapchain(XrInstance instance,
 	swapchain->images = malloc(sizeof(XrSwapchainImageOpenGLKHR*));
 	swapchain->swapchain_count = 1;
 
-	return _create_swapchain(instance, session, swapchain, 0, format, sample_count, w, h,
+	return _create_swapchain(instance, session, swapchain, 0, format, sample_count, w, h, array_size,
 	                         usage_flags);
 }
 
@@ -1265,7 +865,7 @@ create_swapchain_from_views(XrInstance instance,
 		uint32_t w = viewconfig_views[i].recommendedImageRectWidth;
 		uint32_t h = viewconfig_views[i].recommendedImageRectHeight;
 
-		if (!_create_swapchain(instance, session, swapchain, i, format, sample_count, w, h,
+		if (!_create_swapchain(instance, session, swapchain, i, format, sample_count, w, h, 1,
 		                       usage_flags))
 			return false;
 	}
@@ -1362,6 +962,55 @@ suggest_actions(XrInstance instance, char* profile, struct Binding* b, int bindi
 	return true;
 }
 
+static void
+record_action_state(const struct action_t* action, uint32_t idx, XrTime time, bool velocities)
+{
+	struct rec_action* rec = recorder_begin(REC_ACTION, sizeof(struct rec_action));
+	if (rec == NULL)
+		return;
+
+	*rec = (struct rec_action){
+	    .time = time,
+	    .action = action->record_id,
+	    .subaction = idx,
+	    .action_type = action->action_type,
+	};
+
+	switch (action->action_type) {
+	case XR_ACTION_TYPE_FLOAT_INPUT:
+		rec->is_active = action->states[idx].float_.isActive;
+		rec->changed_since_last_sync = action->states[idx].float_.changedSinceLastSync;
+		rec->value[0] = action->states[idx].float_.currentState;
+		break;
+	case XR_ACTION_TYPE_BOOLEAN_INPUT:
+		rec->is_active = action->states[idx].boolean_.isActive;
+		rec->changed_since_last_sync = action->states[idx].boolean_.changedSinceLastSync;
+		rec->value[0] = action->states[idx].boolean_.currentState;
+		break;
+	case XR_ACTION_TYPE_VECTOR2F_INPUT:
+		rec->is_active = action->states[idx].vec2f_.isActive;
+		rec->changed_since_last_sync = action->states[idx].vec2f_.changedSinceLastSync;
+		rec->value[0] = action->states[idx].vec2f_.currentState.x;
+		rec->value[1] = action->states[idx].vec2f_.currentState.y;
+		break;
+	case XR_ACTION_TYPE_POSE_INPUT:
+		rec->is_active = action->states[idx].pose_.isActive;
+		if (!rec->is_active)
+			break;
+		rec->location_flags = action->pose_locations[idx].locationFlags;
+		rec->pose = action->pose_locations[idx].pose;
+		if (velocities) {
+			rec->has_velocity = 1;
+			rec->velocity_flags = action->pose_velocities[idx].velocityFlags;
+			rec->linear_velocity = action->pose_velocities[idx].linearVelocity;
+			rec->angular_velocity = action->pose_velocities[idx].angularVelocity;
+		}
+		break;
+	default: break;
+	}
+
+	recorder_commit();
+}
 
 bool
 update_action_data(XrInstance instance,
@@ -1433,17 +1082,14 @@ update_action_data(XrInstance instance,
 		if (!xr_check(instance, result, "Failed to get action state")) {
 			return false;
 		}
+
+		if (recorder_active())
+			record_action_state(action, subaction_path_idx, time, velocities);
 	}
 
 	return true;
 }
 
-struct quad_layer_t
-{
-	// quad layers are placed into world space, no need to render them per eye
-	struct swapchain_t swapchain;
-	uint32_t pixel_width, pixel_height;
-};
 
 static bool
 create_hand_trackers(XrInstance instance, XrSession session, struct hand_tracking_t* hand_tracking)
@@ -1479,6 +1125,69 @@ create_hand_trackers(XrInstance instance, XrSession session, struct hand_trackin
 	return true;
 }
 
+// converts joint locations into JointData relative to the first tracked pose and stores them in
+// buffer_out for the network thread, the caller holds buffer_mutex
+static void
+pack_hand_joints(const XrHandJointLocationEXT* joints, int hand)
+{
+	for (int jointIndex = 0; jointIndex < XR_HAND_JOINT_COUNT_EXT; ++jointIndex) {
+		XrHandJointLocationEXT jointLocation = joints[jointIndex];
+
+		// Create a JointLocation structure to hold the data
+		JointData joint;
+
+		// Set the hand information
+		joint.hand = hand;
+		joint.joint_index = jointIndex;
+
+		// Check if the bit corresponding to the joint location is set
+		if (jointLocation.locationFlags & XR_SPACE_LOCATION_POSITION_TRACKED_BIT) {
+			// Set initial data
+			if (initialized_hand[hand] == 0) {
+				initialized_hand[hand] = 1;
+				initial_data[hand].hand = hand;
+				initial_data[hand].joint_index = jointIndex;
+				initial_data[hand].pose = jointLocation.pose;					
+			}
+
+			// Set to jointLocation.pose if the bit is set
+			joint.pose = jointLocation.pose;
+			joint.pose.position.x = jointLocation.pose.position.x - initial_data[hand].pose.position.x;
+			joint.pose.position.y = jointLocation.pose.position.y - initial_data[hand].pose.position.y;
+			joint.pose.position.z = jointLocation.pose.position.z - initial_data[hand].pose.position.z;
+			joint.pose.orientation.x = jointLocation.pose.orientation.x - initial_data[hand].pose.orientation.x;
+			joint.pose.orientation.y = jointLocation.pose.orientation.y - initial_data[hand].pose.orientation.y;
+			joint.pose.orientation.z = jointLocation.pose.orientation.z - initial_data[hand].pose.orientation.z;
+			joint.pose.orientation.w = jointLocation.pose.orientation.w - initial_data[hand].pose.orientation.w;
+
+		} else {
+			// Set to default value if the bit is not set
+			joint.pose.position.x = JOINT_DEFAULT;
+			joint.pose.position.y = JOINT_DEFAULT;
+			joint.pose.position.z = JOINT_DEFAULT;
+			joint.pose.orientation.x = JOINT_DEFAULT;
+			joint.pose.orientation.y = JOINT_DEFAULT;
+			joint.pose.orientation.z = JOINT_DEFAULT;
+			joint.pose.orientation.w = JOINT_DEFAULT;
+		}
+
+
+		if (control.packed_frames % 10 == 0) {
+			LOG_DEBUG("Hand %d Joint %d: orientation (%f, %f, %f, %f), position (%f, %f, %f)\n",
+				joint.hand, joint.joint_index, joint.pose.orientation.x, joint.pose.orientation.y,
+				joint.pose.orientation.z, joint.pose.orientation.w, joint.pose.position.x,
+				joint.pose.position.y, joint.pose.position.z);
+		}
+
+		// Calculate the offset in the buffer for the current joint
+		size_t offset = sizeof(double) + jointIndex * sizeof(JointData) + hand * XR_HAND_JOINT_COUNT_EXT * sizeof(JointData);
+
+		// Copy the JointLocation structure to the buffer
+		memcpy(buffer_out + offset, &joint, sizeof(JointData));
+	}
+}
+
+// true if the joints of hand were located
 static bool
 get_hand_tracking(XrInstance instance,
                   XrSpace space,
@@ -1506,69 +1215,30 @@ get_hand_tracking(XrInstance instance,
 	                                              &hand_tracking->joint_locations[hand]);
 	
 
-	if (result == XR_SUCCESS) {
-		for (int jointIndex = 0; jointIndex < XR_HAND_JOINT_COUNT_EXT; ++jointIndex) {
-			XrHandJointLocationEXT jointLocation =
-				hand_tracking->joint_locations[hand].jointLocations[jointIndex];
-
-			// Create a JointLocation structure to hold the data
-			JointData joint;
-
-			// Set the hand information
-			joint.hand = hand;
-			joint.joint_index = jointIndex;
-
-			// Check if the bit corresponding to the joint location is set
-			if (jointLocation.locationFlags & XR_SPACE_LOCATION_POSITION_TRACKED_BIT) {
-				// Set initial data
-				if (initialized_hand[hand] == 0) {
-					initialized_hand[hand] = 1;
-					initial_data[hand].hand = hand;
-					initial_data[hand].joint_index = jointIndex;
-					initial_data[hand].pose = jointLocation.pose;					
-				}
-
-				// Set to jointLocation.pose if the bit is set
-				joint.pose = jointLocation.pose;
-				joint.pose.position.x = jointLocation.pose.position.x - initial_data[hand].pose.position.x;
-				joint.pose.position.y = jointLocation.pose.position.y - initial_data[hand].pose.position.y;
-				joint.pose.position.z = jointLocation.pose.position.z - initial_data[hand].pose.position.z;
-				joint.pose.orientation.x = jointLocation.pose.orientation.x - initial_data[hand].pose.orientation.x;
-				joint.pose.orientation.y = jointLocation.pose.orientation.y - initial_data[hand].pose.orientation.y;
-				joint.pose.orientation.z = jointLocation.pose.orientation.z - initial_data[hand].pose.orientation.z;
-				joint.pose.orientation.w = jointLocation.pose.orientation.w - initial_data[hand].pose.orientation.w;
-
-			} else {
-				// Set to default value if the bit is not set
-				joint.pose.position.x = JOINT_DEFAULT;
-				joint.pose.position.y = JOINT_DEFAULT;
-				joint.pose.position.z = JOINT_DEFAULT;
-				joint.pose.orientation.x = JOINT_DEFAULT;
-				joint.pose.orientation.y = JOINT_DEFAULT;
-				joint.pose.orientation.z = JOINT_DEFAULT;
-				joint.pose.orientation.w = JOINT_DEFAULT;
-			}
-
-
-			if (flag % 10 == 0) {
-				printf("Hand %d Joint %d: orientation (%f, %f, %f, %f), position (%f, %f, %f)\n",
-					joint.hand, joint.joint_index, joint.pose.orientation.x, joint.pose.orientation.y,
-					joint.pose.orientation.z, joint.pose.orientation.w, joint.pose.position.x,
-					joint.pose.position.y, joint.pose.position.z);
-			}
-
-			// Calculate the offset in the buffer for the current joint
-			size_t offset = sizeof(double) + jointIndex * sizeof(JointData) + hand * XR_HAND_JOINT_COUNT_EXT * sizeof(JointData);
-
-			// Copy the JointLocation structure to the buffer
-			memcpy(buffer_out + offset, &joint, sizeof(JointData));
+	if (result == XR_SUCCESS && recorder_active()) {
+		struct rec_joints* rec = recorder_begin(REC_JOINTS, sizeof(struct rec_joints));
+		if (rec != NULL) {
+			rec->time = time;
+			rec->hand = hand;
+			rec->is_active = hand_tracking->joint_locations[hand].isActive;
+			rec->has_velocities = query_joint_velocities;
+			rec->reserved = 0;
+			memcpy(rec->joints, hand_tracking->joint_locations[hand].jointLocations,
+			       sizeof(rec->joints));
+			if (query_joint_velocities)
+				memcpy(rec->velocities, hand_tracking->joint_velocities_arr[hand],
+				       sizeof(rec->velocities));
+			else
+				memset(rec->velocities, 0, sizeof(rec->velocities));
+			recorder_commit();
 		}
 	}
 
 	if (!xr_check(instance, result, "failed to locate hand joints!"))
 		return false;
 
-	return true;
+	// only fully located joints are sent
+	return result == XR_SUCCESS;
 }
 
 
@@ -1579,6 +1249,24 @@ static struct option long_options[] = {{"help", no_argument, 0, 'h'},
                                        {"blendmode", required_argument, 0, 'b'},
                                        {"space", required_argument, 0, 's'},
                                        {"movingcube", required_argument, 0, 'c'},
+                                       {"loglevel", required_argument, 0, 'l'},
+                                       {"lograte", required_argument, 0, 'r'},
+                                       {"record", required_argument, 0, 'o'},
+                                       {"replay", required_argument, 0, 'i'},
+                                       {"replayspeed", required_argument, 0, 'x'},
+                                       {"stereo", required_argument, 0, 't'},
+                                       {"pipelined", no_argument, 0, 'p'},
+                                       {"latelatch", no_argument, 0, 'a'},
+                                       {"timingreport", required_argument, 0, 'T'},
+                                       {"mirror", required_argument, 0, 'm'},
+                                       {"mirrorscale", required_argument, 0, 'M'},
+                                       {"shadercache", required_argument, 0, 'S'},
+                                       {"nodiagnostics", no_argument, 0, 'D'},
+                                       {"videopool", required_argument, 0, 'V'},
+                                       {"allocsteady", required_argument, 0, 'A'},
+                                       {"threadprofile", required_argument, 0, 'P'},
+                                       {"jobworkers", required_argument, 0, 'J'},
+                                       {"uring", no_argument, 0, 'U'},
                                        {0, 0, 0, 0}};
 void
 parse_opts(int argc, char** argv, struct ApplicationState* app)
@@ -1586,7 +1274,8 @@ parse_opts(int argc, char** argv, struct ApplicationState* app)
 	while (1) {
 		int c;
 		int option_index = 0;
-		c = getopt_long(argc, argv, "jhf:b:s:c:p", long_options, &option_index);
+		c = getopt_long(argc, argv, "jhf:b:s:c:l:r:o:i:x:t:paT:m:M:S:DV:A:P:J:U", long_options,
+		                &option_index);
 		if (c == -1)
 			break;
 
@@ -1616,6 +1305,25 @@ parse_opts(int argc, char** argv, struct ApplicationState* app)
 			printf("\t\thorizontal\n");
 			printf("\t\tdiagonal\n");
 			printf("\t\tvertical\n");
+			printf("\t-l|--loglevel <error|warn|info|debug|trace>\n");
+			printf("\t-r|--lograte <max records per second per log statement, 0 = unlimited>\n");
+			printf("\t-o|--record <file>\n");
+			printf("\t-i|--replay <file>\n");
+			printf("\t-x|--replayspeed <factor, 1 = original timing, 0 = as fast as possible>\n");
+			printf("\t-t|--stereo <off|auto|multiview|vertexlayer|geometry>\n");
+			printf("\t-p|--pipelined\n");
+			printf("\t-a|--latelatch\n");
+			printf("\t-T|--timingreport <seconds between frame timing reports, 0 = only at exit>\n");
+			printf("\t-m|--mirror <off|every:N|async>\n");
+			printf("\t-M|--mirrorscale <mirror window size relative to the eye resolution>\n");
+			printf("\t-S|--shadercache <directory|off>\n");
+			printf("\t-D|--nodiagnostics\n");
+			printf("\t-V|--videopool <max width>x<max height>[,lock][,thp|,hugetlb]\n");
+			printf("\t-A|--allocsteady <frame>[,abort] (builds with -DALLOC_TRACKER=ON)\n");
+			printf("\t-P|--threadprofile <xr|render|mirror|net|job>[:cpus=<list>]"
+			       "[:fifo=<priority>|:rr=<priority>|:other], repeatable\n");
+			printf("\t-J|--jobworkers <threads running the frame jobs besides the xr thread>\n");
+			printf("\t-U|--uring (receive the video through io_uring)\n");
 			exit(0);
 
 		case 'b':
@@ -1663,80 +1371,954 @@ parse_opts(int argc, char** argv, struct ApplicationState* app)
 			app->query_hand_velocities = true;
 			break;
 
-		default: abort();
+		case 'l': {
+			enum log_level level;
+			if (!logger_parse_level(optarg, &level)) {
+				printf("ARG: Unknown log level %s\n", optarg);
+				exit(1);
+			}
+			logger_set_level(level);
+			printf("ARG: Log level %s -> %d\n", optarg, level);
+			break;
 		}
-	}
-}
 
-void *main_loop(void* arg)
-{
-	printf("Entering main loop\n");
+		case 'r': {
+			// 0 is unlimited, so a typo must not quietly become it
+			char* end = NULL;
+			unsigned long rate = strtoul(optarg, &end, 10);
+			if (*optarg < '0' || *optarg > '9' || *end != '\0' || rate > UINT32_MAX) {
+				printf("ARG: Log rate limit must be 0..%u records/s\n", UINT32_MAX);
+				exit(1);
+			}
+			logger_set_rate_limit((uint32_t)rate);
+			printf("ARG: Log rate limit %lu records/s\n", rate);
+			break;
+		}
 
-	struct ApplicationState app = {
-	    .ext =
-	        {
-	            .opengl.base.ext_name_string = XR_KHR_OPENGL_ENABLE_EXTENSION_NAME,
-	            .depth.base.ext_name_string = XR_KHR_COMPOSITION_LAYER_DEPTH_EXTENSION_NAME,
-	            .hand_tracking.base.ext_name_string = XR_EXT_HAND_TRACKING_EXTENSION_NAME,
-	            .refresh_rate.base.ext_name_string = XR_FB_DISPLAY_REFRESH_RATE_EXTENSION_NAME,
-	            .vive_tracker.base.ext_name_string = XR_HTCX_VIVE_TRACKER_INTERACTION_EXTENSION_NAME,
-	        },
-	    .oxr =
-	        {
-	            .form_factor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY,
-	            .view_type = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO,
-	            .play_space_type = XR_REFERENCE_SPACE_TYPE_STAGE,
+		case 'o':
+			app->record_path = optarg;
+			printf("ARG: Recording session to %s\n", optarg);
+			break;
 
-	            .instance = XR_NULL_HANDLE,
-	            .session = XR_NULL_HANDLE,
-	            .system_id = XR_NULL_SYSTEM_ID,
-	            .state = XR_SESSION_STATE_UNKNOWN,
-	            .play_space = XR_NULL_HANDLE,
+		case 'i':
+			app->replay_path = optarg;
+			printf("ARG: Replaying session from %s\n", optarg);
+			break;
 
-	            .view_count = 0,
-	            .viewconfig_views = NULL,
-	            .projection_views = NULL,
-	            .views = NULL,
-	        },
-	    .gl_renderer =
-	        {
-	            .near_z = 0.01f,
-	            .far_z = 100.0f,
-	        },
-	    .query_joint_velocities = false,
-	    .query_hand_velocities = false,
+		case 'x': {
+			// 0 is as fast as possible, so a typo must not quietly become it
+			char* end = NULL;
+			app->replay_speed = strtod(optarg, &end);
+			if (end == optarg || *end != '\0' || !isfinite(app->replay_speed) ||
+			    app->replay_speed < 0) {
+				printf("ARG: Replay speed must be a number >= 0\n");
+				exit(1);
+			}
+			printf("ARG: Replay speed %f\n", app->replay_speed);
+			break;
+		}
 
-	};
-	struct MainArgs* mainArgs = (struct MainArgs*)arg;
-    int argc = mainArgs->argc;
-    char** argv = mainArgs->argv;
+		case 't':
+			if (!parse_stereo_mode(optarg, &app->gl_renderer.stereo_mode)) {
+				printf("ARG: Unknown stereo mode %s\n", optarg);
+				exit(1);
+			}
+			printf("ARG: Single pass stereo %s\n", optarg);
+			break;
 
-	parse_opts(argc, argv, &app);
+		case 'p':
+			printf("ARG: Rendering on a separate thread\n");
+			app->pipelined = true;
+			break;
 
-	// The runtime interacts with the OpenGL images (textures) via a Swapchain.
-	XrGraphicsBindingOpenGLXlibKHR graphics_binding_gl = {0};
+		case 'a':
+			printf("ARG: Late latching views and hand joints\n");
+			app->late_latch = true;
+			break;
 
-	struct swapchain_t vr_swapchains[SWAPCHAIN_LAST];
+		case 'T': {
+			// 0 only reports at exit, so a typo must not quietly become it
+			char* end = NULL;
+			app->timing_report_s = strtod(optarg, &end);
+			if (end == optarg || *end != '\0' || !isfinite(app->timing_report_s) ||
+			    app->timing_report_s < 0) {
+				printf("ARG: Frame timing report interval must be a number of seconds >= 0\n");
+				exit(1);
+			}
+			printf("ARG: Frame timing report every %f s\n", app->timing_report_s);
+			break;
+		}
 
-	// define texture width/height
-	struct quad_layer_t quad_layer = {.pixel_width = 500 * SCALE, .pixel_height = 300 * SCALE};
+		case 'm': {
+			const char* every = strncmp(optarg, "every:", 6) == 0 ? optarg + 6 : NULL;
+			if (strcmp(optarg, "off") == 0) {
+				app->mirror_mode = MIRROR_OFF;
+			} else if (strcmp(optarg, "async") == 0) {
+				app->mirror_mode = MIRROR_ASYNC;
+			} else if (every != NULL) {
+				// strtoul() would skip blanks and negate a sign, only digits are a frame count
+				char* end = NULL;
+				unsigned long frames = strtoul(every, &end, 10);
+				if (*every < '0' || *every > '9' || *end != '\0' || frames == 0 ||
+				    frames > UINT32_MAX) {
+					printf("ARG: Mirror every:N needs a frame count of 1..%u\n", UINT32_MAX);
+					exit(1);
+				}
+				app->mirror_mode = MIRROR_EVERY;
+				app->mirror_every = (uint32_t)frames;
+			} else {
+				printf("ARG: Unknown mirror mode %s\n", optarg);
+				exit(1);
+			}
+			printf("ARG: Desktop mirror %s\n", optarg);
+			break;
+		}
 
-	XrPath hand_paths[HAND_COUNT];
-	XrPath hand_interaction_profile[HAND_COUNT] = {0};
+		case 'M':
+			app->mirror_scale = strtof(optarg, NULL);
+			if (app->mirror_scale <= 0 || app->mirror_scale > 1) {
+				printf("ARG: Mirror scale must be in (0, 1]\n");
+				exit(1);
+			}
+			printf("ARG: Mirror scale %f\n", app->mirror_scale);
+			break;
 
-	XrPath vive_tracker_interaction_profile[VIVE_TRACKER_ROLE_COUNT] = {0};
+		case 'S':
+			app->shader_cache_dir = optarg;
+			printf("ARG: Shader cache %s\n", optarg);
+			break;
 
-	// reuse this variable for all our OpenXR return codes
-	XrResult result = XR_SUCCESS;
+		case 'D':
+			printf("ARG: Not printing runtime diagnostics\n");
+			print_diagnostics = false;
+			break;
 
-	result = _check_extensions(&app, &app.ext);
-	if (!xr_check(app.oxr.instance, result, "Extensions check failed!")) {
-		return (void *)1;
-	}
-	if (!app.ext.opengl.base.supported) {
-		printf("%s is required\n", app.ext.opengl.base.ext_name_string);
-		return (void *)1;
-	};
+		case 'V': {
+			int consumed = 0;
+			if (sscanf(optarg, "%ux%u%n", &video_pool_config.max_width, &video_pool_config.max_height,
+			           &consumed) != 2 ||
+			    video_pool_config.max_width == 0 || video_pool_config.max_height == 0) {
+				printf("ARG: Video pool size must be <width>x<height>\n");
+				exit(1);
+			}
+			printf("ARG: Video pool %s\n", optarg);
+			for (char* flag = strtok(optarg + consumed, ","); flag != NULL; flag = strtok(NULL, ",")) {
+				if (strcmp(flag, "lock") == 0) {
+					video_pool_config.lock = true;
+				} else if (strcmp(flag, "thp") == 0) {
+					video_pool_config.pages = FRAME_POOL_PAGES_TRANSPARENT_HUGE;
+				} else if (strcmp(flag, "hugetlb") == 0) {
+					video_pool_config.pages = FRAME_POOL_PAGES_HUGETLB;
+				} else {
+					printf("ARG: Unknown video pool flag %s\n", flag);
+					exit(1);
+				}
+			}
+			break;
+		}
+
+		case 'A': {
+#ifdef ALLOC_TRACKER
+			char* end = NULL;
+			unsigned long long frame = strtoull(optarg, &end, 10);
+			bool abort_on_alloc = strcmp(end, ",abort") == 0;
+			if (end == optarg || frame == 0 || (*end != '\0' && !abort_on_alloc)) {
+				printf("ARG: Steady state needs a frame number > 0, optionally followed by ,abort\n");
+				exit(1);
+			}
+			alloc_tracker_configure(frame, abort_on_alloc ? ALLOC_TRACKER_ABORT : ALLOC_TRACKER_WARN);
+			printf("ARG: No allocations after frame %llu%s\n", frame,
+			       abort_on_alloc ? ", aborting on one" : "");
+#else
+			printf("ARG: --allocsteady needs a build with -DALLOC_TRACKER=ON\n");
+			exit(1);
+#endif
+			break;
+		}
+
+		case 'P':
+			if (!thread_profile_parse(optarg)) {
+				printf("ARG: Invalid thread profile %s, see --help\n", optarg);
+				exit(1);
+			}
+			printf("ARG: Thread profile %s\n", optarg);
+			break;
+
+		case 'J': {
+			char* end = NULL;
+			unsigned long workers = strtoul(optarg, &end, 10);
+			if (end == optarg || *end != '\0' || workers > JOB_MAX_WORKERS) {
+				printf("ARG: Job workers must be 0..%d\n", JOB_MAX_WORKERS);
+				exit(1);
+			}
+			app->job_workers = (uint32_t)workers;
+			printf("ARG: %u job workers\n", app->job_workers);
+			break;
+		}
+
+		case 'U':
+			printf("ARG: Receiving the video through io_uring\n");
+			video_recv_ring = true;
+			break;
+
+		default: abort();
+		}
+	}
+}
+
+static struct action_t*
+replay_action_for(struct ApplicationState* app, uint32_t record_id)
+{
+	switch (record_id) {
+	case REC_ACTION_GRAB: return &app->grab_action;
+	case REC_ACTION_ACCELERATE: return &app->accelerate_action;
+	case REC_ACTION_HAND_POSE: return &app->hand_pose_action;
+	case REC_ACTION_AIM: return &app->aim_action;
+	// vive trackers only exist with a running session
+	default: return NULL;
+	}
+}
+
+// inverse of record_action_state()
+static void
+replay_action_state(struct ApplicationState* app, const struct rec_action* rec)
+{
+	struct action_t* action = replay_action_for(app, rec->action);
+	if (action == NULL || rec->subaction >= HAND_COUNT)
+		return;
+
+	uint32_t idx = rec->subaction;
+	action->action_type = rec->action_type;
+
+	switch (rec->action_type) {
+	case XR_ACTION_TYPE_FLOAT_INPUT:
+		action->states[idx].float_.isActive = rec->is_active;
+		action->states[idx].float_.changedSinceLastSync = rec->changed_since_last_sync;
+		action->states[idx].float_.currentState = rec->value[0];
+		break;
+	case XR_ACTION_TYPE_BOOLEAN_INPUT:
+		action->states[idx].boolean_.isActive = rec->is_active;
+		action->states[idx].boolean_.changedSinceLastSync = rec->changed_since_last_sync;
+		action->states[idx].boolean_.currentState = rec->value[0] != 0;
+		break;
+	case XR_ACTION_TYPE_VECTOR2F_INPUT:
+		action->states[idx].vec2f_.isActive = rec->is_active;
+		action->states[idx].vec2f_.changedSinceLastSync = rec->changed_since_last_sync;
+		action->states[idx].vec2f_.currentState = (XrVector2f){rec->value[0], rec->value[1]};
+		break;
+	case XR_ACTION_TYPE_POSE_INPUT:
+		action->states[idx].pose_.isActive = rec->is_active;
+		action->pose_locations[idx].locationFlags = rec->location_flags;
+		action->pose_locations[idx].pose = rec->pose;
+		action->pose_velocities[idx].velocityFlags = rec->velocity_flags;
+		action->pose_velocities[idx].linearVelocity = rec->linear_velocity;
+		action->pose_velocities[idx].angularVelocity = rec->angular_velocity;
+		break;
+	default: break;
+	}
+}
+
+// publishes the joints of one replayed frame to the network thread the same way the frame loop
+// does
+static void
+replay_publish_frame(struct ApplicationState* app, const bool* hand_located, bool wait_for_sender)
+{
+	thread_profile_tick();
+
+	pthread_mutex_lock(&buffer_mutex);
+	// as fast as possible still sends every frame, so runs are comparable
+	while (wait_for_sender && atomic_load_explicit(&control.data_ready, memory_order_acquire) &&
+	       !atomic_load_explicit(&control.closing_app, memory_order_acquire))
+		pthread_cond_wait(&control.data_ready_changed, &buffer_mutex);
+	for (int i = 0; i < HAND_COUNT; i++) {
+		if (app->accelerate_action.states[i].float_.isActive &&
+		    app->accelerate_action.states[i].float_.currentState != 0) {
+			LOG_DEBUG("Throttle value %d: changed %d: %f\n", i,
+			       app->accelerate_action.states[i].float_.changedSinceLastSync,
+			       app->accelerate_action.states[i].float_.currentState);
+		}
+
+		if (hand_located[i])
+			pack_hand_joints(app->ext.hand_tracking.joints[i], i);
+	}
+	control.packed_frames++;
+	atomic_store_explicit(&control.data_ready, 1, memory_order_release);
+	pthread_cond_broadcast(&control.data_ready_changed);
+	pthread_mutex_unlock(&buffer_mutex);
+	reactor_notify(&net.joints_ready);
+	alloc_tracker_frame();
+}
+
+// the payload of a record replay reads, NULL with a warning if the record is shorter than the
+// payload struct of its type
+static const void*
+replay_payload(const struct rec_header* hdr, uint32_t size)
+{
+	if (hdr->size < size) {
+		LOG_WARN("Skipping a type %u record of %u bytes, expected %u\n", hdr->type, hdr->size, size);
+		return NULL;
+	}
+	return rec_payload(hdr);
+}
+
+// runs the pipeline behind the frame loop (joint packing, the network thread) from a
+// recording, without an OpenXR runtime or headset
+static void*
+replay_session(struct ApplicationState* app)
+{
+	struct recording rec;
+	if (!recording_open(&rec, app->replay_path))
+		return (void*)1;
+
+	const struct rec_header* hdr;
+	int64_t first_mono_ns = -1;
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	bool in_frame = false;
+	bool hand_located[HAND_COUNT] = {false};
+	uint64_t frames = 0;
+
+	startup_milestone(STARTUP_SESSION_READY);
+
+	while ((hdr = recording_next(&rec)) != NULL &&
+	       !atomic_load_explicit(&control.closing_app, memory_order_acquire)) {
+		switch (hdr->type) {
+		case REC_FRAME: {
+			if (in_frame) {
+				replay_publish_frame(app, hand_located, app->replay_speed == 0);
+				frames++;
+			}
+			in_frame = true;
+			memset(hand_located, 0, sizeof(hand_located));
+
+			if (first_mono_ns < 0)
+				first_mono_ns = hdr->mono_ns;
+
+			// wait until this frame's original time, scaled by the replay speed
+			if (app->replay_speed > 0) {
+				int64_t offset_ns =
+				    (int64_t)((double)(hdr->mono_ns - first_mono_ns) / app->replay_speed);
+				int64_t target_ns = (int64_t)start.tv_sec * 1000000000ll + start.tv_nsec + offset_ns;
+				struct timespec target = {.tv_sec = target_ns / 1000000000ll,
+				                          .tv_nsec = target_ns % 1000000000ll};
+				clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, NULL);
+			}
+			break;
+		}
+
+		case REC_JOINTS: {
+			const struct rec_joints* joints = replay_payload(hdr, sizeof(*joints));
+			if (joints == NULL || joints->hand >= HAND_COUNT)
+				break;
+			memcpy(app->ext.hand_tracking.joints[joints->hand], joints->joints,
+			       sizeof(joints->joints));
+			if (joints->has_velocities)
+				memcpy(app->ext.hand_tracking.joint_velocities_arr[joints->hand], joints->velocities,
+				       sizeof(joints->velocities));
+			hand_located[joints->hand] = true;
+			break;
+		}
+
+		case REC_ACTION: {
+			const struct rec_action* action = replay_payload(hdr, sizeof(*action));
+			if (action != NULL)
+				replay_action_state(app, action);
+			break;
+		}
+
+		// only the header of a frame record is used, video arrivals are produced live by the
+		// network thread
+		default: break;
+		}
+	}
+	if (in_frame) {
+		replay_publish_frame(app, hand_located, app->replay_speed == 0);
+		frames++;
+	}
+
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("Replayed %lu frames in %f s (%f frames/s)\n", (unsigned long)frames, elapsed,
+	       elapsed > 0 ? frames / elapsed : 0);
+
+	recording_close(&rec);
+
+	// let the network thread send the last frame before shutting down
+	pthread_mutex_lock(&buffer_mutex);
+	while (atomic_load_explicit(&control.data_ready, memory_order_acquire))
+		pthread_cond_wait(&control.data_ready_changed, &buffer_mutex);
+	atomic_store_explicit(&control.closing_app, true, memory_order_release);
+	pthread_cond_broadcast(&control.data_ready_changed);
+	pthread_mutex_unlock(&buffer_mutex);
+
+	recorder_close();
+	return NULL;
+}
+
+// one frame handed from the xr thread, which waits for it and samples the input, to the thread
+// that renders and submits it. Without --pipelined both are the same thread.
+struct frame_slot
+{
+	XrFrameState frame_state;
+	XrViewState view_state;
+	XrView* views;
+	// located by the xr thread, the render thread never reads app.oxr.view_count
+	uint32_t view_count;
+	struct draw_list_t draw_list;
+
+	// CLOCK_MONOTONIC time the views of the first pass were located
+	int64_t pose_ns;
+	// CLOCK_MONOTONIC time the xr thread pushed the slot, --pipelined only
+	int64_t queued_ns;
+
+	struct frame_timing timing;
+};
+
+// what submit_frame() renders into, only touched by the rendering thread
+struct frame_target
+{
+	struct ApplicationState* app;
+	struct swapchain_t* vr_swapchains;
+	struct quad_layer_t* quad_layer;
+	XrGraphicsBindingOpenGLXlibKHR* graphics_binding_gl;
+	bool stereo;
+	struct gpu_timer gpu_timer;
+
+	// paces --mirror every:N
+	uint64_t submitted_frames;
+};
+
+// two slots let the xr thread prepare frame N+1 while frame N is rendered
+#define FRAME_SLOT_COUNT 2
+
+struct render_thread_args
+{
+	struct frame_target* target;
+	struct frame_ring* ring;
+	struct frame_slot* slots;
+};
+
+// --latelatch: locates views and hand joints again for the display time of the frame right before
+// the first projection pass. Only the slot and the draw list are written, so with --pipelined this
+// runs on the render thread without touching the input state of the xr thread. Joint velocities
+// are not latched, their visualization stays at the pose sampled with the input.
+static void
+late_latch(struct frame_target* target, struct frame_slot* slot)
+{
+	struct ApplicationState* app = target->app;
+	XrTime time = slot->frame_state.predictedDisplayTime;
+
+	XrViewLocateInfo view_locate_info = {.type = XR_TYPE_VIEW_LOCATE_INFO,
+	                                     .next = NULL,
+	                                     .viewConfigurationType =
+	                                         XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO,
+	                                     .displayTime = time,
+	                                     .space = app->oxr.play_space};
+	XrViewState view_state = {.type = XR_TYPE_VIEW_STATE, .next = NULL};
+	uint32_t view_count = 0;
+	XrResult result = xrLocateViews(app->oxr.session, &view_locate_info, &view_state,
+	                                slot->view_count, &view_count, slot->views);
+	if (!xr_check(app->oxr.instance, result, "Could not late latch views"))
+		return;
+	slot->view_state = view_state;
+
+	struct hand_tracking_t* hand_tracking = &app->ext.hand_tracking;
+	if (!hand_tracking->system_supported)
+		return;
+
+	for (int hand = 0; hand < HAND_COUNT; hand++) {
+		XrHandJointLocationEXT joints[XR_HAND_JOINT_COUNT_EXT];
+		XrHandJointLocationsEXT joint_locations = {.type = XR_TYPE_HAND_JOINT_LOCATIONS_EXT,
+		                                           .next = NULL,
+		                                           .jointCount = XR_HAND_JOINT_COUNT_EXT,
+		                                           .jointLocations = joints};
+		XrHandJointsLocateInfoEXT locate_info = {.type = XR_TYPE_HAND_JOINTS_LOCATE_INFO_EXT,
+		                                         .next = NULL,
+		                                         .baseSpace = app->oxr.play_space,
+		                                         .time = time};
+		result = hand_tracking->xrLocateHandJointsEXT(hand_tracking->trackers[hand], &locate_info,
+		                                              &joint_locations);
+		if (!xr_check(app->oxr.instance, result, "failed to late latch hand joints!"))
+			continue;
+		if (joint_locations.isActive)
+			update_hand_joints(&app->gl_renderer.draw_list, hand, joints, joint_locations.jointCount);
+	}
+}
+
+// renders the draw list of the slot into the swapchains and submits the frame, false if the frame
+// loop has to stop
+static bool
+submit_frame(struct frame_target* target, struct frame_slot* slot)
+{
+	struct ApplicationState* app = target->app;
+	struct swapchain_t* vr_swapchains = target->vr_swapchains;
+	struct quad_layer_t* quad_layer = target->quad_layer;
+	XrGraphicsBindingOpenGLXlibKHR* graphics_binding_gl = target->graphics_binding_gl;
+	XrResult result;
+
+	// the slot gets the previous list back and reuses its allocations for a later frame
+	struct draw_list_t list = app->gl_renderer.draw_list;
+	app->gl_renderer.draw_list = slot->draw_list;
+	slot->draw_list = list;
+
+	// --- Begin frame
+	XrFrameBeginInfo frame_begin_info = {.type = XR_TYPE_FRAME_BEGIN_INFO, .next = NULL};
+
+	// the GPU times of a frame a few frames back
+	int64_t gpu_ns[GPU_STAGE_COUNT];
+	if (gpu_timer_next_frame(&target->gpu_timer, gpu_ns)) {
+		for (int stage = 0; stage < GPU_STAGE_COUNT; stage++) {
+			if (gpu_ns[stage] >= 0)
+				frame_timing_add_gpu(stage, gpu_ns[stage]);
+		}
+	}
+
+	struct frame_timing* timing = &slot->timing;
+	int64_t stage_ns = frame_timing_now();
+	result = xrBeginFrame(app->oxr.session, &frame_begin_info);
+	if (!xr_check(app->oxr.instance, result, "failed to begin frame!"))
+		return false;
+	stage_ns = frame_timing_add(timing, FRAME_STAGE_BEGIN_FRAME, stage_ns);
+
+	// all swapchain release infos happen to be the same
+	XrSwapchainImageReleaseInfo release_info = {.type = XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO,
+	                                            .next = NULL};
+
+	// render projection layer (once per swapchain, i.e. per view unless single pass stereo
+	// renders all views into one array swapchain) and fill projection_views with the result
+	for (uint32_t i = 0; i < vr_swapchains[SWAPCHAIN_PROJECTION].swapchain_count; i++) {
+		uint32_t projection_index;
+		if (!acquire_swapchain(app->oxr.instance, &vr_swapchains[SWAPCHAIN_PROJECTION], i,
+		                       &projection_index))
+			break;
+
+		uint32_t depth_index = 0;
+		if (app->ext.depth.base.supported) {
+			if (!acquire_swapchain(app->oxr.instance, &vr_swapchains[SWAPCHAIN_DEPTH], i, &depth_index))
+				break;
+		}
+
+		GLuint depth_image = app->ext.depth.base.supported
+		                         ? vr_swapchains[SWAPCHAIN_DEPTH].images[i][depth_index].image
+		                         : 0;
+		GLuint projection_image =
+		    vr_swapchains[SWAPCHAIN_PROJECTION].images[i][projection_index].image;
+
+		int w = app->oxr.viewconfig_views[i].recommendedImageRectWidth;
+		int h = app->oxr.viewconfig_views[i].recommendedImageRectHeight;
+
+		// once before the first pass, every pass and projection_views use the same views
+		if (app->late_latch && i == 0) {
+			late_latch(target, slot);
+			slot->pose_ns = frame_timing_now();
+		}
+
+		// TODO: should not be necessary, but is for SteamVR 1.16.4 (but not 1.15.x)
+		glXMakeCurrent(graphics_binding_gl->xDisplay, graphics_binding_gl->glxDrawable,
+		               graphics_binding_gl->glxContext);
+
+		enum gpu_stage gpu_pass = i == 0 ? GPU_STAGE_RENDER_PASS_0 : GPU_STAGE_RENDER_PASS_1;
+		gpu_timer_begin(&target->gpu_timer, gpu_pass);
+		if (target->stereo) {
+			render_frame_stereo(w, h, &app->gl_renderer, projection_index, slot->views,
+			                    projection_image, app->ext.depth.base.supported, depth_image);
+		} else {
+			render_frame(w, h, &app->gl_renderer, projection_index, i, &slot->views[i],
+			             projection_image, app->ext.depth.base.supported, depth_image);
+		}
+		gpu_timer_end(&target->gpu_timer, gpu_pass);
+		if (i == 0 && app->mirror_mode != MIRROR_OFF) {
+			GLuint framebuffer = app->gl_renderer.framebuffers[i][projection_index];
+			// only frames that copy or blit are timed, skipped ones would pull the times down
+			if (app->mirror_mode == MIRROR_ASYNC) {
+				gpu_timer_begin(&target->gpu_timer, GPU_STAGE_MIRROR_BLIT);
+				mirror_copy(framebuffer, w, h);
+				gpu_timer_end(&target->gpu_timer, GPU_STAGE_MIRROR_BLIT);
+			} else if (target->submitted_frames % app->mirror_every == 0) {
+				gpu_timer_begin(&target->gpu_timer, GPU_STAGE_MIRROR_BLIT);
+				blit_to_desktop(framebuffer, w, h);
+				gpu_timer_end(&target->gpu_timer, GPU_STAGE_MIRROR_BLIT);
+			}
+		}
+
+		result =
+		    xrReleaseSwapchainImage(vr_swapchains[SWAPCHAIN_PROJECTION].swapchains[i], &release_info);
+		if (!xr_check(app->oxr.instance, result, "failed to release swapchain image!"))
+			break;
+
+		if (app->ext.depth.base.supported) {
+			result = xrReleaseSwapchainImage(vr_swapchains[SWAPCHAIN_DEPTH].swapchains[i], &release_info);
+			if (!xr_check(app->oxr.instance, result, "failed to release swapchain image!"))
+				break;
+		}
+
+		enum frame_stage pass = i == 0 ? FRAME_STAGE_RENDER_PASS_0 : FRAME_STAGE_RENDER_PASS_1;
+		stage_ns = frame_timing_add(timing, pass, stage_ns);
+	}
+
+	for (uint32_t i = 0; i < slot->view_count; i++) {
+		app->oxr.projection_views[i].pose = slot->views[i].pose;
+		app->oxr.projection_views[i].fov = slot->views[i].fov;
+	}
+
+
+	uint32_t quad_index = 0;
+	stage_ns = frame_timing_now();
+	if (!acquire_swapchain(app->oxr.instance, &quad_layer->swapchain, 0, &quad_index))
+		return false;
+
+	gpu_timer_begin(&target->gpu_timer, GPU_STAGE_QUAD_UPLOAD);
+	pthread_mutex_lock(&buffer_mutex);
+	update_quad_texture(&app->gl_renderer, quad_layer, buffer_in);
+	bool has_video = buffer_in_size > 0;
+	pthread_mutex_unlock(&buffer_mutex);
+
+	render_quad(&app->gl_renderer, quad_layer, quad_index, slot->frame_state.predictedDisplayTime);
+	gpu_timer_end(&target->gpu_timer, GPU_STAGE_QUAD_UPLOAD);
+
+	result = xrReleaseSwapchainImage(quad_layer->swapchain.swapchains[0], &release_info);
+	if (!xr_check(app->oxr.instance, result, "failed to release swapchain image!"))
+		return false;
+	frame_timing_add(timing, FRAME_STAGE_QUAD_UPLOAD, stage_ns);
+
+
+	// projectionLayers struct reused for every frame
+	XrCompositionLayerProjection projection_layer = {
+	    .type = XR_TYPE_COMPOSITION_LAYER_PROJECTION,
+	    .next = NULL,
+	    .layerFlags = 0,
+	    .space = app->oxr.play_space,
+	    .viewCount = slot->view_count,
+	    .views = app->oxr.projection_views,
+	};
+
+
+	float quad_aspect = (float)quad_layer->pixel_width / (float)quad_layer->pixel_height;
+	float quad_width = 1.f;
+	XrCompositionLayerQuad quad_comp_layer = {
+	    .type = XR_TYPE_COMPOSITION_LAYER_QUAD,
+	    .next = NULL,
+	    .layerFlags = XR_COMPOSITION_LAYER_BLEND_TEXTURE_SOURCE_ALPHA_BIT,
+	    .space = app->oxr.play_space,
+	    .eyeVisibility = XR_EYE_VISIBILITY_BOTH,
+	    .pose = {.orientation = {.x = 0.f, .y = 0.f, .z = 0.f, .w = 1.f},
+	             .position = {.x = 1.5f, .y = .7f, .z = -1.5f}},
+	    .size = {.width = quad_width, .height = quad_width / quad_aspect},
+	    .subImage = {
+	        .swapchain = quad_layer->swapchain.swapchains[0],
+	        .imageRect = {
+	            .offset = {.x = 0, .y = 0},
+	            .extent = {.width = quad_layer->pixel_width, .height = quad_layer->pixel_height},
+	        }}};
+
+
+	int submitted_layer_count = 1;
+	const XrCompositionLayerBaseHeader* submitted_layers[2] = {
+	    (const XrCompositionLayerBaseHeader* const) & projection_layer};
+	// already set projection_views[i].next = &depth.infos[i]; if depth supported
+
+
+	submitted_layers[submitted_layer_count++] =
+	    (const XrCompositionLayerBaseHeader* const) & quad_comp_layer;
+
+	if ((slot->view_state.viewStateFlags & XR_VIEW_STATE_ORIENTATION_VALID_BIT) == 0) {
+		LOG_WARN("Not submitting layers because orientation is invalid\n");
+		submitted_layer_count = 0;
+	}
+
+	XrFrameEndInfo frameEndInfo = {.type = XR_TYPE_FRAME_END_INFO,
+	                               .displayTime = slot->frame_state.predictedDisplayTime,
+	                               .layerCount = submitted_layer_count,
+	                               .layers = submitted_layers,
+	                               .environmentBlendMode = app->oxr.blend_mode,
+	                               .next = NULL};
+	stage_ns = frame_timing_add(timing, FRAME_STAGE_POSE_TO_SUBMIT, slot->pose_ns);
+	result = xrEndFrame(app->oxr.session, &frameEndInfo);
+	if (!xr_check(app->oxr.instance, result, "failed to end frame!"))
+		return false;
+	frame_timing_add(timing, FRAME_STAGE_END_FRAME, stage_ns);
+	mirror_publish();
+	startup_milestone(STARTUP_FIRST_FRAME);
+	if (has_video)
+		startup_milestone(STARTUP_FIRST_VIDEO_FRAME);
+
+	// the frame started when xrWaitFrame() returned, waiting for the render thread is not part of
+	// it or every frame queued behind a slow one would be late as well
+	int64_t wait_return_ns =
+	    timing->start_ns[FRAME_STAGE_WAIT_FRAME] + timing->duration_ns[FRAME_STAGE_WAIT_FRAME];
+	frame_timing_add(timing, FRAME_STAGE_FRAME, wait_return_ns);
+	timing->duration_ns[FRAME_STAGE_FRAME] -= timing->duration_ns[FRAME_STAGE_QUEUED];
+	frame_timing_commit(timing);
+	target->submitted_frames++;
+
+	return true;
+}
+
+// --pipelined: owns the GL context and submits the frames the xr thread pushes into the ring
+static void*
+render_thread(void* arg)
+{
+	logger_set_thread_name("render");
+	alloc_tracker_set_thread("render");
+	struct render_thread_args* args = (struct render_thread_args*)arg;
+	XrGraphicsBindingOpenGLXlibKHR* gl = args->target->graphics_binding_gl;
+
+	thread_profile_start(THREAD_ROLE_RENDER);
+	glXMakeCurrent(gl->xDisplay, gl->glxDrawable, gl->glxContext);
+
+	int index;
+	while ((index = frame_ring_peek(args->ring)) >= 0) {
+		thread_profile_tick();
+		struct frame_slot* slot = &args->slots[index];
+		frame_timing_add(&slot->timing, FRAME_STAGE_QUEUED, slot->queued_ns);
+		if (!submit_frame(args->target, slot)) {
+			// the xr thread stops waiting for frames once it sees the closed ring
+			frame_ring_discard(args->ring);
+			break;
+		}
+		frame_ring_release(args->ring);
+	}
+
+	glXMakeCurrent(gl->xDisplay, None, NULL);
+	return NULL;
+}
+
+// the CPU work of a frame once its actions are synced, a job graph the xr thread waits for:
+//
+//   hand tracking -+-> publish joints -+-> frame
+//   cube update ---+-> prepare scene --+
+//
+// Each job stamps its own frame stage.
+struct frame_jobs
+{
+	struct ApplicationState* app;
+	struct frame_slot* slot;
+	XrTime display_time;
+	bool hand_located[HAND_COUNT];
+};
+
+static void
+hand_tracking_job(void* arg)
+{
+	struct frame_jobs* frame = (struct frame_jobs*)arg;
+	struct ApplicationState* app = frame->app;
+	if (!app->ext.hand_tracking.system_supported)
+		return;
+
+	int64_t start_ns = frame_timing_now();
+	for (int i = 0; i < HAND_COUNT; i++) {
+		frame->hand_located[i] =
+		    get_hand_tracking(app->oxr.instance, app->oxr.play_space, frame->display_time,
+		                      app->query_joint_velocities, &app->ext.hand_tracking, i);
+	}
+	frame_timing_add(&frame->slot->timing, FRAME_STAGE_HAND_TRACKING, start_ns);
+}
+
+// hands the located joints to the network thread
+static void
+publish_joints_job(void* arg)
+{
+	struct frame_jobs* frame = (struct frame_jobs*)arg;
+	struct hand_tracking_t* hand_tracking = &frame->app->ext.hand_tracking;
+
+	pthread_mutex_lock(&buffer_mutex);
+	for (int i = 0; i < HAND_COUNT; i++) {
+		if (frame->hand_located[i])
+			pack_hand_joints(hand_tracking->joint_locations[i].jointLocations, i);
+	}
+	control.packed_frames++;
+	atomic_store_explicit(&control.data_ready, 1, memory_order_release);
+	pthread_cond_broadcast(&control.data_ready_changed);
+	pthread_mutex_unlock(&buffer_mutex);
+	reactor_notify(&net.joints_ready);
+}
+
+static void
+cube_update_job(void* arg)
+{
+	struct frame_jobs* frame = (struct frame_jobs*)arg;
+	struct ApplicationState* app = frame->app;
+	if (!app->cube.enabled)
+		return;
+
+	int64_t start_ns = frame_timing_now();
+	if (app->cube.pos_ts != 0) {
+		XrDuration diff_ns = frame->display_time - app->cube.pos_ts;
+		float diff_s = (double)diff_ns * 1. / 1000. * 1. / 1000. * 1. / 1000.;
+		XrVector3f next_pos = {
+		    .x = app->cube.current_pos.x += app->cube.velocity.x * diff_s,
+		    .y = app->cube.current_pos.y += app->cube.velocity.y * diff_s,
+		    .z = app->cube.current_pos.z += app->cube.velocity.z * diff_s,
+		};
+		if (next_pos.x > app->cube.center_pos.x + app->cube.bouncing_lengths.x || //
+		    next_pos.y > app->cube.center_pos.y + app->cube.bouncing_lengths.y || //
+		    next_pos.z > app->cube.center_pos.z + app->cube.bouncing_lengths.z || //
+		    next_pos.x < app->cube.center_pos.x - app->cube.bouncing_lengths.x || //
+		    next_pos.y < app->cube.center_pos.y - app->cube.bouncing_lengths.y || //
+		    next_pos.z < app->cube.center_pos.z - app->cube.bouncing_lengths.z) {
+			app->cube.velocity.x *= -1;
+			app->cube.velocity.y *= -1;
+			app->cube.velocity.z *= -1;
+
+			next_pos = (XrVector3f){
+			    .x = app->cube.current_pos.x += app->cube.velocity.x * diff_s,
+			    .y = app->cube.current_pos.y += app->cube.velocity.y * diff_s,
+			    .z = app->cube.current_pos.z += app->cube.velocity.z * diff_s,
+			};
+		}
+		app->cube.current_pos = next_pos;
+		// printf("render cube at %f %f %f\n", app->cube.current_pos.x, app->cube.current_pos.y,
+		// app->cube.current_pos.z);
+	}
+
+	app->cube.pos_ts = frame->display_time;
+	frame_timing_add(&frame->slot->timing, FRAME_STAGE_CUBE_UPDATE, start_ns);
+}
+
+static void
+prepare_scene_job(void* arg)
+{
+	struct frame_jobs* frame = (struct frame_jobs*)arg;
+	struct ApplicationState* app = frame->app;
+
+	int64_t start_ns = frame_timing_now();
+	// model matrices of everything in the scene, shared by all views
+	prepare_scene(app, &frame->slot->draw_list, app->hand_pose_action.pose_locations,
+	              &app->ext.hand_tracking);
+	frame_timing_add(&frame->slot->timing, FRAME_STAGE_PREPARE_SCENE, start_ns);
+}
+
+// returns the job that finishes the frame, NULL if the graph does not fit the job arena
+static struct job*
+submit_frame_jobs(struct ApplicationState* app, struct frame_slot* slot, XrTime display_time)
+{
+	job_frame_begin();
+	struct frame_jobs* frame = job_frame_alloc(sizeof(*frame));
+	if (frame == NULL)
+		return NULL;
+	*frame = (struct frame_jobs){.app = app, .slot = slot, .display_time = display_time};
+
+	struct job* hands = job_create("hand tracking", hand_tracking_job, frame);
+	struct job* publish = job_create("publish joints", publish_joints_job, frame);
+	struct job* cube = job_create("cube update", cube_update_job, frame);
+	struct job* scene = job_create("prepare scene", prepare_scene_job, frame);
+	struct job* done = job_create("frame", NULL, NULL);
+	if (hands == NULL || publish == NULL || cube == NULL || scene == NULL || done == NULL)
+		return NULL;
+
+	// in this order a thread running the graph alone publishes before it prepares the scene
+	job_depend(publish, hands);
+	job_depend(scene, hands);
+	job_depend(scene, cube);
+	job_depend(done, publish);
+	job_depend(done, scene);
+	job_submit(cube);
+	job_submit(hands);
+	job_submit(publish);
+	job_submit(scene);
+	job_submit(done);
+	return done;
+}
+
+void *main_loop(void* arg)
+{
+	logger_set_thread_name("xr");
+	alloc_tracker_set_thread("xr");
+	printf("Entering main loop\n");
+
+	struct ApplicationState app = {
+	    .ext =
+	        {
+	            .opengl.base.ext_name_string = XR_KHR_OPENGL_ENABLE_EXTENSION_NAME,
+	            .depth.base.ext_name_string = XR_KHR_COMPOSITION_LAYER_DEPTH_EXTENSION_NAME,
+	            .hand_tracking.base.ext_name_string = XR_EXT_HAND_TRACKING_EXTENSION_NAME,
+	            .refresh_rate.base.ext_name_string = XR_FB_DISPLAY_REFRESH_RATE_EXTENSION_NAME,
+	            .vive_tracker.base.ext_name_string = XR_HTCX_VIVE_TRACKER_INTERACTION_EXTENSION_NAME,
+	        },
+	    .oxr =
+	        {
+	            .form_factor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY,
+	            .view_type = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO,
+	            .play_space_type = XR_REFERENCE_SPACE_TYPE_STAGE,
+
+	            .instance = XR_NULL_HANDLE,
+	            .session = XR_NULL_HANDLE,
+	            .system_id = XR_NULL_SYSTEM_ID,
+	            .state = XR_SESSION_STATE_UNKNOWN,
+	            .play_space = XR_NULL_HANDLE,
+
+	            .view_count = 0,
+	            .viewconfig_views = NULL,
+	            .projection_views = NULL,
+	            .views = NULL,
+	        },
+	    .gl_renderer =
+	        {
+	            .near_z = 0.01f,
+	            .far_z = 100.0f,
+	        },
+	    .query_joint_velocities = false,
+	    .query_hand_velocities = false,
+	    .replay_speed = 1.0,
+	    .timing_report_s = 10,
+	    .mirror_mode = MIRROR_EVERY,
+	    .mirror_every = 1,
+	    .mirror_scale = 0.5f,
+
+	};
+	struct MainArgs* mainArgs = (struct MainArgs*)arg;
+    int argc = mainArgs->argc;
+    char** argv = mainArgs->argv;
+
+	parse_opts(argc, argv, &app);
+	startup_release(STARTUP_GATE_OPTIONS);
+	// threads started from here on, the GL driver's too, inherit this placement unless they have a
+	// profile of their own
+	thread_profile_start(THREAD_ROLE_XR);
+	frame_timing_init(app.timing_report_s);
+
+	// the render or mirror thread makes a context current and swaps the desktop window while this
+	// thread keeps polling SDL events, Xlib has to lock its connections before the first call
+	if ((app.pipelined || app.mirror_mode == MIRROR_ASYNC) && !XInitThreads()) {
+		printf("XInitThreads failed!\n");
+		return (void *)1;
+	}
+
+	if (app.record_path && !recorder_open(app.record_path)) {
+		printf("Failed to open recording %s\n", app.record_path);
+		return (void *)1;
+	}
+
+	if (app.replay_path)
+		return replay_session(&app);
+
+	// The runtime interacts with the OpenGL images (textures) via a Swapchain.
+	XrGraphicsBindingOpenGLXlibKHR graphics_binding_gl = {0};
+
+	struct swapchain_t vr_swapchains[SWAPCHAIN_LAST];
+
+	// define texture width/height
+	struct quad_layer_t quad_layer = {.pixel_width = 500 * SCALE, .pixel_height = 300 * SCALE};
+
+	XrPath hand_paths[HAND_COUNT];
+	XrPath hand_interaction_profile[HAND_COUNT] = {0};
+
+	XrPath vive_tracker_interaction_profile[VIVE_TRACKER_ROLE_COUNT] = {0};
+
+	// reuse this variable for all our OpenXR return codes
+	XrResult result = XR_SUCCESS;
+
+	int64_t phase_start = startup_now();
+	result = _check_extensions(&app, &app.ext);
+	if (!xr_check(app.oxr.instance, result, "Extensions check failed!")) {
+		return (void *)1;
+	}
+	if (!app.ext.opengl.base.supported) {
+		printf("%s is required\n", app.ext.opengl.base.ext_name_string);
+		return (void *)1;
+	};
 
 
 	// --- Create XrInstance
@@ -1791,9 +2373,11 @@ void *main_loop(void* arg)
 	if (!xr_check(app.oxr.instance, result, "Failed to init extensions!")) {
 		return (void *)1;
 	}
+	phase_start = startup_phase("xr: instance", phase_start);
 
 	// Optionally get runtime name and version
-	print_instance_properties(app.oxr.instance);
+	if (print_diagnostics)
+		print_instance_properties(app.oxr.instance);
 
 	// --- Create XrSystem
 	XrSystemGetInfo system_get_info = {
@@ -1829,10 +2413,12 @@ void *main_loop(void* arg)
 		app.ext.hand_tracking.system_supported =
 		    app.ext.hand_tracking.base.supported && ht.supportsHandTracking;
 
-		print_system_properties(&system_props);
+		if (print_diagnostics)
+			print_system_properties(&system_props);
 	}
 
-	print_supported_view_configs(app.oxr.instance, app.oxr.system_id);
+	if (print_diagnostics)
+		print_supported_view_configs(app.oxr.instance, app.oxr.system_id);
 
 	// view_count usually depends on the form_factor / view_type.
 	// dynamically allocating all view related structs hopefully allows this app to scale easily to
@@ -1854,7 +2440,8 @@ void *main_loop(void* arg)
 	                                           app.oxr.viewconfig_views);
 	if (!xr_check(app.oxr.instance, result, "Failed to enumerate view configuration views!"))
 		return (void *)1;
-	print_viewconfig_view_info(app.oxr.view_count, app.oxr.viewconfig_views);
+	if (print_diagnostics)
+		print_viewconfig_view_info(app.oxr.view_count, app.oxr.viewconfig_views);
 
 
 	// OpenXR requires checking graphics requirements before creating a session.
@@ -1887,9 +2474,11 @@ void *main_loop(void* arg)
 	XrEnvironmentBlendMode mode_preference1 = XR_ENVIRONMENT_BLEND_MODE_ADDITIVE;
 	XrEnvironmentBlendMode mode_preference2 = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
 
-	printf("Supported blend modes:\n");
+	if (print_diagnostics)
+		printf("Supported blend modes:\n");
 	for (uint32_t i = 0; i < blend_mode_count; i++) {
-		printf("\t%s\n", XrStr_XrEnvironmentBlendMode(blend_modes[i]));
+		if (print_diagnostics)
+			printf("\t%s\n", XrStr_XrEnvironmentBlendMode(blend_modes[i]));
 		if (!app.oxr.blend_mode_explicitly_set) {
 			if (blend_modes[i] == mode_preference1) {
 				app.oxr.blend_mode = blend_modes[i];
@@ -1900,6 +2489,7 @@ void *main_loop(void* arg)
 	}
 	printf("Using blend mode: %s\n", XrStr_XrEnvironmentBlendMode(app.oxr.blend_mode));
 	free(blend_modes);
+	phase_start = startup_phase("xr: system", phase_start);
 
 
 	// --- Create session
@@ -1907,15 +2497,19 @@ void *main_loop(void* arg)
 	    .type = XR_TYPE_GRAPHICS_BINDING_OPENGL_XLIB_KHR,
 	};
 
-	// create SDL window the size of the left eye & fill GL graphics binding info
+	// create SDL window the size of the mirror of the left eye & fill GL graphics binding info
+	int mirror_width =
+	    (int)(app.oxr.viewconfig_views[0].recommendedImageRectWidth * app.mirror_scale);
+	int mirror_height =
+	    (int)(app.oxr.viewconfig_views[0].recommendedImageRectHeight * app.mirror_scale);
 	if (!init_sdl_window(&graphics_binding_gl.xDisplay, &graphics_binding_gl.visualid,
 	                     &graphics_binding_gl.glxFBConfig, &graphics_binding_gl.glxDrawable,
-	                     &graphics_binding_gl.glxContext,
-	                     app.oxr.viewconfig_views[0].recommendedImageRectWidth,
-	                     app.oxr.viewconfig_views[0].recommendedImageRectHeight)) {
+	                     &graphics_binding_gl.glxContext, mirror_width > 0 ? mirror_width : 1,
+	                     mirror_height > 0 ? mirror_height : 1, app.mirror_mode)) {
 		printf("GLX init failed!\n");
 		return (void *)1;
 	}
+	phase_start = startup_phase("xr: window", phase_start);
 
 	printf("Using OpenGL version: %s\n", glGetString(GL_VERSION));
 	printf("Using OpenGL Renderer: %s\n", glGetString(GL_RENDERER));
@@ -1935,7 +2529,8 @@ void *main_loop(void* arg)
 	// Many runtimes support at least STAGE and LOCAL but not all do.
 	// Sophisticated apps might check if the chosen one is supported and try another one if not.
 	// Here we will get an error from xrCreateReferenceSpace() and exit.
-	print_reference_spaces(app.oxr.instance, app.oxr.session);
+	if (print_diagnostics)
+		print_reference_spaces(app.oxr.instance, app.oxr.session);
 	XrReferenceSpaceCreateInfo play_space_create_info = {.type = XR_TYPE_REFERENCE_SPACE_CREATE_INFO,
 	                                                     .next = NULL,
 	                                                     .referenceSpaceType =
@@ -2017,6 +2612,7 @@ void *main_loop(void* arg)
 		if (!xr_check(app.oxr.instance, result, "Failed to create play space!"))
 			return (void *)1;
 	}
+	phase_start = startup_phase("xr: session", phase_start);
 
 	// --- Create Swapchains
 	uint32_t swapchain_format_count;
@@ -2024,7 +2620,8 @@ void *main_loop(void* arg)
 	if (!xr_check(app.oxr.instance, result, "Failed to get number of supported swapchain formats"))
 		return (void *)1;
 
-	printf("Runtime supports %d swapchain formats\n", swapchain_format_count);
+	if (print_diagnostics)
+		printf("Runtime supports %d swapchain formats\n", swapchain_format_count);
 	int64_t swapchain_formats[swapchain_format_count];
 	result = xrEnumerateSwapchainFormats(app.oxr.session, swapchain_format_count,
 	                                     &swapchain_format_count, swapchain_formats);
@@ -2047,24 +2644,54 @@ void *main_loop(void* arg)
 		app.ext.depth.base.supported = true;
 	}
 
+	// single pass stereo renders both views into the two layers of one swapchain, which needs
+	// views of the same size
+	bool stereo = app.gl_renderer.stereo_mode != STEREO_OFF;
+	if (stereo && (app.oxr.view_count != 2 ||
+	               app.oxr.viewconfig_views[0].recommendedImageRectWidth !=
+	                   app.oxr.viewconfig_views[1].recommendedImageRectWidth ||
+	               app.oxr.viewconfig_views[0].recommendedImageRectHeight !=
+	                   app.oxr.viewconfig_views[1].recommendedImageRectHeight)) {
+		printf("Single pass stereo needs two views of the same size, rendering views separately\n");
+		app.gl_renderer.stereo_mode = STEREO_OFF;
+		stereo = false;
+	}
+
 	XrSwapchainUsageFlags color_flags =
 	    XR_SWAPCHAIN_USAGE_SAMPLED_BIT | XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT;
-	if (!create_swapchain_from_views(app.oxr.instance, app.oxr.session,
-	                                 &vr_swapchains[SWAPCHAIN_PROJECTION], app.oxr.view_count,
-	                                 color_format, app.oxr.viewconfig_views, color_flags))
-		return (void *)1;
+	XrSwapchainUsageFlags depth_flags = XR_SWAPCHAIN_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	if (stereo) {
+		XrViewConfigurationView* view = &app.oxr.viewconfig_views[0];
+		if (!create_one_swapchain(app.oxr.instance, app.oxr.session,
+		                          &vr_swapchains[SWAPCHAIN_PROJECTION], color_format,
+		                          view->recommendedSwapchainSampleCount,
+		                          view->recommendedImageRectWidth, view->recommendedImageRectHeight,
+		                          app.oxr.view_count, color_flags))
+			return (void *)1;
 
-	if (app.ext.depth.base.supported) {
-		XrSwapchainUsageFlags depth_flags = XR_SWAPCHAIN_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		if (app.ext.depth.base.supported &&
+		    !create_one_swapchain(app.oxr.instance, app.oxr.session, &vr_swapchains[SWAPCHAIN_DEPTH],
+		                          depth_format, view->recommendedSwapchainSampleCount,
+		                          view->recommendedImageRectWidth, view->recommendedImageRectHeight,
+		                          app.oxr.view_count, depth_flags))
+			return (void *)1;
+	} else {
 		if (!create_swapchain_from_views(app.oxr.instance, app.oxr.session,
-		                                 &vr_swapchains[SWAPCHAIN_DEPTH], app.oxr.view_count,
-		                                 depth_format, app.oxr.viewconfig_views, depth_flags)) {
+		                                 &vr_swapchains[SWAPCHAIN_PROJECTION], app.oxr.view_count,
+		                                 color_format, app.oxr.viewconfig_views, color_flags))
 			return (void *)1;
+
+		if (app.ext.depth.base.supported) {
+			if (!create_swapchain_from_views(app.oxr.instance, app.oxr.session,
+			                                 &vr_swapchains[SWAPCHAIN_DEPTH], app.oxr.view_count,
+			                                 depth_format, app.oxr.viewconfig_views, depth_flags)) {
+				return (void *)1;
+			}
 		}
 	}
 
 	if (!create_one_swapchain(app.oxr.instance, app.oxr.session, &quad_layer.swapchain, quad_format,
-	                          1, quad_layer.pixel_width, quad_layer.pixel_height, color_flags))
+	                          1, quad_layer.pixel_width, quad_layer.pixel_height, 1, color_flags))
 		return (void *)1;
 
 	// Do not allocate these every frame to save some resources
@@ -2079,8 +2706,8 @@ void *main_loop(void* arg)
 		app.oxr.projection_views[i].next = NULL;
 
 		app.oxr.projection_views[i].subImage.swapchain =
-		    vr_swapchains[SWAPCHAIN_PROJECTION].swapchains[i];
-		app.oxr.projection_views[i].subImage.imageArrayIndex = 0;
+		    vr_swapchains[SWAPCHAIN_PROJECTION].swapchains[stereo ? 0 : i];
+		app.oxr.projection_views[i].subImage.imageArrayIndex = stereo ? i : 0;
 		app.oxr.projection_views[i].subImage.imageRect.offset.x = 0;
 		app.oxr.projection_views[i].subImage.imageRect.offset.y = 0;
 		app.oxr.projection_views[i].subImage.imageRect.extent.width =
@@ -2103,9 +2730,10 @@ void *main_loop(void* arg)
 			app.ext.depth.infos[i].nearZ = app.gl_renderer.near_z;
 			app.ext.depth.infos[i].farZ = app.gl_renderer.far_z;
 
-			app.ext.depth.infos[i].subImage.swapchain = vr_swapchains[SWAPCHAIN_DEPTH].swapchains[i];
+			app.ext.depth.infos[i].subImage.swapchain =
+			    vr_swapchains[SWAPCHAIN_DEPTH].swapchains[stereo ? 0 : i];
 
-			app.ext.depth.infos[i].subImage.imageArrayIndex = 0;
+			app.ext.depth.infos[i].subImage.imageArrayIndex = stereo ? i : 0;
 			app.ext.depth.infos[i].subImage.imageRect.offset.x = 0;
 			app.ext.depth.infos[i].subImage.imageRect.offset.y = 0;
 			app.ext.depth.infos[i].subImage.imageRect.extent.width =
@@ -2135,9 +2763,11 @@ void *main_loop(void* arg)
 				return (void *)1;
 			}
 
-			printf("Supported refresh rates:\n");
-			for (uint32_t i = 0; i < refresh_rate_count; i++) {
-				printf("\t%f Hz\n", refresh_rates[i]);
+			if (print_diagnostics) {
+				printf("Supported refresh rates:\n");
+				for (uint32_t i = 0; i < refresh_rate_count; i++) {
+					printf("\t%f Hz\n", refresh_rates[i]);
+				}
 			}
 
 			// refresh rates are ordered lowest to highest
@@ -2158,7 +2788,7 @@ void *main_loop(void* arg)
 
 		printf("Current refresh rate: %f Hz\n", refresh_rate);
 	}
-
+	phase_start = startup_phase("xr: swapchains", phase_start);
 
 	// --- Set up input (actions)
 	xrStringToPath(app.oxr.instance, "/user/hand/left", &hand_paths[HAND_LEFT_INDEX]);
@@ -2177,7 +2807,8 @@ void *main_loop(void* arg)
 
 	// Grabbing objects is not actually implemented in this demo, it only gives some  haptic feebdack.
 	app.grab_action =
-	    (struct action_t){.action = XR_NULL_HANDLE, .action_type = XR_ACTION_TYPE_FLOAT_INPUT};
+	    (struct action_t){.action = XR_NULL_HANDLE, .action_type = XR_ACTION_TYPE_FLOAT_INPUT,
+	                      .record_id = REC_ACTION_GRAB};
 	if (!create_action(app.oxr.instance, XR_ACTION_TYPE_FLOAT_INPUT, "grabobjectfloat", "Grab Object",
 	                   gameplay_actionset, HAND_COUNT, hand_paths, &app.grab_action))
 		return (void *)1;
@@ -2185,13 +2816,15 @@ void *main_loop(void* arg)
 
 	// A 1D action that is fed by one axis of a 2D input (y axis of thumbstick).
 	app.accelerate_action =
-	    (struct action_t){.action = XR_NULL_HANDLE, .action_type = XR_ACTION_TYPE_FLOAT_INPUT};
+	    (struct action_t){.action = XR_NULL_HANDLE, .action_type = XR_ACTION_TYPE_FLOAT_INPUT,
+	                      .record_id = REC_ACTION_ACCELERATE};
 	if (!create_action(app.oxr.instance, XR_ACTION_TYPE_FLOAT_INPUT, "accelerate", "Accelerate",
 	                   gameplay_actionset, HAND_COUNT, hand_paths, &app.accelerate_action))
 		return (void *)1;
 
 	app.hand_pose_action =
-	    (struct action_t){.action = XR_NULL_HANDLE, .action_type = XR_ACTION_TYPE_POSE_INPUT};
+	    (struct action_t){.action = XR_NULL_HANDLE, .action_type = XR_ACTION_TYPE_POSE_INPUT,
+	                      .record_id = REC_ACTION_HAND_POSE};
 	if (!create_action(app.oxr.instance, XR_ACTION_TYPE_POSE_INPUT, "handpose", "Hand Pose",
 	                   gameplay_actionset, HAND_COUNT, hand_paths, &app.hand_pose_action))
 		return (void *)1;
@@ -2200,7 +2833,8 @@ void *main_loop(void* arg)
 		return (void *)1;
 
 	app.aim_action =
-	    (struct action_t){.action = XR_NULL_HANDLE, .action_type = XR_ACTION_TYPE_POSE_INPUT};
+	    (struct action_t){.action = XR_NULL_HANDLE, .action_type = XR_ACTION_TYPE_POSE_INPUT,
+	                      .record_id = REC_ACTION_AIM};
 	if (!create_action(app.oxr.instance, XR_ACTION_TYPE_POSE_INPUT, "aim", "Aim Pose",
 	                   gameplay_actionset, HAND_COUNT, hand_paths, &app.aim_action))
 		return (void *)1;
@@ -2386,7 +3020,7 @@ void *main_loop(void* arg)
 		}
 		printf("\n");
 	}
-
+	phase_start = startup_phase("xr: actions", phase_start);
 
 
 	// TODO: should not be necessary, but is for SteamVR 1.16.4 (but not 1.15.x)
@@ -2394,11 +3028,19 @@ void *main_loop(void* arg)
 	               graphics_binding_gl.glxContext);
 
 	// Set up rendering (compile shaders, ...) before starting the app.oxr.session
-	if (init_gl(app.oxr.view_count, vr_swapchains[SWAPCHAIN_PROJECTION].swapchain_lengths,
-	            &app.gl_renderer) != 0) {
+	if (app.shader_cache_dir == NULL || strcmp(app.shader_cache_dir, "off") != 0)
+		shader_cache_init(app.shader_cache_dir);
+	app.gl_renderer.FramebufferTextureMultiviewOVR =
+	    (PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC)glXGetProcAddressARB(
+	        (GLubyte*)"glFramebufferTextureMultiviewOVR");
+	if (init_gl(vr_swapchains[SWAPCHAIN_PROJECTION].swapchain_count,
+	            vr_swapchains[SWAPCHAIN_PROJECTION].swapchain_lengths, &app.gl_renderer) != 0) {
 		printf("OpenGl setup failed!\n");
 		return (void *)1;
 	}
+	if (!mirror_start())
+		return (void *)1;
+	phase_start = startup_phase("xr: gl init", phase_start);
 
 	XrSessionActionSetsAttachInfo actionset_attach_info = {
 	    .type = XR_TYPE_SESSION_ACTION_SETS_ATTACH_INFO,
@@ -2408,8 +3050,45 @@ void *main_loop(void* arg)
 	result = xrAttachSessionActionSets(app.oxr.session, &actionset_attach_info);
 	if (!xr_check(app.oxr.instance, result, "failed to attach action set"))
 		return (void *)1;
+	startup_phase("xr: attach actions", phase_start);
+
+	startup_milestone(STARTUP_SESSION_READY);
+
+	// slot 0 is the only one without --pipelined
+	struct frame_slot frame_slots[FRAME_SLOT_COUNT] = {{.views = app.oxr.views}};
+	for (uint32_t i = 1; app.pipelined && i < FRAME_SLOT_COUNT; i++) {
+		frame_slots[i].views = (XrView*)malloc(sizeof(XrView) * app.oxr.view_count);
+		if (frame_slots[i].views == NULL) {
+			printf("Failed to allocate frame slot views\n");
+			return (void *)1;
+		}
+	}
+
+	struct frame_target frame_target = {.app = &app,
+	                                    .vr_swapchains = vr_swapchains,
+	                                    .quad_layer = &quad_layer,
+	                                    .graphics_binding_gl = &graphics_binding_gl,
+	                                    .stereo = stereo};
+	gpu_timer_init(&frame_target.gpu_timer);
+
+	struct frame_ring frame_ring;
+	pthread_t render_thread_id;
+	struct render_thread_args render_args = {
+	    .target = &frame_target, .ring = &frame_ring, .slots = frame_slots};
+	if (app.pipelined) {
+		frame_ring_init(&frame_ring, FRAME_SLOT_COUNT);
+
+		// from here on only the render thread touches GL
+		glXMakeCurrent(graphics_binding_gl.xDisplay, None, NULL);
+		if (pthread_create(&render_thread_id, NULL, render_thread, &render_args) != 0) {
+			printf("Failed to start the render thread\n");
+			return (void *)1;
+		}
+	}
 
-	VR_initialized = 1;
+	// workers start from the xr thread but apply the job profile, not its placement
+	if (!job_system_init(app.job_workers))
+		return (void *)1;
 
 	uint64_t frame_count = 0;
 
@@ -2417,7 +3096,6 @@ void *main_loop(void* arg)
 	bool session_running = false; // to avoid beginning an already running app.oxr.session
 
 	struct timeval start_time_fps, end_time_fps;
-	struct timeval start_time_render_loop, end_time_render_loop;
 
 	// Record the start time
     gettimeofday(&start_time_fps, NULL);
@@ -2425,7 +3103,7 @@ void *main_loop(void* arg)
 	// RENDER LOOP
 	while (!quit_renderloop) {
 
-		gettimeofday(&start_time_render_loop, NULL);
+		int64_t poll_start_ns = frame_timing_now();
 
 		// --- Poll SDL for events so we can exit with esc
 		SDL_Event sdl_event;
@@ -2514,6 +3192,12 @@ void *main_loop(void* arg)
 					// end app.oxr.session only if it is running, i.e. not when we already called xrEndSession
 					// but the runtime did not switch to the next app.oxr.state yet
 					if (session_running) {
+						// every frame the render thread was handed has to end before the session does
+						if (app.pipelined && !frame_ring_drain(&frame_ring)) {
+							quit_renderloop = true;
+							skip_renderloop = true;
+							break;
+						}
 						result = xrEndSession(app.oxr.session);
 						if (!xr_check(app.oxr.instance, result, "Failed to end app.oxr.session!"))
 							return (void *)1;
@@ -2526,6 +3210,8 @@ void *main_loop(void* arg)
 				// destroy app.oxr.session, skip render loop, exit render loop and quit
 				case XR_SESSION_STATE_LOSS_PENDING:
 				case XR_SESSION_STATE_EXITING:
+					if (app.pipelined)
+						frame_ring_drain(&frame_ring);
 					result = xrDestroySession(app.oxr.session);
 					if (!xr_check(app.oxr.instance, result, "Failed to destroy app.oxr.session!"))
 						return (void *)1;
@@ -2769,16 +3455,43 @@ void *main_loop(void* arg)
 			continue;
 		}
 
-
+		// a free slot before xrWaitFrame(), the poses sampled after it must not wait for the render
+		// thread to catch up
+		int slot_index = 0;
+		if (app.pipelined) {
+			slot_index = frame_ring_acquire(&frame_ring);
+			if (slot_index < 0)
+				break;
+		}
+		struct frame_slot* slot = &frame_slots[slot_index];
 
 		frame_count++;
 
+		struct frame_timing* timing = &slot->timing;
+		frame_timing_reset(timing, frame_count);
+		int64_t stage_ns = frame_timing_add(timing, FRAME_STAGE_POLL_EVENTS, poll_start_ns);
+
 		// --- Wait for our turn to do head-pose dependent computation and render a frame
 		XrFrameState frameState = {.type = XR_TYPE_FRAME_STATE, .next = NULL};
 		XrFrameWaitInfo frameWaitInfo = {.type = XR_TYPE_FRAME_WAIT_INFO, .next = NULL};
 		result = xrWaitFrame(app.oxr.session, &frameWaitInfo, &frameState);
 		if (!xr_check(app.oxr.instance, result, "xrWaitFrame() was not successful, exiting..."))
 			break;
+		slot->frame_state = frameState;
+		thread_profile_tick();
+		stage_ns = frame_timing_add(timing, FRAME_STAGE_WAIT_FRAME, stage_ns);
+		timing->display_time = frameState.predictedDisplayTime;
+		timing->display_period = frameState.predictedDisplayPeriod;
+
+		if (recorder_active()) {
+			struct rec_frame rec = {
+			    .frame_index = frame_count,
+			    .predicted_display_time = frameState.predictedDisplayTime,
+			    .predicted_display_period = frameState.predictedDisplayPeriod,
+			    .should_render = frameState.shouldRender,
+			};
+			recorder_write(REC_FRAME, &rec, sizeof(rec));
+		}
 
 
 
@@ -2791,15 +3504,17 @@ void *main_loop(void* arg)
 		                                     .space = app.oxr.play_space};
 
 		for (uint32_t i = 0; i < app.oxr.view_count; i++) {
-			app.oxr.views[i].type = XR_TYPE_VIEW;
-			app.oxr.views[i].next = NULL;
+			slot->views[i].type = XR_TYPE_VIEW;
+			slot->views[i].next = NULL;
 		};
 
-		app.oxr.view_state = (XrViewState){.type = XR_TYPE_VIEW_STATE, .next = NULL};
-		result = xrLocateViews(app.oxr.session, &view_locate_info, &app.oxr.view_state,
-		                       app.oxr.view_count, &app.oxr.view_count, app.oxr.views);
+		slot->view_state = (XrViewState){.type = XR_TYPE_VIEW_STATE, .next = NULL};
+		result = xrLocateViews(app.oxr.session, &view_locate_info, &slot->view_state,
+		                       app.oxr.view_count, &slot->view_count, slot->views);
 		if (!xr_check(app.oxr.instance, result, "Could not locate views"))
 			break;
+		slot->pose_ns = frame_timing_now();
+		stage_ns = frame_timing_add(timing, FRAME_STAGE_LOCATE_VIEWS, stage_ns);
 
 
 		//! @todo Move this action processing to before xrWaitFrame, probably.
@@ -2883,27 +3598,25 @@ void *main_loop(void* arg)
 		}
 #endif
 
-		pthread_mutex_lock(&buffer_mutex);
-		
 		for (int i = 0; i < HAND_COUNT; i++) {
 			if (!update_action_data(app.oxr.instance, app.oxr.session, &app.hand_pose_action,
 			                        app.oxr.play_space, frameState.predictedDisplayTime,
 			                        app.query_hand_velocities))
-				printf("Failed to get hand pose action data for hand %d\n", i);
+				LOG_WARN("Failed to get hand pose action data for hand %d\n", i);
 
 			if (!update_action_data(app.oxr.instance, app.oxr.session, &app.aim_action,
 			                        app.oxr.play_space, frameState.predictedDisplayTime,
 			                        app.query_hand_velocities))
-				printf("Failed to get aim pose action data for hand %d\n", i);
+				LOG_WARN("Failed to get aim pose action data for hand %d\n", i);
 
 
 			if (!update_action_data(app.oxr.instance, app.oxr.session, &app.grab_action, XR_NULL_HANDLE,
 			                        0, false))
-				printf("Failed to get grab action data for hand %d\n", i);
+				LOG_WARN("Failed to get grab action data for hand %d\n", i);
 
 			if (!update_action_data(app.oxr.instance, app.oxr.session, &app.accelerate_action,
 			                        XR_NULL_HANDLE, 0, false))
-				printf("Failed to get accelerate action data for hand %d\n", i);
+				LOG_WARN("Failed to get accelerate action data for hand %d\n", i);
 
 
 
@@ -2928,182 +3641,28 @@ void *main_loop(void* arg)
 
 			if (app.accelerate_action.states[i].float_.isActive &&
 			    app.accelerate_action.states[i].float_.currentState != 0) {
-				printf("Throttle value %d: changed %d: %f\n", i,
+				LOG_DEBUG("Throttle value %d: changed %d: %f\n", i,
 				       app.accelerate_action.states[i].float_.changedSinceLastSync,
 				       app.accelerate_action.states[i].float_.currentState);
 			}
-
-			if (app.ext.hand_tracking.system_supported) {
-				get_hand_tracking(app.oxr.instance, app.oxr.play_space, frameState.predictedDisplayTime,
-				                  app.query_joint_velocities, &app.ext.hand_tracking, i);
-			}
 		};
+		frame_timing_add(timing, FRAME_STAGE_SYNC_ACTIONS, stage_ns);
 
-		flag += 1;
-		data_ready = 1;
-        pthread_mutex_unlock(&buffer_mutex);
-
-		if (app.cube.enabled) {
-			if (app.cube.pos_ts != 0) {
-				XrDuration diff_ns = frameState.predictedDisplayTime - app.cube.pos_ts;
-				float diff_s = (double)diff_ns * 1. / 1000. * 1. / 1000. * 1. / 1000.;
-				XrVector3f next_pos = {
-				    .x = app.cube.current_pos.x += app.cube.velocity.x * diff_s,
-				    .y = app.cube.current_pos.y += app.cube.velocity.y * diff_s,
-				    .z = app.cube.current_pos.z += app.cube.velocity.z * diff_s,
-				};
-				if (next_pos.x > app.cube.center_pos.x + app.cube.bouncing_lengths.x || //
-				    next_pos.y > app.cube.center_pos.y + app.cube.bouncing_lengths.y || //
-				    next_pos.z > app.cube.center_pos.z + app.cube.bouncing_lengths.z || //
-				    next_pos.x < app.cube.center_pos.x - app.cube.bouncing_lengths.x || //
-				    next_pos.y < app.cube.center_pos.y - app.cube.bouncing_lengths.y || //
-				    next_pos.z < app.cube.center_pos.z - app.cube.bouncing_lengths.z) {
-					app.cube.velocity.x *= -1;
-					app.cube.velocity.y *= -1;
-					app.cube.velocity.z *= -1;
-
-					next_pos = (XrVector3f){
-					    .x = app.cube.current_pos.x += app.cube.velocity.x * diff_s,
-					    .y = app.cube.current_pos.y += app.cube.velocity.y * diff_s,
-					    .z = app.cube.current_pos.z += app.cube.velocity.z * diff_s,
-					};
-				}
-				app.cube.current_pos = next_pos;
-				// printf("render cube at %f %f %f\n", app.cube.current_pos.x, app.cube.current_pos.y,
-				// app.cube.current_pos.z);
-			}
-
-			app.cube.pos_ts = frameState.predictedDisplayTime;
-		}
-
-		// --- Begin frame
-		XrFrameBeginInfo frame_begin_info = {.type = XR_TYPE_FRAME_BEGIN_INFO, .next = NULL};
-
-		result = xrBeginFrame(app.oxr.session, &frame_begin_info);
-		if (!xr_check(app.oxr.instance, result, "failed to begin frame!"))
+		// the xr thread runs jobs as well until the graph is through
+		struct job* frame_jobs_done = submit_frame_jobs(&app, slot, frameState.predictedDisplayTime);
+		if (frame_jobs_done == NULL) {
+			printf("The frame jobs do not fit the job arena\n");
 			break;
-
-		// all swapchain release infos happen to be the same
-		XrSwapchainImageReleaseInfo release_info = {.type = XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO,
-		                                            .next = NULL};
-
-		// render projection layer (once per view) and fill projection_views with the result
-		for (uint32_t i = 0; i < app.oxr.view_count; i++) {
-			uint32_t projection_index;
-			if (!acquire_swapchain(app.oxr.instance, &vr_swapchains[SWAPCHAIN_PROJECTION], i,
-			                       &projection_index))
-				break;
-
-			uint32_t depth_index = 0;
-			if (app.ext.depth.base.supported) {
-				if (!acquire_swapchain(app.oxr.instance, &vr_swapchains[SWAPCHAIN_DEPTH], i, &depth_index))
-					break;
-			}
-
-			GLuint depth_image = app.ext.depth.base.supported
-			                         ? vr_swapchains[SWAPCHAIN_DEPTH].images[i][depth_index].image
-			                         : 0;
-			GLuint projection_image =
-			    vr_swapchains[SWAPCHAIN_PROJECTION].images[i][projection_index].image;
-
-			int w = app.oxr.viewconfig_views[i].recommendedImageRectWidth;
-			int h = app.oxr.viewconfig_views[i].recommendedImageRectHeight;
-
-			// TODO: should not be necessary, but is for SteamVR 1.16.4 (but not 1.15.x)
-			glXMakeCurrent(graphics_binding_gl.xDisplay, graphics_binding_gl.glxDrawable,
-			               graphics_binding_gl.glxContext);
-
-			render_frame(&app, w, h, &app.gl_renderer, projection_index, frameState.predictedDisplayTime,
-			             i, app.hand_pose_action.pose_locations, &app.ext.hand_tracking,
-			             &app.oxr.views[i], projection_image, app.ext.depth.base.supported, depth_image);
-
-			result =
-			    xrReleaseSwapchainImage(vr_swapchains[SWAPCHAIN_PROJECTION].swapchains[i], &release_info);
-			if (!xr_check(app.oxr.instance, result, "failed to release swapchain image!"))
-				break;
-
-			if (app.ext.depth.base.supported) {
-				result =
-				    xrReleaseSwapchainImage(vr_swapchains[SWAPCHAIN_DEPTH].swapchains[i], &release_info);
-				if (!xr_check(app.oxr.instance, result, "failed to release swapchain image!"))
-					break;
-			}
-
-			app.oxr.projection_views[i].pose = app.oxr.views[i].pose;
-			app.oxr.projection_views[i].fov = app.oxr.views[i].fov;
 		}
+		job_wait(frame_jobs_done);
 
-
-		uint32_t quad_index = 0;
-		if (!acquire_swapchain(app.oxr.instance, &quad_layer.swapchain, 0, &quad_index))
-			break;
-
-		render_quad(&app.gl_renderer, &quad_layer, quad_index, frameState.predictedDisplayTime);
-
-		result = xrReleaseSwapchainImage(quad_layer.swapchain.swapchains[0], &release_info);
-		if (!xr_check(app.oxr.instance, result, "failed to release swapchain image!"))
+		if (app.pipelined) {
+			slot->queued_ns = frame_timing_now();
+			frame_ring_push(&frame_ring);
+		} else if (!submit_frame(&frame_target, slot)) {
 			break;
-
-
-		// projectionLayers struct reused for every frame
-		XrCompositionLayerProjection projection_layer = {
-		    .type = XR_TYPE_COMPOSITION_LAYER_PROJECTION,
-		    .next = NULL,
-		    .layerFlags = 0,
-		    .space = app.oxr.play_space,
-		    .viewCount = app.oxr.view_count,
-		    .views = app.oxr.projection_views,
-		};
-
-
-		float quad_aspect = (float)quad_layer.pixel_width / (float)quad_layer.pixel_height;
-		float quad_width = 1.f;
-		XrCompositionLayerQuad quad_comp_layer = {
-		    .type = XR_TYPE_COMPOSITION_LAYER_QUAD,
-		    .next = NULL,
-		    .layerFlags = XR_COMPOSITION_LAYER_BLEND_TEXTURE_SOURCE_ALPHA_BIT,
-		    .space = app.oxr.play_space,
-		    .eyeVisibility = XR_EYE_VISIBILITY_BOTH,
-		    .pose = {.orientation = {.x = 0.f, .y = 0.f, .z = 0.f, .w = 1.f},
-		             .position = {.x = 1.5f, .y = .7f, .z = -1.5f}},
-		    .size = {.width = quad_width, .height = quad_width / quad_aspect},
-		    .subImage = {
-		        .swapchain = quad_layer.swapchain.swapchains[0],
-		        .imageRect = {
-		            .offset = {.x = 0, .y = 0},
-		            .extent = {.width = quad_layer.pixel_width, .height = quad_layer.pixel_height},
-		        }}};
-
-
-		int submitted_layer_count = 1;
-		const XrCompositionLayerBaseHeader* submitted_layers[2] = {
-		    (const XrCompositionLayerBaseHeader* const) & projection_layer};
-		// already set projection_views[i].next = &depth.infos[i]; if depth supported
-
-
-		submitted_layers[submitted_layer_count++] =
-		    (const XrCompositionLayerBaseHeader* const) & quad_comp_layer;
-
-		if ((app.oxr.view_state.viewStateFlags & XR_VIEW_STATE_ORIENTATION_VALID_BIT) == 0) {
-			printf("Not submitting layers because orientation is invalid\n");
-			submitted_layer_count = 0;
 		}
 
-		XrFrameEndInfo frameEndInfo = {.type = XR_TYPE_FRAME_END_INFO,
-		                               .displayTime = frameState.predictedDisplayTime,
-		                               .layerCount = submitted_layer_count,
-		                               .layers = submitted_layers,
-		                               .environmentBlendMode = app.oxr.blend_mode,
-		                               .next = NULL};
-		result = xrEndFrame(app.oxr.session, &frameEndInfo);
-		if (!xr_check(app.oxr.instance, result, "failed to end frame!"))
-			break;
-
-		gettimeofday(&end_time_render_loop, NULL);
-
-		double loop_duration = (end_time_render_loop.tv_sec - start_time_render_loop.tv_sec) +
-							(end_time_render_loop.tv_usec - start_time_render_loop.tv_usec) / 1000000.0;
-		// printf("Render loop duration: %f\n", loop_duration);
 		sleep(0.04);
 	}
 
@@ -3113,11 +3672,34 @@ void *main_loop(void* arg)
 							(end_time_fps.tv_usec - start_time_fps.tv_usec) / 1000000.0);
 	printf("Frame rate: %f fps\n", frame_rate);
 
+	if (app.pipelined) {
+		// the render thread submits what is still queued and gives the context back
+		frame_ring_close(&frame_ring);
+		pthread_join(render_thread_id, NULL);
+		frame_ring_destroy(&frame_ring);
+		glXMakeCurrent(graphics_binding_gl.xDisplay, graphics_binding_gl.glxDrawable,
+		               graphics_binding_gl.glxContext);
+	}
+
+	job_system_shutdown();
+
+	frame_timing_print();
+	job_system_print();
+	if (frame_target.gpu_timer.dropped_frames > 0) {
+		printf("GPU timing dropped %lu frames whose queries were not done in time\n",
+		       (unsigned long)frame_target.gpu_timer.dropped_frames);
+	}
+
 
 	// --- Clean up after render loop quits
-	closing_app = 1;
+	pthread_mutex_lock(&buffer_mutex);
+	atomic_store_explicit(&control.closing_app, true, memory_order_release);
+	pthread_cond_broadcast(&control.data_ready_changed);
+	pthread_mutex_unlock(&buffer_mutex);
 
-	for (uint32_t i = 0; i < app.oxr.view_count; i++) {
+	recorder_close();
+
+	for (uint32_t i = 0; i < vr_swapchains[SWAPCHAIN_PROJECTION].swapchain_count; i++) {
 		free(vr_swapchains[SWAPCHAIN_PROJECTION].images[i]);
 		if (app.ext.depth.base.supported) {
 			free(vr_swapchains[SWAPCHAIN_DEPTH].images[i]);
@@ -3127,8 +3709,19 @@ void *main_loop(void* arg)
 		                     app.gl_renderer.framebuffers[i]);
 		free(app.gl_renderer.framebuffers[i]);
 	}
+	gpu_timer_destroy(&frame_target.gpu_timer);
+	mirror_stop();
 	xrDestroyInstance(app.oxr.instance);
 
+	// before app.oxr.views is freed, slot 0 shares it
+	for (uint32_t i = 0; i < FRAME_SLOT_COUNT; i++) {
+		if (frame_slots[i].views != app.oxr.views)
+			free(frame_slots[i].views);
+		free(frame_slots[i].draw_list.items);
+		free(frame_slots[i].draw_list.staging);
+		free(frame_slots[i].draw_list.staging_mesh);
+	}
+
 	free(app.oxr.viewconfig_views);
 	free(app.oxr.projection_views);
 	free(app.oxr.views);
@@ -3146,15 +3739,39 @@ void *main_loop(void* arg)
 
 
 // =============================================================================
-// OpenGL rendering code
+// Desktop window, the rendering code itself is in renderer.c
 // =============================================================================
 
-// A small header with functions for OpenGL math
-#define MATH_3D_IMPLEMENTATION
-#include "math_3d.h"
-
 static SDL_Window* desktop_window;
 static SDL_GLContext gl_context;
+static int desktop_width, desktop_height;
+
+// --mirror async: the rendering thread downscales the left eye into one of two textures and
+// publishes it after xrEndFrame(), the mirror thread blits and swaps it with its own context
+#define MIRROR_TEXTURES 2
+
+static struct
+{
+	SDL_GLContext context;
+	pthread_t thread;
+	bool running;
+
+	// rendering context only
+	GLuint textures[MIRROR_TEXTURES];
+	GLuint fbo;
+	// copied this frame, not published yet
+	int copied;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t changed;
+	// signaled when the copy into the texture is done, replaced by the rendering thread only while
+	// the texture is neither published nor read
+	GLsync fences[MIRROR_TEXTURES];
+	// -1 for none
+	int published;
+	int reading;
+	bool quit;
+} mirror = {.copied = -1, .published = -1, .reading = -1};
 
 // don't need a gl loader for just one function, just load it ourselves'
 PFNGLBLITNAMEDFRAMEBUFFERPROC _glBlitNamedFramebuffer;
@@ -3183,7 +3800,8 @@ init_sdl_window(Display** xDisplay,
                 GLXDrawable* glxDrawable,
                 GLXContext* glxContext,
                 int w,
-                int h)
+                int h,
+                enum mirror_mode mirror_mode)
 {
 
 	if (SDL_Init(SDL_INIT_VIDEO) < 0) {
@@ -3198,15 +3816,28 @@ init_sdl_window(Display** xDisplay,
 	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 0);
 
 
-	/* Create our window centered at half the VR resolution */
-	desktop_window =
-	    SDL_CreateWindow("OpenXR Example", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, w / 2,
-	                     h / 2, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
+	/* Create our window centered, the size of the mirror */
+	uint32_t visibility = mirror_mode == MIRROR_OFF ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN;
+	desktop_window = SDL_CreateWindow("OpenXR Example", SDL_WINDOWPOS_CENTERED,
+	                                  SDL_WINDOWPOS_CENTERED, w, h, SDL_WINDOW_OPENGL | visibility);
 	if (!desktop_window) {
 		printf("Unable to create window");
 		return false;
 	}
 
+	desktop_width = w;
+	desktop_height = h;
+
+	// creating a context makes it current, the mirror one is made first to end up with gl_context
+	if (mirror_mode == MIRROR_ASYNC) {
+		mirror.context = SDL_GL_CreateContext(desktop_window);
+		if (!mirror.context) {
+			printf("Unable to create the mirror context");
+			return false;
+		}
+		SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+	}
+
 	gl_context = SDL_GL_CreateContext(desktop_window);
 
 	glEnable(GL_DEBUG_OUTPUT);
@@ -3218,632 +3849,421 @@ init_sdl_window(Display** xDisplay,
 	    (PFNGLBLITNAMEDFRAMEBUFFERPROC)glXGetProcAddressARB((GLubyte*)"glBlitNamedFramebuffer");
 
 	// HACK? OpenXR wants us to report these values, so "work around" SDL a
-	// bit and get the underlying glx stuff. Does this still work when e.g.
-	// SDL switches to xcb?
-	*xDisplay = XOpenDisplay(NULL);
-	*glxContext = glXGetCurrentContext();
-	*glxDrawable = glXGetCurrentDrawable();
-
-	return true;
-}
-
-
-static const char* vertexshader =
-    "#version 330 core\n"
-    "#extension GL_ARB_explicit_uniform_location : require\n"
-    "layout(location = 0) in vec3 aPos;\n"
-    "layout(location = 2) uniform mat4 model;\n"
-    "layout(location = 3) uniform mat4 view;\n"
-    "layout(location = 4) uniform mat4 proj;\n"
-    "layout(location = 5) in vec2 aTexCoord;\n"
-    "out vec2 texCoord;\n"
-    "void main() {\n"
-    "	gl_Position = proj * view * model * vec4(aPos, 1.0);\n"
-    "	texCoord = aTexCoord;\n"
-    "}\n";
-
-static const char* fragmentshader =
-    "#version 330 core\n"
-    "#extension GL_ARB_explicit_uniform_location : require\n"
-    "layout(location = 0) out vec4 FragColor;\n"
-    "uniform vec4 uniformColor;\n"
-    "layout(location=1) uniform sampler2D imageTexture;\n"
-    "in vec2 texCoord;\n"
-    "void main() {\n"
-    "    FragColor = (uniformColor.x < 0.01 &&\n"
-    "                 uniformColor.y < 0.01 &&\n"
-    "                 uniformColor.z < 0.01)\n"
-    "                    ? texture(imageTexture, texCoord)\n"
-    "                    : uniformColor;\n"
-    "}\n";
-
-
-
-int
-init_gl(uint32_t view_count, uint32_t* swapchain_lengths, struct gl_renderer_t* gl_renderer)
-{
-
-	/* Allocate resources that we use for our own rendering.
-	 * We will bind framebuffers to the runtime provided textures for rendering.
-	 * For this, we create one framebuffer per OpenGL texture.
-	 * This is not mandated by OpenXR, other ways to render to textures will work too.
-	 */
-	gl_renderer->framebuffers = malloc(sizeof(GLuint*) * view_count);
-	for (uint32_t i = 0; i < view_count; i++) {
-		gl_renderer->framebuffers[i] = malloc(sizeof(GLuint) * swapchain_lengths[i]);
-		glGenFramebuffers(swapchain_lengths[i], gl_renderer->framebuffers[i]);
-	}
-
-	GLuint vertex_shader_id = glCreateShader(GL_VERTEX_SHADER);
-	const GLchar* vertex_shader_source[1];
-	vertex_shader_source[0] = vertexshader;
-	// printf("Vertex Shader:\n%s\n", vertexShaderSource);
-	glShaderSource(vertex_shader_id, 1, vertex_shader_source, NULL);
-	glCompileShader(vertex_shader_id);
-	int vertex_compile_res;
-	glGetShaderiv(vertex_shader_id, GL_COMPILE_STATUS, &vertex_compile_res);
-	if (!vertex_compile_res) {
-		char info_log[512];
-		glGetShaderInfoLog(vertex_shader_id, 512, NULL, info_log);
-		printf("Vertex Shader failed to compile: %s\n", info_log);
-		return 1;
-	} else {
-		printf("Successfully compiled vertex shader!\n");
-	}
-
-	GLuint fragment_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
-	const GLchar* fragment_shader_source[1];
-	fragment_shader_source[0] = fragmentshader;
-	glShaderSource(fragment_shader_id, 1, fragment_shader_source, NULL);
-	glCompileShader(fragment_shader_id);
-	int fragment_compile_res;
-	glGetShaderiv(fragment_shader_id, GL_COMPILE_STATUS, &fragment_compile_res);
-	if (!fragment_compile_res) {
-		char info_log[512];
-		glGetShaderInfoLog(fragment_shader_id, 512, NULL, info_log);
-		printf("Fragment Shader failed to compile: %s\n", info_log);
-		return 1;
-	} else {
-		printf("Successfully compiled fragment shader!\n");
-	}
-
-	gl_renderer->shader_program_id = glCreateProgram();
-	glAttachShader(gl_renderer->shader_program_id, vertex_shader_id);
-	glAttachShader(gl_renderer->shader_program_id, fragment_shader_id);
-	glLinkProgram(gl_renderer->shader_program_id);
-	GLint shader_program_res;
-	glGetProgramiv(gl_renderer->shader_program_id, GL_LINK_STATUS, &shader_program_res);
-	if (!shader_program_res) {
-		char info_log[512];
-		glGetProgramInfoLog(gl_renderer->shader_program_id, 512, NULL, info_log);
-		printf("Shader Program failed to link: %s\n", info_log);
-		return 1;
-	} else {
-		printf("Successfully linked shader program!\n");
-	}
-
-	glDeleteShader(vertex_shader_id);
-	glDeleteShader(fragment_shader_id);
-
-
-	// vertices for a cube
-	float cube_vertices[] = {-0.5f, -0.5f, -0.5f, 0.0f, 0.0f, 0.5f,  -0.5f, -0.5f, 1.0f, 0.0f,
-	                    0.5f,  0.5f,  -0.5f, 1.0f, 1.0f, 0.5f,  0.5f,  -0.5f, 1.0f, 1.0f,
-	                    -0.5f, 0.5f,  -0.5f, 0.0f, 1.0f, -0.5f, -0.5f, -0.5f, 0.0f, 0.0f,
-
-	                    -0.5f, -0.5f, 0.5f,  0.0f, 0.0f, 0.5f,  -0.5f, 0.5f,  1.0f, 0.0f,
-	                    0.5f,  0.5f,  0.5f,  1.0f, 1.0f, 0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-	                    -0.5f, 0.5f,  0.5f,  0.0f, 1.0f, -0.5f, -0.5f, 0.5f,  0.0f, 0.0f,
-
-	                    -0.5f, 0.5f,  0.5f,  1.0f, 0.0f, -0.5f, 0.5f,  -0.5f, 1.0f, 1.0f,
-	                    -0.5f, -0.5f, -0.5f, 0.0f, 1.0f, -0.5f, -0.5f, -0.5f, 0.0f, 1.0f,
-	                    -0.5f, -0.5f, 0.5f,  0.0f, 0.0f, -0.5f, 0.5f,  0.5f,  1.0f, 0.0f,
-
-	                    0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 0.5f,  0.5f,  -0.5f, 1.0f, 1.0f,
-	                    0.5f,  -0.5f, -0.5f, 0.0f, 1.0f, 0.5f,  -0.5f, -0.5f, 0.0f, 1.0f,
-	                    0.5f,  -0.5f, 0.5f,  0.0f, 0.0f, 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-	                    -0.5f, -0.5f, -0.5f, 0.0f, 1.0f, 0.5f,  -0.5f, -0.5f, 1.0f, 1.0f,
-	                    0.5f,  -0.5f, 0.5f,  1.0f, 0.0f, 0.5f,  -0.5f, 0.5f,  1.0f, 0.0f,
-	                    -0.5f, -0.5f, 0.5f,  0.0f, 0.0f, -0.5f, -0.5f, -0.5f, 0.0f, 1.0f,
-
-	                    -0.5f, 0.5f,  -0.5f, 0.0f, 1.0f, 0.5f,  0.5f,  -0.5f, 1.0f, 1.0f,
-	                    0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-	                    -0.5f, 0.5f,  0.5f,  0.0f, 0.0f, -0.5f, 0.5f,  -0.5f, 0.0f, 1.0f};	
-
-	// vertices for a rectangle
-	float rectangle_vertices[] = {
-    // Positions (x, y, z)        // Texture Coordinates (s, t)
-    -1.5f, 0.0f, -0.8f,           0.0f, 0.0f,
-     1.5f, 0.0f, -0.8f,           1.0f, 0.0f,
-     1.5f, 0.0f,  0.8f,           1.0f, 1.0f,
-    -1.5f, 0.0f, -0.8f,           0.0f, 0.0f,
-     1.5f, 0.0f,  0.8f,           1.0f, 1.0f,
-    -1.5f, 0.0f,  0.8f,           0.0f, 1.0f 
-	};
-
-
-
-
-
-	GLuint VBOs[2];
-	glGenBuffers(2, VBOs);
-
-	GLuint* VAOs;
-	VAOs = malloc(2 * sizeof(GLuint));
-	glGenVertexArrays(2, VAOs);
-	gl_renderer->VAOs = VAOs;
-
-	// Initialize cube VAO/VBO
-	glBindVertexArray(gl_renderer->VAOs[0]);
-	glBindBuffer(GL_ARRAY_BUFFER, VBOs[0]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_DYNAMIC_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_DYNAMIC_DRAW);
-	glVertexAttribPointer(5, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(5);
-
-	// Initialize rectangle VAO/VBO
-	glBindVertexArray(gl_renderer->VAOs[1]);
-	glBindBuffer(GL_ARRAY_BUFFER, VBOs[1]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(rectangle_vertices), rectangle_vertices, GL_DYNAMIC_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	glBufferData(GL_ARRAY_BUFFER, sizeof(rectangle_vertices), rectangle_vertices, GL_DYNAMIC_DRAW);
-	glVertexAttribPointer(5, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(5);
-
-
-	glEnable(GL_DEPTH_TEST);
-
-	gl_renderer->modelLoc = glGetUniformLocation(gl_renderer->shader_program_id, "model");
-	gl_renderer->colorLoc = glGetUniformLocation(gl_renderer->shader_program_id, "uniformColor");
-	gl_renderer->textureLoc = glGetUniformLocation(gl_renderer->shader_program_id, "imageTexture");
-	gl_renderer->viewLoc = glGetUniformLocation(gl_renderer->shader_program_id, "view");
-	gl_renderer->projLoc = glGetUniformLocation(gl_renderer->shader_program_id, "proj");
-
-	return 0;
-}
+	// bit and get the underlying glx stuff. Does this still work when e.g.
+	// SDL switches to xcb?
+	*xDisplay = XOpenDisplay(NULL);
+	*glxContext = glXGetCurrentContext();
+	*glxDrawable = glXGetCurrentDrawable();
 
-static void
-render_block(XrVector3f* position, XrQuaternionf* orientation, XrVector3f* radi, int modelLoc)
-{
-	XrMatrix4x4f model_matrix;
-	XrMatrix4x4f_CreateModelMatrix(&model_matrix, position, orientation, radi);
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, (float*)model_matrix.m);
-	glDrawArrays(GL_TRIANGLES, 0, 36);
+	return true;
 }
 
-static void
-render_cube(XrVector3f* position, XrQuaternionf* orientation, float cube_size, int modelLoc)
+// blit left eye to desktop window
+void
+blit_to_desktop(GLuint framebuffer, int w, int h)
 {
-	XrVector3f s = {cube_size, cube_size, cube_size};
-	render_block(position, orientation, &s, modelLoc);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	_glBlitNamedFramebuffer((GLuint)framebuffer,             // readFramebuffer
+	                        (GLuint)0,                       // backbuffer     // drawFramebuffer
+	                        (GLint)0,                        // srcX0
+	                        (GLint)0,                        // srcY0
+	                        (GLint)w,                        // srcX1
+	                        (GLint)h,                        // srcY1
+	                        (GLint)0,                        // dstX0
+	                        (GLint)0,                        // dstY0
+	                        (GLint)desktop_width,            // dstX1
+	                        (GLint)desktop_height,           // dstY1
+	                        (GLbitfield)GL_COLOR_BUFFER_BIT, // mask
+	                        (GLenum)GL_LINEAR);              // filter
+
+	SDL_GL_SwapWindow(desktop_window);
 }
 
-static void
-render_simple_cube(vec3_t position, vec3_t cube_size, int modelLoc)
+static void*
+mirror_thread(void* arg)
 {
-	mat4_t modelmatrix =
-	    m4_mul(m4_translation(position), m4_scaling(vec3(cube_size.x, cube_size.y, cube_size.z)));
-
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, (float*)modelmatrix.m);
-	glDrawArrays(GL_TRIANGLES, 0, 36);
-}
+	logger_set_thread_name("mirror");
+	alloc_tracker_set_thread("mirror");
+	thread_profile_start(THREAD_ROLE_MIRROR);
+	SDL_GL_MakeCurrent(desktop_window, mirror.context);
+
+	// framebuffer objects are not shared between contexts
+	GLuint fbos[MIRROR_TEXTURES];
+	glGenFramebuffers(MIRROR_TEXTURES, fbos);
+	for (int i = 0; i < MIRROR_TEXTURES; i++) {
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, fbos[i]);
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+		                       mirror.textures[i], 0);
+	}
 
+	pthread_mutex_lock(&mirror.mutex);
+	while (true) {
+		while (!mirror.quit && mirror.published < 0)
+			pthread_cond_wait(&mirror.changed, &mirror.mutex);
+		if (mirror.quit)
+			break;
+		int index = mirror.published;
+		mirror.published = -1;
+		mirror.reading = index;
+		GLsync fence = mirror.fences[index];
+		pthread_mutex_unlock(&mirror.mutex);
+		thread_profile_tick();
+
+		// waits on the GPU, not here
+		glWaitSync(fence, 0, GL_TIMEOUT_IGNORED);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, fbos[index]);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, desktop_width, desktop_height, 0, 0, desktop_width, desktop_height,
+		                  GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		SDL_GL_SwapWindow(desktop_window);
+		// the texture may be overwritten once the blit has read it
+		glFinish();
 
+		pthread_mutex_lock(&mirror.mutex);
+		mirror.reading = -1;
+	}
+	pthread_mutex_unlock(&mirror.mutex);
 
-static float
-vec3_mag(XrVector3f* vec)
-{
-	return sqrt(vec->x * vec->x + vec->y * vec->y + vec->z * vec->z);
+	glDeleteFramebuffers(MIRROR_TEXTURES, fbos);
+	SDL_GL_MakeCurrent(desktop_window, NULL);
+	return NULL;
 }
 
-static XrVector3f
-vec3_norm(XrVector3f* vec)
+// with the rendering context current, does nothing unless the window was created for MIRROR_ASYNC
+bool
+mirror_start(void)
 {
-	float mag = vec3_mag(vec);
-	XrVector3f r = {.x = vec->x / mag, .y = vec->y / mag, .z = vec->z / mag};
-	return r;
-}
+	if (!mirror.context)
+		return true;
 
-static mat4_t
-m4_dir_to_matrix(vec3_t dir)
-{
-	vec3_t z_axis = vec3(0, 0, -1);
-	vec3_t rot_axis = v3_cross(z_axis, dir);
-	float angle = acos(v3_dot(z_axis, dir));
-	return m4_rotation(angle, rot_axis);
+	glGenTextures(MIRROR_TEXTURES, mirror.textures);
+	for (int i = 0; i < MIRROR_TEXTURES; i++) {
+		glBindTexture(GL_TEXTURE_2D, mirror.textures[i]);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_SRGB8_ALPHA8, desktop_width, desktop_height);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glGenFramebuffers(1, &mirror.fbo);
+
+	pthread_mutex_init(&mirror.mutex, NULL);
+	pthread_cond_init(&mirror.changed, NULL);
+	if (pthread_create(&mirror.thread, NULL, mirror_thread, NULL) != 0) {
+		printf("Failed to start the mirror thread\n");
+		return false;
+	}
+	mirror.running = true;
+	return true;
 }
 
-static void
-render_vec(struct ApplicationState* app, XrVector3f* vec, XrVector3f* start)
+// before the swapchain image of the left eye is released, the blit only queues GPU work
+void
+mirror_copy(GLuint framebuffer, int w, int h)
 {
-	float width = 0.005;
-	float lin_len = vec3_mag(vec);
-
-	XrVector3f lin_direction = vec3_norm(vec);
-
-	mat4_t m = m4_identity();
-	m = m4_mul(m, m4_translation(vec3(0, 0, -lin_len / 2.)));
-	m = m4_mul(m, m4_scaling(vec3(width, width, lin_len)));
-	m = m4_mul(m4_dir_to_matrix(vec3(lin_direction.x, lin_direction.y, lin_direction.z)), m);
-	m = m4_mul(m4_translation(vec3(start->x, start->y, start->z)), m);
+	if (!mirror.running)
+		return;
 
-	glUniformMatrix4fv(app->gl_renderer.modelLoc, 1, GL_FALSE, (float*)m.m);
-	glDrawArrays(GL_TRIANGLES, 0, 36);
-}
+	// the other texture than the one being shown, a published but not yet shown frame is replaced
+	pthread_mutex_lock(&mirror.mutex);
+	int index = mirror.reading == 0 ? 1 : 0;
+	if (mirror.published == index)
+		mirror.published = -1;
+	pthread_mutex_unlock(&mirror.mutex);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mirror.fbo);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+	                       mirror.textures[index], 0);
+	glBlitFramebuffer(0, 0, w, h, 0, 0, desktop_width, desktop_height, GL_COLOR_BUFFER_BIT,
+	                  GL_LINEAR);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-static void
-render_line(struct ApplicationState* app, XrVector3f* v1, XrVector3f* v2)
-{
-	XrVector3f v1tov2 = {v2->x - v1->x, v2->y - v1->y, v2->z - v1->z};
-	render_vec(app, &v1tov2, v1);
+	if (mirror.fences[index])
+		glDeleteSync(mirror.fences[index]);
+	mirror.fences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	mirror.copied = index;
 }
 
+// after xrEndFrame(), hands the copy of this frame to the mirror thread
 void
-render_rotated_cube(vec3_t position, float cube_size, float rotation, int modelLoc)
+mirror_publish(void)
 {
-	mat4_t rotationmatrix = m4_rotation_y(degrees_to_radians(rotation));
-	mat4_t modelmatrix = m4_mul(m4_translation(position),
-	                            m4_scaling(vec3(cube_size / 2., cube_size / 2., cube_size / 2.)));
-	modelmatrix = m4_mul(modelmatrix, rotationmatrix);
+	if (mirror.copied < 0)
+		return;
 
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, (float*)modelmatrix.m);
-	glDrawArrays(GL_TRIANGLES, 0, 36);
+	// the mirror thread waits for the fence on its context, it has to reach the GPU first
+	glFlush();
+	pthread_mutex_lock(&mirror.mutex);
+	mirror.published = mirror.copied;
+	pthread_cond_signal(&mirror.changed);
+	pthread_mutex_unlock(&mirror.mutex);
+	mirror.copied = -1;
 }
 
-static void
-visualize_velocity(XrPosef* base,
-                   XrVector3f* linearVelocity,
-                   XrVector3f* angularVelocity,
-                   int modelLoc,
-                   float size)
+// with the rendering context current
+void
+mirror_stop(void)
 {
-	float cube_radius = size / 2;
-	float lin_len = vec3_mag(linearVelocity);
-	float block_radius = lin_len / 2.;
-	XrVector3f lin_direction = vec3_norm(linearVelocity);
-
-#if 0
-	for (float i = 0; i < lin_len / size; i++) {
-		XrVector3f pos = base->position;
-		pos.x += lin_direction.x * size * i;
-		pos.y += lin_direction.y * size * i;
-		pos.z += lin_direction.z * size * i;
-		render_cube(&pos, &identity, cube_radius, modelLoc);
+	if (mirror.running) {
+		pthread_mutex_lock(&mirror.mutex);
+		mirror.quit = true;
+		pthread_cond_signal(&mirror.changed);
+		pthread_mutex_unlock(&mirror.mutex);
+		pthread_join(mirror.thread, NULL);
+		mirror.running = false;
+
+		for (int i = 0; i < MIRROR_TEXTURES; i++) {
+			if (mirror.fences[i])
+				glDeleteSync(mirror.fences[i]);
+		}
+		glDeleteFramebuffers(1, &mirror.fbo);
+		glDeleteTextures(MIRROR_TEXTURES, mirror.textures);
+		pthread_cond_destroy(&mirror.changed);
+		pthread_mutex_destroy(&mirror.mutex);
+	}
+	if (mirror.context) {
+		SDL_GL_DeleteContext(mirror.context);
+		mirror.context = NULL;
+	}
 }
+
 #endif
 
 
-// linear velocity
-#if 1
-	{
-		/* create matrix that translates lin_len / 2. in lin_direction (because
-		 * block origin is in the middle), scales to lin_len in "z" direction and
-		 * rotates in lin_direction. Used as model matrix for unit cube this renders
-		 * a block of length lin_len in lin_direction starting at the base pose.
-		 */
-		vec3_t from = vec3(base->position.x + lin_direction.x * block_radius / 2.,
-		                   base->position.y + lin_direction.y * block_radius / 2.,
-		                   base->position.z + lin_direction.z * block_radius / 2.);
-		vec3_t to = vec3(base->position.x + lin_direction.x, base->position.y + lin_direction.y,
-		                 base->position.z + lin_direction.z);
-		mat4_t look_at = m4_invert_affine(m4_look_at(from, to, vec3(0, 1, 0)));
-
-		mat4_t scale = m4_scaling(vec3(cube_radius, cube_radius, block_radius));
-		look_at = m4_mul(look_at, scale);
-
-		glUniformMatrix4fv(modelLoc, 1, GL_FALSE, (float*)look_at.m);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-	}
-#endif
+// network thread
 
-// angular velocity - block is axis, length is velocity
-#if 0
+static int64_t
+net_now_ns(void)
 {
-vec3_t from = vec3(0, 0, 0);
-vec3_t to = vec3(angularVelocity->x / 2., angularVelocity->y / 2., angularVelocity->z / 2.0);
-mat4_t look_at = m4_invert_affine(m4_look_at(from, to, vec3(0, 1, 0)));
-
-float ang_len = vec3_mag(angularVelocity);
-mat4_t scale = m4_scaling(vec3(cube_radius, cube_radius, ang_len / 2.));
-look_at = m4_mul(look_at, scale);
-
-vec3_t pos = vec3(base->position.x, base->position.y, base->position.z);
-mat4_t model = m4_mul(m4_translation(pos), look_at);
-glUniformMatrix4fv(modelLoc, 1, GL_FALSE, (float*)model.m);
-glDrawArrays(GL_TRIANGLES, 0, 36);
-}
-#endif
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
 }
 
-void
-render_frame(struct ApplicationState* app,
-             int w,
-             int h,
-             struct gl_renderer_t* gl_renderer,
-             uint32_t projection_index,
-             XrTime predictedDisplayTime,
-             int view_index,
-             XrSpaceLocation* hand_locations,
-             struct hand_tracking_t* hand_tracking,
-             XrView* view,
-             GLuint image,
-             bool depth_supported,
-             GLuint depthbuffer)
+// joints_ready: sends the joints in buffer_out to the receiver
+static void
+send_joints(struct reactor_source* source, uint32_t events)
 {
-	GLuint framebuffer = gl_renderer->framebuffers[view_index][projection_index];
-	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-
-	glViewport(0, 0, w, h);
-	glScissor(0, 0, w, h);
-
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, image, 0);
-	if (depth_supported) {
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthbuffer, 0);
-	} else {
-		// TODO: need a depth attachment for depth test when rendering to fbo
+	pthread_mutex_lock(&buffer_mutex);
+	if (atomic_load_explicit(&control.data_ready, memory_order_acquire) == 0) {
+		pthread_mutex_unlock(&buffer_mutex);
+		return;
 	}
+	thread_profile_tick();
 
-	glClearColor(.0f, 0.0f, 0.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	glUseProgram(gl_renderer->shader_program_id);
-
-
-	XrMatrix4x4f projection_matrix;
-	XrMatrix4x4f_CreateProjectionFov(&projection_matrix, GRAPHICS_OPENGL, view->fov,
-	                                 gl_renderer->near_z, gl_renderer->far_z);
-
-	XrMatrix4x4f view_matrix;
-	XrMatrix4x4f_CreateViewMatrix(&view_matrix, &view->pose.position, &view->pose.orientation);
-
-
-	glUniformMatrix4fv(gl_renderer->viewLoc, 1, GL_FALSE, (float*)view_matrix.m);
-	glUniformMatrix4fv(gl_renderer->projLoc, 1, GL_FALSE, (float*)projection_matrix.m);
-
-
-	{
-		// use rectangle VAO
-		glBindVertexArray(gl_renderer->VAOs[1]);
-
-		// render textured rectangle
-		glUniform4f(gl_renderer->colorLoc, 0.0, 0.0, 0.0, 0.0);
-
-		float rectangle_size = 4.05;
-		render_rotated_cube(vec3(0, 0, 0), rectangle_size, 0, gl_renderer->modelLoc);
+	if (!net.joints_sent) {
+		start_time = clock();
+		net.joints_sent = true;
 	}
+	current_time = clock();
+	double elapsed_time = (double)(current_time - start_time) / CLOCKS_PER_SEC;
+	// Send time data first
+	memcpy(buffer_out, &elapsed_time, sizeof(double));
+
+	// never blocks the video, a full socket buffer drops this frame's joints
+	const struct sockaddr* receiver = (const struct sockaddr*)&net.receiver_addr;
+	ssize_t bytes_sent = sendto(net.send_fd, buffer_out, buffer_out_size, MSG_DONTWAIT, receiver,
+	                            sizeof(net.receiver_addr));
+	if (bytes_sent == -1)
+		LOG_WARN("UDP sendto failed: %s\n", strerror(errno));
+
+	atomic_store_explicit(&control.data_ready, 0, memory_order_release);
+	pthread_cond_broadcast(&control.data_ready_changed);
+	pthread_mutex_unlock(&buffer_mutex);
+}
 
-	// use cube VAO
-	glBindVertexArray(gl_renderer->VAOs[0]);
-	// render controllers / hand joints
-	for (int hand = 0; hand < 2; hand++) {
-		if (hand == 0) {
-			glUniform4f(gl_renderer->colorLoc, 1.0, 0.5, 0.5, 1.0);
-		} else {
-			glUniform4f(gl_renderer->colorLoc, 0.5, 1.0, 0.5, 1.0);
-		}
-
-
-		// if at least some joints had valid poses, draw them instead of controller blocks
-		bool any_joints_valid = false;
-
-		struct XrHandJointLocationsEXT* joint_locations = &hand_tracking->joint_locations[hand];
-		if (joint_locations->isActive) {
-			for (uint32_t i = 0; i < joint_locations->jointCount; i++) {
-				struct XrHandJointLocationEXT* joint_location = &joint_locations->jointLocations[i];
-
-				if (!(joint_location->locationFlags & XR_SPACE_LOCATION_POSITION_VALID_BIT)) {
-					// printf("Hand %d Joint %d: Position not valid\n", hand, i);
-					continue;
-				}
-
-				float size = joint_location->radius;
-				render_cube(&joint_location->pose.position, &joint_location->pose.orientation, size,
-				            gl_renderer->modelLoc);
-
-				if (joint_locations->next != NULL) {
-					// we set .next only to null or XrHandJointVelocitiesEXT in main
-					XrHandJointVelocitiesEXT* vel = (XrHandJointVelocitiesEXT*)joint_locations->next;
-					if ((vel->jointVelocities[i].velocityFlags & XR_SPACE_VELOCITY_LINEAR_VALID_BIT) != 0) {
-						visualize_velocity(&joint_location->pose, &vel->jointVelocities[i].linearVelocity,
-						                   &vel->jointVelocities[i].angularVelocity, gl_renderer->modelLoc,
-						                   0.005);
-					} else {
-						printf("Joint velocities %d invalid\n", i);
-					}
-				}
-
-				any_joints_valid = true;
-			}
-		}
-
-
-
-		bool hand_location_valid =
-		    //(spaceLocation[hand].locationFlags & XR_SPACE_LOCATION_POSITION_VALID_BIT) != 0 &&
-		    (hand_locations[hand].locationFlags & XR_SPACE_LOCATION_ORIENTATION_VALID_BIT) != 0;
-		bool aim_location_valid =
-		    //(spaceLocation[hand].locationFlags & XR_SPACE_LOCATION_POSITION_VALID_BIT) != 0 &&
-		    (app->aim_action.pose_locations[hand].locationFlags &
-		     XR_SPACE_LOCATION_ORIENTATION_VALID_BIT) != 0;
-
-		// the controller blocks itself are only drawn if we didn't draw hand joints'
-		if (!any_joints_valid && hand_location_valid) {
-			XrVector3f scale = {.x = .05f, .y = .05f, .z = .2f};
-			render_block(&hand_locations[hand].pose.position, &hand_locations[hand].pose.orientation,
-			             &scale, gl_renderer->modelLoc);
-		}
+// ends the frame being reassembled, publishes it in buffer_in if it is complete
+static void
+finish_video_frame(bool complete)
+{
+	net.receiving = false;
+	reactor_arm_timer(&net.video_timeout, 0, 0);
+
+	if (recorder_active()) {
+		struct rec_video rec = {
+		    .frame_id = net.prev_frame_id + 1,
+		    .status = complete ? REC_VIDEO_COMPLETE : REC_VIDEO_SKIPPED,
+		    .width = textureInfo.width,
+		    .height = textureInfo.height,
+		    .bytes = net.bytes_received,
+		    .first_packet_mono_ns = net.first_packet_ns,
+		};
+		recorder_write(REC_VIDEO, &rec, sizeof(rec));
+	}
+	if (!complete)
+		return;
 
-		if (aim_location_valid) {
-			// always draw an aim pose
-			XrMatrix4x4f aim_model_matrix;
-			XrVector3f aim_model_scale = {.x = 1, .y = 1, .z = 1};
-			XrPosef* aim_pose = &app->aim_action.pose_locations[hand].pose;
-			XrMatrix4x4f_CreateModelMatrix(&aim_model_matrix, &aim_pose->position, &aim_pose->orientation,
-			                               &aim_model_scale);
-
-			XrMatrix4x4f zminus1_matrix;
-			XrMatrix4x4f_CreateTranslation(&zminus1_matrix, 0, 0, -1);
-
-			XrMatrix4x4f aim_zminus1;
-			XrMatrix4x4f_Multiply(&aim_zminus1, &aim_model_matrix, &zminus1_matrix);
-
-			XrVector3f aim_vec = {.x = aim_zminus1.m[12], .y = aim_zminus1.m[13], .z = aim_zminus1.m[14]};
-			glUniform4f(gl_renderer->colorLoc, 1.0, 0.0, 0.0, 0.0);
-			render_line(app, &aim_pose->position, &aim_vec);
-			// render_simple_cube(vec3(aim_vec.x, aim_vec.y, aim_vec.z), vec3(0.1, 0.1, 0.1),
-			// app->gl_renderer.modelLoc);
-		} else if (hand_location_valid && !aim_location_valid) {
-			// printf("Hand location %d valid but not aim location\n", hand);
-		}
+	pthread_mutex_lock(&buffer_mutex);
+	buffer_in = net.frame;
+	buffer_in_size = net.bytes_received;
+	video_frames_received++;
+	pthread_mutex_unlock(&buffer_mutex);
+	net.back_frame = (net.back_frame + 1) % video_pool.config.frame_count;
+	net.prev_frame_id += 1;
+	startup_milestone(STARTUP_FIRST_VIDEO_RECEIVED);
+}
 
+// a TextureInfo header starts the next frame
+static void
+start_video_frame(const GLubyte* data)
+{
+	memcpy(&textureInfo, data, sizeof(TextureInfo));
+	net.first_packet_ns = net_now_ns();
 
+	LOG_DEBUG("Texture info: width = %d, height = %d\n", textureInfo.width, textureInfo.height);
 
-		// controller velocities are always drawn if available
-		if (hand_locations[hand].next != NULL) {
-			// we set .next only to null or XrSpaceVelocity in main
-			XrSpaceVelocity* vel = (XrSpaceVelocity*)hand_locations[hand].next;
-			if ((vel->velocityFlags & XR_SPACE_VELOCITY_LINEAR_VALID_BIT) != 0) {
-				visualize_velocity(&hand_locations[hand].pose, &vel->linearVelocity, &vel->angularVelocity,
-				                   gl_renderer->modelLoc, 0.005);
-			}
-		}
+	if (textureInfo.width <= 0 || textureInfo.height <= 0) {
+		LOG_WARN("Ignoring video frame of %dx%d\n", textureInfo.width, textureInfo.height);
+		return;
 	}
-
-
-	if (app->cube.enabled) {
-		if (app->cube.pos_ts != 0) {
-
-			glUniform4f(app->gl_renderer.colorLoc, 1, 1, 1, 0.0);
-			render_simple_cube(
-			    vec3(app->cube.current_pos.x, app->cube.current_pos.y, app->cube.current_pos.z),
-			    vec3(0.1, 0.1, 0.1), app->gl_renderer.modelLoc);
+	net.bytes_expected = textureInfo.width * textureInfo.height * 3;
+	// only a frame above the configured maximum maps the pool again, the renderer may be reading
+	// the published frame
+	if ((size_t)net.bytes_expected > video_pool.frame_size) {
+		pthread_mutex_lock(&buffer_mutex);
+		bool fits = frame_pool_fit(&video_pool, textureInfo.width, textureInfo.height);
+		buffer_in = fits ? frame_pool_frame(&video_pool, 0) : NULL;
+		buffer_in_size = 0;
+		pthread_mutex_unlock(&buffer_mutex);
+		if (!fits) {
+			printf("Error: could not grow the video frame pool\n");
+			exit(EXIT_FAILURE);
 		}
+		net.back_frame = 1;
 	}
+	// not published, nothing else reads it while it is filled
+	net.frame = frame_pool_frame(&video_pool, net.back_frame);
+	net.bytes_received = 0;
+	net.receiving = true;
+	reactor_arm_timer(&net.video_timeout, VIDEO_FRAME_TIMEOUT_NS, 0);
+}
 
-	glUniform4f(app->gl_renderer.colorLoc, 0, 1, 1, 0.0);
-	if (app->ext.vive_tracker.base.supported) {
-		struct known_vive_tracker* t = app->ext.vive_tracker.trackers;
-		while (t) {
-			if (!t->action.states[0].pose_.isActive) {
-				t = t->next;
-				continue;
-			}
-			if ((t->action.pose_locations->locationFlags & XR_SPACE_LOCATION_ORIENTATION_TRACKED_BIT) ==
-			    0) {
-				t = t->next;
-				continue;
-			}
-
-			XrVector3f scale = {.x = .075f, .y = .075f, .z = .075f};
-			render_block(&t->action.pose_locations[0].pose.position,
-			             &t->action.pose_locations[0].pose.orientation, &scale, gl_renderer->modelLoc);
-			t = t->next;
-		}
+// a payload packet of the frame being reassembled: frame id, then pixels
+static void
+add_video_packet(const GLubyte* data, int bytes)
+{
+	if (bytes < (int)sizeof(GLuint)) {
+		LOG_WARN("Ignoring video packet of %d bytes\n", bytes);
+		return;
 	}
-
-	// blit left eye to desktop window
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	if (view_index == 0) {
-		_glBlitNamedFramebuffer((GLuint)framebuffer,             // readFramebuffer
-		                        (GLuint)0,                       // backbuffer     // drawFramebuffer
-		                        (GLint)0,                        // srcX0
-		                        (GLint)0,                        // srcY0
-		                        (GLint)w,                        // srcX1
-		                        (GLint)h,                        // srcY1
-		                        (GLint)0,                        // dstX0
-		                        (GLint)0,                        // dstY0
-		                        (GLint)w / 2,                    // dstX1
-		                        (GLint)h / 2,                    // dstY1
-		                        (GLbitfield)GL_COLOR_BUFFER_BIT, // mask
-		                        (GLenum)GL_LINEAR);              // filter
-
-		SDL_GL_SwapWindow(desktop_window);
+	GLuint frame_id = 0;
+	memcpy(&frame_id, data, sizeof(GLuint));
+
+	LOG_TRACE("prev_frame_id: %d\n", net.prev_frame_id);
+	LOG_TRACE("frame_id: %d\n", frame_id);
+	if (frame_id != net.prev_frame_id + 1) {
+		LOG_WARN("Error: frame_id is not correct, skipping next 2 frames...\n");
+		finish_video_frame(false);
+		net.prev_frame_id += 2;
+		return;
 	}
-}
-
-void initialize_quad(struct gl_renderer_t* gl_renderer, struct quad_layer_t* quad) {
-    glGenTextures(1, &gl_renderer->quad.texture);
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gl_renderer->quad.texture);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	int width = quad->pixel_width;
-	int height = quad->pixel_height;
-    glViewport(0, 0, width, height);
-    glScissor(0, 0, width, height);
 
-    glGenFramebuffers(1, &gl_renderer->quad.fbo);
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, gl_renderer->quad.fbo);
-    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gl_renderer->quad.texture, 0);
+	int payload_bytes = bytes - 4; // skip the first 4 bytes for frame id
+	if (net.bytes_received + payload_bytes > net.bytes_expected) {
+		printf("Error: Received more than the expected %d bytes\n", net.bytes_expected);
+		exit(EXIT_FAILURE);
+	}
+	memcpy(net.frame + net.bytes_received, data + 4, payload_bytes);
+	net.bytes_received += payload_bytes;
 
-    gl_renderer->quad.initialized = 1;
+	if (net.bytes_received == net.bytes_expected)
+		finish_video_frame(true);
 }
 
-void update_texture(struct gl_renderer_t* gl_renderer, struct quad_layer_t* quad) {
-
-	glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gl_renderer->quad.texture);
-
-	// lock mutex
-	pthread_mutex_lock(&buffer_mutex);
-
-    // Frame is BGR
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, (GLsizei)quad->pixel_width, (GLsizei)quad->pixel_height, 0, GL_BGR, GL_UNSIGNED_BYTE, buffer_in);
-
-	// unlock mutex
-	pthread_mutex_unlock(&buffer_mutex);
-
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, gl_renderer->quad.fbo);
-    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gl_renderer->quad.texture, 0);
+// a header starts a frame, everything else is payload of the frame being reassembled
+static void
+receive_video_datagram(const uint8_t* data, int bytes, void* user)
+{
+	if (net.receiving)
+		add_video_packet(data, bytes);
+	else if (bytes == sizeof(TextureInfo))
+		start_video_frame(data);
 }
 
-void render_quad(struct gl_renderer_t* gl_renderer, struct quad_layer_t* quad, uint32_t swapchain_index, XrTime predictedDisplayTime) {
-    if (!gl_renderer->quad.initialized) {
-        printf("Creating Quad texture\n");
-        //initialize_quad(gl_renderer, quad, "/home/jarvis/thomas/LIS_VR_app/cat.png");
-		initialize_quad(gl_renderer, quad);
-    }
-
-	update_texture(gl_renderer, quad);
-
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, gl_renderer->quad.fbo);
-
-    GLuint texture = quad->swapchain.images[0][swapchain_index].image;
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, quad->pixel_width, quad->pixel_height);
+// video_socket: reads the datagrams that arrived
+static void
+receive_video(struct reactor_source* source, uint32_t events)
+{
+	for (int i = 0; i < VIDEO_PACKETS_PER_WAKEUP; i++) {
+		struct sockaddr_in client_addr;
+		socklen_t addr_len = sizeof(client_addr);
+		ssize_t bytes_received = recvfrom(source->fd, net.recv_buffer, MAX_BUFFER_SIZE, MSG_DONTWAIT,
+		                                  (struct sockaddr*)&client_addr, &addr_len);
+		if (bytes_received == -1) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+				return;
+			perror("recvfrom failed");
+			exit(EXIT_FAILURE);
+		}
 
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		if (!net.receiving && bytes_received == sizeof(TextureInfo))
+			LOG_DEBUG("Received data from %s:%d\n", inet_ntoa(client_addr.sin_addr),
+			          ntohs(client_addr.sin_port));
+		receive_video_datagram(net.recv_buffer, (int)bytes_received, NULL);
+	}
 }
 
-#endif
+// video_ring: the datagrams io_uring received since the last batch
+static void
+receive_video_ring(struct reactor_source* source, uint32_t events)
+{
+	if (recv_ring_consume(&net.ring, receive_video_datagram, NULL) >= 0)
+		return;
 
+	// a kernel before 6.0 rejects the multishot receive with the first completion
+	LOG_WARN("Falling back to recvfrom() for the video\n");
+	reactor_remove(&net.reactor, &net.video_ring);
+	recv_ring_destroy(&net.ring);
+	net.use_ring = false;
+	if (!reactor_add_fd(&net.reactor, &net.video_socket, net.video_fd, EPOLLIN, receive_video,
+	                    NULL)) {
+		printf("Error: could not receive the video\n");
+		exit(EXIT_FAILURE);
+	}
+}
 
-// udp functions
+// video_timeout: the rest of the frame is not coming, the next header starts over
+static void
+drop_video_frame(struct reactor_source* source, uint32_t events)
+{
+	if (!net.receiving)
+		return;
+	LOG_WARN("Video frame %u incomplete after %lld ms, %d of %d bytes, dropping it\n",
+	         net.prev_frame_id + 1, VIDEO_FRAME_TIMEOUT_NS / 1000000, net.bytes_received,
+	         net.bytes_expected);
+	finish_video_frame(false);
+	net.prev_frame_id += 1;
+}
 
-void *udp_receiver(void* arg) {
+// video_watchdog: warns once when the video stops after it started, and when it is back
+static void
+check_video(struct reactor_source* source, uint32_t events)
+{
+	// only this thread writes it
+	uint64_t frames = video_frames_received;
+	bool stalled = frames > 0 && frames == net.watchdog_frames;
+	if (stalled && !net.video_stalled)
+		LOG_WARN("No video frame for %lld s\n", VIDEO_WATCHDOG_NS / 1000000000);
+	else if (!stalled && net.video_stalled)
+		LOG_INFO("Video frames arrive again\n");
+	net.video_stalled = stalled;
+	net.watchdog_frames = frames;
+}
 
-	printf("UDP receiver thread started\n");
+// receives the video frames and sends the joints, both sockets and every timeout multiplexed by
+// one reactor. Sending does not wait for the session, it only happens when the xr thread or the
+// replay notifies joints_ready.
+void*
+net_thread(void* arg)
+{
+	logger_set_thread_name("net");
+	alloc_tracker_set_thread("net");
+	printf("Network thread started\n");
+	int64_t phase_start = startup_now();
 
-	// set up UDP receiver
 	int sockfd;
 	struct sockaddr_in server_addr;
-	struct sockaddr_in* client_addr = malloc(sizeof(struct sockaddr_in));
-	socklen_t addr_len = sizeof(*client_addr);
-	
 
     // Create the socket
-    if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) == -1) {
+    if ((sockfd = net.video_fd = socket(AF_INET, SOCK_DGRAM, 0)) == -1) {
         perror("socket creation failed");
         exit(EXIT_FAILURE);
     }
@@ -3859,242 +4279,84 @@ void *udp_receiver(void* arg) {
         exit(EXIT_FAILURE);
     }
 
-	pthread_mutex_lock(&buffer_mutex);
-    while (!VR_initialized) {
-        pthread_mutex_unlock(&buffer_mutex);
-        // Sleep or perform other tasks while waiting
-        sleep(1);
-        pthread_mutex_lock(&buffer_mutex);
-    }
-    pthread_mutex_unlock(&buffer_mutex);
-
-
-    printf("Waiting for data...\n");
-
-	struct timeval udp_receiver_start_time, udp_receiver_end_time;	
-
-	while (1) {
-
-		gettimeofday(&udp_receiver_start_time, NULL);
-    
-        // Receive data
-        GLubyte recv_buffer[MAX_BUFFER_SIZE];
-        int bytes_received = recvfrom(sockfd, recv_buffer, MAX_BUFFER_SIZE, 0, (struct sockaddr *)client_addr, &addr_len);
-
-        if (bytes_received == -1) {
-            perror("recvfrom failed");
-            exit(EXIT_FAILURE);
-        }
-
-        // Check if recv_buffer is properly allocated
-        if (recv_buffer == NULL) {
-            printf("Error: recvbuffer is NULL\n");
-            return NULL;
-        }
-
-        // Check if client_addr is NULL
-        if (client_addr == NULL) {
-            printf("Error: client_addr is NULL\n");
-            return NULL;
-        }
-        // Check if client_addr is properly initialized
-        if (((struct sockaddr_in*)client_addr)->sin_family != AF_INET) {
-			printf("Error: client_addr is not properly initialized\n");
-			return NULL;
-		}
-
-
-		// lock mutex
-		pthread_mutex_lock(&buffer_mutex);
-
-        if (bytes_received == sizeof(TextureInfo)) {
-            
-            memcpy(&textureInfo, recv_buffer, sizeof(TextureInfo));
-            
-            printf("Received data from %s:%d\n", inet_ntoa(((struct sockaddr_in*)client_addr)->sin_addr), ntohs(((struct sockaddr_in*)client_addr)->sin_port));
-            printf("Texture info: width = %d, height = %d\n", textureInfo.width, textureInfo.height);
-
-            int total_bytes_expected = textureInfo.width * textureInfo.height * 3;
-            buffer_in = (GLubyte*)realloc(buffer_in, total_bytes_expected);
-			//buffer_in = (GLubyte*)realloc(buffer_in, 400000);
-            if (buffer_in == NULL) {
-                perror("realloc failed");
-                exit(EXIT_FAILURE);
-            }
-
-            int total_bytes_received = 0;
-            while (total_bytes_received < total_bytes_expected) {
-                // bytes_received = recvfrom(sockfd, recv_buffer, MIN(MAX_BUFFER_SIZE,total_bytes_expected-total_bytes_received), 0, (struct sockaddr *)client_addr, &addr_len);
-				bytes_received = recvfrom(sockfd, recv_buffer, MAX_BUFFER_SIZE, 0, (struct sockaddr *)client_addr, &addr_len);
-                if (bytes_received == -1) {
-                    perror("recvfrom failed");
-                    exit(EXIT_FAILURE);
-                }
-				GLuint frame_id = 0;
-				memcpy(&frame_id, recv_buffer, sizeof(GLuint));
-				
-				printf("prev_frame_id: %d\n", prev_frame_id);
-				printf("frame_id: %d\n", frame_id);
-				if (frame_id != prev_frame_id + 1) {
-					printf("Error: frame_id is not correct, skipping next 2 frames...\n");
-					skip_frame_count = 1;
-					break;
-				}
-				// if (skip_frame_count >= 1) {
-				// 	skip_frame_count += 1;
-				// 	break;
-				// }
-
-				// printf("Size of total_bytes_expected (buffer_in size): %d\n", total_bytes_expected);
-				// printf("Value of total_bytes_received: %d\n", total_bytes_received);
-				// printf("Value of bytes_received: %d\n", bytes_received);
-				// printf("\n");
-
-                memcpy(buffer_in + total_bytes_received, recv_buffer + 4, bytes_received); // skip the first 4 bytes for frame id
-                total_bytes_received += bytes_received - 4;
-            }
-            
-			if (skip_frame_count == 0) {
-				// After receiving all the data, check if you've received the expected amount of data
-				if (total_bytes_received != textureInfo.width * textureInfo.height * 3) {
-					printf("Error: Received %d bytes, expected %d bytes\n", total_bytes_received, textureInfo.width * textureInfo.height * 3);
-					free(buffer_in);
-					exit(EXIT_FAILURE);
-				} else {
-					// printf("Received %d bytes\n", total_bytes_received);
-					buffer_in_size = total_bytes_received;
-				}
-
-				prev_frame_id += 1;
-				// printf("Received one frame!\n");
-
-			} else if (skip_frame_count == 1) {
-				prev_frame_id += 2;
-				skip_frame_count = 0;
-			}
-			// } else if (skip_frame_count == 2) {
-			// 	prev_frame_id += 1;
-			// 	skip_frame_count = 0;
-			//}
-        }
-
-
-		// unlock mutex
-		pthread_mutex_unlock(&buffer_mutex);
-
-		gettimeofday(&udp_receiver_end_time, NULL);
-		double elapsed_time = (udp_receiver_end_time.tv_sec - udp_receiver_start_time.tv_sec) +
-                   (udp_receiver_end_time.tv_usec - udp_receiver_start_time.tv_usec) / 1000000.0;
-		// printf("UDP receiver loop duration: %f\n", elapsed_time);
-
-	}
-
-	free(client_addr);
-
-    return NULL;
-}
-
-
-// UDP sender thread function
-void* udp_sender(void* arg) {
-
-	printf("UDP sender thread started\n");
-    int sockfd;
-    struct sockaddr_in receiverAddr;
-
     // Create UDP socket
-    if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) == -1) {
+    if ((net.send_fd = socket(AF_INET, SOCK_DGRAM, 0)) == -1) {
         perror("Socket creation failed");
         exit(EXIT_FAILURE);
     }
 
     // Initialize receiver address
-    memset(&receiverAddr, 0, sizeof(receiverAddr));
-    receiverAddr.sin_family = AF_INET;
-    receiverAddr.sin_port = htons(SENDER_PORT);
-    if (inet_pton(AF_INET, RECEIVER_IP, &receiverAddr.sin_addr) != 1) {
+    memset(&net.receiver_addr, 0, sizeof(net.receiver_addr));
+    net.receiver_addr.sin_family = AF_INET;
+    net.receiver_addr.sin_port = htons(SENDER_PORT);
+    if (inet_pton(AF_INET, RECEIVER_IP, &net.receiver_addr.sin_addr) != 1) {
         perror("Invalid receiver IP address");
         exit(EXIT_FAILURE);
     }
+	phase_start = startup_phase("net: sockets", phase_start);
 
+	// the pool is mapped and faulted in now so receiving never allocates. Receiving does not wait for
+	// the session, a frame that arrives during OpenXR setup is shown with the first submitted frame.
+	startup_wait(STARTUP_GATE_OPTIONS);
+	thread_profile_start(THREAD_ROLE_NET);
 	pthread_mutex_lock(&buffer_mutex);
-    while (!VR_initialized) {
-        pthread_mutex_unlock(&buffer_mutex);
-        // Sleep or perform other tasks while waiting
-        usleep(100000);
-        pthread_mutex_lock(&buffer_mutex);
-    }
-    pthread_mutex_unlock(&buffer_mutex);
-
-
-	struct timeval udp_sender_start_time, udp_sender_end_time;
-
-	double elapsed_time = 0.0;
-	start_time = clock();
-
-    while (1) {
-
-		if (data_ready == 0) {
-			continue;
-		}
-
-		current_time = clock();
-		elapsed_time = (double)(current_time - start_time) / CLOCKS_PER_SEC;
-		// printf("Elapsed time: %f\n", elapsed_time);
-
-		pthread_mutex_lock(&buffer_mutex);
-
-		// printf("Accessing buffer_out\n");
-
-		gettimeofday(&udp_sender_start_time, NULL);
-
-		// Send time data first
-		memcpy(buffer_out, &elapsed_time, sizeof(double));
-
-		// Send jointBuffer over UDP
-		ssize_t bytesSent = sendto(sockfd, buffer_out, buffer_out_size, 0,
-								(const struct sockaddr*)&receiverAddr, sizeof(receiverAddr));
-
-		if (bytesSent == -1) {
-			perror("UDP sendto failed");
-			// Handle error as needed
-		} else {
-			// printf("Sent %ld bytes\n", bytesSent);
-		}
-
-		// printf("Released buffer_out\n");
-
-		gettimeofday(&udp_sender_end_time, NULL);
-		double elapsed_time = (udp_sender_end_time.tv_sec - udp_sender_start_time.tv_sec) +
-                   (udp_sender_end_time.tv_usec - udp_sender_start_time.tv_usec) / 1000000.0;
-		// printf("UDP sender loop duration: %f\n", elapsed_time);
-
-		data_ready = 0;
-
-		pthread_mutex_unlock(&buffer_mutex);
+	if (!frame_pool_init(&video_pool, &video_pool_config)) {
+		printf("Error: could not allocate the video frame pool\n");
+		exit(EXIT_FAILURE);
+	}
+	// an empty (black) frame until the first one arrives
+	buffer_in = frame_pool_frame(&video_pool, 0);
+	pthread_mutex_unlock(&buffer_mutex);
+	net.back_frame = 1;
+	phase_start = startup_phase("net: frame pool", phase_start);
+
+	// the receive buffers come from a frame pool with the same pages as the video frames
+	net.use_ring = video_recv_ring && recv_ring_init(&net.ring, sockfd, VIDEO_RING_BUFFERS,
+	                                                 video_pool_config.pages, video_pool_config.lock);
+	LOG_INFO("Receiving the video with %s\n", net.use_ring ? "io_uring" : "recvfrom()");
+	startup_phase("net: receive ring", phase_start);
+
+	bool receiving = net.use_ring ? reactor_add_fd(&net.reactor, &net.video_ring, net.ring.ring_fd,
+	                                               EPOLLIN, receive_video_ring, NULL)
+	                              : reactor_add_fd(&net.reactor, &net.video_socket, sockfd, EPOLLIN,
+	                                               receive_video, NULL);
+	if (!receiving || !reactor_add_timer(&net.reactor, &net.video_timeout, drop_video_frame, NULL) ||
+	    !reactor_add_timer(&net.reactor, &net.video_watchdog, check_video, NULL) ||
+	    !reactor_arm_timer(&net.video_watchdog, VIDEO_WATCHDOG_NS, VIDEO_WATCHDOG_NS)) {
+		printf("Error: could not set up the network reactor\n");
+		exit(EXIT_FAILURE);
+	}
 
-		usleep(1000);
+    printf("Waiting for data...\n");
+	reactor_run(&net.reactor);
 
-		if (closing_app == 1) {
-			break;
-		}
+	reactor_remove(&net.reactor, &net.video_watchdog);
+	reactor_remove(&net.reactor, &net.video_timeout);
+	if (net.use_ring) {
+		reactor_remove(&net.reactor, &net.video_ring);
+		recv_ring_destroy(&net.ring);
+	} else {
+		reactor_remove(&net.reactor, &net.video_socket);
 	}
-
-	// Close the socket (not reached in this example)
 	close(sockfd);
-
+	close(net.send_fd);
 	return NULL;
-
 }
 
 
 
 
-
 // Main function with threads	
 
 int main(int argc, char** argv) {
 
+	startup_init();
+
+	// hot threads log through per-thread rings, written out by a background thread
+	if (!logger_init()) {
+		exit(EXIT_FAILURE);
+	}
+
 	// Initialize buffer_out
 	buffer_out_size = sizeof(double) + HAND_COUNT * XR_HAND_JOINT_COUNT_EXT * sizeof(JointData);
     buffer_out = (GLubyte*)malloc(buffer_out_size);
@@ -4105,15 +4367,22 @@ int main(int argc, char** argv) {
     }
 
 	pthread_mutex_init(&buffer_mutex, NULL);
+
+	// before the threads start, the xr thread may notify joints_ready before the network thread
+	// runs the reactor
+	if (!reactor_init(&net.reactor) ||
+	    !reactor_add_notifier(&net.reactor, &net.joints_ready, send_joints, NULL)) {
+		exit(EXIT_FAILURE);
+	}
 	
-	pthread_t mainLoopThreadId, udpReceiverThreadId, udpSenderThreadId;
+	pthread_t mainLoopThreadId, netThreadId;
 
 	struct MainArgs mainArgs;
     mainArgs.argc = argc;
     mainArgs.argv = argv;
 
-	if (pthread_create(&udpReceiverThreadId, NULL, udp_receiver, NULL) != 0) {
-        perror("pthread_create for udp receiver failed");
+	if (pthread_create(&netThreadId, NULL, net_thread, NULL) != 0) {
+        perror("pthread_create for the network thread failed");
         exit(EXIT_FAILURE);
     }
 
@@ -4122,18 +4391,38 @@ int main(int argc, char** argv) {
         exit(EXIT_FAILURE);
     }
 
-	if (pthread_create(&udpSenderThreadId, NULL, udp_sender, NULL) != 0) {
-        perror("pthread_create for udp sender failed");
-        exit(EXIT_FAILURE);
-    }
-
 	if (pthread_join(mainLoopThreadId, NULL) != 0) {
 		perror("pthread_join for main loop failed");
 		exit(EXIT_FAILURE);
 	}
+	// a replay only returns once its last joints were sent
+	reactor_stop(&net.reactor);
+	pthread_join(netThreadId, NULL);
+	reactor_remove(&net.reactor, &net.joints_ready);
+	reactor_destroy(&net.reactor);
+
+	startup_print();
+
+	// more than one allocation means a frame above --videopool arrived
+	pthread_mutex_lock(&buffer_mutex);
+	printf("Video frame pool: %llu frames received, %u allocations\n",
+	       (unsigned long long)video_frames_received, video_pool.allocations);
+	pthread_mutex_unlock(&buffer_mutex);
+	// the network thread has exited
+	if (net.use_ring)
+		printf("Video receive: io_uring, %llu datagrams in %llu batches, %llu re-arms\n",
+		       (unsigned long long)net.ring.datagrams, (unsigned long long)net.ring.batches,
+		       (unsigned long long)net.ring.rearms);
+	else
+		printf("Video receive: recvfrom()\n");
+
+	alloc_tracker_print();
+	thread_profile_print();
 
 	free(buffer_out);
 
 	pthread_mutex_destroy(&buffer_mutex);
 
+	logger_shutdown();
+
 }
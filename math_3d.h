@@ -25,6 +25,13 @@ QUICK NOTES
   the 16 SSE2 registers anyway. If profiling shows significant slowdowns the
   matrix type might change but ease of use is more important than every last
   percent of performance.
+- On x86-64 (SSE2) and AArch64 (NEON) `mat4_t` also holds its columns as 4
+  wide vectors and is 16 byte aligned. `m4_mul()`, `m4_invert_affine()`,
+  `m4_look_at()` and `m4_mul_pos()` then use them; the scalar code stays
+  available as `m4_mul_scalar()` etc. and is used everywhere when
+  MATH_3D_NO_SIMD is defined. The vector code performs the same floating
+  point operations in the same order, so both give the same results up to
+  the sign of zeros (unless the compiler fuses multiply-adds).
 - When combining matrices with multiplication the effects apply right to left.
   This is the convention used in mathematics and OpenGL. Source:
   https://en.wikipedia.org/wiki/Transformation_matrix#Composing_and_inverting_transformations
@@ -78,6 +85,16 @@ v1.0  2016-02-15  Initial release
 #include <math.h>
 #include <stdio.h>
 
+#if !defined(MATH_3D_NO_SIMD) && defined(__SSE2__)
+#define MATH_3D_SIMD
+#define MATH_3D_SSE
+#include <emmintrin.h>
+#elif !defined(MATH_3D_NO_SIMD) && defined(__ARM_NEON) && defined(__aarch64__)
+#define MATH_3D_SIMD
+#define MATH_3D_NEON
+#include <arm_neon.h>
+#endif
+
 
 // Define PI directly because we would need to define the _BSD_SOURCE or
 // _XOPEN_SOURCE feature test macros to get it from math.h. That would be a
@@ -219,6 +236,12 @@ typedef union {
 		float m20, m21, m22, m23;
 		float m30, m31, m32, m33;
 	};
+#if defined(MATH_3D_SSE)
+	// the columns, also makes the matrix 16 byte aligned
+	__m128 col[4];
+#elif defined(MATH_3D_NEON)
+	float32x4_t col[4];
+#endif
 } mat4_t;
 
 static inline mat4_t
@@ -275,6 +298,16 @@ mat4_t
 m4_invert_affine(mat4_t matrix);
 vec3_t
 m4_mul_pos(mat4_t matrix, vec3_t position);
+
+// scalar reference versions of the functions that have vector implementations
+static inline mat4_t
+m4_mul_scalar(mat4_t a, mat4_t b);
+mat4_t
+m4_invert_affine_scalar(mat4_t matrix);
+mat4_t
+m4_look_at_scalar(vec3_t from, vec3_t to, vec3_t up);
+vec3_t
+m4_mul_pos_scalar(mat4_t matrix, vec3_t position);
 vec3_t
 m4_mul_dir(mat4_t matrix, vec3_t direction);
 
@@ -442,7 +475,7 @@ m4_transpose(mat4_t matrix)
  * columns.
  */
 static inline mat4_t
-m4_mul(mat4_t a, mat4_t b)
+m4_mul_scalar(mat4_t a, mat4_t b)
 {
 	mat4_t result;
 
@@ -459,6 +492,93 @@ m4_mul(mat4_t a, mat4_t b)
 	return result;
 }
 
+
+//
+// 4 wide vector helpers for the SIMD implementations. The w component of
+// vectors made from a vec3_t is 0.
+//
+
+#if defined(MATH_3D_SSE)
+typedef __m128 m3d_v4_t;
+#define m3d_add _mm_add_ps
+#define m3d_sub _mm_sub_ps
+#define m3d_mul _mm_mul_ps
+#define m3d_div _mm_div_ps
+#define m3d_splat _mm_set1_ps
+#define m3d_store _mm_storeu_ps
+static inline m3d_v4_t
+m3d_set(float x, float y, float z, float w)
+{
+	return _mm_setr_ps(x, y, z, w);
+}
+static inline m3d_v4_t
+m3d_yzx(m3d_v4_t v)
+{
+	return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1));
+}
+static inline m3d_v4_t
+m3d_neg(m3d_v4_t v)
+{
+	return _mm_xor_ps(v, _mm_set1_ps(-0.0f));
+}
+#elif defined(MATH_3D_NEON)
+typedef float32x4_t m3d_v4_t;
+#define m3d_add vaddq_f32
+#define m3d_sub vsubq_f32
+#define m3d_mul vmulq_f32
+#define m3d_div vdivq_f32
+#define m3d_splat vdupq_n_f32
+#define m3d_store vst1q_f32
+#define m3d_neg vnegq_f32
+static inline m3d_v4_t
+m3d_set(float x, float y, float z, float w)
+{
+	float v[4] = {x, y, z, w};
+	return vld1q_f32(v);
+}
+// w of the result is y of v
+static inline m3d_v4_t
+m3d_yzx(m3d_v4_t v)
+{
+	return vcombine_f32(vext_f32(vget_low_f32(v), vget_high_f32(v), 1), vget_low_f32(v));
+}
+#endif
+
+#ifdef MATH_3D_SIMD
+static inline m3d_v4_t
+m3d_vec3(vec3_t v)
+{
+	return m3d_set(v.x, v.y, v.z, 0);
+}
+
+// x, y and z are the same as v3_cross(), w is undefined
+static inline m3d_v4_t
+m3d_cross(m3d_v4_t a, m3d_v4_t b)
+{
+	// a * b.yzx - a.yzx * b is the cross product in zxy order
+	return m3d_yzx(m3d_sub(m3d_mul(a, m3d_yzx(b)), m3d_mul(m3d_yzx(a), b)));
+}
+#endif
+
+static inline mat4_t
+m4_mul(mat4_t a, mat4_t b)
+{
+#ifdef MATH_3D_SIMD
+	// column i of the result is a times column i of b, summed in the same
+	// order as in m4_mul_scalar()
+	mat4_t result;
+	for (int i = 0; i < 4; i++) {
+		m3d_v4_t sum = m3d_mul(a.col[0], m3d_splat(b.m[i][0]));
+		sum = m3d_add(sum, m3d_mul(a.col[1], m3d_splat(b.m[i][1])));
+		sum = m3d_add(sum, m3d_mul(a.col[2], m3d_splat(b.m[i][2])));
+		result.col[i] = m3d_add(sum, m3d_mul(a.col[3], m3d_splat(b.m[i][3])));
+	}
+	return result;
+#else
+	return m4_mul_scalar(a, b);
+#endif
+}
+
 #endif // MATH_3D_HEADER
 
 
@@ -594,7 +714,7 @@ m4_perspective(float vertical_field_of_view_in_deg,
  * multiplications.
  */
 mat4_t
-m4_look_at(vec3_t from, vec3_t to, vec3_t up)
+m4_look_at_scalar(vec3_t from, vec3_t to, vec3_t up)
 {
 	vec3_t z = v3_muls(v3_norm(v3_sub(to, from)), -1);
 	vec3_t x = v3_norm(v3_cross(up, z));
@@ -636,7 +756,7 @@ m4_look_at(vec3_t from, vec3_t to, vec3_t up)
  * https://www.khanacademy.org/math/precalculus/precalc-matrices/determinants-and-inverses-of-large-matrices/v/inverting-3x3-part-2-determinant-and-adjugate-of-a-matrix
  */
 mat4_t
-m4_invert_affine(mat4_t matrix)
+m4_invert_affine_scalar(mat4_t matrix)
 {
 	// Create shorthands to access matrix members
 	float m00 = matrix.m00, m10 = matrix.m10, m20 = matrix.m20, m30 = matrix.m30;
@@ -678,7 +798,7 @@ m4_invert_affine(mat4_t matrix)
  * dividing through the 4th component (if it's not 0 or 1).
  */
 vec3_t
-m4_mul_pos(mat4_t matrix, vec3_t position)
+m4_mul_pos_scalar(mat4_t matrix, vec3_t position)
 {
 	vec3_t result = vec3(
 	    matrix.m00 * position.x + matrix.m10 * position.y + matrix.m20 * position.z + matrix.m30,
@@ -693,6 +813,113 @@ m4_mul_pos(mat4_t matrix, vec3_t position)
 	return result;
 }
 
+
+//
+// SIMD versions of m4_look_at(), m4_invert_affine() and m4_mul_pos(). They
+// follow the scalar code above step by step, see there for the math.
+//
+
+#ifdef MATH_3D_SIMD
+static inline m3d_v4_t
+m3d_norm3(m3d_v4_t v)
+{
+	float f[4];
+	m3d_store(f, v);
+	float len = sqrtf(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+	if (len > 0)
+		return m3d_div(v, m3d_splat(len));
+	else
+		return m3d_splat(0);
+}
+#endif
+
+mat4_t
+m4_look_at(vec3_t from, vec3_t to, vec3_t up)
+{
+#ifdef MATH_3D_SIMD
+	m3d_v4_t z = m3d_mul(m3d_norm3(m3d_vec3(v3_sub(to, from))), m3d_splat(-1));
+	m3d_v4_t x = m3d_norm3(m3d_cross(m3d_vec3(up), z));
+	m3d_v4_t y = m3d_cross(z, x);
+
+	float xs[4], ys[4], zs[4];
+	m3d_store(xs, x);
+	m3d_store(ys, y);
+	m3d_store(zs, z);
+
+	mat4_t result;
+	result.col[0] = m3d_set(xs[0], ys[0], zs[0], 0);
+	result.col[1] = m3d_set(xs[1], ys[1], zs[1], 0);
+	result.col[2] = m3d_set(xs[2], ys[2], zs[2], 0);
+	result.col[3] = m3d_set(-(from.x * xs[0] + from.y * xs[1] + from.z * xs[2]),
+	                        -(from.x * ys[0] + from.y * ys[1] + from.z * ys[2]),
+	                        -(from.x * zs[0] + from.y * zs[1] + from.z * zs[2]), 1);
+	return result;
+#else
+	return m4_look_at_scalar(from, to, up);
+#endif
+}
+
+mat4_t
+m4_invert_affine(mat4_t matrix)
+{
+#ifdef MATH_3D_SIMD
+	// The rows of the cofactor matrix of R are cross products of its columns
+	// (the w components of the columns are ignored by the cross product).
+	m3d_v4_t c0 = m3d_cross(matrix.col[1], matrix.col[2]);
+	m3d_v4_t c1 = m3d_cross(matrix.col[2], matrix.col[0]);
+	m3d_v4_t c2 = m3d_cross(matrix.col[0], matrix.col[1]);
+
+	float r0[4], r1[4], r2[4];
+	m3d_store(r0, c0);
+	m3d_store(r1, c1);
+	m3d_store(r2, c2);
+
+	float det = matrix.m00 * r0[0] + matrix.m10 * r1[0] + matrix.m20 * r2[0];
+	if (fabsf(det) < 0.00001)
+		return m4_identity();
+
+	// the inverse of R is the transposed cofactor matrix divided by the determinant
+	m3d_v4_t d = m3d_splat(det);
+	m3d_v4_t i0 = m3d_div(m3d_set(r0[0], r1[0], r2[0], 0), d);
+	m3d_v4_t i1 = m3d_div(m3d_set(r0[1], r1[1], r2[1], 0), d);
+	m3d_v4_t i2 = m3d_div(m3d_set(r0[2], r1[2], r2[2], 0), d);
+
+	m3d_v4_t t = m3d_mul(i0, m3d_splat(matrix.m30));
+	t = m3d_add(t, m3d_mul(i1, m3d_splat(matrix.m31)));
+	t = m3d_add(t, m3d_mul(i2, m3d_splat(matrix.m32)));
+
+	mat4_t result;
+	result.col[0] = i0;
+	result.col[1] = i1;
+	result.col[2] = i2;
+	result.col[3] = m3d_neg(t);
+	result.m33 = 1;
+	return result;
+#else
+	return m4_invert_affine_scalar(matrix);
+#endif
+}
+
+vec3_t
+m4_mul_pos(mat4_t matrix, vec3_t position)
+{
+#ifdef MATH_3D_SIMD
+	m3d_v4_t r = m3d_mul(matrix.col[0], m3d_splat(position.x));
+	r = m3d_add(r, m3d_mul(matrix.col[1], m3d_splat(position.y)));
+	r = m3d_add(r, m3d_mul(matrix.col[2], m3d_splat(position.z)));
+	r = m3d_add(r, matrix.col[3]);
+
+	float v[4];
+	m3d_store(v, r);
+	if (v[3] != 0 && v[3] != 1)
+		return vec3(v[0] / v[3], v[1] / v[3], v[2] / v[3]);
+
+	return vec3(v[0], v[1], v[2]);
+#else
+	return m4_mul_pos_scalar(matrix, position);
+#endif
+}
+
 /**
  * Multiplies a 4x4 matrix with a 3D vector representing a direction in 3D
  * space.
@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Compares the SIMD and the scalar reference implementation of math_3d.h.
+ *
+ * Runs the sequences of math_3d.h calls the renderer makes per item on random inputs, once with
+ * m4_mul(), m4_invert_affine(), m4_look_at() and m4_mul_pos() and once with their *_scalar()
+ * reference versions. The results of both are compared first (exit code 1 on a difference), then
+ * each call mix is timed.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#define MATH_3D_IMPLEMENTATION
+#include "math_3d.h"
+
+// items per iteration, the joints of two hands
+#define ITEM_COUNT 52
+
+struct item
+{
+	vec3_t position;
+	vec3_t direction;
+	float size;
+};
+
+static int64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static float
+random_float(float min, float max)
+{
+	return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+// the call mixes, instantiated for the SIMD and the scalar functions
+#define DEFINE_MIXES(suffix, MUL, INVERT_AFFINE, LOOK_AT, MUL_POS)                                 \
+	/* render_vec(): a block from start along a vector */                                            \
+	static mat4_t mix_vec_##suffix(const struct item* it)                                            \
+	{                                                                                                \
+		float len = v3_length(it->direction);                                                          \
+		mat4_t m = m4_identity();                                                                      \
+		m = MUL(m, m4_translation(vec3(0, 0, -len / 2.f)));                                            \
+		m = MUL(m, m4_scaling(vec3(0.005f, 0.005f, len)));                                             \
+		m = MUL(m4_rotation(0.3f, it->direction), m);                                                  \
+		return MUL(m4_translation(it->position), m);                                                   \
+	}                                                                                                \
+	/* visualize_velocity(): inverted look at matrix, scaled along the velocity */                   \
+	static mat4_t mix_velocity_##suffix(const struct item* it)                                       \
+	{                                                                                                \
+		vec3_t to = v3_add(it->position, it->direction);                                               \
+		mat4_t look_at = INVERT_AFFINE(LOOK_AT(it->position, to, vec3(0, 1, 0)));                      \
+		return MUL(look_at, m4_scaling(vec3(it->size, it->size, v3_length(it->direction))));           \
+	}                                                                                                \
+	/* render_rotated_rectangle() */                                                                 \
+	static mat4_t mix_rectangle_##suffix(const struct item* it)                                      \
+	{                                                                                                \
+		vec3_t scale = vec3(it->size, it->size, it->size);                                             \
+		mat4_t m = MUL(m4_translation(it->position), m4_scaling(scale));                               \
+		return MUL(m, m4_rotation_y(it->size));                                                        \
+	}                                                                                                \
+	/* a point through a model matrix, stored in the translation */                                  \
+	static mat4_t mix_mul_pos_##suffix(const struct item* it)                                        \
+	{                                                                                                \
+		mat4_t m = MUL(m4_translation(it->position), m4_rotation_y(it->size));                         \
+		return m4_translation(MUL_POS(m, it->direction));                                              \
+	}
+
+DEFINE_MIXES(simd, m4_mul, m4_invert_affine, m4_look_at, m4_mul_pos)
+DEFINE_MIXES(scalar, m4_mul_scalar, m4_invert_affine_scalar, m4_look_at_scalar, m4_mul_pos_scalar)
+
+struct mix
+{
+	const char* name;
+	mat4_t (*simd)(const struct item* it);
+	mat4_t (*scalar)(const struct item* it);
+};
+
+static const struct mix mixes[] = {
+    {"render_vec", mix_vec_simd, mix_vec_scalar},
+    {"velocity", mix_velocity_simd, mix_velocity_scalar},
+    {"rectangle", mix_rectangle_simd, mix_rectangle_scalar},
+    {"mul_pos", mix_mul_pos_simd, mix_mul_pos_scalar},
+};
+
+#define MIX_COUNT (sizeof(mixes) / sizeof(mixes[0]))
+
+// the same operations in the same order, only zero signs and fused multiply-adds may differ
+static bool
+check_mix(const struct mix* mix, const struct item* items)
+{
+	float max_error = 0;
+	for (int i = 0; i < ITEM_COUNT; i++) {
+		mat4_t a = mix->simd(&items[i]);
+		mat4_t b = mix->scalar(&items[i]);
+		for (int j = 0; j < 16; j++) {
+			float error = fabsf(a.m[j / 4][j % 4] - b.m[j / 4][j % 4]);
+			if (error > max_error)
+				max_error = error;
+		}
+	}
+	bool ok = max_error <= 1e-5f;
+	printf("check %-10s max error %g %s\n", mix->name, max_error, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+static double
+time_mix(mat4_t (*fn)(const struct item* it), const struct item* items, int iterations)
+{
+	static mat4_t results[ITEM_COUNT];
+	int64_t start = now_ns();
+	for (int it = 0; it < iterations; it++) {
+		for (int i = 0; i < ITEM_COUNT; i++)
+			results[i] = fn(&items[i]);
+		__asm__ volatile("" : : "r"(results) : "memory");
+	}
+	return (double)(now_ns() - start) / ((double)iterations * ITEM_COUNT);
+}
+
+int
+main(int argc, char** argv)
+{
+	int iterations = 100000;
+
+	static struct option long_options[] = {{"iterations", required_argument, 0, 'i'},
+	                                       {"help", no_argument, 0, 'h'},
+	                                       {0, 0, 0, 0}};
+	int opt;
+	while ((opt = getopt_long(argc, argv, "i:h", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'i': iterations = atoi(optarg); break;
+		case 'h':
+		default:
+			printf("Usage: %s [--iterations N]\n", argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if (iterations <= 0) {
+		printf("--iterations must be positive\n");
+		return 1;
+	}
+
+#if defined(MATH_3D_SSE)
+	printf("math_3d.h backend: SSE\n");
+#elif defined(MATH_3D_NEON)
+	printf("math_3d.h backend: NEON\n");
+#else
+	printf("math_3d.h backend: scalar\n");
+#endif
+
+	srand(1);
+	struct item items[ITEM_COUNT];
+	for (int i = 0; i < ITEM_COUNT; i++) {
+		items[i].position = vec3(random_float(-1, 1), random_float(0, 2), random_float(-1, 1));
+		items[i].direction = vec3(random_float(-1, 1), random_float(-1, 1), random_float(-1, 1));
+		items[i].size = random_float(0.005f, 0.05f);
+	}
+
+	bool ok = true;
+	for (size_t m = 0; m < MIX_COUNT; m++)
+		ok = check_mix(&mixes[m], items) && ok;
+
+	for (size_t m = 0; m < MIX_COUNT; m++) {
+		double scalar_ns = time_mix(mixes[m].scalar, items, iterations);
+		double simd_ns = time_mix(mixes[m].simd, items, iterations);
+		printf("%-10s scalar %7.2f ns  simd %7.2f ns  %5.2fx\n", mixes[m].name, scalar_ns, simd_ns,
+		       scalar_ns / simd_ns);
+	}
+
+	return ok ? 0 : 1;
+}
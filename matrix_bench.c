@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Checks and benchmarks the XrMatrix4x4f_CreateModelMatrices() kernels.
+ *
+ * Every kernel supported by the CPU is first compared against XrMatrix4x4f_CreateModelMatrix() on
+ * random poses for all batch sizes up to 64, so the vector loops and the scalar tails are both
+ * covered; the program exits with 1 on a mismatch. Then each kernel is timed on batches of
+ * --count poses, by default the joints of two hands.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "xr_linear_batch.h"
+
+#define CHECK_MAX_COUNT 64
+
+static int64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static float
+random_float(float min, float max)
+{
+	return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+static void
+random_poses(XrPosef* poses, XrVector3f* scales, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		XrQuaternionf q = {random_float(-1, 1), random_float(-1, 1), random_float(-1, 1),
+		                   random_float(-1, 1)};
+		float len = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+		if (len < 1e-3f)
+			q = (XrQuaternionf){0, 0, 0, 1};
+		else
+			q = (XrQuaternionf){q.x / len, q.y / len, q.z / len, q.w / len};
+		poses[i].orientation = q;
+		poses[i].position = (XrVector3f){random_float(-2, 2), random_float(-2, 2), random_float(-2, 2)};
+		scales[i] = (XrVector3f){random_float(.001f, .1f), random_float(.001f, .1f),
+		                         random_float(.001f, .1f)};
+	}
+}
+
+// the kernels compute the same operations as the scalar code, only the sign of zeros may differ
+static bool
+check_level(enum xr_simd_level level)
+{
+	XrPosef poses[CHECK_MAX_COUNT];
+	XrVector3f scales[CHECK_MAX_COUNT];
+	XrMatrix4x4f expected[CHECK_MAX_COUNT];
+	XrMatrix4x4f results[CHECK_MAX_COUNT + 1];
+
+	XrMatrix4x4f_SetSimdLevel(level);
+	for (uint32_t count = 0; count <= CHECK_MAX_COUNT; count++) {
+		random_poses(poses, scales, count);
+		for (uint32_t i = 0; i < count; i++)
+			XrMatrix4x4f_CreateModelMatrix(&expected[i], &poses[i].position, &poses[i].orientation,
+			                               &scales[i]);
+
+		// the matrix behind the batch must not be written
+		memset(results, 0xff, sizeof(results));
+		XrMatrix4x4f_CreateModelMatrices(results, poses, scales, count);
+
+		for (uint32_t i = 0; i < count; i++) {
+			for (int j = 0; j < 16; j++) {
+				if (results[i].m[j] != expected[i].m[j]) {
+					printf("%s: count %u, matrix %u, element %d: %.9g, expected %.9g\n",
+					       xr_simd_level_name(level), count, i, j, results[i].m[j], expected[i].m[j]);
+					return false;
+				}
+			}
+		}
+		uint32_t canary;
+		memcpy(&canary, &results[count].m[0], sizeof(canary));
+		if (canary != 0xffffffff) {
+			printf("%s: count %u, wrote past the last matrix\n", xr_simd_level_name(level), count);
+			return false;
+		}
+	}
+	return true;
+}
+
+int
+main(int argc, char** argv)
+{
+	int count = 2 * XR_HAND_JOINT_COUNT_EXT;
+	int iterations = 200000;
+
+	static struct option long_options[] = {{"count", required_argument, 0, 'n'},
+	                                       {"iterations", required_argument, 0, 'i'},
+	                                       {"help", no_argument, 0, 'h'},
+	                                       {0, 0, 0, 0}};
+	int opt;
+	while ((opt = getopt_long(argc, argv, "n:i:h", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'n': count = atoi(optarg); break;
+		case 'i': iterations = atoi(optarg); break;
+		case 'h':
+		default:
+			printf("Usage: %s [--count N] [--iterations N]\n", argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if (count <= 0 || iterations <= 0) {
+		printf("--count and --iterations must be positive\n");
+		return 1;
+	}
+
+	enum xr_simd_level best = XrMatrix4x4f_DetectSimdLevel();
+	printf("Detected: %s, default: %s\n", xr_simd_level_name(best),
+	       xr_simd_level_name(XrMatrix4x4f_DefaultSimdLevel()));
+
+	srand(1);
+	bool ok = true;
+	for (enum xr_simd_level level = XR_SIMD_SCALAR; level <= best; level++) {
+		bool level_ok = check_level(level);
+		printf("check %-6s %s\n", xr_simd_level_name(level), level_ok ? "ok" : "FAILED");
+		ok = ok && level_ok;
+	}
+
+	XrPosef* poses = malloc(count * sizeof(*poses));
+	XrVector3f* scales = malloc(count * sizeof(*scales));
+	XrMatrix4x4f* results = malloc(count * sizeof(*results));
+	if (!poses || !scales || !results) {
+		printf("Failed to allocate %d poses\n", count);
+		return 1;
+	}
+	random_poses(poses, scales, count);
+
+	// one XrMatrix4x4f_CreateModelMatrix() call per pose, as the renderer did before
+	int64_t start = now_ns();
+	for (int it = 0; it < iterations; it++) {
+		for (int i = 0; i < count; i++)
+			XrMatrix4x4f_CreateModelMatrix(&results[i], &poses[i].position, &poses[i].orientation,
+			                               &scales[i]);
+		__asm__ volatile("" : : "r"(results) : "memory");
+	}
+	double single_ns = (double)(now_ns() - start) / ((double)iterations * count);
+	printf("%-12s %8.2f ns/matrix\n", "per call", single_ns);
+
+	for (enum xr_simd_level level = XR_SIMD_SCALAR; level <= best; level++) {
+		XrMatrix4x4f_SetSimdLevel(level);
+		start = now_ns();
+		for (int it = 0; it < iterations; it++) {
+			XrMatrix4x4f_CreateModelMatrices(results, poses, scales, count);
+			__asm__ volatile("" : : "r"(results) : "memory");
+		}
+		double ns = (double)(now_ns() - start) / ((double)iterations * count);
+		printf("batch %-6s %8.2f ns/matrix  %5.2fx\n", xr_simd_level_name(level), ns, single_ns / ns);
+	}
+
+	free(poses);
+	free(scales);
+	free(results);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,1376 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Minimal OpenXR runtime for running lis_vr_app without a headset.
+ *
+ * Implements the entry points lis_vr_app uses: one instance, one system with a stereo view
+ * configuration, one session with the usual state transitions, GL texture backed swapchains, a
+ * synthetic display clock and scripted head, controller and hand joint poses.
+ *
+ * Configuration through environment variables:
+ *
+ *   MOCK_XR_DISPLAY_HZ   display refresh rate, default 90
+ *   MOCK_XR_FREE_RUN     1: xrWaitFrame() does not sleep, display time advances by one period per
+ *                        frame. Poses then only depend on the frame index, so runs are deterministic.
+ *   MOCK_XR_FRAMES       request session exit after this many frames, default unlimited
+ *   MOCK_XR_MOTION       "wave" (default) or "static"
+ *   MOCK_XR_VIEW_WIDTH   recommended swapchain size per eye, default 1024 x 1024
+ *   MOCK_XR_VIEW_HEIGHT
+ */
+
+#define _GNU_SOURCE
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#define XR_USE_GRAPHICS_API_OPENGL
+#include "../openxr_headers/openxr.h"
+#include "../openxr_headers/openxr_platform.h"
+#include "../openxr_headers/openxr_reflection.h"
+#include "../openxr_headers/loader_interfaces.h"
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+#define MOCK_EXPORT __attribute__((visibility("default")))
+
+#define MOCK_RUNTIME_NAME "lis mock runtime"
+#define MOCK_SYSTEM_ID 1
+#define MOCK_VIEW_COUNT 2
+#define MOCK_SWAPCHAIN_IMAGES 3
+#define MOCK_MAX_PATHS 256
+#define MOCK_MAX_EVENTS 16
+#define MOCK_MAX_PENDING_FRAMES 4
+
+#define HAND_COUNT 2
+
+// two-call idiom for enumerations
+#define ENUMERATE(CAPACITY, COUNT_OUT, OUT, SRC, N)                                                 \
+	do {                                                                                             \
+		*(COUNT_OUT) = (N);                                                                            \
+		if ((CAPACITY) == 0)                                                                           \
+			return XR_SUCCESS;                                                                           \
+		if ((CAPACITY) < (N))                                                                          \
+			return XR_ERROR_SIZE_INSUFFICIENT;                                                           \
+		for (uint32_t i_ = 0; i_ < (N); i_++)                                                          \
+			(OUT)[i_] = (SRC)[i_];                                                                       \
+	} while (0)
+
+struct mock_action
+{
+	XrActionType type;
+	char name[XR_MAX_ACTION_NAME_SIZE];
+	// last reported value per hand, for changedSinceLastSync
+	float last_value[HAND_COUNT];
+};
+
+enum mock_space_kind
+{
+	MOCK_SPACE_REFERENCE,
+	MOCK_SPACE_ACTION,
+};
+
+struct mock_space
+{
+	enum mock_space_kind kind;
+	XrReferenceSpaceType reference_type;
+	struct mock_action* action;
+	int hand;
+	XrPosef offset;
+};
+
+struct mock_swapchain
+{
+	GLenum target;
+	GLuint textures[MOCK_SWAPCHAIN_IMAGES];
+	uint32_t next_acquire;
+};
+
+struct mock_hand_tracker
+{
+	int hand;
+};
+
+static struct
+{
+	pthread_mutex_t mutex;
+
+	bool instance_alive;
+	bool session_alive;
+	XrSessionState state;
+	bool exit_requested;
+
+	char* paths[MOCK_MAX_PATHS];
+	uint32_t path_count;
+	XrPath left_hand_path;
+	XrPath right_hand_path;
+	XrPath interaction_profile;
+	bool profile_event_sent;
+
+	XrEventDataBuffer events[MOCK_MAX_EVENTS];
+	uint32_t event_head, event_count;
+
+	// configuration
+	float display_hz;
+	bool free_run;
+	uint64_t frame_limit;
+	bool static_motion;
+	uint32_t view_width, view_height;
+
+	// frame timing
+	XrTime epoch;
+	XrDuration period;
+	uint64_t frame_index;
+	XrTime display_time;
+	XrTime sync_time;
+	// when xrWaitFrame() returned each of the last display times, a pipelined app ends a frame
+	// after it already waited for the next one
+	struct
+	{
+		XrTime display_time;
+		int64_t return_ns;
+	} waits[MOCK_MAX_PENDING_FRAMES];
+	bool frame_begun;
+
+	// statistics printed at exit
+	uint64_t frames_ended;
+	uint64_t layers_submitted;
+	int64_t app_ns_total, app_ns_min, app_ns_max;
+	uint64_t haptic_count;
+} mock = {.mutex = PTHREAD_MUTEX_INITIALIZER};
+
+
+// --- helpers
+
+static int64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+static float
+env_float(const char* name, float fallback)
+{
+	const char* value = getenv(name);
+	return value ? strtof(value, NULL) : fallback;
+}
+
+static void
+queue_event(const void* event, size_t size)
+{
+	pthread_mutex_lock(&mock.mutex);
+	if (mock.event_count < MOCK_MAX_EVENTS) {
+		uint32_t slot = (mock.event_head + mock.event_count++) % MOCK_MAX_EVENTS;
+		memset(&mock.events[slot], 0, sizeof(mock.events[slot]));
+		memcpy(&mock.events[slot], event, size);
+	}
+	pthread_mutex_unlock(&mock.mutex);
+}
+
+static void
+queue_state(XrSession session, XrSessionState state)
+{
+	XrEventDataSessionStateChanged event = {
+	    .type = XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED,
+	    .session = session,
+	    .state = state,
+	    .time = now_ns(),
+	};
+	queue_event(&event, sizeof(event));
+}
+
+static XrSession
+session_handle(void)
+{
+	return (XrSession)&mock.session_alive;
+}
+
+static int
+hand_for_path(XrPath path)
+{
+	return path == mock.right_hand_path ? 1 : 0;
+}
+
+
+// --- pose math and scripted motion
+
+static XrQuaternionf
+quat_mul(XrQuaternionf a, XrQuaternionf b)
+{
+	return (XrQuaternionf){
+	    .x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+	    .y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+	    .z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+	    .w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+	};
+}
+
+static XrVector3f
+quat_rotate(XrQuaternionf q, XrVector3f v)
+{
+	XrQuaternionf p = {.x = v.x, .y = v.y, .z = v.z, .w = 0};
+	XrQuaternionf conj = {.x = -q.x, .y = -q.y, .z = -q.z, .w = q.w};
+	XrQuaternionf r = quat_mul(quat_mul(q, p), conj);
+	return (XrVector3f){r.x, r.y, r.z};
+}
+
+static XrQuaternionf
+quat_axis_angle(XrVector3f axis, float angle)
+{
+	float s = sinf(angle / 2);
+	return (XrQuaternionf){.x = axis.x * s, .y = axis.y * s, .z = axis.z * s, .w = cosf(angle / 2)};
+}
+
+// pose b given relative to a
+static XrPosef
+pose_compose(XrPosef a, XrPosef b)
+{
+	XrVector3f p = quat_rotate(a.orientation, b.position);
+	return (XrPosef){
+	    .orientation = quat_mul(a.orientation, b.orientation),
+	    .position = {a.position.x + p.x, a.position.y + p.y, a.position.z + p.z},
+	};
+}
+
+static XrPosef
+pose_invert(XrPosef a)
+{
+	XrQuaternionf conj = {.x = -a.orientation.x, .y = -a.orientation.y, .z = -a.orientation.z,
+	                      .w = a.orientation.w};
+	XrVector3f p = quat_rotate(conj, a.position);
+	return (XrPosef){.orientation = conj, .position = {-p.x, -p.y, -p.z}};
+}
+
+static const XrPosef identity = {.orientation = {.w = 1}};
+
+static float
+motion_seconds(XrTime time)
+{
+	return mock.static_motion ? 0 : (float)((double)(time - mock.epoch) * 1e-9);
+}
+
+static XrPosef
+head_pose(XrTime time)
+{
+	float t = motion_seconds(time);
+	XrPosef pose = identity;
+	pose.position = (XrVector3f){0.02f * sinf(2 * (float)M_PI * 0.25f * t), 1.6f, 0};
+	pose.orientation = quat_axis_angle((XrVector3f){0, 1, 0}, 0.05f * sinf(2 * (float)M_PI * 0.1f * t));
+	return pose;
+}
+
+static XrPosef
+hand_pose(int hand, XrTime time)
+{
+	float t = motion_seconds(time);
+	float side = hand == 0 ? -1 : 1;
+	XrPosef pose = identity;
+	pose.position = (XrVector3f){
+	    side * 0.2f,
+	    1.3f + 0.05f * sinf(2 * (float)M_PI * 0.5f * t + side),
+	    -0.35f,
+	};
+	return pose;
+}
+
+// fraction a finger is curled, 0..1
+static float
+finger_curl(int hand, XrTime time)
+{
+	float t = motion_seconds(time);
+	return 0.5f + 0.5f * sinf(2 * (float)M_PI * 0.5f * t + (float)hand * (float)M_PI);
+}
+
+static XrPosef
+joint_pose(int hand, int joint, XrTime time)
+{
+	XrPosef local = identity;
+	float side = hand == 0 ? -1 : 1;
+
+	if (joint == XR_HAND_JOINT_WRIST_EXT) {
+		local.position = (XrVector3f){0, 0, 0.08f};
+	} else if (joint != XR_HAND_JOINT_PALM_EXT) {
+		// thumb has 4 joints starting at 2, the other fingers 5 joints each starting at 6
+		int finger = joint < XR_HAND_JOINT_INDEX_METACARPAL_EXT ? 0
+		                                                        : 1 + (joint - XR_HAND_JOINT_INDEX_METACARPAL_EXT) / 5;
+		int segment = finger == 0 ? joint - XR_HAND_JOINT_THUMB_METACARPAL_EXT
+		                          : (joint - XR_HAND_JOINT_INDEX_METACARPAL_EXT) % 5;
+		float bend = finger_curl(hand, time) * 0.4f * (float)segment;
+		local.position = (XrVector3f){
+		    side * (float)(finger - 2) * 0.02f,
+		    -0.025f * (float)segment * sinf(bend),
+		    0.02f - 0.025f * (float)segment * cosf(bend),
+		};
+		local.orientation = quat_axis_angle((XrVector3f){1, 0, 0}, -bend);
+	}
+	return pose_compose(hand_pose(hand, time), local);
+}
+
+static XrPosef
+space_world_pose(const struct mock_space* space, XrTime time)
+{
+	XrPosef base = identity;
+	if (space->kind == MOCK_SPACE_ACTION) {
+		base = hand_pose(space->hand, time);
+	} else {
+		switch (space->reference_type) {
+		case XR_REFERENCE_SPACE_TYPE_VIEW: base = head_pose(time); break;
+		case XR_REFERENCE_SPACE_TYPE_LOCAL: base.position.y = 1.6f; break;
+		default: break;
+		}
+	}
+	return pose_compose(base, space->offset);
+}
+
+
+// --- instance
+
+static XrResult XRAPI_CALL
+mock_xrGetInstanceProcAddr(XrInstance instance, const char* name, PFN_xrVoidFunction* function);
+
+static const char* supported_extensions[] = {
+    XR_KHR_OPENGL_ENABLE_EXTENSION_NAME,
+    XR_KHR_COMPOSITION_LAYER_DEPTH_EXTENSION_NAME,
+    XR_EXT_HAND_TRACKING_EXTENSION_NAME,
+    XR_FB_DISPLAY_REFRESH_RATE_EXTENSION_NAME,
+};
+
+static XrResult XRAPI_CALL
+mock_xrEnumerateInstanceExtensionProperties(const char* layer_name,
+                                            uint32_t capacity,
+                                            uint32_t* count,
+                                            XrExtensionProperties* properties)
+{
+	*count = ARRAY_SIZE(supported_extensions);
+	if (capacity == 0)
+		return XR_SUCCESS;
+	if (capacity < ARRAY_SIZE(supported_extensions))
+		return XR_ERROR_SIZE_INSUFFICIENT;
+
+	for (uint32_t i = 0; i < ARRAY_SIZE(supported_extensions); i++) {
+		snprintf(properties[i].extensionName, XR_MAX_EXTENSION_NAME_SIZE, "%s",
+		         supported_extensions[i]);
+		properties[i].extensionVersion = 1;
+	}
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrEnumerateApiLayerProperties(uint32_t capacity, uint32_t* count, XrApiLayerProperties* props)
+{
+	*count = 0;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrCreateInstance(const XrInstanceCreateInfo* info, XrInstance* instance)
+{
+	if (mock.instance_alive)
+		return XR_ERROR_LIMIT_REACHED;
+
+	for (uint32_t i = 0; i < info->enabledExtensionCount; i++) {
+		bool found = false;
+		for (uint32_t j = 0; j < ARRAY_SIZE(supported_extensions); j++)
+			found |= strcmp(info->enabledExtensionNames[i], supported_extensions[j]) == 0;
+		if (!found)
+			return XR_ERROR_EXTENSION_NOT_PRESENT;
+	}
+
+	mock.display_hz = env_float("MOCK_XR_DISPLAY_HZ", 90);
+	if (mock.display_hz <= 0)
+		mock.display_hz = 90;
+	mock.free_run = env_float("MOCK_XR_FREE_RUN", 0) != 0;
+	mock.frame_limit = (uint64_t)env_float("MOCK_XR_FRAMES", 0);
+	mock.static_motion = getenv("MOCK_XR_MOTION") && strcmp(getenv("MOCK_XR_MOTION"), "static") == 0;
+	mock.view_width = (uint32_t)env_float("MOCK_XR_VIEW_WIDTH", 1024);
+	mock.view_height = (uint32_t)env_float("MOCK_XR_VIEW_HEIGHT", 1024);
+
+	mock.period = (XrDuration)(1e9 / mock.display_hz);
+	mock.epoch = now_ns();
+	mock.instance_alive = true;
+	*instance = (XrInstance)&mock.instance_alive;
+
+	printf("%s: %.1f Hz%s, %ux%u per eye\n", MOCK_RUNTIME_NAME, mock.display_hz,
+	       mock.free_run ? " free running" : "", mock.view_width, mock.view_height);
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrDestroyInstance(XrInstance instance)
+{
+	if (mock.frames_ended > 0) {
+		printf("%s: %lu frames, %lu layers, %lu haptic pulses, app time per frame "
+		       "min %.3f / mean %.3f / max %.3f ms\n",
+		       MOCK_RUNTIME_NAME, (unsigned long)mock.frames_ended,
+		       (unsigned long)mock.layers_submitted, (unsigned long)mock.haptic_count,
+		       mock.app_ns_min / 1e6, mock.app_ns_total / 1e6 / mock.frames_ended,
+		       mock.app_ns_max / 1e6);
+	}
+
+	for (uint32_t i = 0; i < mock.path_count; i++)
+		free(mock.paths[i]);
+	mock.path_count = 0;
+	mock.instance_alive = false;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrGetInstanceProperties(XrInstance instance, XrInstanceProperties* props)
+{
+	props->runtimeVersion = XR_MAKE_VERSION(0, 1, 0);
+	snprintf(props->runtimeName, XR_MAX_RUNTIME_NAME_SIZE, "%s", MOCK_RUNTIME_NAME);
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrResultToString(XrInstance instance, XrResult value, char buffer[XR_MAX_RESULT_STRING_SIZE])
+{
+#define RESULT_CASE(name, val)                                                                     \
+	case name: snprintf(buffer, XR_MAX_RESULT_STRING_SIZE, "%s", #name); return XR_SUCCESS;
+	switch (value) {
+		XR_LIST_ENUM_XrResult(RESULT_CASE);
+	default: snprintf(buffer, XR_MAX_RESULT_STRING_SIZE, "XR_UNKNOWN_RESULT_%d", value);
+	}
+#undef RESULT_CASE
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrStructureTypeToString(XrInstance instance,
+                             XrStructureType value,
+                             char buffer[XR_MAX_STRUCTURE_NAME_SIZE])
+{
+#define STRUCT_CASE(name, val)                                                                     \
+	case name: snprintf(buffer, XR_MAX_STRUCTURE_NAME_SIZE, "%s", #name); return XR_SUCCESS;
+	switch (value) {
+		XR_LIST_ENUM_XrStructureType(STRUCT_CASE);
+	default: snprintf(buffer, XR_MAX_STRUCTURE_NAME_SIZE, "XR_UNKNOWN_STRUCTURE_TYPE_%d", value);
+	}
+#undef STRUCT_CASE
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrPollEvent(XrInstance instance, XrEventDataBuffer* event)
+{
+	XrResult result = XR_EVENT_UNAVAILABLE;
+	pthread_mutex_lock(&mock.mutex);
+	if (mock.event_count > 0) {
+		*event = mock.events[mock.event_head];
+		mock.event_head = (mock.event_head + 1) % MOCK_MAX_EVENTS;
+		mock.event_count--;
+		result = XR_SUCCESS;
+	}
+	pthread_mutex_unlock(&mock.mutex);
+
+	if (result == XR_SUCCESS && event->type == XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED)
+		mock.state = ((XrEventDataSessionStateChanged*)event)->state;
+	return result;
+}
+
+static XrResult XRAPI_CALL
+mock_xrStringToPath(XrInstance instance, const char* string, XrPath* path)
+{
+	for (uint32_t i = 0; i < mock.path_count; i++) {
+		if (strcmp(mock.paths[i], string) == 0) {
+			*path = i + 1;
+			return XR_SUCCESS;
+		}
+	}
+	if (mock.path_count == MOCK_MAX_PATHS)
+		return XR_ERROR_PATH_COUNT_EXCEEDED;
+
+	mock.paths[mock.path_count] = strdup(string);
+	*path = ++mock.path_count;
+
+	if (strcmp(string, "/user/hand/left") == 0)
+		mock.left_hand_path = *path;
+	else if (strcmp(string, "/user/hand/right") == 0)
+		mock.right_hand_path = *path;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrPathToString(
+    XrInstance instance, XrPath path, uint32_t capacity, uint32_t* count, char* buffer)
+{
+	if (path == XR_NULL_PATH || path > mock.path_count)
+		return XR_ERROR_PATH_INVALID;
+
+	const char* str = mock.paths[path - 1];
+	*count = (uint32_t)strlen(str) + 1;
+	if (capacity == 0)
+		return XR_SUCCESS;
+	if (capacity < *count)
+		return XR_ERROR_SIZE_INSUFFICIENT;
+	memcpy(buffer, str, *count);
+	return XR_SUCCESS;
+}
+
+
+// --- system
+
+static XrResult XRAPI_CALL
+mock_xrGetSystem(XrInstance instance, const XrSystemGetInfo* info, XrSystemId* system_id)
+{
+	if (info->formFactor != XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY)
+		return XR_ERROR_FORM_FACTOR_UNSUPPORTED;
+	*system_id = MOCK_SYSTEM_ID;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrGetSystemProperties(XrInstance instance, XrSystemId system_id, XrSystemProperties* props)
+{
+	props->systemId = MOCK_SYSTEM_ID;
+	props->vendorId = 0;
+	snprintf(props->systemName, XR_MAX_SYSTEM_NAME_SIZE, "%s", MOCK_RUNTIME_NAME);
+	props->graphicsProperties.maxSwapchainImageWidth = 4096;
+	props->graphicsProperties.maxSwapchainImageHeight = 4096;
+	props->graphicsProperties.maxLayerCount = XR_MIN_COMPOSITION_LAYERS_SUPPORTED;
+	props->trackingProperties.orientationTracking = XR_TRUE;
+	props->trackingProperties.positionTracking = XR_TRUE;
+
+	for (XrBaseOutStructure* next = props->next; next; next = next->next) {
+		if (next->type == XR_TYPE_SYSTEM_HAND_TRACKING_PROPERTIES_EXT)
+			((XrSystemHandTrackingPropertiesEXT*)next)->supportsHandTracking = XR_TRUE;
+	}
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrEnumerateViewConfigurations(XrInstance instance,
+                                   XrSystemId system_id,
+                                   uint32_t capacity,
+                                   uint32_t* count,
+                                   XrViewConfigurationType* types)
+{
+	static const XrViewConfigurationType supported[] = {XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO};
+	ENUMERATE(capacity, count, types, supported, 1u);
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrGetViewConfigurationProperties(XrInstance instance,
+                                      XrSystemId system_id,
+                                      XrViewConfigurationType type,
+                                      XrViewConfigurationProperties* props)
+{
+	if (type != XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO)
+		return XR_ERROR_VIEW_CONFIGURATION_TYPE_UNSUPPORTED;
+	props->viewConfigurationType = type;
+	props->fovMutable = XR_FALSE;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrEnumerateViewConfigurationViews(XrInstance instance,
+                                       XrSystemId system_id,
+                                       XrViewConfigurationType type,
+                                       uint32_t capacity,
+                                       uint32_t* count,
+                                       XrViewConfigurationView* views)
+{
+	if (type != XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO)
+		return XR_ERROR_VIEW_CONFIGURATION_TYPE_UNSUPPORTED;
+
+	*count = MOCK_VIEW_COUNT;
+	if (capacity == 0)
+		return XR_SUCCESS;
+	if (capacity < MOCK_VIEW_COUNT)
+		return XR_ERROR_SIZE_INSUFFICIENT;
+
+	for (uint32_t i = 0; i < MOCK_VIEW_COUNT; i++) {
+		views[i].recommendedImageRectWidth = mock.view_width;
+		views[i].maxImageRectWidth = 4096;
+		views[i].recommendedImageRectHeight = mock.view_height;
+		views[i].maxImageRectHeight = 4096;
+		views[i].recommendedSwapchainSampleCount = 1;
+		views[i].maxSwapchainSampleCount = 1;
+	}
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrEnumerateEnvironmentBlendModes(XrInstance instance,
+                                      XrSystemId system_id,
+                                      XrViewConfigurationType type,
+                                      uint32_t capacity,
+                                      uint32_t* count,
+                                      XrEnvironmentBlendMode* modes)
+{
+	static const XrEnvironmentBlendMode supported[] = {XR_ENVIRONMENT_BLEND_MODE_OPAQUE};
+	ENUMERATE(capacity, count, modes, supported, 1u);
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrGetOpenGLGraphicsRequirementsKHR(XrInstance instance,
+                                        XrSystemId system_id,
+                                        XrGraphicsRequirementsOpenGLKHR* reqs)
+{
+	reqs->minApiVersionSupported = XR_MAKE_VERSION(3, 3, 0);
+	reqs->maxApiVersionSupported = XR_MAKE_VERSION(4, 6, 0);
+	return XR_SUCCESS;
+}
+
+
+// --- session
+
+static XrResult XRAPI_CALL
+mock_xrCreateSession(XrInstance instance, const XrSessionCreateInfo* info, XrSession* session)
+{
+	if (mock.session_alive)
+		return XR_ERROR_LIMIT_REACHED;
+	if (info->next == NULL)
+		return XR_ERROR_GRAPHICS_DEVICE_INVALID;
+
+	mock.session_alive = true;
+	mock.exit_requested = false;
+	mock.state = XR_SESSION_STATE_UNKNOWN;
+	*session = session_handle();
+
+	queue_state(*session, XR_SESSION_STATE_IDLE);
+	queue_state(*session, XR_SESSION_STATE_READY);
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrDestroySession(XrSession session)
+{
+	mock.session_alive = false;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrBeginSession(XrSession session, const XrSessionBeginInfo* info)
+{
+	if (mock.state != XR_SESSION_STATE_READY)
+		return XR_ERROR_SESSION_NOT_READY;
+
+	queue_state(session, XR_SESSION_STATE_SYNCHRONIZED);
+	queue_state(session, XR_SESSION_STATE_VISIBLE);
+	queue_state(session, XR_SESSION_STATE_FOCUSED);
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrEndSession(XrSession session)
+{
+	if (mock.state != XR_SESSION_STATE_STOPPING)
+		return XR_ERROR_SESSION_NOT_STOPPING;
+
+	queue_state(session, XR_SESSION_STATE_IDLE);
+	if (mock.exit_requested)
+		queue_state(session, XR_SESSION_STATE_EXITING);
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrRequestExitSession(XrSession session)
+{
+	// also called by xrEndFrame() on a pipelined app's render thread
+	pthread_mutex_lock(&mock.mutex);
+	bool requested = mock.exit_requested;
+	mock.exit_requested = true;
+	bool focused = mock.state == XR_SESSION_STATE_FOCUSED;
+	pthread_mutex_unlock(&mock.mutex);
+	if (requested)
+		return XR_SUCCESS;
+
+	if (focused) {
+		queue_state(session, XR_SESSION_STATE_VISIBLE);
+		queue_state(session, XR_SESSION_STATE_SYNCHRONIZED);
+	}
+	queue_state(session, XR_SESSION_STATE_STOPPING);
+	return XR_SUCCESS;
+}
+
+
+// --- refresh rate
+
+static XrResult XRAPI_CALL
+mock_xrEnumerateDisplayRefreshRatesFB(XrSession session,
+                                      uint32_t capacity,
+                                      uint32_t* count,
+                                      float* rates)
+{
+	ENUMERATE(capacity, count, rates, &mock.display_hz, 1u);
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrGetDisplayRefreshRateFB(XrSession session, float* rate)
+{
+	*rate = mock.display_hz;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrRequestDisplayRefreshRateFB(XrSession session, float rate)
+{
+	return rate == 0 || rate == mock.display_hz ? XR_SUCCESS : XR_ERROR_DISPLAY_REFRESH_RATE_UNSUPPORTED_FB;
+}
+
+
+// --- spaces
+
+static XrResult XRAPI_CALL
+mock_xrEnumerateReferenceSpaces(XrSession session,
+                                uint32_t capacity,
+                                uint32_t* count,
+                                XrReferenceSpaceType* spaces)
+{
+	static const XrReferenceSpaceType supported[] = {
+	    XR_REFERENCE_SPACE_TYPE_VIEW,
+	    XR_REFERENCE_SPACE_TYPE_LOCAL,
+	    XR_REFERENCE_SPACE_TYPE_STAGE,
+	};
+	ENUMERATE(capacity, count, spaces, supported, (uint32_t)ARRAY_SIZE(supported));
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrCreateReferenceSpace(XrSession session, const XrReferenceSpaceCreateInfo* info, XrSpace* space)
+{
+	struct mock_space* s = calloc(1, sizeof(*s));
+	if (s == NULL)
+		return XR_ERROR_OUT_OF_MEMORY;
+	s->kind = MOCK_SPACE_REFERENCE;
+	s->reference_type = info->referenceSpaceType;
+	s->offset = info->poseInReferenceSpace;
+	*space = (XrSpace)s;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrCreateActionSpace(XrSession session, const XrActionSpaceCreateInfo* info, XrSpace* space)
+{
+	struct mock_space* s = calloc(1, sizeof(*s));
+	if (s == NULL)
+		return XR_ERROR_OUT_OF_MEMORY;
+	s->kind = MOCK_SPACE_ACTION;
+	s->action = (struct mock_action*)info->action;
+	s->hand = hand_for_path(info->subactionPath);
+	s->offset = info->poseInActionSpace;
+	*space = (XrSpace)s;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrDestroySpace(XrSpace space)
+{
+	free((struct mock_space*)space);
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrLocateSpace(XrSpace space, XrSpace base, XrTime time, XrSpaceLocation* location)
+{
+	XrPosef world = space_world_pose((struct mock_space*)space, time);
+	XrPosef base_world = space_world_pose((struct mock_space*)base, time);
+
+	location->pose = pose_compose(pose_invert(base_world), world);
+	location->locationFlags =
+	    XR_SPACE_LOCATION_ORIENTATION_VALID_BIT | XR_SPACE_LOCATION_POSITION_VALID_BIT |
+	    XR_SPACE_LOCATION_ORIENTATION_TRACKED_BIT | XR_SPACE_LOCATION_POSITION_TRACKED_BIT;
+
+	for (XrBaseOutStructure* next = (XrBaseOutStructure*)location->next; next; next = next->next) {
+		if (next->type != XR_TYPE_SPACE_VELOCITY)
+			continue;
+
+		// finite difference over 1 ms
+		XrSpaceLocation later = {.type = XR_TYPE_SPACE_LOCATION};
+		XrPosef world_later = space_world_pose((struct mock_space*)space, time + 1000000);
+		XrPosef base_later = space_world_pose((struct mock_space*)base, time + 1000000);
+		later.pose = pose_compose(pose_invert(base_later), world_later);
+
+		XrSpaceVelocity* velocity = (XrSpaceVelocity*)next;
+		velocity->velocityFlags = XR_SPACE_VELOCITY_LINEAR_VALID_BIT;
+		velocity->linearVelocity = (XrVector3f){
+		    (later.pose.position.x - location->pose.position.x) * 1000,
+		    (later.pose.position.y - location->pose.position.y) * 1000,
+		    (later.pose.position.z - location->pose.position.z) * 1000,
+		};
+		velocity->angularVelocity = (XrVector3f){0, 0, 0};
+	}
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrLocateViews(XrSession session,
+                   const XrViewLocateInfo* info,
+                   XrViewState* state,
+                   uint32_t capacity,
+                   uint32_t* count,
+                   XrView* views)
+{
+	*count = MOCK_VIEW_COUNT;
+	if (capacity == 0)
+		return XR_SUCCESS;
+	if (capacity < MOCK_VIEW_COUNT)
+		return XR_ERROR_SIZE_INSUFFICIENT;
+
+	state->viewStateFlags = XR_VIEW_STATE_ORIENTATION_VALID_BIT | XR_VIEW_STATE_POSITION_VALID_BIT |
+	                        XR_VIEW_STATE_ORIENTATION_TRACKED_BIT | XR_VIEW_STATE_POSITION_TRACKED_BIT;
+
+	XrPosef base_world = space_world_pose((struct mock_space*)info->space, info->displayTime);
+	XrPosef head = pose_compose(pose_invert(base_world), head_pose(info->displayTime));
+
+	for (uint32_t i = 0; i < MOCK_VIEW_COUNT; i++) {
+		XrPosef eye = identity;
+		eye.position.x = i == 0 ? -0.032f : 0.032f;
+		views[i].pose = pose_compose(head, eye);
+		views[i].fov = (XrFovf){.angleLeft = -0.785f, .angleRight = 0.785f, .angleUp = 0.785f,
+		                        .angleDown = -0.785f};
+	}
+	return XR_SUCCESS;
+}
+
+
+// --- swapchains
+
+static const int64_t swapchain_formats[] = {
+    GL_SRGB8_ALPHA8,
+    GL_RGBA8,
+    GL_DEPTH_COMPONENT16,
+    GL_DEPTH_COMPONENT32F,
+};
+
+static XrResult XRAPI_CALL
+mock_xrEnumerateSwapchainFormats(XrSession session,
+                                 uint32_t capacity,
+                                 uint32_t* count,
+                                 int64_t* formats)
+{
+	ENUMERATE(capacity, count, formats, swapchain_formats, (uint32_t)ARRAY_SIZE(swapchain_formats));
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrCreateSwapchain(XrSession session, const XrSwapchainCreateInfo* info, XrSwapchain* swapchain)
+{
+	bool depth = info->format == GL_DEPTH_COMPONENT16 || info->format == GL_DEPTH_COMPONENT32F;
+	bool known = false;
+	for (uint32_t i = 0; i < ARRAY_SIZE(swapchain_formats); i++)
+		known |= swapchain_formats[i] == info->format;
+	if (!known)
+		return XR_ERROR_SWAPCHAIN_FORMAT_UNSUPPORTED;
+
+	struct mock_swapchain* sc = calloc(1, sizeof(*sc));
+	if (sc == NULL)
+		return XR_ERROR_OUT_OF_MEMORY;
+
+	// textures are created in the app's GL context, which is current on the calling thread
+	sc->target = info->arraySize > 1 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+	GLenum format = depth ? GL_DEPTH_COMPONENT : GL_RGBA;
+	GLenum type = depth ? GL_FLOAT : GL_UNSIGNED_BYTE;
+
+	glGenTextures(MOCK_SWAPCHAIN_IMAGES, sc->textures);
+	for (uint32_t i = 0; i < MOCK_SWAPCHAIN_IMAGES; i++) {
+		glBindTexture(sc->target, sc->textures[i]);
+		glTexParameteri(sc->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(sc->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		if (sc->target == GL_TEXTURE_2D_ARRAY)
+			glTexImage3D(sc->target, 0, (GLint)info->format, info->width, info->height,
+			             info->arraySize, 0, format, type, NULL);
+		else
+			glTexImage2D(sc->target, 0, (GLint)info->format, info->width, info->height, 0, format,
+			             type, NULL);
+	}
+	glBindTexture(sc->target, 0);
+
+	*swapchain = (XrSwapchain)sc;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrDestroySwapchain(XrSwapchain swapchain)
+{
+	struct mock_swapchain* sc = (struct mock_swapchain*)swapchain;
+	glDeleteTextures(MOCK_SWAPCHAIN_IMAGES, sc->textures);
+	free(sc);
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrEnumerateSwapchainImages(XrSwapchain swapchain,
+                                uint32_t capacity,
+                                uint32_t* count,
+                                XrSwapchainImageBaseHeader* images)
+{
+	struct mock_swapchain* sc = (struct mock_swapchain*)swapchain;
+	*count = MOCK_SWAPCHAIN_IMAGES;
+	if (capacity == 0)
+		return XR_SUCCESS;
+	if (capacity < MOCK_SWAPCHAIN_IMAGES)
+		return XR_ERROR_SIZE_INSUFFICIENT;
+
+	XrSwapchainImageOpenGLKHR* gl_images = (XrSwapchainImageOpenGLKHR*)images;
+	for (uint32_t i = 0; i < MOCK_SWAPCHAIN_IMAGES; i++)
+		gl_images[i].image = sc->textures[i];
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrAcquireSwapchainImage(XrSwapchain swapchain,
+                             const XrSwapchainImageAcquireInfo* info,
+                             uint32_t* index)
+{
+	struct mock_swapchain* sc = (struct mock_swapchain*)swapchain;
+	*index = sc->next_acquire;
+	sc->next_acquire = (sc->next_acquire + 1) % MOCK_SWAPCHAIN_IMAGES;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrWaitSwapchainImage(XrSwapchain swapchain, const XrSwapchainImageWaitInfo* info)
+{
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrReleaseSwapchainImage(XrSwapchain swapchain, const XrSwapchainImageReleaseInfo* info)
+{
+	return XR_SUCCESS;
+}
+
+
+// --- frame loop
+
+static XrResult XRAPI_CALL
+mock_xrWaitFrame(XrSession session, const XrFrameWaitInfo* info, XrFrameState* state)
+{
+	// frame state is shared with xrBeginFrame() and xrEndFrame(), which a pipelined app calls
+	// from another thread, the lock is not held while sleeping
+	pthread_mutex_lock(&mock.mutex);
+	XrTime display_time;
+	if (mock.free_run) {
+		display_time = mock.epoch + (XrTime)(mock.frame_index + 1) * mock.period;
+	} else {
+		// display times lie on a fixed grid, a late app skips slots instead of drifting
+		int64_t now = now_ns();
+		display_time = mock.display_time + mock.period;
+		if (display_time < now + mock.period)
+			display_time = mock.epoch + ((now - mock.epoch) / mock.period + 1) * mock.period;
+	}
+	mock.display_time = display_time;
+	uint64_t frame_index = ++mock.frame_index;
+	state->predictedDisplayTime = display_time;
+	state->predictedDisplayPeriod = mock.period;
+	state->shouldRender = mock.state == XR_SESSION_STATE_VISIBLE || mock.state == XR_SESSION_STATE_FOCUSED;
+	bool free_run = mock.free_run;
+	pthread_mutex_unlock(&mock.mutex);
+
+	if (!free_run) {
+		// wake the app one period before the image is shown
+		int64_t wake = display_time - state->predictedDisplayPeriod;
+		struct timespec ts = {.tv_sec = wake / 1000000000ll, .tv_nsec = wake % 1000000000ll};
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	}
+
+	pthread_mutex_lock(&mock.mutex);
+	uint32_t slot = frame_index % MOCK_MAX_PENDING_FRAMES;
+	mock.waits[slot].display_time = display_time;
+	mock.waits[slot].return_ns = now_ns();
+	pthread_mutex_unlock(&mock.mutex);
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrBeginFrame(XrSession session, const XrFrameBeginInfo* info)
+{
+	pthread_mutex_lock(&mock.mutex);
+	XrResult result = mock.frame_begun ? XR_FRAME_DISCARDED : XR_SUCCESS;
+	mock.frame_begun = true;
+	pthread_mutex_unlock(&mock.mutex);
+	return result;
+}
+
+static XrResult XRAPI_CALL
+mock_xrEndFrame(XrSession session, const XrFrameEndInfo* info)
+{
+	if (info->displayTime <= 0)
+		return XR_ERROR_TIME_INVALID;
+	if (info->layerCount > XR_MIN_COMPOSITION_LAYERS_SUPPORTED)
+		return XR_ERROR_LAYER_LIMIT_EXCEEDED;
+
+	// xrWaitFrame() may run on another thread, an unknown display time counts from the last wait
+	pthread_mutex_lock(&mock.mutex);
+	if (!mock.frame_begun) {
+		pthread_mutex_unlock(&mock.mutex);
+		return XR_ERROR_CALL_ORDER_INVALID;
+	}
+	mock.frame_begun = false;
+	int64_t wait_return_ns = mock.waits[mock.frame_index % MOCK_MAX_PENDING_FRAMES].return_ns;
+	for (uint32_t i = 0; i < MOCK_MAX_PENDING_FRAMES; i++)
+		if (mock.waits[i].display_time == info->displayTime)
+			wait_return_ns = mock.waits[i].return_ns;
+
+	int64_t app_ns = now_ns() - wait_return_ns;
+	if (mock.frames_ended == 0 || app_ns < mock.app_ns_min)
+		mock.app_ns_min = app_ns;
+	if (app_ns > mock.app_ns_max)
+		mock.app_ns_max = app_ns;
+	mock.app_ns_total += app_ns;
+	mock.layers_submitted += info->layerCount;
+	mock.frames_ended++;
+	bool limit_reached = mock.frame_limit != 0 && mock.frames_ended == mock.frame_limit;
+	pthread_mutex_unlock(&mock.mutex);
+
+	if (limit_reached)
+		mock_xrRequestExitSession(session);
+	return XR_SUCCESS;
+}
+
+
+// --- actions
+
+static XrResult XRAPI_CALL
+mock_xrCreateActionSet(XrInstance instance, const XrActionSetCreateInfo* info, XrActionSet* set)
+{
+	// action sets carry no state here, any unique non-null handle will do
+	*set = (XrActionSet)strdup(info->actionSetName);
+	return *set ? XR_SUCCESS : XR_ERROR_OUT_OF_MEMORY;
+}
+
+static XrResult XRAPI_CALL
+mock_xrDestroyActionSet(XrActionSet set)
+{
+	free((char*)set);
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrCreateAction(XrActionSet set, const XrActionCreateInfo* info, XrAction* action)
+{
+	struct mock_action* a = calloc(1, sizeof(*a));
+	if (a == NULL)
+		return XR_ERROR_OUT_OF_MEMORY;
+	a->type = info->actionType;
+	snprintf(a->name, sizeof(a->name), "%s", info->actionName);
+	*action = (XrAction)a;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrDestroyAction(XrAction action)
+{
+	free((struct mock_action*)action);
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrSuggestInteractionProfileBindings(XrInstance instance,
+                                         const XrInteractionProfileSuggestedBinding* suggested)
+{
+	// the first suggested profile becomes the "connected" controller
+	if (mock.interaction_profile == XR_NULL_PATH)
+		mock.interaction_profile = suggested->interactionProfile;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrAttachSessionActionSets(XrSession session, const XrSessionActionSetsAttachInfo* info)
+{
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrGetCurrentInteractionProfile(XrSession session,
+                                    XrPath top_level_path,
+                                    XrInteractionProfileState* state)
+{
+	bool is_hand = top_level_path == mock.left_hand_path || top_level_path == mock.right_hand_path;
+	state->interactionProfile = is_hand ? mock.interaction_profile : XR_NULL_PATH;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrSyncActions(XrSession session, const XrActionsSyncInfo* info)
+{
+	if (mock.state != XR_SESSION_STATE_FOCUSED)
+		return XR_SESSION_NOT_FOCUSED;
+
+	pthread_mutex_lock(&mock.mutex);
+	mock.sync_time = mock.display_time ? mock.display_time : now_ns();
+	pthread_mutex_unlock(&mock.mutex);
+
+	if (!mock.profile_event_sent && mock.interaction_profile != XR_NULL_PATH) {
+		mock.profile_event_sent = true;
+		XrEventDataInteractionProfileChanged event = {
+		    .type = XR_TYPE_EVENT_DATA_INTERACTION_PROFILE_CHANGED,
+		    .session = session,
+		};
+		queue_event(&event, sizeof(event));
+	}
+	return XR_SUCCESS;
+}
+
+// scripted analog input of one hand, 0..1
+static float
+action_value(const struct mock_action* action, int hand)
+{
+	float t = motion_seconds(mock.sync_time);
+	return 0.5f + 0.5f * sinf(2 * (float)M_PI * 0.2f * t + (float)hand);
+}
+
+static struct mock_action*
+checked_action(const XrActionStateGetInfo* info, XrActionType type)
+{
+	struct mock_action* action = (struct mock_action*)info->action;
+	return action != NULL && action->type == type ? action : NULL;
+}
+
+static XrResult XRAPI_CALL
+mock_xrGetActionStateFloat(XrSession session,
+                           const XrActionStateGetInfo* info,
+                           XrActionStateFloat* state)
+{
+	struct mock_action* action = checked_action(info, XR_ACTION_TYPE_FLOAT_INPUT);
+	if (action == NULL)
+		return XR_ERROR_ACTION_TYPE_MISMATCH;
+
+	int hand = hand_for_path(info->subactionPath);
+	state->currentState = action_value(action, hand);
+	state->changedSinceLastSync = state->currentState != action->last_value[hand];
+	state->lastChangeTime = mock.sync_time;
+	state->isActive = XR_TRUE;
+	action->last_value[hand] = state->currentState;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrGetActionStateBoolean(XrSession session,
+                             const XrActionStateGetInfo* info,
+                             XrActionStateBoolean* state)
+{
+	struct mock_action* action = checked_action(info, XR_ACTION_TYPE_BOOLEAN_INPUT);
+	if (action == NULL)
+		return XR_ERROR_ACTION_TYPE_MISMATCH;
+
+	int hand = hand_for_path(info->subactionPath);
+	float value = action_value(action, hand) > 0.5f ? 1.0f : 0.0f;
+	state->currentState = value != 0;
+	state->changedSinceLastSync = value != action->last_value[hand];
+	state->lastChangeTime = mock.sync_time;
+	state->isActive = XR_TRUE;
+	action->last_value[hand] = value;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrGetActionStateVector2f(XrSession session,
+                              const XrActionStateGetInfo* info,
+                              XrActionStateVector2f* state)
+{
+	struct mock_action* action = checked_action(info, XR_ACTION_TYPE_VECTOR2F_INPUT);
+	if (action == NULL)
+		return XR_ERROR_ACTION_TYPE_MISMATCH;
+
+	int hand = hand_for_path(info->subactionPath);
+	float value = action_value(action, hand);
+	state->currentState = (XrVector2f){value * 2 - 1, 0};
+	state->changedSinceLastSync = value != action->last_value[hand];
+	state->lastChangeTime = mock.sync_time;
+	state->isActive = XR_TRUE;
+	action->last_value[hand] = value;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrGetActionStatePose(XrSession session,
+                          const XrActionStateGetInfo* info,
+                          XrActionStatePose* state)
+{
+	if (checked_action(info, XR_ACTION_TYPE_POSE_INPUT) == NULL)
+		return XR_ERROR_ACTION_TYPE_MISMATCH;
+	state->isActive = XR_TRUE;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrApplyHapticFeedback(XrSession session,
+                           const XrHapticActionInfo* info,
+                           const XrHapticBaseHeader* haptic)
+{
+	mock.haptic_count++;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrStopHapticFeedback(XrSession session, const XrHapticActionInfo* info)
+{
+	return XR_SUCCESS;
+}
+
+
+// --- hand tracking
+
+static XrResult XRAPI_CALL
+mock_xrCreateHandTrackerEXT(XrSession session,
+                            const XrHandTrackerCreateInfoEXT* info,
+                            XrHandTrackerEXT* tracker)
+{
+	struct mock_hand_tracker* t = calloc(1, sizeof(*t));
+	if (t == NULL)
+		return XR_ERROR_OUT_OF_MEMORY;
+	t->hand = info->hand == XR_HAND_RIGHT_EXT ? 1 : 0;
+	*tracker = (XrHandTrackerEXT)t;
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrDestroyHandTrackerEXT(XrHandTrackerEXT tracker)
+{
+	free((struct mock_hand_tracker*)tracker);
+	return XR_SUCCESS;
+}
+
+static XrResult XRAPI_CALL
+mock_xrLocateHandJointsEXT(XrHandTrackerEXT tracker,
+                           const XrHandJointsLocateInfoEXT* info,
+                           XrHandJointLocationsEXT* locations)
+{
+	const struct mock_hand_tracker* t = (const struct mock_hand_tracker*)tracker;
+	if (locations->jointCount != XR_HAND_JOINT_COUNT_EXT)
+		return XR_ERROR_VALIDATION_FAILURE;
+
+	XrPosef base_inv = pose_invert(space_world_pose((struct mock_space*)info->baseSpace, info->time));
+
+	XrHandJointVelocitiesEXT* velocities = NULL;
+	for (XrBaseOutStructure* next = locations->next; next; next = next->next) {
+		if (next->type == XR_TYPE_HAND_JOINT_VELOCITIES_EXT)
+			velocities = (XrHandJointVelocitiesEXT*)next;
+	}
+
+	locations->isActive = XR_TRUE;
+	for (uint32_t j = 0; j < XR_HAND_JOINT_COUNT_EXT; j++) {
+		XrHandJointLocationEXT* joint = &locations->jointLocations[j];
+		joint->pose = pose_compose(base_inv, joint_pose(t->hand, (int)j, info->time));
+		joint->radius = j == XR_HAND_JOINT_PALM_EXT ? 0.03f : 0.01f;
+		joint->locationFlags =
+		    XR_SPACE_LOCATION_ORIENTATION_VALID_BIT | XR_SPACE_LOCATION_POSITION_VALID_BIT |
+		    XR_SPACE_LOCATION_ORIENTATION_TRACKED_BIT | XR_SPACE_LOCATION_POSITION_TRACKED_BIT;
+
+		if (velocities && j < velocities->jointCount) {
+			XrPosef later = pose_compose(base_inv, joint_pose(t->hand, (int)j, info->time + 1000000));
+			XrHandJointVelocityEXT* v = &velocities->jointVelocities[j];
+			v->velocityFlags = XR_SPACE_VELOCITY_LINEAR_VALID_BIT;
+			v->linearVelocity = (XrVector3f){
+			    (later.position.x - joint->pose.position.x) * 1000,
+			    (later.position.y - joint->pose.position.y) * 1000,
+			    (later.position.z - joint->pose.position.z) * 1000,
+			};
+			v->angularVelocity = (XrVector3f){0, 0, 0};
+		}
+	}
+	return XR_SUCCESS;
+}
+
+
+// --- dispatch
+
+#define MOCK_FUNCTIONS(_)                                                                          \
+	_(xrGetInstanceProcAddr)                                                                         \
+	_(xrEnumerateInstanceExtensionProperties)                                                        \
+	_(xrEnumerateApiLayerProperties)                                                                 \
+	_(xrCreateInstance)                                                                              \
+	_(xrDestroyInstance)                                                                             \
+	_(xrGetInstanceProperties)                                                                       \
+	_(xrResultToString)                                                                              \
+	_(xrStructureTypeToString)                                                                       \
+	_(xrPollEvent)                                                                                   \
+	_(xrStringToPath)                                                                                \
+	_(xrPathToString)                                                                                \
+	_(xrGetSystem)                                                                                   \
+	_(xrGetSystemProperties)                                                                         \
+	_(xrEnumerateViewConfigurations)                                                                 \
+	_(xrGetViewConfigurationProperties)                                                              \
+	_(xrEnumerateViewConfigurationViews)                                                             \
+	_(xrEnumerateEnvironmentBlendModes)                                                              \
+	_(xrGetOpenGLGraphicsRequirementsKHR)                                                            \
+	_(xrCreateSession)                                                                               \
+	_(xrDestroySession)                                                                              \
+	_(xrBeginSession)                                                                                \
+	_(xrEndSession)                                                                                  \
+	_(xrRequestExitSession)                                                                          \
+	_(xrEnumerateDisplayRefreshRatesFB)                                                              \
+	_(xrGetDisplayRefreshRateFB)                                                                     \
+	_(xrRequestDisplayRefreshRateFB)                                                                 \
+	_(xrEnumerateReferenceSpaces)                                                                    \
+	_(xrCreateReferenceSpace)                                                                        \
+	_(xrCreateActionSpace)                                                                           \
+	_(xrDestroySpace)                                                                                \
+	_(xrLocateSpace)                                                                                 \
+	_(xrLocateViews)                                                                                 \
+	_(xrEnumerateSwapchainFormats)                                                                   \
+	_(xrCreateSwapchain)                                                                             \
+	_(xrDestroySwapchain)                                                                            \
+	_(xrEnumerateSwapchainImages)                                                                    \
+	_(xrAcquireSwapchainImage)                                                                       \
+	_(xrWaitSwapchainImage)                                                                          \
+	_(xrReleaseSwapchainImage)                                                                       \
+	_(xrWaitFrame)                                                                                   \
+	_(xrBeginFrame)                                                                                  \
+	_(xrEndFrame)                                                                                    \
+	_(xrCreateActionSet)                                                                             \
+	_(xrDestroyActionSet)                                                                            \
+	_(xrCreateAction)                                                                                \
+	_(xrDestroyAction)                                                                               \
+	_(xrSuggestInteractionProfileBindings)                                                           \
+	_(xrAttachSessionActionSets)                                                                     \
+	_(xrGetCurrentInteractionProfile)                                                                \
+	_(xrSyncActions)                                                                                 \
+	_(xrGetActionStateFloat)                                                                         \
+	_(xrGetActionStateBoolean)                                                                       \
+	_(xrGetActionStateVector2f)                                                                      \
+	_(xrGetActionStatePose)                                                                          \
+	_(xrApplyHapticFeedback)                                                                         \
+	_(xrStopHapticFeedback)                                                                          \
+	_(xrCreateHandTrackerEXT)                                                                        \
+	_(xrDestroyHandTrackerEXT)                                                                       \
+	_(xrLocateHandJointsEXT)
+
+static XrResult XRAPI_CALL
+mock_xrGetInstanceProcAddr(XrInstance instance, const char* name, PFN_xrVoidFunction* function)
+{
+#define MOCK_LOOKUP(NAME)                                                                          \
+	if (strcmp(name, #NAME) == 0) {                                                                  \
+		*function = (PFN_xrVoidFunction)mock_##NAME;                                                   \
+		return XR_SUCCESS;                                                                             \
+	}
+	MOCK_FUNCTIONS(MOCK_LOOKUP)
+#undef MOCK_LOOKUP
+
+	*function = NULL;
+	return XR_ERROR_FUNCTION_UNSUPPORTED;
+}
+
+MOCK_EXPORT XrResult XRAPI_CALL
+xrNegotiateLoaderRuntimeInterface(const XrNegotiateLoaderInfo* loader_info,
+                                  XrNegotiateRuntimeRequest* runtime_request)
+{
+	if (loader_info == NULL || runtime_request == NULL ||
+	    loader_info->structType != XR_LOADER_INTERFACE_STRUCT_LOADER_INFO ||
+	    runtime_request->structType != XR_LOADER_INTERFACE_STRUCT_RUNTIME_REQUEST ||
+	    loader_info->minInterfaceVersion > XR_CURRENT_LOADER_RUNTIME_VERSION ||
+	    loader_info->maxInterfaceVersion < XR_CURRENT_LOADER_RUNTIME_VERSION)
+		return XR_ERROR_INITIALIZATION_FAILED;
+
+	runtime_request->runtimeInterfaceVersion = XR_CURRENT_LOADER_RUNTIME_VERSION;
+	// the loader interface only has room for the low 32 bits
+	runtime_request->runtimeXrVersion = (uint32_t)XR_CURRENT_API_VERSION;
+	runtime_request->getInstanceProcAddr = mock_xrGetInstanceProcAddr;
+	return XR_SUCCESS;
+}
@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Compares the CPU cost of the video receive paths on loopback.
+ *
+ * A sender thread sends datagrams of --size bytes to a loopback socket, as fast as it can or paced
+ * to --rate Gbit/s in 1 ms bursts. The main thread receives them for --seconds with each path
+ * lis_vr_app has: recvfrom() on the socket from a reactor (up to 16 datagrams per wakeup) and
+ * io_uring with a multishot receive and a provided buffer ring (recv_ring.h). Every datagram is
+ * copied into a frame sized buffer like the reassembly does. The receiving thread's CPU time is
+ * reported per gigabit received, next to the throughput and the datagrams the socket dropped.
+ * Unpaced, the receiver is overloaded and the numbers mostly say how much it gets done; a rate it
+ * keeps up with compares the cost per byte.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "reactor.h"
+#include "recv_ring.h"
+
+#define RING_BUFFERS 64
+#define PACKETS_PER_WAKEUP 16
+// a 1280x720 RGB frame
+#define FRAME_SIZE (1280 * 720 * 3)
+
+struct sender
+{
+	int fd;
+	int size;
+	// 0 sends as fast as possible
+	double rate_gbit;
+	_Atomic bool stop;
+	uint64_t datagrams;
+};
+
+static struct
+{
+	struct reactor reactor;
+	struct reactor_source socket;
+	struct reactor_source ring_source;
+	struct reactor_source deadline;
+	struct recv_ring ring;
+	uint8_t frame[FRAME_SIZE];
+	size_t frame_offset;
+	uint8_t buffer[65536];
+
+	uint64_t datagrams;
+	uint64_t bytes;
+} bench;
+
+static int64_t
+now_ns(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void*
+send_datagrams(void* arg)
+{
+	struct sender* sender = arg;
+	uint8_t* payload = calloc(1, sender->size);
+	// datagrams per 1 ms burst
+	double burst = sender->rate_gbit * 1e9 / 8 / 1000 / sender->size;
+	double owed = 0;
+	struct timespec next;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!atomic_load_explicit(&sender->stop, memory_order_relaxed)) {
+		int count = 1;
+		if (burst > 0) {
+			owed += burst;
+			count = (int)owed;
+			owed -= count;
+		}
+		for (int i = 0; i < count; i++) {
+			// the receiver falling behind fills the socket buffer, the kernel then drops
+			if (send(sender->fd, payload, sender->size, 0) == sender->size)
+				sender->datagrams++;
+		}
+		if (burst > 0) {
+			next.tv_nsec += 1000000;
+			if (next.tv_nsec >= 1000000000) {
+				next.tv_sec++;
+				next.tv_nsec -= 1000000000;
+			}
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		}
+	}
+	free(payload);
+	return NULL;
+}
+
+// what the reassembly does with a payload packet
+static void
+deliver(const uint8_t* data, int bytes, void* user)
+{
+	if (bytes <= 0)
+		return;
+	if (bench.frame_offset + bytes > FRAME_SIZE)
+		bench.frame_offset = 0;
+	memcpy(bench.frame + bench.frame_offset, data, bytes);
+	bench.frame_offset += bytes;
+	bench.datagrams++;
+	bench.bytes += bytes;
+}
+
+static void
+receive_socket(struct reactor_source* source, uint32_t events)
+{
+	for (int i = 0; i < PACKETS_PER_WAKEUP; i++) {
+		ssize_t bytes = recv(source->fd, bench.buffer, sizeof(bench.buffer), MSG_DONTWAIT);
+		if (bytes < 0)
+			return;
+		deliver(bench.buffer, (int)bytes, NULL);
+	}
+}
+
+static void
+receive_ring(struct reactor_source* source, uint32_t events)
+{
+	if (recv_ring_consume(&bench.ring, deliver, NULL) < 0)
+		reactor_stop(&bench.reactor);
+}
+
+static void
+stop(struct reactor_source* source, uint32_t events)
+{
+	reactor_stop(&bench.reactor);
+}
+
+// receives for seconds with recvfrom() or io_uring, false if the path is not available
+static bool
+run(bool use_ring, double seconds, int size, double rate_gbit)
+{
+	int receiver = socket(AF_INET, SOCK_DGRAM, 0);
+	int sender_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+	socklen_t addr_len = sizeof(addr);
+	if (receiver < 0 || sender_fd < 0 || bind(receiver, (struct sockaddr*)&addr, addr_len) != 0 ||
+	    getsockname(receiver, (struct sockaddr*)&addr, &addr_len) != 0 ||
+	    connect(sender_fd, (struct sockaddr*)&addr, addr_len) != 0) {
+		printf("Could not set up the loopback sockets: %s\n", strerror(errno));
+		exit(1);
+	}
+
+	memset(&bench.reactor, 0, sizeof(bench.reactor));
+	bench.datagrams = 0;
+	bench.bytes = 0;
+	if (!reactor_init(&bench.reactor) ||
+	    !reactor_add_timer(&bench.reactor, &bench.deadline, stop, NULL))
+		exit(1);
+	bool ok;
+	if (use_ring) {
+		ok = recv_ring_init(&bench.ring, receiver, RING_BUFFERS, FRAME_POOL_PAGES_NORMAL, false) &&
+		     reactor_add_fd(&bench.reactor, &bench.ring_source, bench.ring.ring_fd, EPOLLIN,
+		                    receive_ring, NULL);
+	} else {
+		ok = reactor_add_fd(&bench.reactor, &bench.socket, receiver, EPOLLIN, receive_socket, NULL);
+	}
+	if (!ok) {
+		printf("%-9s not available\n", use_ring ? "io_uring" : "recvfrom");
+		reactor_remove(&bench.reactor, &bench.deadline);
+		reactor_destroy(&bench.reactor);
+		close(sender_fd);
+		close(receiver);
+		return false;
+	}
+
+	struct sender sender = {.fd = sender_fd, .size = size, .rate_gbit = rate_gbit};
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, send_datagrams, &sender) != 0) {
+		printf("pthread_create for the sender failed\n");
+		exit(1);
+	}
+
+	int64_t start_ns = now_ns(CLOCK_MONOTONIC);
+	int64_t start_cpu_ns = now_ns(CLOCK_THREAD_CPUTIME_ID);
+	reactor_arm_timer(&bench.deadline, (int64_t)(seconds * 1e9), 0);
+	reactor_run(&bench.reactor);
+	double cpu_s = (now_ns(CLOCK_THREAD_CPUTIME_ID) - start_cpu_ns) / 1e9;
+	double wall_s = (now_ns(CLOCK_MONOTONIC) - start_ns) / 1e9;
+
+	atomic_store_explicit(&sender.stop, true, memory_order_relaxed);
+	pthread_join(thread, NULL);
+
+	double gigabits = bench.bytes * 8 / 1e9;
+	double dropped = sender.datagrams > 0 ? 100.0 * (1.0 - (double)bench.datagrams / sender.datagrams)
+	                                      : 0;
+	printf("%-9s %8.2f Gbit/s  %9.0f datagrams/s  %5.1f%% cpu  %8.1f cpu ms/Gbit  %5.1f%% dropped",
+	       use_ring ? "io_uring" : "recvfrom", gigabits / wall_s, bench.datagrams / wall_s,
+	       100.0 * cpu_s / wall_s, gigabits > 0 ? 1000.0 * cpu_s / gigabits : 0.0, dropped);
+	if (use_ring)
+		printf("  %.1f datagrams/batch, %llu re-arms",
+		       bench.ring.batches > 0 ? (double)bench.ring.datagrams / bench.ring.batches : 0.0,
+		       (unsigned long long)bench.ring.rearms);
+	printf("\n");
+
+	if (use_ring) {
+		reactor_remove(&bench.reactor, &bench.ring_source);
+		recv_ring_destroy(&bench.ring);
+	} else {
+		reactor_remove(&bench.reactor, &bench.socket);
+	}
+	reactor_remove(&bench.reactor, &bench.deadline);
+	reactor_destroy(&bench.reactor);
+	close(sender_fd);
+	close(receiver);
+	return true;
+}
+
+int
+main(int argc, char** argv)
+{
+	double seconds = 2;
+	int size = 8192;
+	double rate_gbit = 0;
+
+	static struct option long_options[] = {{"seconds", required_argument, 0, 's'},
+	                                       {"size", required_argument, 0, 'b'},
+	                                       {"rate", required_argument, 0, 'r'},
+	                                       {"help", no_argument, 0, 'h'},
+	                                       {0, 0, 0, 0}};
+	int opt;
+	while ((opt = getopt_long(argc, argv, "s:b:r:h", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 's': seconds = atof(optarg); break;
+		case 'b': size = atoi(optarg); break;
+		case 'r': rate_gbit = atof(optarg); break;
+		case 'h':
+		default:
+			printf("Usage: %s [--seconds S] [--size BYTES] [--rate GBIT/S]\n", argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if (seconds <= 0 || size <= 0 || size > 65507 || rate_gbit < 0) {
+		printf("--seconds must be positive, --size 1..65507 and --rate not negative\n");
+		return 1;
+	}
+
+	if (rate_gbit > 0)
+		printf("%d byte datagrams at %.2f Gbit/s for %.1f s each\n", size, rate_gbit, seconds);
+	else
+		printf("%d byte datagrams for %.1f s each\n", size, seconds);
+	run(false, seconds, size, rate_gbit);
+	return run(true, seconds, size, rate_gbit) ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief epoll event loop, see reactor.h.
+ */
+
+#include "reactor.h"
+#include "logger.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// ready sources handled per epoll_wait()
+#define REACTOR_MAX_EVENTS 16
+
+static bool
+add_source(struct reactor* reactor,
+           struct reactor_source* source,
+           int fd,
+           enum reactor_source_type type,
+           uint32_t events,
+           reactor_fn fn,
+           void* data)
+{
+	*source = (struct reactor_source){.fd = fd, .type = type, .fn = fn, .data = data};
+	struct epoll_event event = {.events = events, .data.ptr = source};
+	if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+		LOG_ERROR("Could not add fd %d to the reactor: %s\n", fd, strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+bool
+reactor_init(struct reactor* reactor)
+{
+	atomic_init(&reactor->stopping, false);
+	reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (reactor->epoll_fd < 0) {
+		LOG_ERROR("Could not create the reactor's epoll: %s\n", strerror(errno));
+		return false;
+	}
+	if (!reactor_add_notifier(reactor, &reactor->stop, NULL, NULL)) {
+		close(reactor->epoll_fd);
+		return false;
+	}
+	return true;
+}
+
+void
+reactor_destroy(struct reactor* reactor)
+{
+	reactor_remove(reactor, &reactor->stop);
+	close(reactor->epoll_fd);
+	reactor->epoll_fd = -1;
+}
+
+bool
+reactor_add_fd(struct reactor* reactor,
+               struct reactor_source* source,
+               int fd,
+               uint32_t events,
+               reactor_fn fn,
+               void* data)
+{
+	return add_source(reactor, source, fd, REACTOR_SOURCE_FD, events, fn, data);
+}
+
+bool
+reactor_add_timer(struct reactor* reactor, struct reactor_source* source, reactor_fn fn, void* data)
+{
+	int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0) {
+		LOG_ERROR("Could not create a reactor timer: %s\n", strerror(errno));
+		return false;
+	}
+	if (!add_source(reactor, source, fd, REACTOR_SOURCE_TIMER, EPOLLIN, fn, data)) {
+		close(fd);
+		return false;
+	}
+	return true;
+}
+
+bool
+reactor_arm_timer(struct reactor_source* timer, int64_t delay_ns, int64_t interval_ns)
+{
+	struct itimerspec spec = {
+	    .it_value = {.tv_sec = delay_ns / 1000000000, .tv_nsec = delay_ns % 1000000000},
+	    .it_interval = {.tv_sec = interval_ns / 1000000000, .tv_nsec = interval_ns % 1000000000},
+	};
+	return timerfd_settime(timer->fd, 0, &spec, NULL) == 0;
+}
+
+bool
+reactor_add_notifier(struct reactor* reactor,
+                     struct reactor_source* source,
+                     reactor_fn fn,
+                     void* data)
+{
+	int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fd < 0) {
+		LOG_ERROR("Could not create a reactor notifier: %s\n", strerror(errno));
+		return false;
+	}
+	if (!add_source(reactor, source, fd, REACTOR_SOURCE_NOTIFIER, EPOLLIN, fn, data)) {
+		close(fd);
+		return false;
+	}
+	return true;
+}
+
+void
+reactor_notify(struct reactor_source* notifier)
+{
+	uint64_t one = 1;
+	// only fails when the counter would overflow, the reactor is woken up anyway then
+	ssize_t written = write(notifier->fd, &one, sizeof(one));
+	(void)written;
+}
+
+void
+reactor_remove(struct reactor* reactor, struct reactor_source* source)
+{
+	if (source->fd < 0)
+		return;
+	epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL);
+	if (source->type != REACTOR_SOURCE_FD)
+		close(source->fd);
+	source->fd = -1;
+}
+
+bool
+reactor_run(struct reactor* reactor)
+{
+	struct epoll_event events[REACTOR_MAX_EVENTS];
+	while (!atomic_load_explicit(&reactor->stopping, memory_order_acquire)) {
+		int count = epoll_wait(reactor->epoll_fd, events, REACTOR_MAX_EVENTS, -1);
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			LOG_ERROR("Reactor epoll_wait failed: %s\n", strerror(errno));
+			return false;
+		}
+
+		for (int i = 0; i < count; i++) {
+			struct reactor_source* source = events[i].data.ptr;
+			if (source->type != REACTOR_SOURCE_FD) {
+				// the expiration or notification count, resets the fd
+				if (read(source->fd, &source->count, sizeof(source->count)) !=
+				    sizeof(source->count))
+					continue;
+			}
+			if (source->fn != NULL)
+				source->fn(source, events[i].events);
+		}
+	}
+	return true;
+}
+
+void
+reactor_stop(struct reactor* reactor)
+{
+	atomic_store_explicit(&reactor->stopping, true, memory_order_release);
+	reactor_notify(&reactor->stop);
+}
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief epoll event loop with timerfd timers and eventfd notifiers.
+ *
+ * One thread runs reactor_run() and every callback. A source is embedded in the state of its user:
+ * a socket added with reactor_add_fd(), a timer (timerfd) added with reactor_add_timer() and armed
+ * with reactor_arm_timer(), or a notifier (eventfd) added with reactor_add_notifier() that any
+ * thread triggers with reactor_notify(). Timers and notifiers are read before their callback runs,
+ * so one callback covers every expiration or notification since the last one, source->count says
+ * how many. Sockets are level triggered, a callback may leave data for the next round.
+ *
+ * The thread sleeps in epoll_wait() until a source is ready, there is no polling interval.
+ */
+
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+struct reactor_source;
+
+// events are the EPOLL* flags for sockets, EPOLLIN for timers and notifiers
+typedef void (*reactor_fn)(struct reactor_source* source, uint32_t events);
+
+enum reactor_source_type
+{
+	REACTOR_SOURCE_FD,
+	REACTOR_SOURCE_TIMER,
+	REACTOR_SOURCE_NOTIFIER,
+};
+
+struct reactor_source
+{
+	int fd;
+	enum reactor_source_type type;
+	reactor_fn fn;
+	void* data;
+	// expirations or notifications handled by this callback
+	uint64_t count;
+};
+
+struct reactor
+{
+	int epoll_fd;
+	// reactor_stop() wakes reactor_run() through it
+	struct reactor_source stop;
+	_Atomic bool stopping;
+};
+
+bool
+reactor_init(struct reactor* reactor);
+
+// closes the epoll and the stop eventfd, sources are closed with reactor_remove()
+void
+reactor_destroy(struct reactor* reactor);
+
+// fd stays owned by the caller
+bool
+reactor_add_fd(struct reactor* reactor,
+               struct reactor_source* source,
+               int fd,
+               uint32_t events,
+               reactor_fn fn,
+               void* data);
+
+// disarmed until reactor_arm_timer()
+bool
+reactor_add_timer(struct reactor* reactor,
+                  struct reactor_source* source,
+                  reactor_fn fn,
+                  void* data);
+
+// fires after delay_ns, then every interval_ns unless that is 0. A delay of 0 disarms the timer.
+bool
+reactor_arm_timer(struct reactor_source* timer, int64_t delay_ns, int64_t interval_ns);
+
+bool
+reactor_add_notifier(struct reactor* reactor,
+                     struct reactor_source* source,
+                     reactor_fn fn,
+                     void* data);
+
+// from any thread, the notifier's callback runs once for all notifications since its last run
+void
+reactor_notify(struct reactor_source* notifier);
+
+// closes the fd of timers and notifiers
+void
+reactor_remove(struct reactor* reactor, struct reactor_source* source);
+
+// runs callbacks until reactor_stop(), false on an epoll error
+bool
+reactor_run(struct reactor* reactor);
+
+// from any thread, also before reactor_run() started
+void
+reactor_stop(struct reactor* reactor);
+
+#endif // REACTOR_H
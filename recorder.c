@@ -0,0 +1,499 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Binary session recorder and reader, see recorder.h.
+ */
+
+#define _GNU_SOURCE
+#include "recorder.h"
+#include "spsc_ring.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// staging slots per producer thread, 2 MiB per thread
+#define REC_RING_SLOTS 1024
+#define REC_SLOT_SIZE 2048
+#define REC_FLUSH_POLL_NS 1000000
+#define REC_HEADER_SIZE 4096
+
+_Static_assert(sizeof(struct rec_header) + REC_MAX_PAYLOAD <= REC_SLOT_SIZE, "slot too small");
+_Static_assert(sizeof(struct rec_joints) <= REC_MAX_PAYLOAD, "joint record too large");
+
+struct rec_stream
+{
+	struct spsc_ring ring;
+	_Atomic uint64_t dropped;
+	struct rec_stream* next;
+};
+
+static struct
+{
+	_Atomic bool active;
+	_Atomic bool stop;
+
+	int fd;
+	uint32_t chunk_size;
+	struct rec_file_header* header;
+
+	// chunk currently being filled, only touched by the flush thread
+	uint8_t* chunk;
+	struct rec_chunk_header* chunk_header;
+
+	struct rec_index_entry* index;
+	uint64_t index_capacity;
+
+	pthread_t flusher;
+	pthread_mutex_t streams_mutex;
+	_Atomic(struct rec_stream*) streams;
+} recorder = {.fd = -1, .streams_mutex = PTHREAD_MUTEX_INITIALIZER};
+
+static _Thread_local struct rec_stream* tls_stream;
+static _Thread_local struct rec_header* tls_pending;
+
+static inline int64_t
+clock_ns(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+static inline uint32_t
+record_span(uint32_t payload_size)
+{
+	return (uint32_t)((sizeof(struct rec_header) + payload_size + 7u) & ~7u);
+}
+
+// --- flush thread
+
+static void
+finish_chunk(void)
+{
+	if (recorder.chunk == NULL)
+		return;
+
+	struct rec_index_entry* entry = &recorder.index[recorder.header->chunk_count - 1];
+	entry->first_mono_ns = recorder.chunk_header->first_mono_ns;
+	entry->last_mono_ns = recorder.chunk_header->last_mono_ns;
+	entry->record_count = recorder.chunk_header->record_count;
+
+	msync(recorder.chunk, recorder.chunk_size, MS_ASYNC);
+	munmap(recorder.chunk, recorder.chunk_size);
+	recorder.chunk = NULL;
+	recorder.chunk_header = NULL;
+}
+
+static bool
+start_chunk(void)
+{
+	finish_chunk();
+
+	uint64_t n = recorder.header->chunk_count;
+	off_t offset = REC_HEADER_SIZE + (off_t)n * recorder.chunk_size;
+
+	// allocate blocks up front so a full disk fails here and not with SIGBUS on a store
+	int err = posix_fallocate(recorder.fd, offset, recorder.chunk_size);
+	if (err != 0 && ftruncate(recorder.fd, offset + recorder.chunk_size) != 0) {
+		perror("recorder: growing recording failed");
+		return false;
+	}
+
+	void* chunk = mmap(NULL, recorder.chunk_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	                   recorder.fd, offset);
+	if (chunk == MAP_FAILED) {
+		perror("recorder: mapping chunk failed");
+		return false;
+	}
+
+	if (n == recorder.index_capacity) {
+		uint64_t capacity = recorder.index_capacity ? recorder.index_capacity * 2 : 64;
+		struct rec_index_entry* index = realloc(recorder.index, capacity * sizeof(*index));
+		if (index == NULL) {
+			munmap(chunk, recorder.chunk_size);
+			return false;
+		}
+		recorder.index = index;
+		recorder.index_capacity = capacity;
+	}
+	recorder.index[n] = (struct rec_index_entry){.offset = (uint64_t)offset};
+
+	recorder.chunk = chunk;
+	recorder.chunk_header = chunk;
+	*recorder.chunk_header = (struct rec_chunk_header){
+	    .magic = RECORDING_CHUNK_MAGIC,
+	    .used = sizeof(struct rec_chunk_header),
+	};
+	recorder.header->chunk_count = n + 1;
+	return true;
+}
+
+static bool
+append(const struct rec_header* hdr)
+{
+	uint32_t span = record_span(hdr->size);
+
+	if (recorder.chunk == NULL || recorder.chunk_header->used + span > recorder.chunk_size) {
+		if (!start_chunk())
+			return false;
+	}
+
+	struct rec_chunk_header* ch = recorder.chunk_header;
+	memcpy(recorder.chunk + ch->used, hdr, sizeof(*hdr) + hdr->size);
+	if (ch->record_count == 0)
+		ch->first_mono_ns = hdr->mono_ns;
+	ch->last_mono_ns = hdr->mono_ns;
+	ch->record_count++;
+	ch->used += span;
+	recorder.header->record_count++;
+	return true;
+}
+
+// moves every staged record into the file, returns the number of records moved
+static uint32_t
+flush_streams(void)
+{
+	uint32_t moved = 0;
+	for (struct rec_stream* s = atomic_load_explicit(&recorder.streams, memory_order_acquire); s;
+	     s = s->next) {
+		const struct rec_header* hdr;
+		while ((hdr = spsc_ring_peek(&s->ring)) != NULL) {
+			if (!append(hdr))
+				atomic_fetch_add_explicit(&s->dropped, 1, memory_order_relaxed);
+			spsc_ring_release(&s->ring);
+			moved++;
+		}
+	}
+	return moved;
+}
+
+static void*
+flush_thread(void* arg)
+{
+	(void)arg;
+	struct timespec poll = {.tv_sec = 0, .tv_nsec = REC_FLUSH_POLL_NS};
+
+	while (!atomic_load_explicit(&recorder.stop, memory_order_acquire)) {
+		if (flush_streams() == 0)
+			nanosleep(&poll, NULL);
+	}
+	flush_streams();
+	return NULL;
+}
+
+// --- producer side
+
+bool
+recorder_open(const char* path)
+{
+	if (atomic_load(&recorder.active))
+		return false;
+
+	recorder.fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (recorder.fd < 0) {
+		perror("recorder: opening recording failed");
+		return false;
+	}
+
+	if (ftruncate(recorder.fd, REC_HEADER_SIZE) != 0) {
+		perror("recorder: ftruncate failed");
+		close(recorder.fd);
+		return false;
+	}
+
+	recorder.header =
+	    mmap(NULL, REC_HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, recorder.fd, 0);
+	if (recorder.header == MAP_FAILED) {
+		perror("recorder: mapping header failed");
+		close(recorder.fd);
+		return false;
+	}
+
+	recorder.chunk_size = RECORDING_DEFAULT_CHUNK_SIZE;
+	*recorder.header = (struct rec_file_header){
+	    .version = RECORDING_VERSION,
+	    .chunk_size = recorder.chunk_size,
+	    .start_mono_ns = clock_ns(CLOCK_MONOTONIC),
+	    .start_real_ns = clock_ns(CLOCK_REALTIME),
+	};
+	memcpy(recorder.header->magic, RECORDING_MAGIC, sizeof(recorder.header->magic));
+
+	if (!start_chunk()) {
+		munmap(recorder.header, REC_HEADER_SIZE);
+		close(recorder.fd);
+		return false;
+	}
+
+	atomic_store(&recorder.stop, false);
+	if (pthread_create(&recorder.flusher, NULL, flush_thread, NULL) != 0) {
+		perror("pthread_create for recorder failed");
+		finish_chunk();
+		munmap(recorder.header, REC_HEADER_SIZE);
+		close(recorder.fd);
+		return false;
+	}
+
+	atomic_store_explicit(&recorder.active, true, memory_order_release);
+	printf("Recording session to %s\n", path);
+	return true;
+}
+
+void
+recorder_close(void)
+{
+	if (!atomic_load(&recorder.active))
+		return;
+
+	// staging rings stay allocated, a producer racing with close only loses its record
+	atomic_store_explicit(&recorder.active, false, memory_order_release);
+	atomic_store_explicit(&recorder.stop, true, memory_order_release);
+	pthread_join(recorder.flusher, NULL);
+
+	// trim the unused tail of the last chunk and append the index behind it
+	uint64_t chunks = recorder.header->chunk_count;
+	uint64_t end = REC_HEADER_SIZE + (uint64_t)chunks * recorder.chunk_size;
+	if (recorder.chunk_header != NULL)
+		end += recorder.chunk_header->used - recorder.chunk_size;
+	finish_chunk();
+
+	size_t index_size = chunks * sizeof(struct rec_index_entry);
+	if (ftruncate(recorder.fd, (off_t)end) != 0 ||
+	    pwrite(recorder.fd, recorder.index, index_size, (off_t)end) != (ssize_t)index_size) {
+		perror("recorder: writing index failed");
+	} else {
+		recorder.header->index_offset = end;
+	}
+
+	uint64_t dropped = 0;
+	for (struct rec_stream* s = atomic_load(&recorder.streams); s; s = s->next)
+		dropped += atomic_load(&s->dropped);
+
+	printf("Recording closed: %lu records in %lu chunks, %lu dropped\n",
+	       (unsigned long)recorder.header->record_count, (unsigned long)chunks,
+	       (unsigned long)dropped);
+
+	msync(recorder.header, REC_HEADER_SIZE, MS_SYNC);
+	munmap(recorder.header, REC_HEADER_SIZE);
+	close(recorder.fd);
+	recorder.fd = -1;
+
+	free(recorder.index);
+	recorder.index = NULL;
+	recorder.index_capacity = 0;
+}
+
+bool
+recorder_active(void)
+{
+	return atomic_load_explicit(&recorder.active, memory_order_relaxed);
+}
+
+static struct rec_stream*
+register_stream(void)
+{
+	struct rec_stream* s = calloc(1, sizeof(*s));
+	if (s == NULL)
+		return NULL;
+	if (!spsc_ring_init(&s->ring, REC_RING_SLOTS, REC_SLOT_SIZE)) {
+		free(s);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&recorder.streams_mutex);
+	s->next = atomic_load(&recorder.streams);
+	atomic_store_explicit(&recorder.streams, s, memory_order_release);
+	pthread_mutex_unlock(&recorder.streams_mutex);
+
+	tls_stream = s;
+	return s;
+}
+
+void*
+recorder_begin(enum rec_type type, uint32_t size)
+{
+	if (!atomic_load_explicit(&recorder.active, memory_order_acquire) || size > REC_MAX_PAYLOAD)
+		return NULL;
+
+	struct rec_stream* s = tls_stream;
+	if (s == NULL && (s = register_stream()) == NULL)
+		return NULL;
+
+	struct rec_header* hdr = spsc_ring_reserve(&s->ring);
+	if (hdr == NULL) {
+		atomic_fetch_add_explicit(&s->dropped, 1, memory_order_relaxed);
+		return NULL;
+	}
+
+	*hdr = (struct rec_header){
+	    .type = (uint16_t)type,
+	    .size = size,
+	    .mono_ns = clock_ns(CLOCK_MONOTONIC),
+	};
+	tls_pending = hdr;
+	return hdr + 1;
+}
+
+void
+recorder_commit(void)
+{
+	if (tls_pending == NULL)
+		return;
+	tls_pending = NULL;
+	spsc_ring_commit(&tls_stream->ring);
+}
+
+bool
+recorder_write(enum rec_type type, const void* payload, uint32_t size)
+{
+	void* dst = recorder_begin(type, size);
+	if (dst == NULL)
+		return false;
+	memcpy(dst, payload, size);
+	recorder_commit();
+	return true;
+}
+
+
+// --- reading
+
+static bool
+rebuild_index(struct recording* rec)
+{
+	const struct rec_file_header* fh = rec->header;
+	uint64_t capacity = fh->chunk_count ? fh->chunk_count : 1;
+	rec->index = calloc(capacity, sizeof(*rec->index));
+	if (rec->index == NULL)
+		return false;
+	rec->owns_index = true;
+
+	rec->chunk_count = 0;
+	for (uint64_t offset = REC_HEADER_SIZE;
+	     offset + sizeof(struct rec_chunk_header) <= rec->size && rec->chunk_count < capacity;
+	     offset += fh->chunk_size) {
+		const struct rec_chunk_header* ch = (const void*)(rec->data + offset);
+		if (ch->magic != RECORDING_CHUNK_MAGIC || offset + ch->used > rec->size)
+			break;
+		rec->index[rec->chunk_count++] = (struct rec_index_entry){
+		    .offset = offset,
+		    .first_mono_ns = ch->first_mono_ns,
+		    .last_mono_ns = ch->last_mono_ns,
+		    .record_count = ch->record_count,
+		};
+	}
+	return true;
+}
+
+bool
+recording_open(struct recording* rec, const char* path)
+{
+	*rec = (struct recording){0};
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		perror("recording: open failed");
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < REC_HEADER_SIZE) {
+		printf("recording: %s is too small to be a recording\n", path);
+		close(fd);
+		return false;
+	}
+
+	void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		perror("recording: mmap failed");
+		return false;
+	}
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+	rec->data = data;
+	rec->size = st.st_size;
+	rec->header = data;
+
+	const struct rec_file_header* fh = rec->header;
+	if (memcmp(fh->magic, RECORDING_MAGIC, sizeof(fh->magic)) != 0 ||
+	    fh->version != RECORDING_VERSION || fh->chunk_size == 0) {
+		printf("recording: %s is not a version %d recording\n", path, RECORDING_VERSION);
+		recording_close(rec);
+		return false;
+	}
+
+	if (fh->index_offset != 0 &&
+	    fh->index_offset + fh->chunk_count * sizeof(struct rec_index_entry) <= rec->size) {
+		rec->index = (struct rec_index_entry*)(rec->data + fh->index_offset);
+		rec->chunk_count = fh->chunk_count;
+	} else {
+		printf("recording: %s was not closed cleanly, scanning chunks\n", path);
+		if (!rebuild_index(rec)) {
+			recording_close(rec);
+			return false;
+		}
+	}
+
+	recording_seek(rec, INT64_MIN);
+	return true;
+}
+
+void
+recording_close(struct recording* rec)
+{
+	if (rec->owns_index)
+		free(rec->index);
+	if (rec->data)
+		munmap((void*)rec->data, rec->size);
+	*rec = (struct recording){0};
+}
+
+void
+recording_seek(struct recording* rec, int64_t mono_ns)
+{
+	// first chunk whose last record is not before mono_ns
+	uint64_t lo = 0, hi = rec->chunk_count;
+	while (lo < hi) {
+		uint64_t mid = lo + (hi - lo) / 2;
+		if (rec->index[mid].last_mono_ns < mono_ns)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	rec->chunk = lo;
+	rec->offset = sizeof(struct rec_chunk_header);
+}
+
+const struct rec_header*
+recording_next(struct recording* rec)
+{
+	while (rec->chunk < rec->chunk_count) {
+		const struct rec_index_entry* entry = &rec->index[rec->chunk];
+		const struct rec_chunk_header* ch = (const void*)(rec->data + entry->offset);
+
+		// a corrupt index entry or a chunk cut off by a crash is skipped, and so is the rest of a
+		// chunk once a record claims to run past its end
+		bool chunk_valid = entry->offset <= rec->size &&
+		                   rec->size - entry->offset >= sizeof(struct rec_chunk_header) &&
+		                   ch->used <= rec->size - entry->offset;
+		if (chunk_valid && rec->offset + sizeof(struct rec_header) <= ch->used) {
+			const struct rec_header* hdr = (const void*)(rec->data + entry->offset + rec->offset);
+			// 64 bit, record_span() would wrap for a garbage size
+			uint64_t span = (sizeof(struct rec_header) + (uint64_t)hdr->size + 7u) & ~(uint64_t)7u;
+			if (rec->offset + span <= ch->used) {
+				rec->offset += span;
+				return hdr;
+			}
+		}
+
+		rec->chunk++;
+		rec->offset = sizeof(struct rec_chunk_header);
+	}
+	return NULL;
+}
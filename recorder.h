@@ -0,0 +1,239 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Binary session recorder and reader.
+ *
+ * Producer threads write records into per-thread SPSC staging rings; a background flush thread
+ * copies them into a memory-mapped file that grows in fixed-size chunks. The recording threads
+ * never issue a syscall for a record.
+ *
+ * File layout:
+ *
+ *   | file header (one page) | chunk 0 | chunk 1 | ... | chunk index |
+ *
+ * Every chunk starts with a chunk header followed by 8 byte aligned records that never straddle
+ * a chunk boundary. The chunk index (one entry per chunk with its time range) is appended when the
+ * recording is closed; a recording that was not closed cleanly is still readable by walking the
+ * chunk headers.
+ */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "openxr_headers/openxr.h"
+
+#define RECORDING_MAGIC "LISREC01"
+#define RECORDING_VERSION 1
+#define RECORDING_CHUNK_MAGIC 0x4b4e4843u // "CHNK"
+#define RECORDING_DEFAULT_CHUNK_SIZE (4u << 20)
+
+enum rec_type
+{
+	REC_FRAME = 1,
+	REC_JOINTS = 2,
+	REC_ACTION = 3,
+	REC_VIDEO = 4,
+	REC_FRAME_TIMING = 5,
+};
+
+// ids of recorded actions, stored in rec_action.action
+enum rec_action_id
+{
+	REC_ACTION_NONE = 0,
+	REC_ACTION_GRAB,
+	REC_ACTION_ACCELERATE,
+	REC_ACTION_HAND_POSE,
+	REC_ACTION_AIM,
+	// vive tracker role i is recorded as REC_ACTION_VIVE_TRACKER + i
+	REC_ACTION_VIVE_TRACKER = 16,
+};
+
+struct rec_file_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t chunk_size;
+	uint64_t chunk_count;
+	uint64_t record_count;
+	// 0 if the recording was not closed
+	uint64_t index_offset;
+	// CLOCK_MONOTONIC and CLOCK_REALTIME when recording started
+	int64_t start_mono_ns;
+	int64_t start_real_ns;
+};
+
+struct rec_chunk_header
+{
+	uint32_t magic;
+	uint32_t record_count;
+	// bytes used in this chunk including the header
+	uint64_t used;
+	int64_t first_mono_ns;
+	int64_t last_mono_ns;
+};
+
+struct rec_index_entry
+{
+	uint64_t offset;
+	int64_t first_mono_ns;
+	int64_t last_mono_ns;
+	uint64_t record_count;
+};
+
+struct rec_header
+{
+	uint16_t type;
+	uint16_t reserved;
+	// payload size in bytes, the record occupies sizeof(header) + size rounded up to 8
+	uint32_t size;
+	// CLOCK_MONOTONIC when the data was captured
+	int64_t mono_ns;
+};
+
+// XrFrameState as returned by xrWaitFrame()
+struct rec_frame
+{
+	uint64_t frame_index;
+	XrTime predicted_display_time;
+	XrDuration predicted_display_period;
+	uint32_t should_render;
+	uint32_t reserved;
+};
+
+// one hand as returned by xrLocateHandJointsEXT()
+struct rec_joints
+{
+	XrTime time;
+	uint32_t hand;
+	uint32_t is_active;
+	uint32_t has_velocities;
+	uint32_t reserved;
+	XrHandJointLocationEXT joints[XR_HAND_JOINT_COUNT_EXT];
+	XrHandJointVelocityEXT velocities[XR_HAND_JOINT_COUNT_EXT];
+};
+
+// one subaction path of an action as read by update_action_data()
+struct rec_action
+{
+	XrTime time;
+	uint32_t action;
+	uint32_t subaction;
+	uint32_t action_type;
+	uint32_t is_active;
+	uint32_t changed_since_last_sync;
+	uint32_t has_velocity;
+	// float and boolean states use value[0], vector2f states both
+	float value[2];
+	XrSpaceLocationFlags location_flags;
+	XrPosef pose;
+	XrSpaceVelocityFlags velocity_flags;
+	XrVector3f linear_velocity;
+	XrVector3f angular_velocity;
+};
+
+enum rec_video_status
+{
+	REC_VIDEO_COMPLETE = 0,
+	REC_VIDEO_SKIPPED = 1,
+};
+
+// arrival of one video frame on the UDP receiver
+struct rec_video
+{
+	uint32_t frame_id;
+	uint32_t status;
+	int32_t width;
+	int32_t height;
+	uint32_t bytes;
+	uint32_t reserved;
+	// CLOCK_MONOTONIC of the TextureInfo header that started the frame
+	int64_t first_packet_mono_ns;
+};
+
+// stage stamps of one frame, indexed by enum frame_stage of frame_timing.h
+#define REC_FRAME_TIMING_STAGES 16
+
+struct rec_frame_timing
+{
+	uint64_t frame_index;
+	XrTime display_time;
+	XrDuration display_period;
+	uint32_t stage_count;
+	uint32_t reserved;
+	// CLOCK_MONOTONIC, start 0 if the stage did not run
+	int64_t start_ns[REC_FRAME_TIMING_STAGES];
+	int64_t duration_ns[REC_FRAME_TIMING_STAGES];
+};
+
+// largest payload a single record may carry
+#define REC_MAX_PAYLOAD 2032
+
+
+// --- writing
+
+bool
+recorder_open(const char* path);
+
+// flushes everything queued, writes the chunk index and closes the file
+void
+recorder_close(void);
+
+bool
+recorder_active(void);
+
+// reserves a record of the calling thread's staging ring, returns NULL if not recording or the
+// ring is full (the record is then counted as dropped). Must be followed by recorder_commit().
+void*
+recorder_begin(enum rec_type type, uint32_t size);
+
+void
+recorder_commit(void);
+
+// copying convenience wrapper around recorder_begin()/recorder_commit()
+bool
+recorder_write(enum rec_type type, const void* payload, uint32_t size);
+
+
+// --- reading
+
+struct recording
+{
+	const uint8_t* data;
+	size_t size;
+	const struct rec_file_header* header;
+
+	// either the index stored in the file or one rebuilt from the chunk headers
+	struct rec_index_entry* index;
+	uint64_t chunk_count;
+	bool owns_index;
+
+	// iteration state
+	uint64_t chunk;
+	uint64_t offset;
+};
+
+bool
+recording_open(struct recording* rec, const char* path);
+
+void
+recording_close(struct recording* rec);
+
+// positions the iterator at the first chunk that may contain records at or after mono_ns
+void
+recording_seek(struct recording* rec, int64_t mono_ns);
+
+// returns the next record header (payload follows it) or NULL at the end of the recording
+const struct rec_header*
+recording_next(struct recording* rec);
+
+static inline const void*
+rec_payload(const struct rec_header* hdr)
+{
+	return hdr + 1;
+}
+
+#endif // RECORDER_H
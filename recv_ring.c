@@ -0,0 +1,238 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief io_uring multishot datagram receive, see recv_ring.h.
+ *
+ * Uses the raw io_uring syscalls and the kernel's uapi header, the queue only ever holds the one
+ * multishot receive so liburing would add nothing but a dependency.
+ */
+
+#include "recv_ring.h"
+#include "logger.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// the multishot receive and room for arming it again while the old one completes
+#define SUBMISSION_ENTRIES 2
+#define BUFFER_GROUP 0
+
+static int
+uring_setup(uint32_t entries, struct io_uring_params* params)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int
+uring_enter(int fd, uint32_t to_submit)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, 0, 0, NULL, 0);
+}
+
+static int
+uring_register(int fd, uint32_t opcode, void* arg, uint32_t arg_count)
+{
+	return (int)syscall(__NR_io_uring_register, fd, opcode, arg, arg_count);
+}
+
+// hands buffer id back to the kernel, visible after publish_buffers()
+static void
+give_buffer(struct recv_ring* ring, uint16_t id)
+{
+	struct io_uring_buf* buffer =
+	    &ring->buffer_ring->bufs[ring->buffer_tail & (ring->buffer_count - 1)];
+	buffer->addr = (uintptr_t)frame_pool_frame(&ring->buffers, id);
+	buffer->len = RECV_RING_BUFFER_SIZE;
+	buffer->bid = id;
+	ring->buffer_tail++;
+}
+
+static void
+publish_buffers(struct recv_ring* ring)
+{
+	atomic_store_explicit((_Atomic uint16_t*)&ring->buffer_ring->tail, ring->buffer_tail,
+	                      memory_order_release);
+}
+
+static bool
+arm(struct recv_ring* ring)
+{
+	uint32_t tail = atomic_load_explicit(ring->sq_tail, memory_order_relaxed);
+	uint32_t index = tail & ring->sq_mask;
+	struct io_uring_sqe* sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = ring->socket_fd;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = BUFFER_GROUP;
+	ring->sq_array[index] = index;
+	atomic_store_explicit(ring->sq_tail, tail + 1, memory_order_release);
+
+	if (uring_enter(ring->ring_fd, 1) != 1) {
+		LOG_WARN("Could not submit the io_uring receive: %s\n", strerror(errno));
+		return false;
+	}
+	ring->armed = true;
+	return true;
+}
+
+static bool
+map_rings(struct recv_ring* ring, const struct io_uring_params* params)
+{
+	size_t sq_size = params->sq_off.array + params->sq_entries * sizeof(uint32_t);
+	size_t cq_size = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+	ring->rings_size = sq_size > cq_size ? sq_size : cq_size;
+	ring->rings = mmap(NULL, ring->rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	                   ring->ring_fd, IORING_OFF_SQ_RING);
+	if (ring->rings == MAP_FAILED) {
+		ring->rings = NULL;
+		return false;
+	}
+	ring->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	                  ring->ring_fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		ring->sqes = NULL;
+		return false;
+	}
+
+	uint8_t* rings = ring->rings;
+	ring->sq_tail = (_Atomic uint32_t*)(rings + params->sq_off.tail);
+	ring->sq_array = (uint32_t*)(rings + params->sq_off.array);
+	ring->sq_mask = *(uint32_t*)(rings + params->sq_off.ring_mask);
+	ring->cq_head = (_Atomic uint32_t*)(rings + params->cq_off.head);
+	ring->cq_tail = (_Atomic uint32_t*)(rings + params->cq_off.tail);
+	ring->cqes = (struct io_uring_cqe*)(rings + params->cq_off.cqes);
+	ring->cq_mask = *(uint32_t*)(rings + params->cq_off.ring_mask);
+	return true;
+}
+
+static bool
+register_buffers(struct recv_ring* ring, enum frame_pool_pages pages, bool lock)
+{
+	struct frame_pool_config config = {.name = "io_uring receive buffers",
+	                                   .max_width = RECV_RING_BUFFER_SIZE,
+	                                   .max_height = 1,
+	                                   .bytes_per_pixel = 1,
+	                                   .frame_count = ring->buffer_count,
+	                                   .pages = pages,
+	                                   .lock = lock};
+	if (!frame_pool_init(&ring->buffers, &config))
+		return false;
+
+	// the kernel wants the ring page aligned, which mmap() is
+	ring->buffer_ring_size = ring->buffer_count * sizeof(struct io_uring_buf);
+	ring->buffer_ring = mmap(NULL, ring->buffer_ring_size, PROT_READ | PROT_WRITE,
+	                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if (ring->buffer_ring == MAP_FAILED) {
+		ring->buffer_ring = NULL;
+		return false;
+	}
+
+	struct io_uring_buf_reg reg = {.ring_addr = (uintptr_t)ring->buffer_ring,
+	                               .ring_entries = ring->buffer_count,
+	                               .bgid = BUFFER_GROUP};
+	if (uring_register(ring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+		LOG_INFO("No io_uring provided buffer rings (%s)\n", strerror(errno));
+		return false;
+	}
+	for (uint32_t id = 0; id < ring->buffer_count; id++)
+		give_buffer(ring, (uint16_t)id);
+	publish_buffers(ring);
+	return true;
+}
+
+bool
+recv_ring_init(struct recv_ring* ring,
+               int socket_fd,
+               uint32_t buffer_count,
+               enum frame_pool_pages pages,
+               bool lock)
+{
+	memset(ring, 0, sizeof(*ring));
+	ring->socket_fd = socket_fd;
+	ring->buffer_count = buffer_count;
+	if (buffer_count == 0 || buffer_count > 32768 || (buffer_count & (buffer_count - 1)) != 0) {
+		LOG_ERROR("io_uring receive needs a power of two up to 32768 buffers, not %u\n",
+		          buffer_count);
+		ring->ring_fd = -1;
+		return false;
+	}
+
+	// a completion per datagram, room for two rounds of buffers between two batches
+	struct io_uring_params params = {.flags = IORING_SETUP_CQSIZE, .cq_entries = buffer_count * 2};
+	ring->ring_fd = uring_setup(SUBMISSION_ENTRIES, &params);
+	if (ring->ring_fd < 0) {
+		LOG_INFO("No io_uring (%s)\n", strerror(errno));
+		return false;
+	}
+	if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0 || !map_rings(ring, &params) ||
+	    !register_buffers(ring, pages, lock) || !arm(ring)) {
+		recv_ring_destroy(ring);
+		return false;
+	}
+	return true;
+}
+
+void
+recv_ring_destroy(struct recv_ring* ring)
+{
+	// cancels the receive and drops the buffer ring registration
+	if (ring->ring_fd >= 0)
+		close(ring->ring_fd);
+	ring->ring_fd = -1;
+	if (ring->buffer_ring != NULL)
+		munmap(ring->buffer_ring, ring->buffer_ring_size);
+	if (ring->sqes != NULL)
+		munmap(ring->sqes, ring->sqes_size);
+	if (ring->rings != NULL)
+		munmap(ring->rings, ring->rings_size);
+	ring->buffer_ring = NULL;
+	ring->sqes = NULL;
+	ring->rings = NULL;
+	frame_pool_destroy(&ring->buffers);
+	ring->armed = false;
+}
+
+int
+recv_ring_consume(struct recv_ring* ring, recv_ring_fn fn, void* user)
+{
+	uint32_t head = atomic_load_explicit(ring->cq_head, memory_order_relaxed);
+	uint32_t tail = atomic_load_explicit(ring->cq_tail, memory_order_acquire);
+	int datagrams = 0;
+	int error = 0;
+	for (; head != tail; head++) {
+		const struct io_uring_cqe* cqe = &ring->cqes[head & ring->cq_mask];
+		// the kernel ended the receive, after an error or with no buffer left (ENOBUFS)
+		if ((cqe->flags & IORING_CQE_F_MORE) == 0)
+			ring->armed = false;
+		if (cqe->flags & IORING_CQE_F_BUFFER) {
+			uint16_t id = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+			fn(frame_pool_frame(&ring->buffers, id), cqe->res, user);
+			give_buffer(ring, id);
+			datagrams++;
+		} else if (cqe->res < 0 && cqe->res != -ENOBUFS) {
+			error = -cqe->res;
+		}
+	}
+	atomic_store_explicit(ring->cq_head, head, memory_order_release);
+	publish_buffers(ring);
+
+	ring->datagrams += datagrams;
+	ring->batches += datagrams > 0;
+	if (error != 0) {
+		LOG_WARN("io_uring receive failed: %s\n", strerror(error));
+		return -1;
+	}
+	if (!ring->armed) {
+		ring->rearms++;
+		if (!arm(ring))
+			return -1;
+	}
+	return datagrams;
+}
@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief io_uring datagram receive with a multishot receive and a provided buffer ring.
+ *
+ * One multishot IORING_OP_RECV stays armed on the socket and the kernel picks a buffer from a
+ * provided buffer ring for every datagram, so receiving costs no syscall per datagram. The buffers
+ * are the frames of a frame pool (frame_pool.h): mapped, pre-faulted and optionally locked or on
+ * huge pages once, 64 KiB each so that any UDP datagram fits.
+ *
+ * The ring's fd becomes readable when completions are queued, it is added to a reactor like a
+ * socket and recv_ring_consume() handles every queued completion as one batch: each datagram is
+ * handed to a callback, its buffer goes back to the kernel after it returns and the completion
+ * queue head and buffer ring tail are published once per batch. A receive the kernel ended (all
+ * buffers in use) is armed again after the batch.
+ *
+ * Kernels without io_uring, provided buffer rings (5.19) or multishot receive (6.0), and systems
+ * that disabled io_uring, make recv_ring_init() or the first recv_ring_consume() fail, the caller
+ * then receives with recvfrom().
+ */
+
+#ifndef RECV_RING_H
+#define RECV_RING_H
+
+#include "frame_pool.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// the largest UDP payload, rounded up to pages
+#define RECV_RING_BUFFER_SIZE 65536
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+// data is valid until the callback returns
+typedef void (*recv_ring_fn)(const uint8_t* data, int bytes, void* user);
+
+struct recv_ring
+{
+	int ring_fd;
+	int socket_fd;
+
+	void* rings;
+	size_t rings_size;
+	struct io_uring_sqe* sqes;
+	size_t sqes_size;
+	_Atomic uint32_t* sq_tail;
+	uint32_t* sq_array;
+	uint32_t sq_mask;
+	_Atomic uint32_t* cq_head;
+	_Atomic uint32_t* cq_tail;
+	struct io_uring_cqe* cqes;
+	uint32_t cq_mask;
+
+	struct io_uring_buf_ring* buffer_ring;
+	size_t buffer_ring_size;
+	uint16_t buffer_tail;
+	uint32_t buffer_count;
+	// buffer i is frame i
+	struct frame_pool buffers;
+
+	// a multishot receive is queued in the kernel
+	bool armed;
+
+	uint64_t datagrams;
+	uint64_t batches;
+	uint64_t rearms;
+};
+
+// buffer_count is a power of two up to 32768, pages and lock as in frame_pool_config. False if
+// io_uring or provided buffer rings are not available, the ring is then empty.
+bool
+recv_ring_init(struct recv_ring* ring,
+               int socket_fd,
+               uint32_t buffer_count,
+               enum frame_pool_pages pages,
+               bool lock);
+
+void
+recv_ring_destroy(struct recv_ring* ring);
+
+// handles the queued completions, calls fn for every datagram. Returns the number of datagrams,
+// -1 if the kernel rejected the receive, the caller then falls back to recvfrom().
+int
+recv_ring_consume(struct recv_ring* ring, recv_ring_fn fn, void* user);
+
+#endif // RECV_RING_H
@@ -0,0 +1,531 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Offscreen benchmark of render_frame() and the quad layer upload.
+ *
+ * Creates a surfaceless EGL context, sets up the same gl_renderer_t state as the app and renders
+ * synthetic hand joints, aim poses and a BGR video frame into offscreen textures that stand in for
+ * the OpenXR swapchain images. Reports the CPU time spent submitting each frame and the GPU time
+ * measured with GL_TIME_ELAPSED queries, for every requested per eye resolution. The render passes
+ * and the quad upload are also timed on their own with the gpu_timer.h timestamps the app uses.
+ * With --shadercache the programs are loaded through the same binary cache as in the app, a second
+ * run then reports the warm startup time.
+ *
+ * The pose to submit time runs from sampling the hand joints to the end of the frame. With
+ * --latelatch the joints are sampled again once before the first eye and patched into the draw
+ * list like the app does, so the interval starts there instead of before prepare_scene().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <math.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "gpu_timer.h"
+#include "renderer.h"
+#include "shader_cache.h"
+
+#define VIEW_COUNT 2
+#define SWAPCHAIN_LENGTH 3
+#define JOINT_COUNT XR_HAND_JOINT_COUNT_EXT
+
+// GPU time queries in flight, results are read back this many frames later to not stall the CPU
+#define QUERY_RING 4
+
+struct bench_opts
+{
+	int frames;
+	int warmup;
+	int video_width;
+	int video_height;
+	bool depth;
+	enum stereo_mode stereo_mode;
+	bool late_latch;
+};
+
+struct bench_eye
+{
+	GLuint color[SWAPCHAIN_LENGTH];
+	GLuint depth[SWAPCHAIN_LENGTH];
+};
+
+static int64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// stores the pass times of a frame gpu_timer_next_frame() read back, if that frame is measured
+static void
+collect_gpu_passes(struct gpu_timer* timer, bool measured, int64_t* pass_ns[GPU_STAGE_COUNT],
+                   int pass_count[GPU_STAGE_COUNT])
+{
+	int64_t ns[GPU_STAGE_COUNT];
+	if (!gpu_timer_next_frame(timer, ns) || !measured)
+		return;
+	for (int stage = 0; stage < GPU_STAGE_COUNT; stage++) {
+		if (ns[stage] >= 0)
+			pass_ns[stage][pass_count[stage]++] = ns[stage];
+	}
+}
+
+static int
+cmp_int64(const void* a, const void* b)
+{
+	int64_t x = *(const int64_t*)a;
+	int64_t y = *(const int64_t*)b;
+	return (x > y) - (x < y);
+}
+
+static bool
+init_egl(void)
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+	    (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (!get_platform_display) {
+		printf("EGL_EXT_platform_base not supported\n");
+		return false;
+	}
+
+	EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+		printf("Failed to initialize surfaceless EGL display: 0x%x\n", eglGetError());
+		return false;
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		printf("Failed to bind the OpenGL API\n");
+		return false;
+	}
+
+	// same context version as init_sdl_window(), drivers hand out the newest compatible core
+	// context for it like they do for the app
+	EGLint attribs[] = {EGL_CONTEXT_MAJOR_VERSION,
+	                    3,
+	                    EGL_CONTEXT_MINOR_VERSION,
+	                    2,
+	                    EGL_CONTEXT_OPENGL_PROFILE_MASK,
+	                    EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+	                    EGL_NONE};
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+	if (context == EGL_NO_CONTEXT) {
+		printf("Failed to create OpenGL 3.2 core context: 0x%x\n", eglGetError());
+		return false;
+	}
+
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		printf("Failed to make context current: 0x%x\n", eglGetError());
+		return false;
+	}
+
+	printf("EGL %d.%d, %s, %s\n", major, minor, glGetString(GL_RENDERER), glGetString(GL_VERSION));
+	return true;
+}
+
+// an array texture if layers > 1, like a swapchain created with arraySize = layers
+static GLuint
+create_texture(GLenum internal_format, GLenum format, GLenum type, int w, int h, int layers)
+{
+	GLenum target = layers > 1 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(target, texture);
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (layers > 1)
+		glTexImage3D(target, 0, internal_format, w, h, layers, 0, format, type, NULL);
+	else
+		glTexImage2D(target, 0, internal_format, w, h, 0, format, type, NULL);
+	return texture;
+}
+
+// one eye looking down -z from 2 m in front of the textured rectangle at the origin
+static void
+synthetic_view(XrView* view, int eye)
+{
+	view->type = XR_TYPE_VIEW;
+	view->pose.orientation = (XrQuaternionf){.x = 0, .y = 0, .z = 0, .w = 1};
+	view->pose.position = (XrVector3f){.x = eye == 0 ? -0.032f : 0.032f, .y = 0, .z = 2.0f};
+	view->fov = (XrFovf){.angleLeft = -0.8f, .angleRight = 0.8f, .angleUp = 0.8f, .angleDown = -0.8f};
+}
+
+// hands in front of the viewer with joints spread out like fingers, waving with the frame index
+static void
+synthetic_hands(struct ApplicationState* app, uint64_t frame)
+{
+	struct hand_tracking_t* ht = &app->ext.hand_tracking;
+	float t = (float)frame / 90.0f;
+
+	for (int hand = 0; hand < HAND_COUNT; hand++) {
+		float side = hand == HAND_LEFT_INDEX ? -1.0f : 1.0f;
+		XrVector3f palm = {.x = side * 0.2f, .y = -0.2f + 0.05f * sinf(t + hand), .z = 1.5f};
+
+		ht->joint_locations[hand].type = XR_TYPE_HAND_JOINT_LOCATIONS_EXT;
+		ht->joint_locations[hand].next = NULL;
+		ht->joint_locations[hand].isActive = XR_TRUE;
+		ht->joint_locations[hand].jointCount = JOINT_COUNT;
+		ht->joint_locations[hand].jointLocations = ht->joints[hand];
+
+		for (int i = 0; i < JOINT_COUNT; i++) {
+			int finger = i < 2 ? 0 : (i - 2) / 5;
+			int segment = i < 2 ? 0 : (i - 2) % 5;
+			XrHandJointLocationEXT* joint = &ht->joints[hand][i];
+			joint->locationFlags =
+			    XR_SPACE_LOCATION_POSITION_VALID_BIT | XR_SPACE_LOCATION_ORIENTATION_VALID_BIT;
+			joint->pose.orientation = (XrQuaternionf){.x = 0, .y = 0, .z = 0, .w = 1};
+			joint->pose.position = (XrVector3f){
+			    .x = palm.x + side * (finger - 2) * 0.02f,
+			    .y = palm.y + segment * 0.02f * cosf(t * 2 + finger),
+			    .z = palm.z - segment * 0.01f,
+			};
+			joint->radius = 0.008f;
+		}
+
+		// aim poses point forward from the palm
+		XrSpaceLocation* aim = &app->aim_action.pose_locations[hand];
+		aim->type = XR_TYPE_SPACE_LOCATION;
+		aim->next = NULL;
+		aim->locationFlags = XR_SPACE_LOCATION_POSITION_VALID_BIT | XR_SPACE_LOCATION_ORIENTATION_VALID_BIT;
+		aim->pose.position = palm;
+		aim->pose.orientation = (XrQuaternionf){.x = 0, .y = 0, .z = 0, .w = 1};
+
+		// hand poses are only drawn when there are no joints, keep them invalid
+		XrSpaceLocation* grip = &app->hand_pose_action.pose_locations[hand];
+		grip->type = XR_TYPE_SPACE_LOCATION;
+		grip->next = NULL;
+		grip->locationFlags = 0;
+	}
+}
+
+// moving gradient so every upload carries different data
+static void
+synthetic_video(uint8_t* pixels, int w, int h, uint64_t frame)
+{
+	for (int y = 0; y < h; y++) {
+		uint8_t* row = pixels + (size_t)y * w * 3;
+		for (int x = 0; x < w; x++) {
+			row[x * 3 + 0] = (uint8_t)(x + frame);
+			row[x * 3 + 1] = (uint8_t)(y + frame);
+			row[x * 3 + 2] = (uint8_t)(x ^ y);
+		}
+	}
+}
+
+static void
+print_stats(const char* name, int64_t* samples, int count)
+{
+	if (count == 0) {
+		printf("  %-12s no samples\n", name);
+		return;
+	}
+
+	double sum = 0;
+	for (int i = 0; i < count; i++)
+		sum += (double)samples[i];
+	qsort(samples, count, sizeof(int64_t), cmp_int64);
+
+	printf("  %-12s mean %8.3f ms  p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms\n", name,
+	       sum / count / 1e6, samples[count / 2] / 1e6, samples[(count * 99) / 100] / 1e6,
+	       samples[count - 1] / 1e6);
+}
+
+static bool
+bench_resolution(struct bench_opts* opts, int w, int h)
+{
+	static struct ApplicationState app;
+	memset(&app, 0, sizeof(app));
+
+	// single pass stereo renders into one swapchain of 2 layer array textures
+	bool stereo = opts->stereo_mode != STEREO_OFF;
+	int swapchain_count = stereo ? 1 : VIEW_COUNT;
+	int layers = stereo ? VIEW_COUNT : 1;
+
+	uint32_t swapchain_lengths[VIEW_COUNT] = {SWAPCHAIN_LENGTH, SWAPCHAIN_LENGTH};
+	app.gl_renderer.near_z = 0.01f;
+	app.gl_renderer.far_z = 100.0f;
+	app.gl_renderer.stereo_mode = opts->stereo_mode;
+	app.gl_renderer.FramebufferTextureMultiviewOVR =
+	    (PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC)eglGetProcAddress("glFramebufferTextureMultiviewOVR");
+	if (init_gl(swapchain_count, swapchain_lengths, &app.gl_renderer) != 0)
+		return false;
+
+	// stand-ins for the projection, depth and quad swapchain images
+	struct bench_eye eyes[VIEW_COUNT];
+	for (int i = 0; i < swapchain_count; i++) {
+		for (int j = 0; j < SWAPCHAIN_LENGTH; j++) {
+			eyes[i].color[j] =
+			    create_texture(GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, w, h, layers);
+			eyes[i].depth[j] =
+			    create_texture(GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, w, h, layers);
+		}
+	}
+
+	XrSwapchainImageOpenGLKHR quad_images[SWAPCHAIN_LENGTH];
+	XrSwapchainImageOpenGLKHR* quad_image_arrays[1] = {quad_images};
+	for (int j = 0; j < SWAPCHAIN_LENGTH; j++) {
+		quad_images[j].type = XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_KHR;
+		quad_images[j].next = NULL;
+		quad_images[j].image = create_texture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, opts->video_width,
+		                                      opts->video_height, 1);
+	}
+
+	struct quad_layer_t quad = {
+	    .swapchain = {.images = quad_image_arrays, .swapchain_count = 1},
+	    .pixel_width = opts->video_width,
+	    .pixel_height = opts->video_height,
+	};
+
+	uint8_t* video = malloc((size_t)opts->video_width * opts->video_height * 3);
+	int64_t* cpu_ns = malloc(sizeof(int64_t) * opts->frames);
+	int64_t* gpu_ns = malloc(sizeof(int64_t) * opts->frames);
+	int64_t* pose_ns = malloc(sizeof(int64_t) * opts->frames);
+	int64_t* pass_ns[GPU_STAGE_COUNT];
+	int pass_count[GPU_STAGE_COUNT] = {0};
+	bool allocated = video && cpu_ns && gpu_ns && pose_ns;
+	for (int stage = 0; stage < GPU_STAGE_COUNT; stage++) {
+		pass_ns[stage] = malloc(sizeof(int64_t) * opts->frames);
+		allocated = allocated && pass_ns[stage];
+	}
+	if (!allocated) {
+		printf("Out of memory\n");
+		return false;
+	}
+
+	GLuint queries[QUERY_RING];
+	glGenQueries(QUERY_RING, queries);
+
+	struct gpu_timer gpu_timer;
+	gpu_timer_init(&gpu_timer);
+
+	XrView views[VIEW_COUNT];
+	for (int i = 0; i < VIEW_COUNT; i++)
+		synthetic_view(&views[i], i);
+
+	int cpu_count = 0;
+	int gpu_count = 0;
+	int total = opts->warmup + opts->frames;
+	for (int frame = 0; frame < total; frame++) {
+		bool measured = frame >= opts->warmup;
+		uint32_t index = frame % SWAPCHAIN_LENGTH;
+		GLuint query = queries[frame % QUERY_RING];
+
+		// read back the query issued QUERY_RING frames ago before reusing it
+		if (frame >= QUERY_RING) {
+			GLuint64 elapsed;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+			if (frame - QUERY_RING >= opts->warmup)
+				gpu_ns[gpu_count++] = (int64_t)elapsed;
+		}
+		collect_gpu_passes(&gpu_timer, frame - GPU_TIMER_FRAMES >= opts->warmup, pass_ns, pass_count);
+
+		// producing the input is not part of the measured work
+		synthetic_hands(&app, frame);
+		synthetic_video(video, opts->video_width, opts->video_height, frame);
+
+		int64_t start = now_ns();
+		int64_t pose_start = start;
+		glBeginQuery(GL_TIME_ELAPSED, query);
+
+		prepare_scene(&app, &app.gl_renderer.draw_list, app.hand_pose_action.pose_locations,
+		              &app.ext.hand_tracking);
+		for (int i = 0; i < (stereo ? 1 : VIEW_COUNT); i++) {
+			// the joints of the same display time sampled again, stands in for xrLocateHandJointsEXT()
+			if (opts->late_latch && i == 0) {
+				pose_start = now_ns();
+				synthetic_hands(&app, frame);
+				for (int hand = 0; hand < HAND_COUNT; hand++)
+					update_hand_joints(&app.gl_renderer.draw_list, hand, app.ext.hand_tracking.joints[hand],
+					                   JOINT_COUNT);
+			}
+			enum gpu_stage pass = i == 0 ? GPU_STAGE_RENDER_PASS_0 : GPU_STAGE_RENDER_PASS_1;
+			gpu_timer_begin(&gpu_timer, pass);
+			if (stereo) {
+				render_frame_stereo(w, h, &app.gl_renderer, index, views, eyes[0].color[index],
+				                    opts->depth, eyes[0].depth[index]);
+			} else {
+				render_frame(w, h, &app.gl_renderer, index, i, &views[i], eyes[i].color[index],
+				             opts->depth, eyes[i].depth[index]);
+			}
+			gpu_timer_end(&gpu_timer, pass);
+		}
+
+		gpu_timer_begin(&gpu_timer, GPU_STAGE_QUAD_UPLOAD);
+		update_quad_texture(&app.gl_renderer, &quad, video);
+		render_quad(&app.gl_renderer, &quad, index, frame * 11111111LL);
+		gpu_timer_end(&gpu_timer, GPU_STAGE_QUAD_UPLOAD);
+
+		glEndQuery(GL_TIME_ELAPSED);
+		glFlush();
+		int64_t end = now_ns();
+
+		if (measured) {
+			pose_ns[cpu_count] = end - pose_start;
+			cpu_ns[cpu_count++] = end - start;
+		}
+	}
+
+	for (int frame = total; frame < total + QUERY_RING && frame - QUERY_RING >= 0; frame++) {
+		GLuint64 elapsed;
+		glGetQueryObjectui64v(queries[frame % QUERY_RING], GL_QUERY_RESULT, &elapsed);
+		if (frame - QUERY_RING >= opts->warmup)
+			gpu_ns[gpu_count++] = (int64_t)elapsed;
+	}
+	// with all queries done the timer hands out the frames still in its ring
+	glFinish();
+	for (int frame = total; frame < total + GPU_TIMER_FRAMES; frame++)
+		collect_gpu_passes(&gpu_timer, frame - GPU_TIMER_FRAMES >= opts->warmup, pass_ns, pass_count);
+
+	GLenum err = glGetError();
+	printf("%dx%d per eye, %d frames, video %dx%d%s, stereo %s%s\n", w, h, opts->frames,
+	       opts->video_width, opts->video_height, opts->depth ? ", depth" : "",
+	       stereo_mode_name(app.gl_renderer.stereo_mode), opts->late_latch ? ", late latch" : "");
+	if (err != GL_NO_ERROR)
+		printf("  GL error 0x%x\n", err);
+	print_stats("cpu submit", cpu_ns, cpu_count);
+	print_stats("gpu", gpu_ns, gpu_count);
+	print_stats("gpu pass 0", pass_ns[GPU_STAGE_RENDER_PASS_0], pass_count[GPU_STAGE_RENDER_PASS_0]);
+	if (!stereo) {
+		print_stats("gpu pass 1", pass_ns[GPU_STAGE_RENDER_PASS_1],
+		            pass_count[GPU_STAGE_RENDER_PASS_1]);
+	}
+	print_stats("gpu quad", pass_ns[GPU_STAGE_QUAD_UPLOAD], pass_count[GPU_STAGE_QUAD_UPLOAD]);
+	if (gpu_timer.dropped_frames > 0)
+		printf("  gpu timer dropped %lu frames\n", (unsigned long)gpu_timer.dropped_frames);
+	print_stats("pose submit", pose_ns, cpu_count);
+
+	glDeleteQueries(QUERY_RING, queries);
+	gpu_timer_destroy(&gpu_timer);
+	for (int i = 0; i < swapchain_count; i++) {
+		glDeleteTextures(SWAPCHAIN_LENGTH, eyes[i].color);
+		glDeleteTextures(SWAPCHAIN_LENGTH, eyes[i].depth);
+		glDeleteFramebuffers(SWAPCHAIN_LENGTH, app.gl_renderer.framebuffers[i]);
+		free(app.gl_renderer.framebuffers[i]);
+	}
+	for (int j = 0; j < SWAPCHAIN_LENGTH; j++)
+		glDeleteTextures(1, &quad_images[j].image);
+	glDeleteTextures(1, &app.gl_renderer.quad.texture);
+	glDeleteFramebuffers(1, &app.gl_renderer.quad.fbo);
+	glDeleteProgram(app.gl_renderer.shader_program_id);
+	glDeleteProgram(app.gl_renderer.instances.program_id);
+	glDeleteVertexArrays(1, &app.gl_renderer.instances.vao);
+	glDeleteBuffers(1, &app.gl_renderer.instances.vbo);
+	glDeleteBuffers(1, &app.gl_renderer.uniforms.camera);
+	glDeleteBuffers(1, &app.gl_renderer.uniforms.material);
+	free(app.gl_renderer.uniforms.material_staging);
+	free(app.gl_renderer.draw_list.items);
+	free(app.gl_renderer.draw_list.staging);
+	free(app.gl_renderer.draw_list.staging_mesh);
+	free(app.gl_renderer.framebuffers);
+	free(video);
+	free(cpu_ns);
+	free(gpu_ns);
+	free(pose_ns);
+	for (int stage = 0; stage < GPU_STAGE_COUNT; stage++)
+		free(pass_ns[stage]);
+	return err == GL_NO_ERROR;
+}
+
+static bool
+parse_size(const char* s, int* w, int* h)
+{
+	if (sscanf(s, "%dx%d", w, h) == 2)
+		return *w > 0 && *h > 0;
+	if (sscanf(s, "%d", w) == 1) {
+		*h = *w;
+		return *w > 0;
+	}
+	return false;
+}
+
+int
+main(int argc, char** argv)
+{
+	struct bench_opts opts = {
+	    .frames = 300,
+	    .warmup = 30,
+	    .video_width = 1280,
+	    .video_height = 720,
+	    .depth = true,
+	};
+	const char* resolutions = "1024,1440,2048";
+
+	static struct option long_options[] = {
+	    {"frames", required_argument, 0, 'n'},     {"warmup", required_argument, 0, 'w'},
+	    {"resolutions", required_argument, 0, 'r'}, {"video", required_argument, 0, 'v'},
+	    {"nodepth", no_argument, 0, 'd'},          {"stereo", required_argument, 0, 't'},
+	    {"latelatch", no_argument, 0, 'l'},        {"shadercache", required_argument, 0, 's'},
+	    {"help", no_argument, 0, 'h'},             {0, 0, 0, 0}};
+
+	while (1) {
+		int c = getopt_long(argc, argv, "n:w:r:v:dt:ls:h", long_options, NULL);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'n': opts.frames = atoi(optarg); break;
+		case 'w': opts.warmup = atoi(optarg); break;
+		case 'r': resolutions = optarg; break;
+		case 'v':
+			if (!parse_size(optarg, &opts.video_width, &opts.video_height)) {
+				printf("Invalid video size %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'd': opts.depth = false; break;
+		case 'l': opts.late_latch = true; break;
+		case 's': shader_cache_init(optarg); break;
+		case 't':
+			if (!parse_stereo_mode(optarg, &opts.stereo_mode)) {
+				printf("Invalid stereo mode %s\n", optarg);
+				return 1;
+			}
+			break;
+		default:
+			printf("%s:\n", argv[0]);
+			printf("\t-n|--frames <measured frames, default 300>\n");
+			printf("\t-w|--warmup <frames rendered before measuring, default 30>\n");
+			printf("\t-r|--resolutions <comma separated per eye sizes, N or WxH, default %s>\n",
+			       resolutions);
+			printf("\t-v|--video <WxH of the BGR quad layer frame, default 1280x720>\n");
+			printf("\t-d|--nodepth\n");
+			printf("\t-t|--stereo <off|auto|multiview|vertexlayer|geometry, default off>\n");
+			printf("\t-l|--latelatch\n");
+			printf("\t-s|--shadercache <directory, default no cache>\n");
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (opts.frames <= 0 || opts.warmup < 0) {
+		printf("Invalid frame count\n");
+		return 1;
+	}
+
+	if (!init_egl())
+		return 1;
+
+	char* list = strdup(resolutions);
+	bool ok = true;
+	for (char* tok = strtok(list, ","); tok != NULL; tok = strtok(NULL, ",")) {
+		int w, h;
+		if (!parse_size(tok, &w, &h)) {
+			printf("Invalid resolution %s\n", tok);
+			ok = false;
+			break;
+		}
+		if (!bench_resolution(&opts, w, h)) {
+			ok = false;
+			break;
+		}
+	}
+	free(list);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,1152 @@
+// Copyright 2019-2021, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief OpenGL rendering of the projection and quad layers.
+ *
+ * Only touches GL state and the structs in app.h, so it runs the same inside the OpenXR frame loop
+ * and in the offscreen render_bench.
+ * @author Christoph Haag <christoph.haag@collabora.com>
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "renderer.h"
+#include "logger.h"
+#include "shader_cache.h"
+#include "xr_linear_batch.h"
+
+// A small header with functions for OpenGL math
+#define MATH_3D_IMPLEMENTATION
+#include "math_3d.h"
+
+#define degrees_to_radians(angle_degrees) ((angle_degrees)*M_PI / 180.0)
+
+// Shader sources are compiled with a preamble for the stereo mode that defines VIEW_COUNT and
+// VIEW_ID, the index of the view a vertex is transformed for. In the layered modes every object is
+// drawn with twice the instances and the odd instances go to layer 1.
+static const char* vertex_preamble[] = {
+    [STEREO_OFF] = "#version 330 core\n"
+                   "#extension GL_ARB_explicit_uniform_location : require\n"
+                   "#define VIEW_COUNT 1\n"
+                   "#define VIEW_ID 0\n",
+    [STEREO_MULTIVIEW] = "#version 330 core\n"
+                         "#extension GL_ARB_explicit_uniform_location : require\n"
+                         "#extension GL_OVR_multiview : require\n"
+                         "#define VIEW_COUNT 2\n"
+                         "#define VIEW_ID int(gl_ViewID_OVR)\n"
+                         "layout(num_views = 2) in;\n",
+    [STEREO_VERTEX_LAYER] = "#version 330 core\n"
+                            "#extension GL_ARB_explicit_uniform_location : require\n"
+                            "#extension GL_ARB_shader_viewport_layer_array : require\n"
+                            "#define VIEW_COUNT 2\n"
+                            "#define VIEW_ID (gl_InstanceID % 2)\n"
+                            "#define STEREO_VERTEX_LAYER\n",
+    [STEREO_GEOMETRY_SHADER] = "#version 330 core\n"
+                               "#extension GL_ARB_explicit_uniform_location : require\n"
+                               "#define VIEW_COUNT 2\n"
+                               "#define VIEW_ID (gl_InstanceID % 2)\n"
+                               "#define STEREO_GEOMETRY_SHADER\n",
+};
+
+// uniform blocks, bound to the binding points below with glUniformBlockBinding() because GLSL 330
+// has no binding layout qualifier. Both use std140 so the CPU side can fill them without querying
+// offsets: mat4 arrays have a stride of 64 bytes, proj follows view at VIEW_COUNT * 64.
+#define UBO_BINDING_CAMERA 0
+#define UBO_BINDING_MATERIAL 1
+
+#define CAMERA_BLOCK                                                                               \
+	"layout(std140) uniform Camera {\n"                                                              \
+	"	mat4 view[VIEW_COUNT];\n"                                                                     \
+	"	mat4 proj[VIEW_COUNT];\n"                                                                     \
+	"};\n"
+
+#define MATERIAL_BLOCK                                                                             \
+	"layout(std140) uniform Material {\n"                                                            \
+	"	mat4 model;\n"                                                                                \
+	"	vec4 uniformColor;\n"                                                                         \
+	"};\n"
+
+struct material_block_t
+{
+	float model[16];
+	float color[4];
+};
+
+static const char* fragment_preamble =
+    "#version 330 core\n"
+    "#extension GL_ARB_explicit_uniform_location : require\n";
+
+static const char* vertexshader =
+    "layout(location = 0) in vec3 aPos;\n"
+    CAMERA_BLOCK
+    MATERIAL_BLOCK
+    "layout(location = 5) in vec2 aTexCoord;\n"
+    "#ifdef STEREO_GEOMETRY_SHADER\n"
+    "out vec2 gsTexCoord;\n"
+    "flat out int gsLayer;\n"
+    "#define texCoord gsTexCoord\n"
+    "#else\n"
+    "out vec2 texCoord;\n"
+    "#endif\n"
+    "void main() {\n"
+    "	gl_Position = proj[VIEW_ID] * view[VIEW_ID] * model * vec4(aPos, 1.0);\n"
+    "	texCoord = aTexCoord;\n"
+    "#if defined(STEREO_VERTEX_LAYER)\n"
+    "	gl_Layer = VIEW_ID;\n"
+    "#elif defined(STEREO_GEOMETRY_SHADER)\n"
+    "	gsLayer = VIEW_ID;\n"
+    "#endif\n"
+    "}\n";
+
+// only used with STEREO_GEOMETRY_SHADER, routes each triangle to the layer of its view
+static const char* geometryshader =
+    "layout(triangles) in;\n"
+    "layout(triangle_strip, max_vertices = 3) out;\n"
+    "in vec2 gsTexCoord[];\n"
+    "flat in int gsLayer[];\n"
+    "out vec2 texCoord;\n"
+    "void main() {\n"
+    "	for (int i = 0; i < 3; i++) {\n"
+    "		gl_Position = gl_in[i].gl_Position;\n"
+    "		gl_Layer = gsLayer[0];\n"
+    "		texCoord = gsTexCoord[i];\n"
+    "		EmitVertex();\n"
+    "	}\n"
+    "	EndPrimitive();\n"
+    "}\n";
+
+static const char* fragmentshader =
+    "layout(location = 0) out vec4 FragColor;\n"
+    MATERIAL_BLOCK
+    "layout(location=1) uniform sampler2D imageTexture;\n"
+    "in vec2 texCoord;\n"
+    "void main() {\n"
+    "    FragColor = (uniformColor.x < 0.01 &&\n"
+    "                 uniformColor.y < 0.01 &&\n"
+    "                 uniformColor.z < 0.01)\n"
+    "                    ? texture(imageTexture, texCoord)\n"
+    "                    : uniformColor;\n"
+    "}\n";
+
+// cubes drawn with glDrawArraysInstanced(), model matrix and color are per instance attributes
+static const char* instance_vertexshader =
+    "layout(location = 0) in vec3 aPos;\n"
+    "layout(location = 6) in mat4 instanceModel;\n"
+    "layout(location = 10) in vec4 instanceColor;\n"
+    CAMERA_BLOCK
+    "#ifdef STEREO_GEOMETRY_SHADER\n"
+    "flat out vec4 gsColor;\n"
+    "flat out int gsLayer;\n"
+    "#define color gsColor\n"
+    "#else\n"
+    "flat out vec4 color;\n"
+    "#endif\n"
+    "void main() {\n"
+    "	gl_Position = proj[VIEW_ID] * view[VIEW_ID] * instanceModel * vec4(aPos, 1.0);\n"
+    "	color = instanceColor;\n"
+    "#if defined(STEREO_VERTEX_LAYER)\n"
+    "	gl_Layer = VIEW_ID;\n"
+    "#elif defined(STEREO_GEOMETRY_SHADER)\n"
+    "	gsLayer = VIEW_ID;\n"
+    "#endif\n"
+    "}\n";
+
+static const char* instance_geometryshader =
+    "layout(triangles) in;\n"
+    "layout(triangle_strip, max_vertices = 3) out;\n"
+    "flat in vec4 gsColor[];\n"
+    "flat in int gsLayer[];\n"
+    "flat out vec4 color;\n"
+    "void main() {\n"
+    "	for (int i = 0; i < 3; i++) {\n"
+    "		gl_Position = gl_in[i].gl_Position;\n"
+    "		gl_Layer = gsLayer[0];\n"
+    "		color = gsColor[i];\n"
+    "		EmitVertex();\n"
+    "	}\n"
+    "	EndPrimitive();\n"
+    "}\n";
+
+static const char* instance_fragmentshader =
+    "layout(location = 0) out vec4 FragColor;\n"
+    "flat in vec4 color;\n"
+    "void main() {\n"
+    "    FragColor = color;\n"
+    "}\n";
+
+
+
+static const char*
+shader_type_name(GLenum type)
+{
+	switch (type) {
+	case GL_VERTEX_SHADER: return "Vertex";
+	case GL_GEOMETRY_SHADER: return "Geometry";
+	case GL_FRAGMENT_SHADER: return "Fragment";
+	default: return "Unknown";
+	}
+}
+
+// returns 0 on failure
+static GLuint
+compile_shader(GLenum type, const char* preamble, const char* body)
+{
+	GLuint shader_id = glCreateShader(type);
+	const GLchar* shader_source[2] = {preamble, body};
+	glShaderSource(shader_id, 2, shader_source, NULL);
+	glCompileShader(shader_id);
+	int compile_res;
+	glGetShaderiv(shader_id, GL_COMPILE_STATUS, &compile_res);
+	if (!compile_res) {
+		char info_log[512];
+		glGetShaderInfoLog(shader_id, 512, NULL, info_log);
+		printf("%s Shader failed to compile: %s\n", shader_type_name(type), info_log);
+		glDeleteShader(shader_id);
+		return 0;
+	} else {
+		printf("Successfully compiled %s shader!\n", shader_type_name(type));
+	}
+	return shader_id;
+}
+
+// geometry_source is only used by STEREO_GEOMETRY_SHADER. Counts a program that was not in the
+// binary cache in compiled.
+static GLuint
+create_program(enum stereo_mode mode,
+               const char* vertex_source,
+               const char* geometry_source,
+               const char* fragment_source,
+               uint32_t* compiled)
+{
+	bool use_geometry_shader = mode == STEREO_GEOMETRY_SHADER;
+
+	// everything the program is built from, the stereo mode is in the preambles
+	const char* sources[] = {vertex_preamble[mode],
+	                         vertex_source,
+	                         use_geometry_shader ? geometry_source : "",
+	                         fragment_preamble,
+	                         fragment_source};
+	GLuint cached_id = shader_cache_load(sources, sizeof(sources) / sizeof(sources[0]));
+	if (cached_id != 0)
+		return cached_id;
+
+	GLuint vertex_shader_id = compile_shader(GL_VERTEX_SHADER, vertex_preamble[mode], vertex_source);
+	GLuint geometry_shader_id =
+	    use_geometry_shader ? compile_shader(GL_GEOMETRY_SHADER, vertex_preamble[mode], geometry_source)
+	                        : 0;
+	GLuint fragment_shader_id =
+	    compile_shader(GL_FRAGMENT_SHADER, fragment_preamble, fragment_source);
+	if (!vertex_shader_id || !fragment_shader_id || (use_geometry_shader && !geometry_shader_id)) {
+		glDeleteShader(vertex_shader_id);
+		glDeleteShader(geometry_shader_id);
+		glDeleteShader(fragment_shader_id);
+		return 0;
+	}
+
+	GLuint program_id = glCreateProgram();
+	glAttachShader(program_id, vertex_shader_id);
+	if (use_geometry_shader)
+		glAttachShader(program_id, geometry_shader_id);
+	glAttachShader(program_id, fragment_shader_id);
+	shader_cache_prepare(program_id);
+	glLinkProgram(program_id);
+	GLint shader_program_res;
+	glGetProgramiv(program_id, GL_LINK_STATUS, &shader_program_res);
+
+	glDeleteShader(vertex_shader_id);
+	glDeleteShader(geometry_shader_id);
+	glDeleteShader(fragment_shader_id);
+
+	if (!shader_program_res) {
+		char info_log[512];
+		glGetProgramInfoLog(program_id, 512, NULL, info_log);
+		printf("Shader Program failed to link: %s\n", info_log);
+		glDeleteProgram(program_id);
+		return 0;
+	} else {
+		printf("Successfully linked shader program!\n");
+	}
+	(*compiled)++;
+
+	shader_cache_store(program_id, sources, sizeof(sources) / sizeof(sources[0]));
+	return program_id;
+}
+
+static GLsizeiptr
+align_size(GLsizeiptr size, GLint alignment)
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+// the layered modes draw every object once per view, as consecutive instances
+static GLuint
+layered_instances(const struct gl_renderer_t* gl_renderer)
+{
+	return gl_renderer->stereo_mode == STEREO_VERTEX_LAYER ||
+	               gl_renderer->stereo_mode == STEREO_GEOMETRY_SHADER
+	           ? 2
+	           : 1;
+}
+
+static bool
+has_gl_extension(const char* name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++) {
+		if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+			return true;
+	}
+	return false;
+}
+
+// resolves STEREO_AUTO and checks that an explicitly requested mode is supported
+static bool
+select_stereo_mode(struct gl_renderer_t* gl_renderer)
+{
+	bool multiview = has_gl_extension("GL_OVR_multiview") &&
+	                 gl_renderer->FramebufferTextureMultiviewOVR != NULL;
+	bool vertex_layer = has_gl_extension("GL_ARB_shader_viewport_layer_array");
+
+	switch (gl_renderer->stereo_mode) {
+	case STEREO_AUTO:
+		if (multiview)
+			gl_renderer->stereo_mode = STEREO_MULTIVIEW;
+		else if (vertex_layer)
+			gl_renderer->stereo_mode = STEREO_VERTEX_LAYER;
+		else
+			gl_renderer->stereo_mode = STEREO_GEOMETRY_SHADER;
+		break;
+	case STEREO_MULTIVIEW:
+		if (!multiview) {
+			printf("GL_OVR_multiview not supported\n");
+			return false;
+		}
+		break;
+	case STEREO_VERTEX_LAYER:
+		if (!vertex_layer) {
+			printf("GL_ARB_shader_viewport_layer_array not supported\n");
+			return false;
+		}
+		break;
+	default: break;
+	}
+
+	if (gl_renderer->stereo_mode != STEREO_OFF)
+		printf("Single pass stereo: %s\n", stereo_mode_name(gl_renderer->stereo_mode));
+	return true;
+}
+
+const char*
+stereo_mode_name(enum stereo_mode mode)
+{
+	switch (mode) {
+	case STEREO_OFF: return "off";
+	case STEREO_AUTO: return "auto";
+	case STEREO_MULTIVIEW: return "multiview";
+	case STEREO_VERTEX_LAYER: return "vertexlayer";
+	case STEREO_GEOMETRY_SHADER: return "geometry";
+	}
+	return "unknown";
+}
+
+bool
+parse_stereo_mode(const char* name, enum stereo_mode* mode)
+{
+	for (enum stereo_mode m = STEREO_OFF; m <= STEREO_GEOMETRY_SHADER; m++) {
+		if (strcmp(name, stereo_mode_name(m)) == 0) {
+			*mode = m;
+			return true;
+		}
+	}
+	return false;
+}
+
+int
+init_gl(uint32_t view_count, uint32_t* swapchain_lengths, struct gl_renderer_t* gl_renderer)
+{
+
+	/* Allocate resources that we use for our own rendering.
+	 * We will bind framebuffers to the runtime provided textures for rendering.
+	 * For this, we create one framebuffer per OpenGL texture.
+	 * This is not mandated by OpenXR, other ways to render to textures will work too.
+	 */
+	gl_renderer->framebuffers = malloc(sizeof(GLuint*) * view_count);
+	for (uint32_t i = 0; i < view_count; i++) {
+		gl_renderer->framebuffers[i] = malloc(sizeof(GLuint) * swapchain_lengths[i]);
+		glGenFramebuffers(swapchain_lengths[i], gl_renderer->framebuffers[i]);
+	}
+
+	if (!select_stereo_mode(gl_renderer))
+		return 1;
+
+	struct timespec programs_start, programs_end;
+	clock_gettime(CLOCK_MONOTONIC, &programs_start);
+	uint32_t cache_hits = shader_cache_get_stats().hits;
+	uint32_t compiled = 0;
+
+	gl_renderer->shader_program_id = create_program(gl_renderer->stereo_mode, vertexshader,
+	                                                geometryshader, fragmentshader, &compiled);
+	if (gl_renderer->shader_program_id == 0)
+		return 1;
+
+	gl_renderer->instances.program_id =
+	    create_program(gl_renderer->stereo_mode, instance_vertexshader, instance_geometryshader,
+	                   instance_fragmentshader, &compiled);
+	if (gl_renderer->instances.program_id == 0)
+		return 1;
+
+	// the first use of a program can still stall on drivers that compile lazily, glFinish() at
+	// least waits for the driver to be done with the link
+	glFinish();
+	clock_gettime(CLOCK_MONOTONIC, &programs_end);
+	cache_hits = shader_cache_get_stats().hits - cache_hits;
+	printf("Shader programs ready in %.3f ms, %s start: %u from the binary cache, %u compiled\n",
+	       (programs_end.tv_sec - programs_start.tv_sec) * 1e3 +
+	           (programs_end.tv_nsec - programs_start.tv_nsec) / 1e6,
+	       compiled == 0 ? "warm" : "cold", cache_hits, compiled);
+
+
+	// vertices for a cube
+	float cube_vertices[] = {-0.5f, -0.5f, -0.5f, 0.0f, 0.0f, 0.5f,  -0.5f, -0.5f, 1.0f, 0.0f,
+	                    0.5f,  0.5f,  -0.5f, 1.0f, 1.0f, 0.5f,  0.5f,  -0.5f, 1.0f, 1.0f,
+	                    -0.5f, 0.5f,  -0.5f, 0.0f, 1.0f, -0.5f, -0.5f, -0.5f, 0.0f, 0.0f,
+
+	                    -0.5f, -0.5f, 0.5f,  0.0f, 0.0f, 0.5f,  -0.5f, 0.5f,  1.0f, 0.0f,
+	                    0.5f,  0.5f,  0.5f,  1.0f, 1.0f, 0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
+	                    -0.5f, 0.5f,  0.5f,  0.0f, 1.0f, -0.5f, -0.5f, 0.5f,  0.0f, 0.0f,
+
+	                    -0.5f, 0.5f,  0.5f,  1.0f, 0.0f, -0.5f, 0.5f,  -0.5f, 1.0f, 1.0f,
+	                    -0.5f, -0.5f, -0.5f, 0.0f, 1.0f, -0.5f, -0.5f, -0.5f, 0.0f, 1.0f,
+	                    -0.5f, -0.5f, 0.5f,  0.0f, 0.0f, -0.5f, 0.5f,  0.5f,  1.0f, 0.0f,
+
+	                    0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 0.5f,  0.5f,  -0.5f, 1.0f, 1.0f,
+	                    0.5f,  -0.5f, -0.5f, 0.0f, 1.0f, 0.5f,  -0.5f, -0.5f, 0.0f, 1.0f,
+	                    0.5f,  -0.5f, 0.5f,  0.0f, 0.0f, 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+
+	                    -0.5f, -0.5f, -0.5f, 0.0f, 1.0f, 0.5f,  -0.5f, -0.5f, 1.0f, 1.0f,
+	                    0.5f,  -0.5f, 0.5f,  1.0f, 0.0f, 0.5f,  -0.5f, 0.5f,  1.0f, 0.0f,
+	                    -0.5f, -0.5f, 0.5f,  0.0f, 0.0f, -0.5f, -0.5f, -0.5f, 0.0f, 1.0f,
+
+	                    -0.5f, 0.5f,  -0.5f, 0.0f, 1.0f, 0.5f,  0.5f,  -0.5f, 1.0f, 1.0f,
+	                    0.5f,  0.5f,  0.5f,  1.0f, 0.0f, 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+	                    -0.5f, 0.5f,  0.5f,  0.0f, 0.0f, -0.5f, 0.5f,  -0.5f, 0.0f, 1.0f};	
+
+	// vertices for a rectangle
+	float rectangle_vertices[] = {
+    // Positions (x, y, z)        // Texture Coordinates (s, t)
+    -1.5f, 0.0f, -0.8f,           0.0f, 0.0f,
+     1.5f, 0.0f, -0.8f,           1.0f, 0.0f,
+     1.5f, 0.0f,  0.8f,           1.0f, 1.0f,
+    -1.5f, 0.0f, -0.8f,           0.0f, 0.0f,
+     1.5f, 0.0f,  0.8f,           1.0f, 1.0f,
+    -1.5f, 0.0f,  0.8f,           0.0f, 1.0f 
+	};
+
+
+
+
+
+	GLuint VBOs[2];
+	glGenBuffers(2, VBOs);
+
+	GLuint* VAOs;
+	VAOs = malloc(2 * sizeof(GLuint));
+	glGenVertexArrays(2, VAOs);
+	gl_renderer->VAOs = VAOs;
+
+	// Initialize cube VAO/VBO
+	glBindVertexArray(gl_renderer->VAOs[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, VBOs[0]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_DYNAMIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+
+	glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_DYNAMIC_DRAW);
+	glVertexAttribPointer(5, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(5);
+
+	// Initialize rectangle VAO/VBO
+	glBindVertexArray(gl_renderer->VAOs[1]);
+	glBindBuffer(GL_ARRAY_BUFFER, VBOs[1]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(rectangle_vertices), rectangle_vertices, GL_DYNAMIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+
+	glBufferData(GL_ARRAY_BUFFER, sizeof(rectangle_vertices), rectangle_vertices, GL_DYNAMIC_DRAW);
+	glVertexAttribPointer(5, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(5);
+
+
+	// Initialize instanced cube VAO, per vertex data from the cube VBO, per instance data from the
+	// instance buffer that is refilled every frame
+	struct gl_instances_t* instances = &gl_renderer->instances;
+	glGenVertexArrays(1, &instances->vao);
+	glGenBuffers(1, &instances->vbo);
+	glBindVertexArray(instances->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, VBOs[0]);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, instances->vbo);
+	for (int column = 0; column < 4; column++) {
+		glVertexAttribPointer(6 + column, 4, GL_FLOAT, GL_FALSE, sizeof(struct draw_item_t),
+		                      (void*)(offsetof(struct draw_item_t, model) + column * 4 * sizeof(float)));
+		glVertexAttribDivisor(6 + column, layered_instances(gl_renderer));
+		glEnableVertexAttribArray(6 + column);
+	}
+	glVertexAttribPointer(10, 4, GL_FLOAT, GL_FALSE, sizeof(struct draw_item_t),
+	                      (void*)offsetof(struct draw_item_t, color));
+	glVertexAttribDivisor(10, layered_instances(gl_renderer));
+	glEnableVertexAttribArray(10);
+	glBindVertexArray(0);
+
+	glUniformBlockBinding(gl_renderer->shader_program_id,
+	                      glGetUniformBlockIndex(gl_renderer->shader_program_id, "Camera"),
+	                      UBO_BINDING_CAMERA);
+	glUniformBlockBinding(gl_renderer->shader_program_id,
+	                      glGetUniformBlockIndex(gl_renderer->shader_program_id, "Material"),
+	                      UBO_BINDING_MATERIAL);
+	glUniformBlockBinding(instances->program_id,
+	                      glGetUniformBlockIndex(instances->program_id, "Camera"),
+	                      UBO_BINDING_CAMERA);
+
+	// one camera slot per framebuffer set, rendering view i (or both views) writes slot i
+	struct gl_uniform_buffers_t* uniforms = &gl_renderer->uniforms;
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	GLsizeiptr views_per_pass = gl_renderer->stereo_mode != STEREO_OFF ? 2 : 1;
+	uniforms->camera_stride = align_size(2 * views_per_pass * sizeof(XrMatrix4x4f), alignment);
+	uniforms->material_stride = align_size(sizeof(struct material_block_t), alignment);
+	uniforms->camera_slots = view_count;
+	glGenBuffers(1, &uniforms->camera);
+	glGenBuffers(1, &uniforms->material);
+	glBindBuffer(GL_UNIFORM_BUFFER, uniforms->camera);
+	glBufferData(GL_UNIFORM_BUFFER, uniforms->camera_slots * uniforms->camera_stride, NULL,
+	             GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+
+	glEnable(GL_DEPTH_TEST);
+
+	return 0;
+}
+
+// returns the position of the item among the items of its mesh, DRAW_ITEM_NONE if it was dropped
+static uint32_t
+draw_list_add(struct draw_list_t* list, enum mesh_id mesh, const float* model, const float* color)
+{
+	if (list->staging_count == list->capacity) {
+		uint32_t capacity = list->capacity ? list->capacity * 2 : 64;
+		struct draw_item_t* items = realloc(list->items, capacity * sizeof(*items));
+		if (items)
+			list->items = items;
+		struct draw_item_t* staging = realloc(list->staging, capacity * sizeof(*staging));
+		if (staging)
+			list->staging = staging;
+		uint8_t* staging_mesh = realloc(list->staging_mesh, capacity * sizeof(*staging_mesh));
+		if (staging_mesh)
+			list->staging_mesh = staging_mesh;
+		if (!items || !staging || !staging_mesh) {
+			LOG_ERROR("Failed to grow draw list to %u\n", capacity);
+			return DRAW_ITEM_NONE;
+		}
+		list->capacity = capacity;
+	}
+
+	struct draw_item_t* item = &list->staging[list->staging_count];
+	memcpy(item->model, model, sizeof(item->model));
+	memcpy(item->color, color, sizeof(item->color));
+	list->staging_mesh[list->staging_count] = mesh;
+	list->staging_count++;
+	return list->staging_mesh_count[mesh]++;
+}
+
+// stable counting sort of the staged items by mesh
+static void
+draw_list_finish(struct draw_list_t* list)
+{
+	for (int mesh = 0; mesh < MESH_COUNT; mesh++) {
+		list->mesh_count[mesh] = list->staging_mesh_count[mesh];
+		list->staging_mesh_count[mesh] = 0;
+	}
+
+	uint32_t first = 0;
+	uint32_t next[MESH_COUNT];
+	for (int mesh = 0; mesh < MESH_COUNT; mesh++) {
+		list->mesh_first[mesh] = next[mesh] = first;
+		first += list->mesh_count[mesh];
+	}
+
+	for (uint32_t i = 0; i < list->staging_count; i++)
+		list->items[next[list->staging_mesh[i]]++] = list->staging[i];
+
+	list->count = list->staging_count;
+	list->staging_count = 0;
+	list->dirty = true;
+}
+
+static void
+render_block(struct draw_list_t* list,
+             XrVector3f* position,
+             XrQuaternionf* orientation,
+             XrVector3f* radi,
+             const float* color)
+{
+	XrMatrix4x4f model_matrix;
+	XrMatrix4x4f_CreateModelMatrix(&model_matrix, position, orientation, radi);
+	draw_list_add(list, MESH_CUBE, model_matrix.m, color);
+}
+
+static void
+render_simple_cube(struct draw_list_t* list,
+                   vec3_t position,
+                   vec3_t cube_size,
+                   const float* color)
+{
+	mat4_t modelmatrix =
+	    m4_mul(m4_translation(position), m4_scaling(vec3(cube_size.x, cube_size.y, cube_size.z)));
+
+	draw_list_add(list, MESH_CUBE, (float*)modelmatrix.m, color);
+}
+
+
+
+static float
+vec3_mag(XrVector3f* vec)
+{
+	return sqrt(vec->x * vec->x + vec->y * vec->y + vec->z * vec->z);
+}
+
+static XrVector3f
+vec3_norm(XrVector3f* vec)
+{
+	float mag = vec3_mag(vec);
+	XrVector3f r = {.x = vec->x / mag, .y = vec->y / mag, .z = vec->z / mag};
+	return r;
+}
+
+static mat4_t
+m4_dir_to_matrix(vec3_t dir)
+{
+	vec3_t z_axis = vec3(0, 0, -1);
+	vec3_t rot_axis = v3_cross(z_axis, dir);
+	float angle = acos(v3_dot(z_axis, dir));
+	return m4_rotation(angle, rot_axis);
+}
+
+static void
+render_vec(struct draw_list_t* list, XrVector3f* vec, XrVector3f* start, const float* color)
+{
+	float width = 0.005;
+	float lin_len = vec3_mag(vec);
+
+	XrVector3f lin_direction = vec3_norm(vec);
+
+	mat4_t m = m4_identity();
+	m = m4_mul(m, m4_translation(vec3(0, 0, -lin_len / 2.)));
+	m = m4_mul(m, m4_scaling(vec3(width, width, lin_len)));
+	m = m4_mul(m4_dir_to_matrix(vec3(lin_direction.x, lin_direction.y, lin_direction.z)), m);
+	m = m4_mul(m4_translation(vec3(start->x, start->y, start->z)), m);
+
+	draw_list_add(list, MESH_CUBE, (float*)m.m, color);
+}
+
+static void
+render_line(struct draw_list_t* list, XrVector3f* v1, XrVector3f* v2, const float* color)
+{
+	XrVector3f v1tov2 = {v2->x - v1->x, v2->y - v1->y, v2->z - v1->z};
+	render_vec(list, &v1tov2, v1, color);
+}
+
+static void
+render_rotated_rectangle(struct draw_list_t* list,
+                         vec3_t position,
+                         float cube_size,
+                         float rotation,
+                         const float* color)
+{
+	mat4_t rotationmatrix = m4_rotation_y(degrees_to_radians(rotation));
+	mat4_t modelmatrix = m4_mul(m4_translation(position),
+	                            m4_scaling(vec3(cube_size / 2., cube_size / 2., cube_size / 2.)));
+	modelmatrix = m4_mul(modelmatrix, rotationmatrix);
+
+	draw_list_add(list, MESH_RECTANGLE, (float*)modelmatrix.m, color);
+}
+
+static void
+visualize_velocity(struct draw_list_t* list,
+                   XrPosef* base,
+                   XrVector3f* linearVelocity,
+                   XrVector3f* angularVelocity,
+                   float size,
+                   const float* color)
+{
+	float cube_radius = size / 2;
+	float lin_len = vec3_mag(linearVelocity);
+	float block_radius = lin_len / 2.;
+	XrVector3f lin_direction = vec3_norm(linearVelocity);
+
+	// linear velocity
+	{
+		/* create matrix that translates lin_len / 2. in lin_direction (because
+		 * block origin is in the middle), scales to lin_len in "z" direction and
+		 * rotates in lin_direction. Used as model matrix for unit cube this renders
+		 * a block of length lin_len in lin_direction starting at the base pose.
+		 */
+		vec3_t from = vec3(base->position.x + lin_direction.x * block_radius / 2.,
+		                   base->position.y + lin_direction.y * block_radius / 2.,
+		                   base->position.z + lin_direction.z * block_radius / 2.);
+		vec3_t to = vec3(base->position.x + lin_direction.x, base->position.y + lin_direction.y,
+		                 base->position.z + lin_direction.z);
+		mat4_t look_at = m4_invert_affine(m4_look_at(from, to, vec3(0, 1, 0)));
+
+		mat4_t scale = m4_scaling(vec3(cube_radius, cube_radius, block_radius));
+		look_at = m4_mul(look_at, scale);
+
+		draw_list_add(list, MESH_CUBE, (float*)look_at.m, color);
+	}
+
+// angular velocity - block is axis, length is velocity
+#if 0
+{
+vec3_t from = vec3(0, 0, 0);
+vec3_t to = vec3(angularVelocity->x / 2., angularVelocity->y / 2., angularVelocity->z / 2.0);
+mat4_t look_at = m4_invert_affine(m4_look_at(from, to, vec3(0, 1, 0)));
+
+float ang_len = vec3_mag(angularVelocity);
+mat4_t scale = m4_scaling(vec3(cube_radius, cube_radius, ang_len / 2.));
+look_at = m4_mul(look_at, scale);
+
+vec3_t pos = vec3(base->position.x, base->position.y, base->position.z);
+mat4_t model = m4_mul(m4_translation(pos), look_at);
+draw_list_add(list, MESH_CUBE, (float*)model.m, color);
+}
+#endif
+}
+
+// model matrices of all joints in one batch, a cube of the joint's radius at its pose. Returns
+// joint_count clamped to XR_HAND_JOINT_COUNT_EXT.
+static uint32_t
+joint_model_matrices(XrMatrix4x4f* matrices,
+                     const XrHandJointLocationEXT* joints,
+                     uint32_t joint_count)
+{
+	if (joint_count > XR_HAND_JOINT_COUNT_EXT)
+		joint_count = XR_HAND_JOINT_COUNT_EXT;
+
+	XrPosef poses[XR_HAND_JOINT_COUNT_EXT];
+	XrVector3f scales[XR_HAND_JOINT_COUNT_EXT];
+	for (uint32_t i = 0; i < joint_count; i++) {
+		float size = joints[i].radius;
+		poses[i] = joints[i].pose;
+		scales[i] = (XrVector3f){size, size, size};
+	}
+	XrMatrix4x4f_CreateModelMatrices(matrices, poses, scales, joint_count);
+	return joint_count;
+}
+
+void
+prepare_scene(struct ApplicationState* app,
+              struct draw_list_t* list,
+              XrSpaceLocation* hand_locations,
+              struct hand_tracking_t* hand_tracking)
+{
+	static const float hand_colors[HAND_COUNT][4] = {{1.0, 0.5, 0.5, 1.0}, {0.5, 1.0, 0.5, 1.0}};
+	static const float aim_color[4] = {1.0, 0.0, 0.0, 0.0};
+	static const float cube_color[4] = {1, 1, 1, 0.0};
+	static const float tracker_color[4] = {0, 1, 1, 0.0};
+
+	memset(list->joint_items, 0xff, sizeof(list->joint_items));
+
+	{
+		// textured rectangle, a black color makes the shader sample the video texture
+		static const float texture_color[4] = {0.0, 0.0, 0.0, 0.0};
+		float rectangle_size = 4.05;
+		render_rotated_rectangle(list, vec3(0, 0, 0), rectangle_size, 0, texture_color);
+	}
+
+	// render controllers / hand joints
+	for (int hand = 0; hand < 2; hand++) {
+		const float* color = hand_colors[hand];
+
+		// if at least some joints had valid poses, draw them instead of controller blocks
+		bool any_joints_valid = false;
+
+		struct XrHandJointLocationsEXT* joint_locations = &hand_tracking->joint_locations[hand];
+		if (joint_locations->isActive) {
+			// invalid joints are skipped below
+			XrMatrix4x4f joint_matrices[XR_HAND_JOINT_COUNT_EXT];
+			uint32_t joint_count = joint_model_matrices(
+			    joint_matrices, joint_locations->jointLocations, joint_locations->jointCount);
+
+			for (uint32_t i = 0; i < joint_count; i++) {
+				struct XrHandJointLocationEXT* joint_location = &joint_locations->jointLocations[i];
+
+				if (!(joint_location->locationFlags & XR_SPACE_LOCATION_POSITION_VALID_BIT)) {
+					// printf("Hand %d Joint %d: Position not valid\n", hand, i);
+					continue;
+				}
+
+				list->joint_items[hand][i] = draw_list_add(list, MESH_CUBE, joint_matrices[i].m, color);
+
+				if (joint_locations->next != NULL) {
+					// we set .next only to null or XrHandJointVelocitiesEXT in main
+					XrHandJointVelocitiesEXT* vel = (XrHandJointVelocitiesEXT*)joint_locations->next;
+					if ((vel->jointVelocities[i].velocityFlags & XR_SPACE_VELOCITY_LINEAR_VALID_BIT) != 0) {
+						visualize_velocity(list, &joint_location->pose,
+						                   &vel->jointVelocities[i].linearVelocity,
+						                   &vel->jointVelocities[i].angularVelocity, 0.005, color);
+					} else {
+						LOG_DEBUG("Joint velocities %d invalid\n", i);
+					}
+				}
+
+				any_joints_valid = true;
+			}
+		}
+
+
+
+		bool hand_location_valid =
+		    //(spaceLocation[hand].locationFlags & XR_SPACE_LOCATION_POSITION_VALID_BIT) != 0 &&
+		    (hand_locations[hand].locationFlags & XR_SPACE_LOCATION_ORIENTATION_VALID_BIT) != 0;
+		bool aim_location_valid =
+		    //(spaceLocation[hand].locationFlags & XR_SPACE_LOCATION_POSITION_VALID_BIT) != 0 &&
+		    (app->aim_action.pose_locations[hand].locationFlags &
+		     XR_SPACE_LOCATION_ORIENTATION_VALID_BIT) != 0;
+
+		// the controller blocks itself are only drawn if we didn't draw hand joints'
+		if (!any_joints_valid && hand_location_valid) {
+			XrVector3f scale = {.x = .05f, .y = .05f, .z = .2f};
+			render_block(list, &hand_locations[hand].pose.position,
+			             &hand_locations[hand].pose.orientation, &scale, color);
+		}
+
+		if (aim_location_valid) {
+			// always draw an aim pose
+			XrMatrix4x4f aim_model_matrix;
+			XrVector3f aim_model_scale = {.x = 1, .y = 1, .z = 1};
+			XrPosef* aim_pose = &app->aim_action.pose_locations[hand].pose;
+			XrMatrix4x4f_CreateModelMatrix(&aim_model_matrix, &aim_pose->position, &aim_pose->orientation,
+			                               &aim_model_scale);
+
+			XrMatrix4x4f zminus1_matrix;
+			XrMatrix4x4f_CreateTranslation(&zminus1_matrix, 0, 0, -1);
+
+			XrMatrix4x4f aim_zminus1;
+			XrMatrix4x4f_Multiply(&aim_zminus1, &aim_model_matrix, &zminus1_matrix);
+
+			XrVector3f aim_vec = {.x = aim_zminus1.m[12], .y = aim_zminus1.m[13], .z = aim_zminus1.m[14]};
+			color = aim_color;
+			render_line(list, &aim_pose->position, &aim_vec, color);
+		} else if (hand_location_valid && !aim_location_valid) {
+			// printf("Hand location %d valid but not aim location\n", hand);
+		}
+
+
+
+		// controller velocities are always drawn if available
+		if (hand_locations[hand].next != NULL) {
+			// we set .next only to null or XrSpaceVelocity in main
+			XrSpaceVelocity* vel = (XrSpaceVelocity*)hand_locations[hand].next;
+			if ((vel->velocityFlags & XR_SPACE_VELOCITY_LINEAR_VALID_BIT) != 0) {
+				visualize_velocity(list, &hand_locations[hand].pose, &vel->linearVelocity,
+				                   &vel->angularVelocity, 0.005, color);
+			}
+		}
+	}
+
+
+	if (app->cube.enabled) {
+		if (app->cube.pos_ts != 0) {
+			render_simple_cube(
+			    list,
+			    vec3(app->cube.current_pos.x, app->cube.current_pos.y, app->cube.current_pos.z),
+			    vec3(0.1, 0.1, 0.1), cube_color);
+		}
+	}
+
+	if (app->ext.vive_tracker.base.supported) {
+		struct known_vive_tracker* t = app->ext.vive_tracker.trackers;
+		while (t) {
+			if (!t->action.states[0].pose_.isActive) {
+				t = t->next;
+				continue;
+			}
+			if ((t->action.pose_locations->locationFlags & XR_SPACE_LOCATION_ORIENTATION_TRACKED_BIT) ==
+			    0) {
+				t = t->next;
+				continue;
+			}
+
+			XrVector3f scale = {.x = .075f, .y = .075f, .z = .075f};
+			render_block(list, &t->action.pose_locations[0].pose.position,
+			             &t->action.pose_locations[0].pose.orientation, &scale, tracker_color);
+			t = t->next;
+		}
+	}
+
+	draw_list_finish(list);
+}
+
+void
+update_hand_joints(struct draw_list_t* list,
+                   int hand,
+                   const XrHandJointLocationEXT* joints,
+                   uint32_t joint_count)
+{
+	XrMatrix4x4f matrices[XR_HAND_JOINT_COUNT_EXT];
+	joint_count = joint_model_matrices(matrices, joints, joint_count);
+	for (uint32_t i = 0; i < joint_count; i++) {
+		uint32_t item = list->joint_items[hand][i];
+		if (item == DRAW_ITEM_NONE || !(joints[i].locationFlags & XR_SPACE_LOCATION_POSITION_VALID_BIT))
+			continue;
+		struct draw_item_t* draw_item = &list->items[list->mesh_first[MESH_CUBE] + item];
+		memcpy(draw_item->model, matrices[i].m, sizeof(draw_item->model));
+		list->dirty = true;
+	}
+}
+
+// streams the cube items into the GL buffer, orphaning the previous storage so the upload does not
+// wait for draws of the last frame that still read it
+static void
+upload_instances(struct gl_instances_t* instances, struct draw_list_t* list)
+{
+	uint32_t count = list->mesh_count[MESH_CUBE];
+	glBindBuffer(GL_ARRAY_BUFFER, instances->vbo);
+	if (instances->buffer_capacity < count)
+		instances->buffer_capacity = list->capacity;
+	glBufferData(GL_ARRAY_BUFFER, instances->buffer_capacity * sizeof(struct draw_item_t), NULL,
+	             GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(struct draw_item_t),
+	                &list->items[list->mesh_first[MESH_CUBE]]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// packs model and color of the items drawn with the textured program into aligned std140 slots and
+// uploads them in one call. The camera buffer is orphaned too, the passes of this frame then write
+// their slots into fresh storage.
+static void
+upload_uniforms(struct gl_uniform_buffers_t* uniforms, struct draw_list_t* list)
+{
+	uint32_t count = list->mesh_count[MESH_RECTANGLE];
+	if (uniforms->material_capacity < count) {
+		uint8_t* staging =
+		    realloc(uniforms->material_staging, list->capacity * uniforms->material_stride);
+		if (!staging)
+			return;
+		uniforms->material_staging = staging;
+		uniforms->material_capacity = list->capacity;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		struct draw_item_t* item = &list->items[list->mesh_first[MESH_RECTANGLE] + i];
+		struct material_block_t* block =
+		    (struct material_block_t*)(uniforms->material_staging + i * uniforms->material_stride);
+		memcpy(block->model, item->model, sizeof(block->model));
+		memcpy(block->color, item->color, sizeof(block->color));
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, uniforms->material);
+	glBufferData(GL_UNIFORM_BUFFER, uniforms->material_capacity * uniforms->material_stride, NULL,
+	             GL_STREAM_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, count * uniforms->material_stride,
+	                uniforms->material_staging);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, uniforms->camera);
+	glBufferData(GL_UNIFORM_BUFFER, uniforms->camera_slots * uniforms->camera_stride, NULL,
+	             GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// writes view and projection matrices of this pass into camera slot `slot` and binds it
+static void
+bind_camera(struct gl_renderer_t* gl_renderer, uint32_t slot, XrView* views, int view_count)
+{
+	// std140 layout of the Camera block: view[view_count] followed by proj[view_count]
+	XrMatrix4x4f matrices[4];
+	for (int i = 0; i < view_count; i++) {
+		XrMatrix4x4f_CreateViewMatrix(&matrices[i], &views[i].pose.position,
+		                              &views[i].pose.orientation);
+		XrMatrix4x4f_CreateProjectionFov(&matrices[view_count + i], GRAPHICS_OPENGL, views[i].fov,
+		                                 gl_renderer->near_z, gl_renderer->far_z);
+	}
+
+	struct gl_uniform_buffers_t* uniforms = &gl_renderer->uniforms;
+	GLintptr offset = slot * uniforms->camera_stride;
+	GLsizeiptr size = 2 * view_count * sizeof(XrMatrix4x4f);
+	glBindBuffer(GL_UNIFORM_BUFFER, uniforms->camera);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, size, matrices);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferRange(GL_UNIFORM_BUFFER, UBO_BINDING_CAMERA, uniforms->camera, offset, size);
+}
+
+// replays the draw list into the bound framebuffer for view_count views, 2 only in the stereo modes
+static void
+draw_scene(struct gl_renderer_t* gl_renderer, uint32_t camera_slot, XrView* views, int view_count)
+{
+	struct draw_list_t* list = &gl_renderer->draw_list;
+	struct gl_instances_t* instances = &gl_renderer->instances;
+	struct gl_uniform_buffers_t* uniforms = &gl_renderer->uniforms;
+	if (list->dirty) {
+		upload_instances(instances, list);
+		upload_uniforms(uniforms, list);
+		list->dirty = false;
+	}
+
+	glClearColor(.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	bind_camera(gl_renderer, camera_slot, views, view_count);
+
+	GLuint layers = layered_instances(gl_renderer);
+
+	// use rectangle VAO, material slots are only missing if their staging allocation failed
+	uint32_t rectangles = list->mesh_count[MESH_RECTANGLE];
+	if (rectangles > uniforms->material_capacity)
+		rectangles = uniforms->material_capacity;
+	glUseProgram(gl_renderer->shader_program_id);
+	glBindVertexArray(gl_renderer->VAOs[1]);
+	for (uint32_t i = 0; i < rectangles; i++) {
+		glBindBufferRange(GL_UNIFORM_BUFFER, UBO_BINDING_MATERIAL, uniforms->material,
+		                  i * uniforms->material_stride, sizeof(struct material_block_t));
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 36, layers);
+	}
+
+	// controllers, hand joints, velocities, the bouncing cube and trackers in one draw call
+	if (list->mesh_count[MESH_CUBE] > 0) {
+		glUseProgram(instances->program_id);
+		glBindVertexArray(instances->vao);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 36, list->mesh_count[MESH_CUBE] * layers);
+	}
+
+	glBindVertexArray(0);
+}
+
+void
+render_frame(int w,
+             int h,
+             struct gl_renderer_t* gl_renderer,
+             uint32_t projection_index,
+             int view_index,
+             XrView* view,
+             GLuint image,
+             bool depth_supported,
+             GLuint depthbuffer)
+{
+	GLuint framebuffer = gl_renderer->framebuffers[view_index][projection_index];
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	glViewport(0, 0, w, h);
+	glScissor(0, 0, w, h);
+
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, image, 0);
+	if (depth_supported) {
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthbuffer, 0);
+	} else {
+		// TODO: need a depth attachment for depth test when rendering to fbo
+	}
+
+	draw_scene(gl_renderer, view_index, view, 1);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void
+render_frame_stereo(int w,
+                    int h,
+                    struct gl_renderer_t* gl_renderer,
+                    uint32_t projection_index,
+                    XrView* views,
+                    GLuint image,
+                    bool depth_supported,
+                    GLuint depthbuffer)
+{
+	GLuint framebuffer = gl_renderer->framebuffers[0][projection_index];
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	glViewport(0, 0, w, h);
+	glScissor(0, 0, w, h);
+
+	// layer i of the array textures is view i
+	if (gl_renderer->stereo_mode == STEREO_MULTIVIEW) {
+		gl_renderer->FramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, image, 0, 0, 2);
+		if (depth_supported)
+			gl_renderer->FramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+			                                            depthbuffer, 0, 0, 2);
+	} else {
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, image, 0);
+		if (depth_supported)
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthbuffer, 0);
+	}
+
+	draw_scene(gl_renderer, 0, views, 2);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+static void
+initialize_quad(struct gl_renderer_t* gl_renderer, struct quad_layer_t* quad)
+{
+	glGenTextures(1, &gl_renderer->quad.texture);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, gl_renderer->quad.texture);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	int width = quad->pixel_width;
+	int height = quad->pixel_height;
+	glViewport(0, 0, width, height);
+	glScissor(0, 0, width, height);
+
+	glGenFramebuffers(1, &gl_renderer->quad.fbo);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, gl_renderer->quad.fbo);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+	                       gl_renderer->quad.texture, 0);
+
+	gl_renderer->quad.initialized = 1;
+}
+
+void
+update_quad_texture(struct gl_renderer_t* gl_renderer, struct quad_layer_t* quad, const void* pixels)
+{
+	if (!gl_renderer->quad.initialized) {
+		printf("Creating Quad texture\n");
+		initialize_quad(gl_renderer, quad);
+	}
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, gl_renderer->quad.texture);
+
+	// Frame is BGR
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, (GLsizei)quad->pixel_width, (GLsizei)quad->pixel_height,
+	             0, GL_BGR, GL_UNSIGNED_BYTE, pixels);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, gl_renderer->quad.fbo);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+	                       gl_renderer->quad.texture, 0);
+}
+
+void
+render_quad(struct gl_renderer_t* gl_renderer,
+            struct quad_layer_t* quad,
+            uint32_t swapchain_index,
+            XrTime predictedDisplayTime)
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, gl_renderer->quad.fbo);
+
+	GLuint texture = quad->swapchain.images[0][swapchain_index].image;
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, quad->pixel_width, quad->pixel_height);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief OpenGL rendering of the projection and quad layers.
+ */
+
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "app.h"
+
+int
+init_gl(uint32_t view_count, uint32_t* swapchain_lengths, struct gl_renderer_t* gl_renderer);
+
+// builds the draw list of the frame from the sampled input, call once per frame before rendering
+// the views. Does not touch GL state, so it can run on another thread than the rendering when the
+// list is handed over as gl_renderer->draw_list afterwards.
+void
+prepare_scene(struct ApplicationState* app,
+              struct draw_list_t* list,
+              XrSpaceLocation* hand_locations,
+              struct hand_tracking_t* hand_tracking);
+
+// late latch: replaces the model matrices of the joints prepare_scene() drew for `hand` with the
+// ones of fresher joint locations. Joints that were not drawn or lost their position keep their
+// matrix, the next render_frame() uploads the changed items.
+void
+update_hand_joints(struct draw_list_t* list,
+                   int hand,
+                   const XrHandJointLocationEXT* joints,
+                   uint32_t joint_count);
+
+// renders the draw list for one view into the swapchain texture `image`, leaves the default
+// framebuffer bound
+void
+render_frame(int w,
+             int h,
+             struct gl_renderer_t* gl_renderer,
+             uint32_t projection_index,
+             int view_index,
+             XrView* view,
+             GLuint image,
+             bool depth_supported,
+             GLuint depthbuffer);
+
+// renders both views into layer 0 and 1 of the array textures `image` and `depthbuffer` in one pass,
+// needs gl_renderer->stereo_mode != STEREO_OFF and a single swapchain passed to init_gl()
+void
+render_frame_stereo(int w,
+                    int h,
+                    struct gl_renderer_t* gl_renderer,
+                    uint32_t projection_index,
+                    XrView* views,
+                    GLuint image,
+                    bool depth_supported,
+                    GLuint depthbuffer);
+
+const char*
+stereo_mode_name(enum stereo_mode mode);
+
+// accepts the names returned by stereo_mode_name()
+bool
+parse_stereo_mode(const char* name, enum stereo_mode* mode);
+
+// uploads a BGR frame of quad->pixel_width x quad->pixel_height, creates the texture on first use
+void
+update_quad_texture(struct gl_renderer_t* gl_renderer, struct quad_layer_t* quad, const void* pixels);
+
+// copies the last uploaded frame into the quad swapchain image
+void
+render_quad(struct gl_renderer_t* gl_renderer,
+            struct quad_layer_t* quad,
+            uint32_t swapchain_index,
+            XrTime predictedDisplayTime);
+
+#endif // RENDERER_H
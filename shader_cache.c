@@ -0,0 +1,272 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief On disk cache of linked GL program binaries, see shader_cache.h.
+ */
+
+#include "shader_cache.h"
+#include "logger.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+// drivers list one or two
+#define MAX_BINARY_FORMATS 16
+
+static struct
+{
+	bool enabled;
+	char dir[PATH_MAX];
+
+	// looked up with the first program, needs a current context
+	bool driver_checked;
+	uint64_t driver_hash;
+	GLint binary_formats[MAX_BINARY_FORMATS];
+	uint32_t binary_format_count;
+
+	struct shader_cache_stats stats;
+} cache;
+
+// FNV-1a, the terminating 0 is hashed as well so that {"ab", "c"} and {"a", "bc"} differ
+static uint64_t
+hash_string(uint64_t hash, const char* s)
+{
+	do {
+		hash ^= (uint8_t)*s;
+		hash *= FNV_PRIME;
+	} while (*s++ != '\0');
+	return hash;
+}
+
+static bool
+make_dirs(char* path)
+{
+	for (char* p = path + 1; *p != '\0'; p++) {
+		if (*p != '/')
+			continue;
+		*p = '\0';
+		bool ok = mkdir(path, 0755) == 0 || errno == EEXIST;
+		*p = '/';
+		if (!ok)
+			return false;
+	}
+	return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+void
+shader_cache_init(const char* dir)
+{
+	int len;
+	if (dir != NULL) {
+		len = snprintf(cache.dir, sizeof(cache.dir), "%s", dir);
+	} else if (getenv("XDG_CACHE_HOME") != NULL && getenv("XDG_CACHE_HOME")[0] != '\0') {
+		len = snprintf(cache.dir, sizeof(cache.dir), "%s/lis_vr_app", getenv("XDG_CACHE_HOME"));
+	} else if (getenv("HOME") != NULL) {
+		len = snprintf(cache.dir, sizeof(cache.dir), "%s/.cache/lis_vr_app", getenv("HOME"));
+	} else {
+		LOG_WARN("Neither XDG_CACHE_HOME nor HOME set, shader cache disabled\n");
+		return;
+	}
+
+	if (len <= 0 || (size_t)len >= sizeof(cache.dir) || !make_dirs(cache.dir)) {
+		LOG_WARN("Can not create shader cache directory %s, shader cache disabled\n", cache.dir);
+		return;
+	}
+	cache.enabled = true;
+}
+
+// false if the context can not return program binaries
+static bool
+check_driver(void)
+{
+	if (cache.driver_checked)
+		return cache.enabled;
+	cache.driver_checked = true;
+
+	// GL 4.1 or ARB_get_program_binary, older contexts report an invalid enum
+	while (glGetError() != GL_NO_ERROR)
+		;
+	GLint format_count = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+	if (glGetError() != GL_NO_ERROR || format_count <= 0) {
+		LOG_INFO("No program binary formats, shader cache disabled\n");
+		cache.enabled = false;
+		return false;
+	}
+
+	// an entry in a format the driver does not list would only be rejected by glProgramBinary()
+	GLint* formats = malloc(format_count * sizeof(*formats));
+	if (formats == NULL) {
+		cache.enabled = false;
+		return false;
+	}
+	glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats);
+	cache.binary_format_count =
+	    format_count < MAX_BINARY_FORMATS ? (uint32_t)format_count : MAX_BINARY_FORMATS;
+	memcpy(cache.binary_formats, formats, cache.binary_format_count * sizeof(*formats));
+	free(formats);
+
+	uint64_t hash = FNV_OFFSET;
+	hash = hash_string(hash, (const char*)glGetString(GL_VENDOR));
+	hash = hash_string(hash, (const char*)glGetString(GL_RENDERER));
+	hash = hash_string(hash, (const char*)glGetString(GL_VERSION));
+	cache.driver_hash = hash;
+	return true;
+}
+
+static bool
+binary_format_supported(uint32_t format)
+{
+	for (uint32_t i = 0; i < cache.binary_format_count; i++) {
+		if ((uint32_t)cache.binary_formats[i] == format)
+			return true;
+	}
+	return false;
+}
+
+static uint64_t
+source_hash(const char* const* sources, uint32_t source_count)
+{
+	uint64_t hash = FNV_OFFSET;
+	for (uint32_t i = 0; i < source_count; i++)
+		hash = hash_string(hash, sources[i]);
+	return hash;
+}
+
+static void
+entry_path(char* path, size_t size, uint64_t sources)
+{
+	snprintf(path, size, "%s/%016llx.bin", cache.dir,
+	         (unsigned long long)(sources ^ (cache.driver_hash * FNV_PRIME)));
+}
+
+// the binary of a valid entry for sources_hash, NULL if there is none
+static void*
+read_entry(const char* path, uint64_t sources_hash, struct shader_cache_header* header)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == NULL)
+		return NULL;
+
+	void* binary = NULL;
+	bool valid = fread(header, sizeof(*header), 1, file) == 1 &&
+	             header->magic == SHADER_CACHE_MAGIC && header->version == SHADER_CACHE_VERSION &&
+	             header->source_hash == sources_hash && header->driver_hash == cache.driver_hash &&
+	             binary_format_supported(header->binary_format) && header->binary_length > 0;
+	if (valid) {
+		binary = malloc(header->binary_length);
+		valid = binary != NULL && fread(binary, header->binary_length, 1, file) == 1;
+	}
+	fclose(file);
+	if (!valid) {
+		free(binary);
+		LOG_DEBUG("Ignoring stale shader cache entry %s\n", path);
+		return NULL;
+	}
+	return binary;
+}
+
+GLuint
+shader_cache_load(const char* const* sources, uint32_t source_count)
+{
+	if (!cache.enabled || !check_driver())
+		return 0;
+
+	uint64_t sources_hash = source_hash(sources, source_count);
+	char path[PATH_MAX + 32];
+	entry_path(path, sizeof(path), sources_hash);
+
+	struct shader_cache_header header;
+	void* binary = read_entry(path, sources_hash, &header);
+	if (binary == NULL) {
+		cache.stats.misses++;
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.binary_format, binary, (GLsizei)header.binary_length);
+	free(binary);
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		LOG_INFO("Driver rejected cached program %s, compiling it\n", path);
+		glDeleteProgram(program);
+		// the invalid binary may have raised a GL error
+		while (glGetError() != GL_NO_ERROR)
+			;
+		cache.stats.rejected++;
+		cache.stats.misses++;
+		return 0;
+	}
+
+	cache.stats.hits++;
+	return program;
+}
+
+void
+shader_cache_prepare(GLuint program)
+{
+	if (cache.enabled && check_driver())
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void
+shader_cache_store(GLuint program, const char* const* sources, uint32_t source_count)
+{
+	if (!cache.enabled || !check_driver())
+		return;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+	void* binary = malloc((size_t)length);
+	if (binary == NULL)
+		return;
+
+	struct shader_cache_header header = {
+	    .magic = SHADER_CACHE_MAGIC,
+	    .version = SHADER_CACHE_VERSION,
+	    .source_hash = source_hash(sources, source_count),
+	    .driver_hash = cache.driver_hash,
+	};
+	GLenum format = 0;
+	GLsizei written = 0;
+	glGetProgramBinary(program, length, &written, &format, binary);
+	header.binary_format = format;
+	header.binary_length = (uint32_t)written;
+
+	char path[PATH_MAX + 32];
+	char tmp_path[PATH_MAX + 64];
+	entry_path(path, sizeof(path), header.source_hash);
+	snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path, (int)getpid());
+
+	FILE* file = written > 0 ? fopen(tmp_path, "wb") : NULL;
+	bool ok = file != NULL && fwrite(&header, sizeof(header), 1, file) == 1 &&
+	          fwrite(binary, (size_t)written, 1, file) == 1;
+	if (file != NULL && fclose(file) != 0)
+		ok = false;
+	free(binary);
+
+	if (ok && rename(tmp_path, path) == 0) {
+		cache.stats.stored++;
+	} else {
+		LOG_WARN("Could not write shader cache entry %s\n", path);
+		if (file != NULL)
+			unlink(tmp_path);
+	}
+}
+
+struct shader_cache_stats
+shader_cache_get_stats(void)
+{
+	return cache.stats;
+}
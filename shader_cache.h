@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief On disk cache of linked GL program binaries.
+ *
+ * A program is looked up by a hash of its shader sources and of GL_VENDOR, GL_RENDERER and
+ * GL_VERSION. Hits are loaded with glProgramBinary(), misses are compiled and linked by the caller
+ * as before and stored with glGetProgramBinary(). A binary the driver rejects, for example after a
+ * driver update that kept the version string, is treated as a miss and overwritten.
+ *
+ * Every entry is one file named after the key hash:
+ *
+ *   | struct shader_cache_header | binary |
+ *
+ * The header repeats both hashes and the binary format, a file is only used if both hashes match
+ * and the driver lists the format in GL_PROGRAM_BINARY_FORMATS.
+ * Files are written to a temporary name and renamed, so concurrent instances never read a
+ * partially written entry.
+ */
+
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app.h"
+
+#define SHADER_CACHE_MAGIC 0x43505347u // "GSPC"
+#define SHADER_CACHE_VERSION 1
+
+struct shader_cache_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t source_hash;
+	uint64_t driver_hash;
+	uint32_t binary_format;
+	uint32_t binary_length;
+};
+
+struct shader_cache_stats
+{
+	uint32_t hits;
+	uint32_t misses;
+	// binaries the driver did not accept
+	uint32_t rejected;
+	uint32_t stored;
+};
+
+// dir NULL uses $XDG_CACHE_HOME/lis_vr_app or ~/.cache/lis_vr_app. Without this call, or if the
+// directory can not be created, every lookup misses and nothing is stored.
+void
+shader_cache_init(const char* dir);
+
+// with the context current. sources are all sources the program is built from, in a fixed order.
+// Returns a linked program, 0 on a miss.
+GLuint
+shader_cache_load(const char* const* sources, uint32_t source_count);
+
+// call before glLinkProgram() on a program that is stored afterwards
+void
+shader_cache_prepare(GLuint program);
+
+// stores a program that was linked from sources after a miss
+void
+shader_cache_store(GLuint program, const char* const* sources, uint32_t source_count);
+
+struct shader_cache_stats
+shader_cache_get_stats(void);
+
+#endif // SHADER_CACHE_H
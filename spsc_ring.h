@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Lock-free single-producer single-consumer ring of fixed-size slots.
+ *
+ * The producer reserves a slot, fills it in place and commits it; the consumer peeks the oldest
+ * committed slot and releases it when done. No slot is ever copied by the ring itself, so records
+ * can be written directly into their final location.
+ *
+ * head and tail are free running counters on separate cache lines. Each side keeps a cached copy
+ * of the other side's counter so the common case touches no shared cache line at all.
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define SPSC_CACHE_LINE 64
+
+struct spsc_ring
+{
+	// producer side
+	_Alignas(SPSC_CACHE_LINE) _Atomic uint32_t head;
+	uint32_t cached_tail;
+
+	// consumer side
+	_Alignas(SPSC_CACHE_LINE) _Atomic uint32_t tail;
+	uint32_t cached_head;
+
+	// immutable after init
+	_Alignas(SPSC_CACHE_LINE) uint32_t mask;
+	uint32_t slot_size;
+	uint8_t* slots;
+};
+
+// capacity is rounded up to a power of two, slot_size up to a multiple of 8 bytes
+static inline bool
+spsc_ring_init(struct spsc_ring* ring, uint32_t capacity, uint32_t slot_size)
+{
+	uint32_t cap = 1;
+	while (cap < capacity)
+		cap <<= 1;
+
+	slot_size = (slot_size + 7u) & ~7u;
+
+	ring->slots = aligned_alloc(SPSC_CACHE_LINE, (size_t)cap * slot_size);
+	if (ring->slots == NULL)
+		return false;
+
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+	ring->cached_tail = 0;
+	ring->cached_head = 0;
+	ring->mask = cap - 1;
+	ring->slot_size = slot_size;
+	return true;
+}
+
+static inline void
+spsc_ring_destroy(struct spsc_ring* ring)
+{
+	free(ring->slots);
+	ring->slots = NULL;
+}
+
+static inline uint32_t
+spsc_ring_capacity(const struct spsc_ring* ring)
+{
+	return ring->mask + 1;
+}
+
+// producer: returns the next free slot or NULL if the ring is full
+static inline void*
+spsc_ring_reserve(struct spsc_ring* ring)
+{
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	if (head - ring->cached_tail > ring->mask) {
+		ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+		if (head - ring->cached_tail > ring->mask)
+			return NULL;
+	}
+	return ring->slots + (size_t)(head & ring->mask) * ring->slot_size;
+}
+
+// producer: publish the slot returned by the last spsc_ring_reserve()
+static inline void
+spsc_ring_commit(struct spsc_ring* ring)
+{
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+// consumer: returns the oldest committed slot or NULL if the ring is empty
+static inline void*
+spsc_ring_peek(struct spsc_ring* ring)
+{
+	uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	if (tail == ring->cached_head) {
+		ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+		if (tail == ring->cached_head)
+			return NULL;
+	}
+	return ring->slots + (size_t)(tail & ring->mask) * ring->slot_size;
+}
+
+// consumer: hand the slot returned by the last spsc_ring_peek() back to the producer
+static inline void
+spsc_ring_release(struct spsc_ring* ring)
+{
+	uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+#endif // SPSC_RING_H
@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Startup trace and the options gate, see startup.h.
+ */
+
+#include "startup.h"
+#include "logger.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+
+struct startup_phase_record
+{
+	const char* name;
+	int64_t start_ns;
+	int64_t end_ns;
+};
+
+static const char* milestone_names[STARTUP_MILESTONE_COUNT] = {
+    [STARTUP_SESSION_READY] = "session ready",
+    [STARTUP_FIRST_FRAME] = "first frame",
+    [STARTUP_FIRST_VIDEO_RECEIVED] = "first video frame received",
+    [STARTUP_FIRST_VIDEO_FRAME] = "first frame with video",
+};
+
+static struct
+{
+	int64_t start_ns;
+
+	// startup only, a mutex is fine
+	pthread_mutex_t mutex;
+	pthread_cond_t released_cond;
+	bool released[STARTUP_GATE_COUNT];
+	struct startup_phase_record phases[STARTUP_MAX_PHASES];
+	uint32_t phase_count;
+
+	// ns since start_ns, 0 until reached
+	_Atomic int64_t milestones[STARTUP_MILESTONE_COUNT];
+} startup = {.mutex = PTHREAD_MUTEX_INITIALIZER, .released_cond = PTHREAD_COND_INITIALIZER};
+
+int64_t
+startup_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void
+startup_init(void)
+{
+	startup.start_ns = startup_now();
+}
+
+int64_t
+startup_phase(const char* name, int64_t start_ns)
+{
+	int64_t now = startup_now();
+	pthread_mutex_lock(&startup.mutex);
+	if (startup.phase_count < STARTUP_MAX_PHASES) {
+		startup.phases[startup.phase_count++] = (struct startup_phase_record){
+		    .name = name, .start_ns = start_ns, .end_ns = now};
+	}
+	pthread_mutex_unlock(&startup.mutex);
+	return now;
+}
+
+void
+startup_milestone(enum startup_milestone milestone)
+{
+	if (atomic_load_explicit(&startup.milestones[milestone], memory_order_relaxed) != 0)
+		return;
+
+	int64_t since_start = startup_now() - startup.start_ns;
+	int64_t expected = 0;
+	if (atomic_compare_exchange_strong(&startup.milestones[milestone], &expected, since_start))
+		LOG_INFO("Startup: %s after %.3f ms\n", milestone_names[milestone], since_start / 1e6);
+}
+
+void
+startup_release(enum startup_gate gate)
+{
+	pthread_mutex_lock(&startup.mutex);
+	startup.released[gate] = true;
+	pthread_cond_broadcast(&startup.released_cond);
+	pthread_mutex_unlock(&startup.mutex);
+}
+
+void
+startup_wait(enum startup_gate gate)
+{
+	pthread_mutex_lock(&startup.mutex);
+	while (!startup.released[gate])
+		pthread_cond_wait(&startup.released_cond, &startup.mutex);
+	pthread_mutex_unlock(&startup.mutex);
+}
+
+void
+startup_print(void)
+{
+	pthread_mutex_lock(&startup.mutex);
+
+	// by start time, phases of different threads interleave
+	struct startup_phase_record* phases = startup.phases;
+	for (uint32_t i = 1; i < startup.phase_count; i++) {
+		struct startup_phase_record phase = phases[i];
+		uint32_t j = i;
+		for (; j > 0 && phases[j - 1].start_ns > phase.start_ns; j--)
+			phases[j] = phases[j - 1];
+		phases[j] = phase;
+	}
+
+	printf("Startup trace (ms since start):  %9s    %9s  %9s\n", "start", "end", "duration");
+	for (uint32_t i = 0; i < startup.phase_count; i++) {
+		printf("  %-30s %9.3f .. %9.3f  %9.3f\n", phases[i].name,
+		       (phases[i].start_ns - startup.start_ns) / 1e6,
+		       (phases[i].end_ns - startup.start_ns) / 1e6,
+		       (phases[i].end_ns - phases[i].start_ns) / 1e6);
+	}
+
+	for (int m = 0; m < STARTUP_MILESTONE_COUNT; m++) {
+		int64_t since_start = atomic_load(&startup.milestones[m]);
+		if (since_start != 0)
+			printf("  %-30s %9.3f\n", milestone_names[m], since_start / 1e6);
+		else
+			printf("  %-30s not reached\n", milestone_names[m]);
+	}
+
+	pthread_mutex_unlock(&startup.mutex);
+}
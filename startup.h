@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Startup trace and the gate that releases the network thread.
+ *
+ * main() stamps the process start, every thread then records the phases it runs during startup
+ * (socket setup, instance and session creation, GL init, ...) with their start and end relative to
+ * it, phase names start with the thread. Milestones like the first submitted frame are logged the
+ * first time they are reached. The whole trace is printed by startup_print() at exit.
+ *
+ * The network thread binds its sockets and maps its buffers in parallel with the OpenXR setup, only
+ * what depends on the command line waits for STARTUP_GATE_OPTIONS, released right after
+ * parse_opts(). Nothing it does needs the session: it sends joints once the frame loop packs them.
+ * The session being ready is a milestone, STARTUP_SESSION_READY.
+ */
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum startup_gate
+{
+	STARTUP_GATE_OPTIONS,
+	STARTUP_GATE_COUNT,
+};
+
+enum startup_milestone
+{
+	// main_loop() attached the action sets to the session, or replay_session() opened the recording
+	STARTUP_SESSION_READY,
+	// xrEndFrame() returned for the first frame
+	STARTUP_FIRST_FRAME,
+	// the network thread got the first complete video frame
+	STARTUP_FIRST_VIDEO_RECEIVED,
+	// the first frame with a video frame in the quad layer was submitted
+	STARTUP_FIRST_VIDEO_FRAME,
+	STARTUP_MILESTONE_COUNT,
+};
+
+// phases beyond this are dropped from the trace
+#define STARTUP_MAX_PHASES 32
+
+// the time everything is relative to, called first thing in main()
+void
+startup_init(void);
+
+// CLOCK_MONOTONIC in ns, the start argument of startup_phase()
+int64_t
+startup_now(void);
+
+// the calling thread ran the phase from start_ns until now, returns now to chain phases. name has
+// to be a string literal.
+int64_t
+startup_phase(const char* name, int64_t start_ns);
+
+// only the first call per milestone is recorded, later calls are a relaxed atomic load
+void
+startup_milestone(enum startup_milestone milestone);
+
+void
+startup_release(enum startup_gate gate);
+
+// blocks until startup_release(gate)
+void
+startup_wait(enum startup_gate gate);
+
+// trace and milestones to stdout
+void
+startup_print(void);
+
+#endif // STARTUP_H
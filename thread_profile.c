@@ -0,0 +1,332 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Thread placement, scheduling and loop jitter, see thread_profile.h.
+ */
+
+#define _GNU_SOURCE
+#include "thread_profile.h"
+#include "logger.h"
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+struct thread_profile
+{
+	// as given, empty without cpus=
+	char cpu_list[32];
+	cpu_set_t cpus;
+	// SCHED_FIFO or SCHED_RR if realtime
+	bool realtime;
+	int policy;
+	int priority;
+};
+
+// thread_profile_tick() of the role's thread updates the interval sums, they are atomic because
+// thread_profile_print() may run before that thread's loop ended
+struct thread_stats
+{
+	// the first thread of the role owns the stats
+	_Atomic bool claimed;
+	// set with release once placement is filled in
+	_Atomic bool started;
+	char placement[64];
+
+	_Atomic uint64_t ticks;
+	// intervals between ticks in ms
+	_Atomic double sum_ms;
+	_Atomic double sum_sq_ms;
+	_Atomic double max_ms;
+	_Atomic long involuntary_switches;
+};
+
+static const char* role_names[THREAD_ROLE_COUNT] = {
+    [THREAD_ROLE_XR] = "xr",
+    [THREAD_ROLE_RENDER] = "render",
+    [THREAD_ROLE_MIRROR] = "mirror",
+    [THREAD_ROLE_NET] = "net",
+    [THREAD_ROLE_JOB] = "job",
+};
+
+static struct
+{
+	// written by parse_opts() before the threads are released
+	struct thread_profile profiles[THREAD_ROLE_COUNT];
+	struct thread_stats stats[THREAD_ROLE_COUNT];
+} threads;
+
+static _Thread_local struct thread_stats* thread_stats;
+static _Thread_local int64_t last_tick_ns;
+static _Thread_local long last_involuntary_switches;
+
+static int64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool
+parse_cpus(const char* list, cpu_set_t* cpus)
+{
+	CPU_ZERO(cpus);
+	const char* p = list;
+	while (*p != '\0') {
+		char* end;
+		long first = strtol(p, &end, 10);
+		long last = first;
+		if (end == p || first < 0)
+			return false;
+		if (*end == '-') {
+			p = end + 1;
+			last = strtol(p, &end, 10);
+			if (end == p || last < first)
+				return false;
+		}
+		if (last >= CPU_SETSIZE || (*end != ',' && *end != '\0'))
+			return false;
+		for (long cpu = first; cpu <= last; cpu++)
+			CPU_SET(cpu, cpus);
+		p = *end == ',' ? end + 1 : end;
+	}
+	return CPU_COUNT(cpus) > 0;
+}
+
+static bool
+parse_priority(const char* value, int policy, int* priority)
+{
+	char* end;
+	long parsed = strtol(value, &end, 10);
+	if (end == value || *end != '\0' || parsed < sched_get_priority_min(policy) ||
+	    parsed > sched_get_priority_max(policy))
+		return false;
+	*priority = (int)parsed;
+	return true;
+}
+
+bool
+thread_profile_parse(const char* spec)
+{
+	char fields[128];
+	if (snprintf(fields, sizeof(fields), "%s", spec) >= (int)sizeof(fields))
+		return false;
+
+	char* save = NULL;
+	const char* name = strtok_r(fields, ":", &save);
+	int role = 0;
+	while (name != NULL && role < THREAD_ROLE_COUNT && strcmp(name, role_names[role]) != 0)
+		role++;
+	if (role == THREAD_ROLE_COUNT || name == NULL)
+		return false;
+
+	struct thread_profile profile = threads.profiles[role];
+	char* field;
+	while ((field = strtok_r(NULL, ":", &save)) != NULL) {
+		if (strncmp(field, "cpus=", 5) == 0) {
+			if (strlen(field + 5) >= sizeof(profile.cpu_list) ||
+			    !parse_cpus(field + 5, &profile.cpus))
+				return false;
+			strcpy(profile.cpu_list, field + 5);
+		} else if (strncmp(field, "fifo=", 5) == 0) {
+			profile.realtime = true;
+			profile.policy = SCHED_FIFO;
+			if (!parse_priority(field + 5, SCHED_FIFO, &profile.priority))
+				return false;
+		} else if (strncmp(field, "rr=", 3) == 0) {
+			profile.realtime = true;
+			profile.policy = SCHED_RR;
+			if (!parse_priority(field + 3, SCHED_RR, &profile.priority))
+				return false;
+		} else if (strcmp(field, "other") == 0) {
+			profile.realtime = false;
+		} else {
+			return false;
+		}
+	}
+	threads.profiles[role] = profile;
+	return true;
+}
+
+static void
+apply_policy(const char* name, int policy, int priority)
+{
+	struct sched_param param = {.sched_priority = priority};
+	int err = pthread_setschedparam(pthread_self(), policy, &param);
+	if (err == EPERM) {
+		// without CAP_SYS_NICE the rtprio limit (limits.conf, ulimit -r) caps the priority
+		struct rlimit limit;
+		if (getrlimit(RLIMIT_RTPRIO, &limit) == 0 && limit.rlim_cur > 0) {
+			rlim_t max = (rlim_t)sched_get_priority_max(policy);
+			rlim_t cap = limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur > max ? max : limit.rlim_cur;
+			param.sched_priority = (int)cap < priority ? (int)cap : priority;
+			err = pthread_setschedparam(pthread_self(), policy, &param);
+			if (err == 0)
+				LOG_WARN("Thread %s: real-time priority %d capped to %d by RLIMIT_RTPRIO\n", name,
+				         priority, param.sched_priority);
+		}
+	}
+	if (err != 0) {
+		LOG_WARN("Thread %s: no real-time scheduling (%s), using SCHED_OTHER\n", name,
+		         strerror(err));
+		param.sched_priority = 0;
+		pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+	}
+}
+
+// taskset style like 0-3,6, "any" if every CPU of the system is in the set
+static void
+format_cpus(const cpu_set_t* cpus, char* out, size_t size)
+{
+	bool any = true;
+	for (long cpu = 0; cpu < sysconf(_SC_NPROCESSORS_CONF) && cpu < CPU_SETSIZE; cpu++)
+		any = any && CPU_ISSET(cpu, cpus);
+	if (any) {
+		snprintf(out, size, "any");
+		return;
+	}
+	size_t len = 0;
+	out[0] = '\0';
+	for (int cpu = 0; cpu < CPU_SETSIZE && len < size; cpu++) {
+		if (!CPU_ISSET(cpu, cpus))
+			continue;
+		int last = cpu;
+		while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, cpus))
+			last++;
+		const char* separator = len > 0 ? "," : "";
+		int written = last > cpu ? snprintf(out + len, size - len, "%s%d-%d", separator, cpu, last)
+		                         : snprintf(out + len, size - len, "%s%d", separator, cpu);
+		len += written > 0 ? (size_t)written : 0;
+		cpu = last;
+	}
+}
+
+// what the thread actually got, not what its profile asked for
+static void
+describe_placement(char* out, size_t size)
+{
+	char cpus[40] = "?";
+	cpu_set_t set;
+	if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+		format_cpus(&set, cpus, sizeof(cpus));
+
+	int policy = SCHED_OTHER;
+	struct sched_param param = {0};
+	pthread_getschedparam(pthread_self(), &policy, &param);
+	if (policy == SCHED_FIFO || policy == SCHED_RR)
+		snprintf(out, size, "cpus %s, %s %d", cpus, policy == SCHED_FIFO ? "fifo" : "rr",
+		         param.sched_priority);
+	else
+		snprintf(out, size, "cpus %s, other", cpus);
+}
+
+void
+thread_profile_start(enum thread_role role)
+{
+	const char* name = role_names[role];
+	const struct thread_profile* profile = &threads.profiles[role];
+	struct thread_stats* stats = &threads.stats[role];
+
+	char thread_name[16];
+	snprintf(thread_name, sizeof(thread_name), "lis-%s", name);
+	pthread_setname_np(pthread_self(), thread_name);
+
+	// threads inherit the mask and policy of their creator, a role without a profile gets all CPUs
+	// and SCHED_OTHER instead of the xr thread's placement
+	cpu_set_t all_cpus;
+	const cpu_set_t* cpus = &profile->cpus;
+	if (profile->cpu_list[0] == '\0') {
+		CPU_ZERO(&all_cpus);
+		for (long cpu = 0; cpu < sysconf(_SC_NPROCESSORS_CONF) && cpu < CPU_SETSIZE; cpu++)
+			CPU_SET(cpu, &all_cpus);
+		cpus = &all_cpus;
+	}
+	int err = pthread_setaffinity_np(pthread_self(), sizeof(*cpus), cpus);
+	if (err != 0)
+		LOG_WARN("Thread %s: could not set the CPU affinity (%s)\n", name, strerror(err));
+
+	if (profile->realtime) {
+		apply_policy(name, profile->policy, profile->priority);
+	} else {
+		struct sched_param param = {.sched_priority = 0};
+		pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+	}
+	if (atomic_exchange_explicit(&stats->claimed, true, memory_order_relaxed))
+		return;
+	describe_placement(stats->placement, sizeof(stats->placement));
+
+	thread_stats = stats;
+	last_tick_ns = 0;
+	struct rusage usage;
+	last_involuntary_switches = getrusage(RUSAGE_THREAD, &usage) == 0 ? usage.ru_nivcsw : 0;
+	atomic_store_explicit(&stats->started, true, memory_order_release);
+}
+
+// single writer, so a relaxed load and store is enough, C11 has no fetch_add for doubles
+static void
+add_relaxed(_Atomic double* sum, double value)
+{
+	atomic_store_explicit(sum, atomic_load_explicit(sum, memory_order_relaxed) + value,
+	                      memory_order_relaxed);
+}
+
+void
+thread_profile_tick(void)
+{
+	struct thread_stats* stats = thread_stats;
+	if (stats == NULL)
+		return;
+
+	int64_t now = now_ns();
+	if (last_tick_ns != 0) {
+		double interval_ms = (now - last_tick_ns) / 1e6;
+		atomic_fetch_add_explicit(&stats->ticks, 1, memory_order_relaxed);
+		add_relaxed(&stats->sum_ms, interval_ms);
+		add_relaxed(&stats->sum_sq_ms, interval_ms * interval_ms);
+		if (interval_ms > atomic_load_explicit(&stats->max_ms, memory_order_relaxed))
+			atomic_store_explicit(&stats->max_ms, interval_ms, memory_order_relaxed);
+	}
+	last_tick_ns = now;
+
+	struct rusage usage;
+	if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+		atomic_fetch_add_explicit(&stats->involuntary_switches,
+		                          usage.ru_nivcsw - last_involuntary_switches, memory_order_relaxed);
+		last_involuntary_switches = usage.ru_nivcsw;
+	}
+}
+
+void
+thread_profile_print(void)
+{
+	printf("Threads (loop interval ms):  %-24s  %8s  %8s  %8s  %8s  %9s\n", "placement", "loops",
+	       "mean", "stddev", "max", "preempted");
+	for (int role = 0; role < THREAD_ROLE_COUNT; role++) {
+		struct thread_stats* stats = &threads.stats[role];
+		if (!atomic_load_explicit(&stats->started, memory_order_acquire))
+			continue;
+
+		uint64_t ticks = atomic_load_explicit(&stats->ticks, memory_order_relaxed);
+		double mean = 0, stddev = 0;
+		if (ticks > 0) {
+			mean = atomic_load_explicit(&stats->sum_ms, memory_order_relaxed) / ticks;
+			double variance =
+			    atomic_load_explicit(&stats->sum_sq_ms, memory_order_relaxed) / ticks - mean * mean;
+			stddev = variance > 0 ? sqrt(variance) : 0;
+		}
+		printf("  %-26s  %-24s  %8lu  %8.3f  %8.3f  %8.3f  %9ld\n", role_names[role],
+		       stats->placement, (unsigned long)ticks, mean, stddev,
+		       atomic_load_explicit(&stats->max_ms, memory_order_relaxed),
+		       atomic_load_explicit(&stats->involuntary_switches, memory_order_relaxed));
+	}
+}
@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Per-thread CPU affinity, real-time scheduling and loop jitter.
+ *
+ * Every long running thread of the app has a role, all job workers share one. --threadprofile sets
+ * the CPUs a role may run on and its scheduling policy, thread_profile_start() names the calling
+ * thread (pthread_setname_np, visible in top -H and perf) and applies its profile. A real-time
+ * policy the process may not use (no CAP_SYS_NICE and RLIMIT_RTPRIO too low) falls back to the
+ * highest allowed priority, or to SCHED_OTHER with a warning.
+ *
+ * Threads call thread_profile_tick() once per loop iteration. The interval between ticks, its
+ * deviation and the involuntary context switches of the thread are printed per thread at exit, to
+ * see which placement keeps the loops steady.
+ */
+
+#ifndef THREAD_PROFILE_H
+#define THREAD_PROFILE_H
+
+#include <stdbool.h>
+
+enum thread_role
+{
+	THREAD_ROLE_XR,
+	THREAD_ROLE_RENDER,
+	THREAD_ROLE_MIRROR,
+	THREAD_ROLE_NET,
+	// every job system worker
+	THREAD_ROLE_JOB,
+	THREAD_ROLE_COUNT,
+};
+
+// <thread>[:cpus=<list>][:fifo=<priority>|:rr=<priority>|:other], thread is xr, render, mirror,
+// net or job, list is taskset style like 2-3,6. Returns false on a malformed spec.
+bool
+thread_profile_parse(const char* spec);
+
+// names the calling thread and applies the profile of role, before the thread's loop starts. The
+// first thread of a role is the one reported, later ones (job workers) only get the placement.
+void
+thread_profile_start(enum thread_role role);
+
+// once per loop iteration of the calling thread
+void
+thread_profile_tick(void);
+
+// placement and loop intervals of every thread that started, to stdout
+void
+thread_profile_print(void);
+
+#endif // THREAD_PROFILE_H
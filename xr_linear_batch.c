@@ -0,0 +1,342 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief SSE and AVX2 kernels for XrMatrix4x4f_CreateModelMatrices() and their runtime selection.
+ *
+ * All kernels compute the rotation part with the same operations in the same order as
+ * XrMatrix4x4f_CreateFromQuaternion() and apply scale and translation directly instead of by the two
+ * full matrix multiplications of XrMatrix4x4f_CreateModelMatrix(), which only add zeros. The results
+ * are the same, up to the sign of zero elements. The SSE and AVX2 kernels transform 4 or 8 poses at
+ * once, one pose per lane, and pass the remaining poses on to the next narrower kernel.
+ */
+
+#include "xr_linear_batch.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define XR_LINEAR_BATCH_X86
+#include <immintrin.h>
+#endif
+
+typedef void (*model_matrices_fn)(XrMatrix4x4f* results,
+                                  const XrPosef* poses,
+                                  const XrVector3f* scales,
+                                  uint32_t count);
+
+struct model_matrices_kernel
+{
+	model_matrices_fn fn;
+	enum xr_simd_level level;
+};
+
+// NULL until the first call or XrMatrix4x4f_SetSimdLevel(), the xr thread's jobs and the render
+// thread may build matrices at the same time
+static _Atomic(const struct model_matrices_kernel*) model_matrices_kernel;
+
+static void
+model_matrices_scalar(XrMatrix4x4f* results,
+                      const XrPosef* poses,
+                      const XrVector3f* scales,
+                      uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		const XrQuaternionf* q = &poses[i].orientation;
+		const XrVector3f* s = &scales[i];
+		float* m = results[i].m;
+
+		const float x2 = q->x + q->x;
+		const float y2 = q->y + q->y;
+		const float z2 = q->z + q->z;
+
+		const float xx2 = q->x * x2;
+		const float yy2 = q->y * y2;
+		const float zz2 = q->z * z2;
+
+		const float yz2 = q->y * z2;
+		const float wx2 = q->w * x2;
+		const float xy2 = q->x * y2;
+		const float wz2 = q->w * z2;
+		const float xz2 = q->x * z2;
+		const float wy2 = q->w * y2;
+
+		m[0] = (1.0f - yy2 - zz2) * s->x;
+		m[1] = (xy2 + wz2) * s->x;
+		m[2] = (xz2 - wy2) * s->x;
+		m[3] = 0.0f;
+
+		m[4] = (xy2 - wz2) * s->y;
+		m[5] = (1.0f - xx2 - zz2) * s->y;
+		m[6] = (yz2 + wx2) * s->y;
+		m[7] = 0.0f;
+
+		m[8] = (xz2 + wy2) * s->z;
+		m[9] = (yz2 - wx2) * s->z;
+		m[10] = (1.0f - xx2 - yy2) * s->z;
+		m[11] = 0.0f;
+
+		m[12] = poses[i].position.x;
+		m[13] = poses[i].position.y;
+		m[14] = poses[i].position.z;
+		m[15] = 1.0f;
+	}
+}
+
+#ifdef XR_LINEAR_BATCH_X86
+
+// column of the model matrix of 4 lanes: a, b, c, d hold the rows 0..3 of the column for each lane
+static inline void
+store_column(XrMatrix4x4f* results, int column, __m128 a, __m128 b, __m128 c, __m128 d)
+{
+	_MM_TRANSPOSE4_PS(a, b, c, d);
+	_mm_storeu_ps(&results[0].m[column * 4], a);
+	_mm_storeu_ps(&results[1].m[column * 4], b);
+	_mm_storeu_ps(&results[2].m[column * 4], c);
+	_mm_storeu_ps(&results[3].m[column * 4], d);
+}
+
+// XrPosef is {qx, qy, qz, qw, px, py, pz}, two overlapping loads per pose stay inside it.
+// v receives qx, qy, qz, qw, px, py, pz of 4 consecutive poses.
+static inline void
+load_poses(const XrPosef* poses, __m128 v[7])
+{
+	const float* p = (const float*)poses;
+	__m128 qx = _mm_loadu_ps(p);
+	__m128 qy = _mm_loadu_ps(p + 7);
+	__m128 qz = _mm_loadu_ps(p + 14);
+	__m128 qw = _mm_loadu_ps(p + 21);
+	_MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+	__m128 w = _mm_loadu_ps(p + 3);
+	__m128 px = _mm_loadu_ps(p + 10);
+	__m128 py = _mm_loadu_ps(p + 17);
+	__m128 pz = _mm_loadu_ps(p + 24);
+	_MM_TRANSPOSE4_PS(w, px, py, pz);
+	v[0] = qx;
+	v[1] = qy;
+	v[2] = qz;
+	v[3] = qw;
+	v[4] = px;
+	v[5] = py;
+	v[6] = pz;
+}
+
+static void
+model_matrices_sse(XrMatrix4x4f* results,
+                   const XrPosef* poses,
+                   const XrVector3f* scales,
+                   uint32_t count)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	uint32_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 v[7];
+		load_poses(&poses[i], v);
+		__m128 qx = v[0], qy = v[1], qz = v[2], qw = v[3];
+		__m128 px = v[4], py = v[5], pz = v[6];
+
+		const XrVector3f* s = &scales[i];
+		__m128 sx = _mm_setr_ps(s[0].x, s[1].x, s[2].x, s[3].x);
+		__m128 sy = _mm_setr_ps(s[0].y, s[1].y, s[2].y, s[3].y);
+		__m128 sz = _mm_setr_ps(s[0].z, s[1].z, s[2].z, s[3].z);
+
+		__m128 x2 = _mm_add_ps(qx, qx);
+		__m128 y2 = _mm_add_ps(qy, qy);
+		__m128 z2 = _mm_add_ps(qz, qz);
+
+		__m128 xx2 = _mm_mul_ps(qx, x2);
+		__m128 yy2 = _mm_mul_ps(qy, y2);
+		__m128 zz2 = _mm_mul_ps(qz, z2);
+
+		__m128 yz2 = _mm_mul_ps(qy, z2);
+		__m128 wx2 = _mm_mul_ps(qw, x2);
+		__m128 xy2 = _mm_mul_ps(qx, y2);
+		__m128 wz2 = _mm_mul_ps(qw, z2);
+		__m128 xz2 = _mm_mul_ps(qx, z2);
+		__m128 wy2 = _mm_mul_ps(qw, y2);
+
+		__m128 m0 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(one, yy2), zz2), sx);
+		__m128 m1 = _mm_mul_ps(_mm_add_ps(xy2, wz2), sx);
+		__m128 m2 = _mm_mul_ps(_mm_sub_ps(xz2, wy2), sx);
+
+		__m128 m4 = _mm_mul_ps(_mm_sub_ps(xy2, wz2), sy);
+		__m128 m5 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(one, xx2), zz2), sy);
+		__m128 m6 = _mm_mul_ps(_mm_add_ps(yz2, wx2), sy);
+
+		__m128 m8 = _mm_mul_ps(_mm_add_ps(xz2, wy2), sz);
+		__m128 m9 = _mm_mul_ps(_mm_sub_ps(yz2, wx2), sz);
+		__m128 m10 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(one, xx2), yy2), sz);
+
+		store_column(&results[i], 0, m0, m1, m2, zero);
+		store_column(&results[i], 1, m4, m5, m6, zero);
+		store_column(&results[i], 2, m8, m9, m10, zero);
+		store_column(&results[i], 3, px, py, pz, one);
+	}
+
+	model_matrices_scalar(&results[i], &poses[i], &scales[i], count - i);
+}
+
+#define LO(v) _mm256_castps256_ps128(v)
+#define HI(v) _mm256_extractf128_ps(v, 1)
+
+__attribute__((target("avx2"))) static void
+model_matrices_avx2(XrMatrix4x4f* results,
+                    const XrPosef* poses,
+                    const XrVector3f* scales,
+                    uint32_t count)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m128 zero4 = _mm_setzero_ps();
+	const __m128 one4 = _mm_set1_ps(1.0f);
+
+	uint32_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		// gathers are slower than two 4 wide loads and transposes on many CPUs
+		__m128 lo[7], hi[7];
+		load_poses(&poses[i], lo);
+		load_poses(&poses[i + 4], hi);
+		__m256 v[7];
+		for (int j = 0; j < 7; j++)
+			v[j] = _mm256_insertf128_ps(_mm256_castps128_ps256(lo[j]), hi[j], 1);
+		__m256 qx = v[0], qy = v[1], qz = v[2], qw = v[3];
+		__m256 px = v[4], py = v[5], pz = v[6];
+
+		const XrVector3f* s = &scales[i];
+		__m256 sx = _mm256_setr_ps(s[0].x, s[1].x, s[2].x, s[3].x, s[4].x, s[5].x, s[6].x, s[7].x);
+		__m256 sy = _mm256_setr_ps(s[0].y, s[1].y, s[2].y, s[3].y, s[4].y, s[5].y, s[6].y, s[7].y);
+		__m256 sz = _mm256_setr_ps(s[0].z, s[1].z, s[2].z, s[3].z, s[4].z, s[5].z, s[6].z, s[7].z);
+
+		__m256 x2 = _mm256_add_ps(qx, qx);
+		__m256 y2 = _mm256_add_ps(qy, qy);
+		__m256 z2 = _mm256_add_ps(qz, qz);
+
+		__m256 xx2 = _mm256_mul_ps(qx, x2);
+		__m256 yy2 = _mm256_mul_ps(qy, y2);
+		__m256 zz2 = _mm256_mul_ps(qz, z2);
+
+		__m256 yz2 = _mm256_mul_ps(qy, z2);
+		__m256 wx2 = _mm256_mul_ps(qw, x2);
+		__m256 xy2 = _mm256_mul_ps(qx, y2);
+		__m256 wz2 = _mm256_mul_ps(qw, z2);
+		__m256 xz2 = _mm256_mul_ps(qx, z2);
+		__m256 wy2 = _mm256_mul_ps(qw, y2);
+
+		__m256 m0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(one, yy2), zz2), sx);
+		__m256 m1 = _mm256_mul_ps(_mm256_add_ps(xy2, wz2), sx);
+		__m256 m2 = _mm256_mul_ps(_mm256_sub_ps(xz2, wy2), sx);
+
+		__m256 m4 = _mm256_mul_ps(_mm256_sub_ps(xy2, wz2), sy);
+		__m256 m5 = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(one, xx2), zz2), sy);
+		__m256 m6 = _mm256_mul_ps(_mm256_add_ps(yz2, wx2), sy);
+
+		__m256 m8 = _mm256_mul_ps(_mm256_add_ps(xz2, wy2), sz);
+		__m256 m9 = _mm256_mul_ps(_mm256_sub_ps(yz2, wx2), sz);
+		__m256 m10 = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(one, xx2), yy2), sz);
+
+		// lanes 0..3 are in the low halves, 4..7 in the high halves
+		store_column(&results[i], 0, LO(m0), LO(m1), LO(m2), zero4);
+		store_column(&results[i], 1, LO(m4), LO(m5), LO(m6), zero4);
+		store_column(&results[i], 2, LO(m8), LO(m9), LO(m10), zero4);
+		store_column(&results[i], 3, LO(px), LO(py), LO(pz), one4);
+		store_column(&results[i + 4], 0, HI(m0), HI(m1), HI(m2), zero4);
+		store_column(&results[i + 4], 1, HI(m4), HI(m5), HI(m6), zero4);
+		store_column(&results[i + 4], 2, HI(m8), HI(m9), HI(m10), zero4);
+		store_column(&results[i + 4], 3, HI(px), HI(py), HI(pz), one4);
+	}
+
+	model_matrices_sse(&results[i], &poses[i], &scales[i], count - i);
+}
+
+#endif // XR_LINEAR_BATCH_X86
+
+enum xr_simd_level
+XrMatrix4x4f_DetectSimdLevel(void)
+{
+#ifdef XR_LINEAR_BATCH_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return XR_SIMD_AVX2;
+	return XR_SIMD_SSE;
+#else
+	return XR_SIMD_SCALAR;
+#endif
+}
+
+enum xr_simd_level
+XrMatrix4x4f_DefaultSimdLevel(void)
+{
+	// AVX2 measured slower than SSE for the batch sizes of a hand, it is only used when set
+	enum xr_simd_level detected = XrMatrix4x4f_DetectSimdLevel();
+	return detected > XR_SIMD_SSE ? XR_SIMD_SSE : detected;
+}
+
+static const struct model_matrices_kernel*
+kernel_for(enum xr_simd_level level)
+{
+	static const struct model_matrices_kernel kernels[] = {
+	    {model_matrices_scalar, XR_SIMD_SCALAR},
+#ifdef XR_LINEAR_BATCH_X86
+	    {model_matrices_sse, XR_SIMD_SSE},
+	    {model_matrices_avx2, XR_SIMD_AVX2},
+#endif
+	};
+	for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++)
+		if (kernels[i].level == level)
+			return &kernels[i];
+	return &kernels[0];
+}
+
+bool
+XrMatrix4x4f_SetSimdLevel(enum xr_simd_level level)
+{
+	if (level > XrMatrix4x4f_DetectSimdLevel())
+		return false;
+
+	atomic_store_explicit(&model_matrices_kernel, kernel_for(level), memory_order_release);
+	return true;
+}
+
+// the kernel in use, the default one unless XrMatrix4x4f_SetSimdLevel() picked another
+static const struct model_matrices_kernel*
+current_kernel(void)
+{
+	const struct model_matrices_kernel* kernel =
+	    atomic_load_explicit(&model_matrices_kernel, memory_order_acquire);
+	if (kernel != NULL)
+		return kernel;
+
+	// racing first calls agree on the default kernel, a concurrent SetSimdLevel() wins
+	const struct model_matrices_kernel* fallback = kernel_for(XrMatrix4x4f_DefaultSimdLevel());
+	if (atomic_compare_exchange_strong_explicit(&model_matrices_kernel, &kernel, fallback,
+	                                            memory_order_acq_rel, memory_order_acquire))
+		return fallback;
+	return kernel;
+}
+
+enum xr_simd_level
+XrMatrix4x4f_GetSimdLevel(void)
+{
+	return current_kernel()->level;
+}
+
+const char*
+xr_simd_level_name(enum xr_simd_level level)
+{
+	switch (level) {
+	case XR_SIMD_SCALAR: return "scalar";
+	case XR_SIMD_SSE: return "sse";
+	case XR_SIMD_AVX2: return "avx2";
+	}
+	return "unknown";
+}
+
+void
+XrMatrix4x4f_CreateModelMatrices(XrMatrix4x4f* results,
+                                 const XrPosef* poses,
+                                 const XrVector3f* scales,
+                                 uint32_t count)
+{
+	current_kernel()->fn(results, poses, scales, count);
+}
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Batch versions of the xr_linear.h model matrix helper with SSE and AVX2 kernels.
+ *
+ * XrMatrix4x4f_CreateModelMatrices() builds one model matrix per pose and scale, with the same
+ * result as calling XrMatrix4x4f_CreateModelMatrix() on each of them. The kernel is picked on the
+ * first call from the features of the CPU: SSE on x86 even if it has AVX2, which was slower for the
+ * few dozen joints of a hand (see matrix_bench). XrMatrix4x4f_SetSimdLevel() overrides it, also to
+ * AVX2. Both may be called from several threads at once.
+ */
+
+#ifndef XR_LINEAR_BATCH_H
+#define XR_LINEAR_BATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "xr_linear.h"
+
+enum xr_simd_level
+{
+	XR_SIMD_SCALAR,
+	XR_SIMD_SSE,
+	XR_SIMD_AVX2,
+};
+
+void
+XrMatrix4x4f_CreateModelMatrices(XrMatrix4x4f* results,
+                                 const XrPosef* poses,
+                                 const XrVector3f* scales,
+                                 uint32_t count);
+
+// best level supported by this CPU and build
+enum xr_simd_level
+XrMatrix4x4f_DetectSimdLevel(void);
+
+// what the first call uses: the detected level, but at most SSE
+enum xr_simd_level
+XrMatrix4x4f_DefaultSimdLevel(void);
+
+// returns false and keeps the current kernel if level is not supported
+bool
+XrMatrix4x4f_SetSimdLevel(enum xr_simd_level level);
+
+enum xr_simd_level
+XrMatrix4x4f_GetSimdLevel(void);
+
+const char*
+xr_simd_level_name(enum xr_simd_level level);
+
+#endif // XR_LINEAR_BATCH_H